@@ -0,0 +1,337 @@
+//==================================================================================================
+//
+// File:	Benchmark.cpp
+//
+// Runs the registered benchmarks. Each one is first calibrated to an iteration count that runs
+// for at least the minimum time, which also warms up caches and branch predictors, and is then
+// run that many iterations once per repetition.
+//
+//=================================================================================================
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "Pch.h"
+#include "Benchmark.h"
+
+namespace Bench
+{
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+//=============================================================================
+struct Benchmark
+{
+	std::string         name;
+	BenchmarkFunc       func;
+	std::vector<uint64> args;
+};
+
+//=============================================================================
+struct Result
+{
+	std::string name;
+	uint64      iterations;
+	float64     median;		// Nanoseconds per iteration
+	float64     mean;
+	float64     deviation;
+	float64     min;
+	float64     itemsPerSecond;
+};
+
+//=============================================================================
+// A function static so registering from the initializers of other files is safe
+static std::vector<Benchmark> & GetBenchmarks ()
+{
+	static std::vector<Benchmark> s_benchmarks;
+	return s_benchmarks;
+}
+
+//=============================================================================
+static float64 Run (const Benchmark & benchmark, uint64 arg, uint64 iterations, uint64 * items)
+{
+	State state(iterations, arg);
+	benchmark.func(state);
+
+	*items = state.GetItemsPerIteration();
+	return state.GetSeconds();
+}
+
+//=============================================================================
+// Finds how many iterations run for at least minSeconds, growing the count by what the last run
+// predicts but never more than tenfold at a time
+static uint64 Calibrate (const Benchmark & benchmark, uint64 arg, float64 minSeconds)
+{
+	uint64 iterations = 1;
+	for (;;)
+	{
+		uint64 items;
+		const float64 seconds = Run(benchmark, arg, iterations, &items);
+		if (seconds >= minSeconds)
+			return iterations;
+
+		const float64 predicted = seconds > 0.0 ? minSeconds * 1.4 / seconds : 10.0;
+		iterations = uint64(std::ceil(float64(iterations) * Min(Max(predicted, 2.0), 10.0)));
+	}
+}
+
+//=============================================================================
+static float64 GetMedian (std::vector<float64> values)
+{
+	std::sort(values.begin(), values.end());
+
+	const size_t middle = values.size() / 2;
+	return values.size() % 2 ? values[middle] : 0.5 * (values[middle - 1] + values[middle]);
+}
+
+//=============================================================================
+// Pins the process and warns about what makes timings on Linux noisy
+static void SetupMachine (const Options & options)
+{
+#if defined(__linux__)
+	if (options.cpu >= 0)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(options.cpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set))
+			std::cerr << "warning: could not pin to cpu " << options.cpu << std::endl;
+	}
+
+	std::ifstream governorFile("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor");
+	std::string   governor;
+	if (governorFile >> governor && governor != "performance")
+		std::cerr << "warning: cpu frequency governor is " << governor << ", timings will vary with the clock" << std::endl;
+#else
+	if (options.cpu >= 0)
+		std::cerr << "warning: --cpu is only supported on Linux" << std::endl;
+#endif
+
+#if defined(BUILD_DEBUG)
+	std::cerr << "warning: this is a debug build" << std::endl;
+#endif
+}
+
+//=============================================================================
+static bool WriteJson (const char * filename, const Options & options, const std::vector<Result> & results)
+{
+	std::ofstream out(filename);
+	if (!out)
+		return false;
+
+	out << std::fixed << std::setprecision(3)
+		<< "{\"repetitions\":" << options.repetitions
+		<< ",\"min_seconds\":"  << options.minSeconds
+		<< ",\"benchmarks\":[";
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const Result & result = results[i];
+		out
+			<< (i ? "," : "")
+			<< "{\"name\":"             << JsonString(result.name.c_str())
+			<< ",\"iterations\":"       << result.iterations
+			<< ",\"median_ns\":"        << result.median
+			<< ",\"mean_ns\":"          << result.mean
+			<< ",\"stddev_ns\":"        << result.deviation
+			<< ",\"min_ns\":"           << result.min
+			<< ",\"items_per_second\":" << result.itemsPerSecond
+			<< "}";
+	}
+
+	out << "]}" << std::endl;
+	return bool(out);
+}
+
+//=============================================================================
+// Returns how many results are slower than their baseline by more than the threshold, or -1 if
+// the baseline can not be read
+static sint32 CompareBaseline (const char * filename, float64 threshold, const std::vector<Result> & results)
+{
+	using namespace Json;
+
+	CDocument doc;
+	doc.Parse(filename);
+	if (!doc.IsValid())
+		return -1;
+
+	const CValue & benchmarks = doc.GetValue()[{"benchmarks"}];
+	if (benchmarks.GetType() != EType::Array)
+		return -1;
+
+	sint32 regressions = 0;
+	for (const CValue & baseline : *benchmarks.As<ArrayType>())
+	{
+		const CValue & name   = baseline[{"name"}];
+		const CValue & median = baseline[{"median_ns"}];
+		if (name.GetType() != EType::String || median.GetType() != EType::Number)
+			continue;
+
+		for (const Result & result : results)
+		{
+			if (result.name != name.As<StringType>()->Ptr())
+				continue;
+
+			const float64 before = *median.As<NumberType>();
+			const float64 change = before > 0.0 ? result.median / before - 1.0 : 0.0;
+			const bool    slower = change > threshold;
+			regressions += slower;
+
+			std::cout
+				<< std::left << std::setw(32) << result.name << std::right
+				<< std::fixed << std::setprecision(1)
+				<< std::setw(12) << before << " ns ->"
+				<< std::setw(12) << result.median << " ns "
+				<< std::showpos << std::setw(7) << change * 100.0 << "%" << std::noshowpos
+				<< (slower ? "  REGRESSION" : "")
+				<< std::endl;
+		}
+	}
+
+	return regressions;
+}
+
+
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+State::State (uint64 iterations, uint64 arg) :
+	mIterations(iterations),
+	mRemaining(iterations),
+	mArg(arg),
+	mItemsPerIteration(1),
+	mSeconds(0.0)
+{
+}
+
+//=============================================================================
+bool Register (const char * name, BenchmarkFunc func, std::initializer_list<uint64> args)
+{
+	GetBenchmarks().push_back({ name, func, args });
+	return true;
+}
+
+//=============================================================================
+int RunBenchmarks (const Options & options)
+{
+	if (!options.repetitions)
+		return 2;
+
+	std::vector<std::pair<const Benchmark *, uint64>> runs;
+	for (const Benchmark & benchmark : GetBenchmarks())
+	{
+		if (benchmark.args.empty())
+			runs.push_back({ &benchmark, 0 });
+
+		for (uint64 arg : benchmark.args)
+			runs.push_back({ &benchmark, arg });
+	}
+
+	const auto getName = [](const std::pair<const Benchmark *, uint64> & run) {
+		std::ostringstream name;
+		name << run.first->name;
+		if (!run.first->args.empty())
+			name << "/" << run.second;
+		return name.str();
+	};
+
+	if (options.list)
+	{
+		for (const auto & run : runs)
+			std::cout << getName(run) << std::endl;
+		return 0;
+	}
+
+	SetupMachine(options);
+
+	std::cout
+		<< std::left << std::setw(32) << "benchmark" << std::right
+		<< std::setw(12) << "iterations"
+		<< std::setw(14) << "median ns"
+		<< std::setw(14) << "mean ns"
+		<< std::setw(9)  << "stddev"
+		<< std::setw(14) << "min ns"
+		<< std::setw(14) << "items/s"
+		<< std::endl;
+
+	std::vector<Result> results;
+	for (const auto & run : runs)
+	{
+		const std::string name = getName(run);
+		if (name.find(options.filter) == std::string::npos)
+			continue;
+
+		const Benchmark & benchmark  = *run.first;
+		const uint64      iterations = Calibrate(benchmark, run.second, options.minSeconds);
+
+		std::vector<float64> times(options.repetitions);
+		uint64 items = 1;
+		for (float64 & time : times)
+			time = Run(benchmark, run.second, iterations, &items) * 1e9 / float64(iterations);
+
+		float64 sum = 0.0;
+		for (float64 time : times)
+			sum += time;
+
+		float64 squares = 0.0;
+		for (float64 time : times)
+			squares += Sq(time - sum / times.size());
+
+		Result result;
+		result.name           = name;
+		result.iterations     = iterations;
+		result.median         = GetMedian(times);
+		result.mean           = sum / times.size();
+		result.deviation      = times.size() > 1 ? std::sqrt(squares / (times.size() - 1)) : 0.0;
+		result.min            = *std::min_element(times.begin(), times.end());
+		result.itemsPerSecond = result.median > 0.0 ? items * 1e9 / result.median : 0.0;
+		results.push_back(result);
+
+		std::cout
+			<< std::left << std::setw(32) << result.name << std::right
+			<< std::setw(12) << result.iterations
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(14) << result.median
+			<< std::setw(14) << result.mean
+			<< std::setw(8)  << (result.mean > 0.0 ? result.deviation / result.mean * 100.0 : 0.0) << "%"
+			<< std::setw(14) << result.min
+			<< std::setprecision(0)
+			<< std::setw(14) << result.itemsPerSecond
+			<< std::endl;
+	}
+
+	if (!options.jsonPath.empty() && !WriteJson(options.jsonPath.c_str(), options, results))
+	{
+		std::cerr << "error: could not write " << options.jsonPath << std::endl;
+		return 2;
+	}
+
+	if (options.baselinePath.empty())
+		return 0;
+
+	std::cout << std::endl << "against " << options.baselinePath << std::endl;
+	const sint32 regressions = CompareBaseline(options.baselinePath.c_str(), options.threshold, results);
+	if (regressions < 0)
+	{
+		std::cerr << "error: could not read " << options.baselinePath << std::endl;
+		return 2;
+	}
+
+	return regressions ? 1 : 0;
+}
+
+} // namespace Bench
@@ -0,0 +1,117 @@
+//==================================================================================================
+//
+// File:	Benchmark.h
+//
+// A small microbenchmark harness in the spirit of Google Benchmark. Kernels register themselves
+// with BENCHMARK, time their hot loop with State::KeepRunning and are run a number of repetitions
+// each, so what gets reported is the median of several measurements rather than a single one.
+//=================================================================================================
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace Bench
+{
+
+//==================================================================================================
+//
+// Handed to a benchmark for one run. Only the loop over KeepRunning is timed, anything the
+// benchmark sets up before it is not.
+//==================================================================================================
+class State
+{
+public:
+	State (uint64 iterations, uint64 arg);
+
+	inline bool KeepRunning ();
+
+	inline uint64 GetArg () const { return mArg; }
+	inline uint64 GetIterations () const { return mIterations; }
+	inline float64 GetSeconds () const { return mSeconds; }
+
+	//! What one iteration processed, for the items per second of the report
+	inline void SetItemsPerIteration (uint64 items) { mItemsPerIteration = items; }
+	inline uint64 GetItemsPerIteration () const { return mItemsPerIteration; }
+
+private:
+	uint64      mIterations;
+	uint64      mRemaining;
+	uint64      mArg;
+	uint64      mItemsPerIteration;
+	Time::Point mStart;
+	float64     mSeconds;
+};
+
+typedef void (*BenchmarkFunc)(State & state);
+
+//! Adds a benchmark, run once per argument or once with 0 without any. Returns true so it can
+//! initialize a static.
+bool Register (const char * name, BenchmarkFunc func, std::initializer_list<uint64> args);
+
+//==================================================================================================
+//
+// How the benchmarks are run
+//==================================================================================================
+struct Options
+{
+	float64     minSeconds  = 0.1;		//!< Every repetition runs at least this long
+	uint32      repetitions = 10;
+	std::string filter;					//!< Only benchmarks whose name contains this
+	std::string jsonPath;				//!< Where the results are written as json, if anywhere
+	std::string baselinePath;			//!< Results of an earlier run to compare against
+	float64     threshold   = 0.1;		//!< How much slower than the baseline counts as a regression
+	sint32      cpu         = -1;		//!< Cpu the process is pinned to, -1 to leave it free
+	bool        list        = false;	//!< Print the names only
+};
+
+//! Runs every registered benchmark matching the filter. Returns the exit code of the process:
+//! 0 on success, 1 when a benchmark regressed against the baseline, 2 on errors.
+int RunBenchmarks (const Options & options);
+
+//! Keeps the compiler from optimizing away value, or the computation producing it
+template <typename T>
+inline void DoNotOptimize (const T & value);
+
+
+
+//=============================================================================
+inline bool State::KeepRunning ()
+{
+	if (mRemaining == mIterations)
+		mStart = Time::GetRealTime();
+
+	if (mRemaining)
+	{
+		--mRemaining;
+		return true;
+	}
+
+	mSeconds = (Time::GetRealTime() - mStart).GetSeconds();
+	return false;
+}
+
+//=============================================================================
+template <typename T>
+inline void DoNotOptimize (const T & value)
+{
+#if defined(_MSC_VER)
+	static const void * volatile s_sink;
+	s_sink = &value;
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+} // namespace Bench
+
+#define BENCHMARK(func) \
+	static const bool s_registered##func = ::Bench::Register(#func, func, {})
+
+#define BENCHMARK_ARGS(func, ...) \
+	static const bool s_registered##func = ::Bench::Register(#func, func, { __VA_ARGS__ })
+
+#endif //BENCHMARK_H
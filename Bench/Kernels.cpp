@@ -0,0 +1,289 @@
+//==================================================================================================
+//
+// File:	Kernels.cpp
+//
+// Benchmarks of the kernels a render spends its time in. Inputs are generated from fixed seeds
+// before the timed loop and cycled through, so every run sees the same work.
+//
+//=================================================================================================
+
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "Pch.h"
+#include "Benchmark.h"
+
+using namespace RT;
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+static const uint32 INPUT_COUNT = 1024;		// Power of two, inputs are picked with a mask
+
+//=============================================================================
+static Material GetMaterial ()
+{
+	Material material;
+	material.type     = MATERIAL_TYPE_DIFFUSE;
+	material.diffuse  = Color(1.0f, 1.0f, 1.0f);
+	material.emissive = Color::Black;
+	return material;
+}
+
+//=============================================================================
+static Vector3 GetRandomDirection (Random & random)
+{
+	for (;;)
+	{
+		const Vector3 v(
+			random.GetFloat32() * 2.0f - 1.0f,
+			random.GetFloat32() * 2.0f - 1.0f,
+			random.GetFloat32() * 2.0f - 1.0f
+		);
+
+		const float32 lengthSq = Dot(v, v);
+		if (lengthSq > 1e-4f && lengthSq <= 1.0f)
+			return v * (1.0f / Sqrt(lengthSq));
+	}
+}
+
+//=============================================================================
+// Rays from around bounds towards points of a box a little larger, about half of them hit
+static std::vector<Ray3> CreateRays (const Aabb3 & bounds)
+{
+	Random random;
+	random.Seed(1);
+
+	const Vector3 center = (Vector3(bounds.min) + Vector3(bounds.max)) * 0.5f;
+	const Vector3 extent = (Vector3(bounds.max) - Vector3(bounds.min)) * 0.5f;
+	const float32 radius = Sqrt(Dot(extent, extent));
+
+	std::vector<Ray3> rays;
+	for (uint32 i = 0; i < INPUT_COUNT; ++i)
+	{
+		Vector3 from;
+		Vector3 to;
+		for (uint axis = 0; axis < 3; ++axis)
+		{
+			from[axis] = center[axis] + (random.GetFloat32() * 2.0f - 1.0f) * radius * 3.0f;
+			to[axis]   = center[axis] + (random.GetFloat32() * 2.0f - 1.0f) * extent[axis] * 1.5f;
+		}
+
+		rays.push_back(Ray3(Point3(from), Normalize(to - from)));
+	}
+
+	return rays;
+}
+
+//=============================================================================
+static void BenchmarkIntersect (Bench::State & state, const Object & object)
+{
+	const std::vector<Ray3> rays = CreateRays(object.GetBounds());
+
+	uint32 i = 0;
+	while (state.KeepRunning())
+	{
+		Result result;
+		Bench::DoNotOptimize(object.Intersect(result, rays[i++ & (INPUT_COUNT - 1)]));
+		Bench::DoNotOptimize(result);
+	}
+}
+
+//=============================================================================
+// count spheres in a cube, sized so the cube stays about equally full at every count
+static std::unique_ptr<Scene> CreateSphereScene (uint32 count)
+{
+	Random random;
+	random.Seed(2);
+
+	const float32 side   = 100.0f;
+	const float32 radius = 0.5f * side / std::cbrt(float32(count));
+
+	std::unique_ptr<Scene> scene(new Scene());
+	for (uint32 i = 0; i < count; ++i)
+	{
+		const Point3 center(
+			(random.GetFloat32() - 0.5f) * side,
+			(random.GetFloat32() - 0.5f) * side,
+			(random.GetFloat32() - 0.5f) * side
+		);
+
+		scene->AddObject(new Sphere(center, radius * (0.5f + random.GetFloat32()), GetMaterial()));
+	}
+
+	scene->BuildBvh();
+	return scene;
+}
+
+
+
+//=============================================================================
+// Benchmarks
+//=============================================================================
+
+//=============================================================================
+static void SphereIntersect (Bench::State & state)
+{
+	BenchmarkIntersect(state, Sphere(Point3(0.0f, 0.0f, 0.0f), 1.0f, GetMaterial()));
+}
+BENCHMARK(SphereIntersect);
+
+//=============================================================================
+static void EllipsoidIntersect (Bench::State & state)
+{
+	BenchmarkIntersect(state, Ellipsoid(Point3(0.0f, 0.0f, 0.0f), Vector3(3.0f, 1.0f, 2.0f), GetMaterial()));
+}
+BENCHMARK(EllipsoidIntersect);
+
+//=============================================================================
+static void AabbIntersect (Bench::State & state)
+{
+	BenchmarkIntersect(state, Aabb(Point3(-1.0f, -2.0f, -1.0f), Point3(1.0f, 2.0f, 1.0f), GetMaterial()));
+}
+BENCHMARK(AabbIntersect);
+
+//=============================================================================
+// The scene of every count is built once, the first time it is needed
+static void SceneFindObject (Bench::State & state)
+{
+	static std::map<uint64, std::unique_ptr<Scene>> s_scenes;
+
+	std::unique_ptr<Scene> & scene = s_scenes[state.GetArg()];
+	if (!scene)
+		scene = CreateSphereScene(uint32(state.GetArg()));
+
+	// From outside the cube through it, so rays pass through the whole hierarchy
+	Random random;
+	random.Seed(3);
+
+	std::vector<Ray3> rays;
+	for (uint32 i = 0; i < INPUT_COUNT; ++i)
+	{
+		const Vector3 from = GetRandomDirection(random) * 150.0f;
+		const Vector3 to(
+			(random.GetFloat32() - 0.5f) * 100.0f,
+			(random.GetFloat32() - 0.5f) * 100.0f,
+			(random.GetFloat32() - 0.5f) * 100.0f
+		);
+
+		rays.push_back(Ray3(Point3(from), Normalize(to - from)));
+	}
+
+	uint32 i = 0;
+	while (state.KeepRunning())
+	{
+		const Object * object = null;
+		Result result;
+		Bench::DoNotOptimize(scene->FindObject(object, result, rays[i++ & (INPUT_COUNT - 1)]));
+		Bench::DoNotOptimize(object);
+	}
+}
+BENCHMARK_ARGS(SceneFindObject, 1, 10, 100, 1000, 10000, 100000, 1000000);
+
+//=============================================================================
+static void CameraGetRay (Bench::State & state)
+{
+	Camera camera;
+	camera.Setup(Point3(0.0f, 0.0f, -10.0f), Point3(0.0f, 0.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), 1.0f, 1.0f, 16.0f / 9.0f);
+
+	// A 32x32 grid over the screen
+	uint32 i = 0;
+	while (state.KeepRunning())
+	{
+		const float64 u = float64(i & 31) / 16.0 - 1.0;
+		const float64 v = float64((i >> 5) & 31) / 16.0 - 1.0;
+		++i;
+
+		Bench::DoNotOptimize(camera.GetRay(u, v));
+	}
+}
+BENCHMARK(CameraGetRay);
+
+//=============================================================================
+static void SampleHemisphere (Bench::State & state)
+{
+	Random random;
+	random.Seed(4);
+
+	while (state.KeepRunning())
+		Bench::DoNotOptimize(SampleInHemisphere(random));
+}
+BENCHMARK(SampleHemisphere);
+
+//=============================================================================
+static void CosineSampleHemisphere (Bench::State & state)
+{
+	Random random;
+	random.Seed(5);
+
+	while (state.KeepRunning())
+		Bench::DoNotOptimize(CosineSampleInHemisphere(random));
+}
+BENCHMARK(CosineSampleHemisphere);
+
+//=============================================================================
+// Half the rays leave glass for air, some of those at angles past total internal reflection
+static void Transmission (Bench::State & state)
+{
+	Random random;
+	random.Seed(6);
+
+	std::vector<Vector3> directions;
+	for (uint32 i = 0; i < INPUT_COUNT; ++i)
+		directions.push_back(GetRandomDirection(random));
+
+	const Vector3 normal(0.0f, 1.0f, 0.0f);
+
+	uint32 i = 0;
+	while (state.KeepRunning())
+	{
+		const Vector3 & direction = directions[i & (INPUT_COUNT - 1)];
+		const bool      entering  = (i++ & 1) != 0;
+
+		Vector3 transmitted;
+		Vector3 reflected;
+		float32 coeffT;
+		float32 coeffR;
+		Bench::DoNotOptimize(ComputeTransmission(
+			direction,
+			normal,
+			entering ? 1.0f : 1.5f,
+			entering ? 1.5f : 1.0f,
+			transmitted,
+			coeffT,
+			reflected,
+			coeffR
+		));
+		Bench::DoNotOptimize(transmitted);
+		Bench::DoNotOptimize(coeffR);
+	}
+}
+BENCHMARK(Transmission);
+
+//=============================================================================
+// Writes an arg by arg image to a file in the working directory
+static void ImageSave (Bench::State & state)
+{
+	const uint size = uint(state.GetArg());
+
+	Random random;
+	random.Seed(7);
+
+	CImage image(size, size);
+	for (uint y = 0; y < size; ++y)
+		for (uint x = 0; x < size; ++x)
+			image.SetPixel(x, y, Color(random.GetFloat32(), random.GetFloat32(), random.GetFloat32()));
+
+	const char * filename = "bench_image_save.tga";
+
+	state.SetItemsPerIteration(uint64(size) * size);
+	while (state.KeepRunning())
+		image.Save(filename);
+
+	std::remove(filename);
+}
+BENCHMARK_ARGS(ImageSave, 256, 1024);
@@ -0,0 +1,71 @@
+#include "Pch.h"
+#define USES_ENGINE_STRING
+#include "Pch.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "Benchmark.h"
+
+//=============================================================================
+static void PrintBenchUsage (const char * exe)
+{
+    std::cout <<
+        "Usage: " << exe << " [options]\n"
+        "  --filter <text>         Only run benchmarks whose name contains text\n"
+        "  --min-time <seconds>    Run every repetition at least this long (default 0.1)\n"
+        "  --repetitions <n>       Repetitions per benchmark, the median is reported (default 10)\n"
+        "  --json <file>           Write the results as json\n"
+        "  --baseline <file>       Compare against the json of an earlier run, exit 1 on regressions\n"
+        "  --threshold <fraction>  How much slower than the baseline is a regression (default 0.1)\n"
+        "  --cpu <index>           Pin to a cpu, Linux only\n"
+        "  --list                  Print the benchmarks and exit\n"
+        "  --help                  Show this message\n";
+}
+
+//=============================================================================
+int main (int argc, char * argv[])
+{
+    Bench::Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char * arg   = argv[i];
+        const char * value = i + 1 < argc ? argv[i + 1] : null;
+
+        if (!strcmp(arg, "--list"))
+        {
+            options.list = true;
+            continue;
+        }
+
+        if (!strcmp(arg, "--help"))
+        {
+            PrintBenchUsage(argv[0]);
+            return 0;
+        }
+
+        if (!value)
+        {
+            PrintBenchUsage(argv[0]);
+            return 2;
+        }
+
+        ++i;
+        if      (!strcmp(arg, "--filter"))      options.filter       = value;
+        else if (!strcmp(arg, "--min-time"))    options.minSeconds   = atof(value);
+        else if (!strcmp(arg, "--repetitions")) options.repetitions  = uint32(atoi(value));
+        else if (!strcmp(arg, "--json"))        options.jsonPath     = value;
+        else if (!strcmp(arg, "--baseline"))    options.baselinePath = value;
+        else if (!strcmp(arg, "--threshold"))   options.threshold    = atof(value);
+        else if (!strcmp(arg, "--cpu"))         options.cpu          = sint32(atoi(value));
+        else
+        {
+            PrintBenchUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    return Bench::RunBenchmarks(options);
+}
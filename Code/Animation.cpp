@@ -0,0 +1,73 @@
+//==================================================================================================
+//
+// File:	Animation.cpp
+//
+// Parses and samples keyframed instance transforms.
+//
+//=================================================================================================
+
+#include <algorithm>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+bool ParseAnimationTrack (const Json::CValue & json, uint32 object, AnimationTrack * out)
+{
+	using namespace Json;
+
+	if (json.GetType() != EType::Array)
+		return false;
+
+	out->object = object;
+	out->keyframes.clear();
+
+	for (const CValue & jsonKeyframe : *json.As<ArrayType>())
+	{
+		const CValue & jsonFrame = jsonKeyframe[{"frame"}];
+		if (jsonFrame.GetType() != EType::Number)
+			return false;
+
+		Keyframe keyframe;
+		keyframe.frame = float32(*jsonFrame.As<NumberType>());
+		if (!ParseTransformDesc(jsonKeyframe, &keyframe.transform))
+			return false;
+
+		out->keyframes.push_back(keyframe);
+	}
+
+	if (out->keyframes.empty())
+		return false;
+
+	std::stable_sort(out->keyframes.begin(), out->keyframes.end(), [](const Keyframe & a, const Keyframe & b) {
+		return a.frame < b.frame;
+	});
+
+	return true;
+}
+
+//=============================================================================
+TransformDesc SampleAnimationTrack (const AnimationTrack & track, float32 frame)
+{
+	ASSERT(!track.keyframes.empty());
+
+	const std::vector<Keyframe> & keyframes = track.keyframes;
+	if (frame <= keyframes.front().frame)
+		return keyframes.front().transform;
+
+	if (frame >= keyframes.back().frame)
+		return keyframes.back().transform;
+
+	// First keyframe after frame, the one before it is at or before frame
+	const auto next = std::upper_bound(keyframes.begin(), keyframes.end(), frame, [](float32 value, const Keyframe & keyframe) {
+		return value < keyframe.frame;
+	});
+	const auto prev = next - 1;
+
+	const float32 t = (frame - prev->frame) / (next->frame - prev->frame);
+	return BlendTransforms(prev->transform, next->transform, t);
+}
+
+} // namespace RT
@@ -0,0 +1,41 @@
+//==================================================================================================
+//
+// File:	Animation.h
+//
+// Keyframed instance transforms for rendering a scene as a sequence of frames. The scene is read
+// once, every frame only moves the animated instances and updates the bvh over them.
+//=================================================================================================
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <vector>
+
+namespace RT
+{
+
+struct Keyframe
+{
+	float32       frame;
+	TransformDesc transform;
+};
+
+//==================================================================================================
+//
+// The keyframes of one instance, sorted by frame. Before the first and after the last keyframe
+// the instance holds still.
+//==================================================================================================
+struct AnimationTrack
+{
+	uint32                object;		//!< Index of the instance in the scene's objects
+	std::vector<Keyframe> keyframes;
+};
+
+//! Parses an array of keyframes, each a "frame" number with the parts of a transform
+bool ParseAnimationTrack (const Json::CValue & json, uint32 object, AnimationTrack * out);
+
+//! Blends the keyframes on either side of frame
+TransformDesc SampleAnimationTrack (const AnimationTrack & track, float32 frame);
+
+} // namespace RT
+
+#endif //ANIMATION_H
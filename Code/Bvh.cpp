@@ -0,0 +1,856 @@
+//==================================================================================================
+//
+// File:	Bvh.cpp
+//
+// Builds bounding volume hierarchies, either with a binned surface area heuristic or by sorting the
+// primitives along a Morton curve. Both split large ranges over several threads.
+//
+//=================================================================================================
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+// Constants
+//=============================================================================
+static const uint32  BIN_COUNT          = 16;
+static const uint32  MAX_LEAF_SIZE      = 8;
+static const uint32  LBVH_LEAF_SIZE     = 4;
+static const uint32  SAH_DEPTH_LIMIT    = 32;		// Deeper than this splits at the median to bound the depth
+static const float32 TRAVERSAL_COST     = 1.0f;	// Relative to intersecting one primitive
+static const float32 INFINITY_F         = std::numeric_limits<float32>::infinity();
+static const uint32  MORTON_BITS        = 10;		// Per axis
+static const uint32  PARALLEL_TASK_SIZE = 1 << 12;	// Subtrees smaller than this stay on their thread
+static const uint32  PARALLEL_CHUNK     = 1 << 14;	// Fewest primitives a thread bins or codes
+static const uint32  RADIX_BITS         = 11;
+
+
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+//=============================================================================
+struct Bounds
+{
+	Point3 min;
+	Point3 max;
+
+	Bounds () :
+		min( INFINITY_F,  INFINITY_F,  INFINITY_F),
+		max(-INFINITY_F, -INFINITY_F, -INFINITY_F)
+	{
+	}
+
+	void Grow (const Point3 & point)
+	{
+		for (uint axis = 0; axis < 3; ++axis)
+		{
+			min[axis] = Min(min[axis], point[axis]);
+			max[axis] = Max(max[axis], point[axis]);
+		}
+	}
+
+	// Per side, so growing by an empty bounds leaves this one as it is
+	void Grow (const Bounds & bounds)
+	{
+		for (uint axis = 0; axis < 3; ++axis)
+		{
+			min[axis] = Min(min[axis], bounds.min[axis]);
+			max[axis] = Max(max[axis], bounds.max[axis]);
+		}
+	}
+
+	float32 HalfArea () const
+	{
+		if (min.x > max.x)
+			return 0.0f;
+
+		const Vector3 d = max - min;
+		return d.x * d.y + d.y * d.z + d.z * d.x;
+	}
+};
+
+//=============================================================================
+struct BuildPrimitive
+{
+	Bounds bounds;
+	Point3 centroid;
+	uint32 index;
+};
+
+//=============================================================================
+struct Bin
+{
+	Bounds bounds;
+	uint32 count = 0;
+};
+
+//=============================================================================
+static BuildPrimitive MakePrimitive (const Aabb3 & bounds, uint32 index)
+{
+	BuildPrimitive primitive;
+	primitive.bounds.Grow(bounds.min);
+	primitive.bounds.Grow(bounds.max);
+	primitive.centroid = (bounds.min + bounds.max) * 0.5f;
+	primitive.index    = index;
+	return primitive;
+}
+
+//=============================================================================
+static void SetBounds (BvhNode * node, const Bounds & bounds)
+{
+	for (uint axis = 0; axis < 3; ++axis)
+	{
+		node->min[axis] = bounds.min[axis];
+		node->max[axis] = bounds.max[axis];
+	}
+}
+
+//=============================================================================
+// Spreads the low 10 bits of value so there are two zero bits between each of them
+static uint32 SpreadBits (uint32 value)
+{
+	value = (value | (value << 16)) & 0x030000ff;
+	value = (value | (value <<  8)) & 0x0300f00f;
+	value = (value | (value <<  4)) & 0x030c30c3;
+	value = (value | (value <<  2)) & 0x09249249;
+	return value;
+}
+
+//=============================================================================
+// Builds a hierarchy top down. Once both halves of a split are large enough the second half is
+// built on a thread of its own into its own nodes, which are appended after the first half's.
+class BvhBuilder
+{
+public:
+	BvhBuilder (std::vector<BuildPrimitive> & primitives, uint threadCount) :
+		mPrimitives(primitives),
+		mThreadCount(threadCount),
+		mSpareThreads(int(threadCount) - 1)
+	{
+	}
+
+	//! depth is how far below the root of the whole hierarchy these nodes start
+	void BuildSah (std::vector<BvhNode> & nodes, uint32 depth = 0);
+	void BuildLbvh (std::vector<BvhNode> & nodes, uint32 depth = 0);
+
+private:
+	void   BuildSah (uint32 begin, uint32 end, uint32 depth, std::vector<BvhNode> & nodes);
+	void   BuildMorton (const std::vector<uint32> & codes, uint32 begin, uint32 end, uint32 depth, std::vector<BvhNode> & nodes);
+
+	template <typename TBuild>
+	void   BuildChildren (uint32 node, uint32 begin, uint32 mid, uint32 end, std::vector<BvhNode> & nodes, TBuild && build);
+
+	uint32 GetChunkCount (uint32 count) const;
+	void   ComputeBounds (uint32 begin, uint32 end, Bounds * bounds, Bounds * centroidBounds) const;
+	uint32 Split (uint32 begin, uint32 end, uint32 depth, const Bounds & centroidBounds, const Bounds & bounds);
+	void   MakeLeaf (BvhNode * node, uint32 begin, uint32 end);
+
+	std::vector<BuildPrimitive> & mPrimitives;
+	uint                          mThreadCount;
+	std::atomic<int>              mSpareThreads;
+};
+
+//=============================================================================
+// Threads for a range of primitives, its share of every thread and never less than a chunk each
+uint32 BvhBuilder::GetChunkCount (uint32 count) const
+{
+	const uint64 share = (uint64(mThreadCount) * count + mPrimitives.size() - 1) / mPrimitives.size();
+	return uint32(Max<uint64>(1, Min<uint64>(share, count / PARALLEL_CHUNK)));
+}
+
+//=============================================================================
+void BvhBuilder::ComputeBounds (uint32 begin, uint32 end, Bounds * bounds, Bounds * centroidBounds) const
+{
+	auto grow = [this](uint32 first, uint32 last, Bounds * rangeBounds, Bounds * rangeCentroids) {
+		for (uint32 i = first; i < last; ++i)
+		{
+			rangeBounds->Grow(mPrimitives[i].bounds);
+			rangeCentroids->Grow(mPrimitives[i].centroid);
+		}
+	};
+
+	const uint32 chunkCount = GetChunkCount(end - begin);
+	if (chunkCount == 1)
+	{
+		grow(begin, end, bounds, centroidBounds);
+		return;
+	}
+
+	std::vector<Bounds> chunkBounds(chunkCount);
+	std::vector<Bounds> chunkCentroids(chunkCount);
+	ParallelFor(chunkCount, [&](uint32 chunk) {
+		const uint32 first = begin + uint32(uint64(end - begin) * chunk / chunkCount);
+		const uint32 last  = begin + uint32(uint64(end - begin) * (chunk + 1) / chunkCount);
+		grow(first, last, &chunkBounds[chunk], &chunkCentroids[chunk]);
+	});
+
+	for (uint32 chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		bounds->Grow(chunkBounds[chunk]);
+		centroidBounds->Grow(chunkCentroids[chunk]);
+	}
+}
+
+//=============================================================================
+template <typename TBuild>
+void BvhBuilder::BuildChildren (
+	uint32                 node,
+	uint32                 begin,
+	uint32                 mid,
+	uint32                 end,
+	std::vector<BvhNode> & nodes,
+	TBuild &&              build
+) {
+	bool parallel = false;
+	if (Min(mid - begin, end - mid) >= PARALLEL_TASK_SIZE)
+	{
+		parallel = mSpareThreads.fetch_sub(1) > 0;
+		if (!parallel)
+			mSpareThreads.fetch_add(1);
+	}
+
+	if (!parallel)
+	{
+		build(begin, mid, nodes);
+		nodes[node].offset = uint32(nodes.size());
+		nodes[node].count  = 0;
+		build(mid, end, nodes);
+		return;
+	}
+
+	std::vector<BvhNode> second;
+	second.reserve(2 * (end - mid));
+
+	std::thread task([&] { build(mid, end, second); });
+	build(begin, mid, nodes);
+	task.join();
+
+	mSpareThreads.fetch_add(1);
+
+	// The second half's interior nodes point into its own nodes
+	const uint32 base = uint32(nodes.size());
+	nodes[node].offset = base;
+	nodes[node].count  = 0;
+
+	nodes.reserve(base + second.size());
+	for (BvhNode child : second)
+	{
+		if (!child.count)
+			child.offset += base;
+
+		nodes.push_back(child);
+	}
+}
+
+//=============================================================================
+void BvhBuilder::BuildSah (std::vector<BvhNode> & nodes, uint32 depth)
+{
+	nodes.reserve(2 * mPrimitives.size());
+	BuildSah(0, uint32(mPrimitives.size()), depth, nodes);
+}
+
+//=============================================================================
+void BvhBuilder::BuildSah (uint32 begin, uint32 end, uint32 depth, std::vector<BvhNode> & nodes)
+{
+	Bounds bounds;
+	Bounds centroidBounds;
+	ComputeBounds(begin, end, &bounds, &centroidBounds);
+
+	const uint32 node = uint32(nodes.size());
+	nodes.push_back(BvhNode());
+	SetBounds(&nodes[node], bounds);
+
+	const uint32 mid = end - begin > 1 && depth < Bvh::MAX_DEPTH - 2
+		? Split(begin, end, depth, centroidBounds, bounds)
+		: begin;
+
+	if (mid == begin)
+	{
+		MakeLeaf(&nodes[node], begin, end);
+		return;
+	}
+
+	BuildChildren(node, begin, mid, end, nodes, [this, depth](uint32 childBegin, uint32 childEnd, std::vector<BvhNode> & out) {
+		BuildSah(childBegin, childEnd, depth + 1, out);
+	});
+}
+
+//=============================================================================
+// Returns where the primitives were partitioned, begin to keep them all in a leaf
+uint32 BvhBuilder::Split (
+	uint32         begin,
+	uint32         end,
+	uint32         depth,
+	const Bounds & centroidBounds,
+	const Bounds & bounds
+) {
+	const uint32 count = end - begin;
+
+	uint axis = 0;
+	const Vector3 extent = centroidBounds.max - centroidBounds.min;
+	if (extent.y > extent[axis]) axis = 1;
+	if (extent.z > extent[axis]) axis = 2;
+
+	// Every centroid in the same place, nothing would separate them
+	if (extent[axis] <= 0.0f)
+		return count > MAX_LEAF_SIZE ? begin + count / 2 : begin;
+
+	if (depth >= SAH_DEPTH_LIMIT)
+	{
+		const uint32 mid = begin + count / 2;
+		std::nth_element(
+			mPrimitives.begin() + begin,
+			mPrimitives.begin() + mid,
+			mPrimitives.begin() + end,
+			[axis](const BuildPrimitive & a, const BuildPrimitive & b) { return a.centroid[axis] < b.centroid[axis]; }
+		);
+		return mid;
+	}
+
+	// Bin the centroids, large ranges in chunks on several threads
+	const float32 scale = BIN_COUNT / extent[axis];
+	auto binOf = [&](const BuildPrimitive & primitive) {
+		const float32 offset = (primitive.centroid[axis] - centroidBounds.min[axis]) * scale;
+		return Min(uint32(offset), BIN_COUNT - 1);
+	};
+
+	auto binRange = [&](uint32 first, uint32 last, Bin * rangeBins) {
+		for (uint32 i = first; i < last; ++i)
+		{
+			Bin & bin = rangeBins[binOf(mPrimitives[i])];
+			bin.bounds.Grow(mPrimitives[i].bounds);
+			++bin.count;
+		}
+	};
+
+	Bin bins[BIN_COUNT];
+
+	const uint32 chunkCount = GetChunkCount(count);
+	if (chunkCount == 1)
+	{
+		binRange(begin, end, bins);
+	}
+	else
+	{
+		std::vector<Bin> chunkBins(chunkCount * BIN_COUNT);
+		ParallelFor(chunkCount, [&](uint32 chunk) {
+			const uint32 first = begin + uint32(uint64(count) * chunk / chunkCount);
+			const uint32 last  = begin + uint32(uint64(count) * (chunk + 1) / chunkCount);
+			binRange(first, last, &chunkBins[chunk * BIN_COUNT]);
+		});
+
+		for (uint32 chunk = 0; chunk < chunkCount; ++chunk)
+		{
+			for (uint32 i = 0; i < BIN_COUNT; ++i)
+			{
+				bins[i].bounds.Grow(chunkBins[chunk * BIN_COUNT + i].bounds);
+				bins[i].count += chunkBins[chunk * BIN_COUNT + i].count;
+			}
+		}
+	}
+
+	// Cost of splitting after each bin, sweeping from the right then from the left
+	float32 rightCost[BIN_COUNT];
+	{
+		Bounds right;
+		uint32 rightCount = 0;
+		for (uint32 i = BIN_COUNT - 1; i > 0; --i)
+		{
+			right.Grow(bins[i].bounds);
+			rightCount += bins[i].count;
+			rightCost[i - 1] = right.HalfArea() * rightCount;
+		}
+	}
+
+	uint32  bestBin  = BIN_COUNT;
+	float32 bestCost = INFINITY_F;
+	{
+		Bounds left;
+		uint32 leftCount = 0;
+		for (uint32 i = 0; i < BIN_COUNT - 1; ++i)
+		{
+			left.Grow(bins[i].bounds);
+			leftCount += bins[i].count;
+			if (!leftCount || leftCount == count)
+				continue;
+
+			const float32 cost = left.HalfArea() * leftCount + rightCost[i];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestBin  = i;
+			}
+		}
+	}
+
+	const float32 area      = bounds.HalfArea();
+	const float32 splitCost = TRAVERSAL_COST + (area > 0.0f ? bestCost / area : 0.0f);
+	const float32 leafCost  = float32(count);
+	if (bestBin == BIN_COUNT || (splitCost >= leafCost && count <= MAX_LEAF_SIZE))
+		return count > MAX_LEAF_SIZE ? begin + count / 2 : begin;
+
+	const auto it = std::partition(
+		mPrimitives.begin() + begin,
+		mPrimitives.begin() + end,
+		[&](const BuildPrimitive & primitive) { return binOf(primitive) <= bestBin; }
+	);
+
+	return uint32(it - mPrimitives.begin());
+}
+
+//=============================================================================
+// Sorts the primitives along a Morton curve through their centroids, after which every range
+// sharing a code prefix is a subtree
+void BvhBuilder::BuildLbvh (std::vector<BvhNode> & nodes, uint32 depth)
+{
+	const uint32 count = uint32(mPrimitives.size());
+
+	Bounds bounds;
+	Bounds centroidBounds;
+	ComputeBounds(0, count, &bounds, &centroidBounds);
+
+	const Vector3 extent = centroidBounds.max - centroidBounds.min;
+	const float32 cells  = float32((1 << MORTON_BITS) - 1);
+
+	Vector3 scale;
+	for (uint axis = 0; axis < 3; ++axis)
+		scale[axis] = extent[axis] > 0.0f ? cells / extent[axis] : 0.0f;
+
+	// Codes, in chunks
+	std::vector<uint64> keys(count);
+	const uint32 chunkCount = GetChunkCount(count);
+	ParallelFor(chunkCount, [&](uint32 chunk) {
+		const uint32 first = uint32(uint64(count) * chunk / chunkCount);
+		const uint32 last  = uint32(uint64(count) * (chunk + 1) / chunkCount);
+		for (uint32 i = first; i < last; ++i)
+		{
+			uint32 code = 0;
+			for (uint axis = 0; axis < 3; ++axis)
+			{
+				const float32 cell = (mPrimitives[i].centroid[axis] - centroidBounds.min[axis]) * scale[axis];
+				code |= SpreadBits(Min(uint32(Max(cell, 0.0f)), uint32(cells))) << (2 - axis);
+			}
+
+			keys[i] = (uint64(code) << 32) | i;
+		}
+	});
+
+	// Radix sort on the codes, keeping the order of equal codes
+	{
+		std::vector<uint64> sorted(count);
+		for (uint32 shift = 32; shift < 32 + 3 * MORTON_BITS; shift += RADIX_BITS)
+		{
+			uint32 offsets[1 << RADIX_BITS] = { };
+			for (uint64 key : keys)
+				++offsets[(key >> shift) & ((1 << RADIX_BITS) - 1)];
+
+			uint32 sum = 0;
+			for (uint32 & offset : offsets)
+			{
+				const uint32 digitCount = offset;
+				offset = sum;
+				sum += digitCount;
+			}
+
+			for (uint64 key : keys)
+				sorted[offsets[(key >> shift) & ((1 << RADIX_BITS) - 1)]++] = key;
+
+			keys.swap(sorted);
+		}
+	}
+
+	std::vector<BuildPrimitive> primitives(count);
+	std::vector<uint32>         codes(count);
+	for (uint32 i = 0; i < count; ++i)
+	{
+		primitives[i] = mPrimitives[uint32(keys[i])];
+		codes[i]      = uint32(keys[i] >> 32);
+	}
+	mPrimitives.swap(primitives);
+
+	nodes.reserve(2 * count / LBVH_LEAF_SIZE + 1);
+	BuildMorton(codes, 0, count, depth, nodes);
+}
+
+//=============================================================================
+void BvhBuilder::BuildMorton (
+	const std::vector<uint32> & codes,
+	uint32                      begin,
+	uint32                      end,
+	uint32                      depth,
+	std::vector<BvhNode> &      nodes
+) {
+	const uint32 node = uint32(nodes.size());
+	nodes.push_back(BvhNode());
+
+	if (end - begin <= LBVH_LEAF_SIZE || depth >= Bvh::MAX_DEPTH - 2)
+	{
+		Bounds bounds;
+		for (uint32 i = begin; i < end; ++i)
+			bounds.Grow(mPrimitives[i].bounds);
+
+		SetBounds(&nodes[node], bounds);
+		MakeLeaf(&nodes[node], begin, end);
+		return;
+	}
+
+	// Split where the highest bit which differs within the range turns on, or in the middle when
+	// the whole range shares one code
+	uint32 mid = begin + (end - begin) / 2;
+
+	const uint32 difference = codes[begin] ^ codes[end - 1];
+	if (difference)
+	{
+		uint32 bit = 0;
+		while (difference >> (bit + 1))
+			++bit;
+
+		const uint32 mask = 1u << bit;
+		mid = uint32(std::partition_point(
+			codes.begin() + begin,
+			codes.begin() + end,
+			[mask](uint32 code) { return !(code & mask); }
+		) - codes.begin());
+	}
+
+	BuildChildren(node, begin, mid, end, nodes, [this, &codes, depth](uint32 childBegin, uint32 childEnd, std::vector<BvhNode> & out) {
+		BuildMorton(codes, childBegin, childEnd, depth + 1, out);
+	});
+
+	// Children are done, the node bounds both
+	const BvhNode & first  = nodes[node + 1];
+	const BvhNode & second = nodes[nodes[node].offset];
+	for (uint axis = 0; axis < 3; ++axis)
+	{
+		nodes[node].min[axis] = Min(first.min[axis], second.min[axis]);
+		nodes[node].max[axis] = Max(first.max[axis], second.max[axis]);
+	}
+}
+
+//=============================================================================
+void BvhBuilder::MakeLeaf (BvhNode * node, uint32 begin, uint32 end)
+{
+	node->offset = begin;
+	node->count  = end - begin;
+}
+
+
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+bool ParseBvhBuilder (const char * name, EBvhBuilder * out)
+{
+	if      (!strcmp(name, "sah"))  *out = BVH_BUILDER_SAH;
+	else if (!strcmp(name, "lbvh")) *out = BVH_BUILDER_LBVH;
+	else return false;
+
+	return true;
+}
+
+//=============================================================================
+const char * GetBvhBuilderName (EBvhBuilder builder)
+{
+	switch (builder)
+	{
+		case BVH_BUILDER_SAH:  return "sah";
+		case BVH_BUILDER_LBVH: return "lbvh";
+	}
+
+	return "unknown";
+}
+
+
+
+//=============================================================================
+// Bvh
+//=============================================================================
+
+//=============================================================================
+Bvh::Bvh () :
+	mNodes(null),
+	mNodeCount(0),
+	mIndices(null),
+	mIndexCount(0)
+{
+}
+
+//=============================================================================
+Bvh::Bvh (const Bvh & bvh) :
+	Bvh()
+{
+	*this = bvh;
+}
+
+//=============================================================================
+Bvh & Bvh::operator= (const Bvh & bvh)
+{
+	if (this == &bvh)
+		return *this;
+
+	mOwnedNodes   = bvh.mOwnedNodes;
+	mOwnedIndices = bvh.mOwnedIndices;
+	mStorage      = bvh.mStorage;
+	mNodeCount    = bvh.mNodeCount;
+	mIndexCount   = bvh.mIndexCount;
+
+	const bool owned = !bvh.mStorage;
+	mNodes   = owned ? mOwnedNodes.data() : bvh.mNodes;
+	mIndices = owned ? mOwnedIndices.data() : bvh.mIndices;
+
+	return *this;
+}
+
+//=============================================================================
+void Bvh::Build (const std::vector<Aabb3> & bounds, EBvhBuilder builder, uint threadCount)
+{
+	Clear();
+	if (bounds.empty())
+		return;
+
+	std::vector<BuildPrimitive> primitives(bounds.size());
+	for (uint32 i = 0; i < bounds.size(); ++i)
+		primitives[i] = MakePrimitive(bounds[i], i);
+
+	BvhBuilder bvhBuilder(primitives, threadCount ? threadCount : Max<uint>(1, ThreadLogicalProcessorCount()));
+	if (builder == BVH_BUILDER_LBVH)
+		bvhBuilder.BuildLbvh(mOwnedNodes);
+	else
+		bvhBuilder.BuildSah(mOwnedNodes);
+
+	mOwnedIndices.resize(primitives.size());
+	for (uint32 i = 0; i < primitives.size(); ++i)
+		mOwnedIndices[i] = primitives[i].index;
+
+	mNodes      = mOwnedNodes.data();
+	mNodeCount  = uint32(mOwnedNodes.size());
+	mIndices    = mOwnedIndices.data();
+	mIndexCount = uint32(mOwnedIndices.size());
+}
+
+//=============================================================================
+void Bvh::SetView (
+	const BvhNode *                     nodes,
+	uint32                              nodeCount,
+	const uint32 *                      indices,
+	uint32                              indexCount,
+	const std::shared_ptr<const void> & storage
+) {
+	Clear();
+
+	mNodes      = nodes;
+	mNodeCount  = nodeCount;
+	mIndices    = indices;
+	mIndexCount = indexCount;
+	mStorage    = storage;
+}
+
+//=============================================================================
+void Bvh::Clear ()
+{
+	mOwnedNodes.clear();
+	mOwnedNodes.shrink_to_fit();
+	mOwnedIndices.clear();
+	mOwnedIndices.shrink_to_fit();
+	mStorage.reset();
+
+	mNodes      = null;
+	mNodeCount  = 0;
+	mIndices    = null;
+	mIndexCount = 0;
+}
+
+//=============================================================================
+// A mapped hierarchy is copied before it is changed
+void Bvh::MakeOwned ()
+{
+	if (!mStorage)
+		return;
+
+	mOwnedNodes.assign(mNodes, mNodes + mNodeCount);
+	mOwnedIndices.assign(mIndices, mIndices + mIndexCount);
+	mStorage.reset();
+
+	mNodes   = mOwnedNodes.data();
+	mIndices = mOwnedIndices.data();
+}
+
+//=============================================================================
+// Children come after their parent, so going backwards every child is fitted before its parent
+void Bvh::Refit (const std::vector<Aabb3> & bounds)
+{
+	MakeOwned();
+
+	for (uint32 i = mNodeCount; i-- > 0; )
+	{
+		BvhNode & node = mOwnedNodes[i];
+
+		Bounds box;
+		if (node.count)
+		{
+			for (uint32 j = node.offset; j < node.offset + node.count; ++j)
+			{
+				box.Grow(bounds[mIndices[j]].min);
+				box.Grow(bounds[mIndices[j]].max);
+			}
+		}
+		else
+		{
+			for (const BvhNode * child : { &mOwnedNodes[i + 1], &mOwnedNodes[node.offset] })
+			{
+				box.Grow(Point3(child->min[0], child->min[1], child->min[2]));
+				box.Grow(Point3(child->max[0], child->max[1], child->max[2]));
+			}
+		}
+
+		SetBounds(&node, box);
+	}
+}
+
+//=============================================================================
+bool Bvh::RebuildSubtree (uint32 node, uint32 depth, const std::vector<Aabb3> & bounds, EBvhBuilder builder)
+{
+	ASSERT(node < mNodeCount);
+
+	MakeOwned();
+
+	// The subtree's nodes start at node, its leaves cover one range of indices
+	uint32 nodeCount = 0;
+	uint32 first     = mIndexCount;
+	uint32 last      = 0;
+
+	std::vector<uint32> stack(1, node);
+	while (!stack.empty())
+	{
+		const BvhNode & current = mOwnedNodes[stack.back()];
+		stack.pop_back();
+		++nodeCount;
+
+		if (current.count)
+		{
+			first = Min(first, current.offset);
+			last  = Max(last, current.offset + current.count);
+		}
+		else
+		{
+			stack.push_back(uint32(&current - mNodes) + 1);
+			stack.push_back(current.offset);
+		}
+	}
+
+	std::vector<BuildPrimitive> primitives(last - first);
+	for (uint32 i = first; i < last; ++i)
+		primitives[i - first] = MakePrimitive(bounds[mIndices[i]], mIndices[i]);
+
+	std::vector<BvhNode> nodes;
+	BvhBuilder bvhBuilder(primitives, 1);
+	if (builder == BVH_BUILDER_LBVH)
+		bvhBuilder.BuildLbvh(nodes, depth);
+	else
+		bvhBuilder.BuildSah(nodes, depth);
+
+	if (nodes.size() > nodeCount)
+		return false;
+
+	for (uint32 i = 0; i < nodes.size(); ++i)
+	{
+		BvhNode child = nodes[i];
+		child.offset += child.count ? first : node;
+		mOwnedNodes[node + i] = child;
+	}
+
+	// Nodes the new subtree does not need are never reached, they become empty leaves
+	for (uint32 i = node + uint32(nodes.size()); i < node + nodeCount; ++i)
+	{
+		SetBounds(&mOwnedNodes[i], Bounds());
+		mOwnedNodes[i].offset = first;
+		mOwnedNodes[i].count  = 1;
+	}
+
+	for (uint32 i = first; i < last; ++i)
+		mOwnedIndices[i] = primitives[i - first].index;
+
+	return true;
+}
+
+//=============================================================================
+// Every node is entered with the probability its area has relative to the root's
+float32 Bvh::ComputeSahCost () const
+{
+	if (!mNodeCount)
+		return 0.0f;
+
+	const float32 rootArea = GetHalfArea(mNodes[0]);
+	if (rootArea <= 0.0f)
+		return float32(mNodes[0].count);
+
+	// Walks the hierarchy, a partly rebuilt one has nodes no parent points to
+	float64 cost = 0.0;
+
+	std::vector<uint32> stack(1, 0);
+	while (!stack.empty())
+	{
+		const uint32    index = stack.back();
+		const BvhNode & node  = mNodes[index];
+		stack.pop_back();
+
+		cost += GetHalfArea(node) / rootArea * (node.count ? float32(node.count) : TRAVERSAL_COST);
+
+		if (!node.count)
+		{
+			stack.push_back(index + 1);
+			stack.push_back(node.offset);
+		}
+	}
+
+	return float32(cost);
+}
+
+//=============================================================================
+bool Bvh::Validate (uint32 primitiveCount) const
+{
+	for (uint32 i = 0; i < mIndexCount; ++i)
+	{
+		if (mIndices[i] >= primitiveCount)
+			return false;
+	}
+
+	std::vector<uint32> depths(mNodeCount, 0);
+	for (uint32 i = 0; i < mNodeCount; ++i)
+	{
+		const BvhNode & node = mNodes[i];
+		if (depths[i] > MAX_DEPTH - 2)
+			return false;
+
+		if (node.count)
+		{
+			if (node.offset > mIndexCount || node.count > mIndexCount - node.offset)
+				return false;
+		}
+		else
+		{
+			// Children always come after their parent, which also rules out cycles
+			if (i + 1 >= mNodeCount || node.offset <= i + 1 || node.offset >= mNodeCount)
+				return false;
+
+			depths[i + 1]       = Max(depths[i + 1], depths[i] + 1);
+			depths[node.offset] = Max(depths[node.offset], depths[i] + 1);
+		}
+	}
+
+	return true;
+}
+
+} // namespace RT
@@ -0,0 +1,223 @@
+//==================================================================================================
+//
+// File:	Bvh.h
+//
+// Bounding volume hierarchy over the primitives of a scene. Nodes are plain data laid out depth
+// first so a hierarchy can be written to disk as is and used straight from a mapped file.
+//=================================================================================================
+#ifndef BVH_H
+#define BVH_H
+
+#include <memory>
+#include <vector>
+
+namespace RT
+{
+
+//==================================================================================================
+//
+// A node is a leaf when count is not 0. The first child of an interior node directly follows it,
+// offset is the index of the second child. For a leaf offset is the first of its primitive indices.
+//==================================================================================================
+struct BvhNode
+{
+	float32 min[3];
+	float32 max[3];
+	uint32  offset;
+	uint32  count;
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode is stored in scene files");
+
+//! Half the surface area of the node's box, which the surface area heuristic weighs nodes by
+inline float32 GetHalfArea (const BvhNode & node)
+{
+	const float32 dx = node.max[0] - node.min[0];
+	const float32 dy = node.max[1] - node.min[1];
+	const float32 dz = node.max[2] - node.min[2];
+	return dx * dy + dy * dz + dz * dx;
+}
+
+//! How a hierarchy is built, trading build time against trace speed
+enum EBvhBuilder
+{
+	BVH_BUILDER_SAH,	//!< Binned surface area heuristic, the fastest to trace
+	BVH_BUILDER_LBVH,	//!< Primitives sorted along a Morton curve, the fastest to build
+};
+
+//! Parses "sah" or "lbvh"
+bool ParseBvhBuilder (const char * name, EBvhBuilder * out);
+const char * GetBvhBuilderName (EBvhBuilder builder);
+
+//==================================================================================================
+// Bvh
+//==================================================================================================
+class Bvh
+{
+public:
+	static const uint32 MAX_DEPTH = 64;
+
+	Bvh ();
+	Bvh (const Bvh & bvh);
+	Bvh & operator= (const Bvh & bvh);
+
+	//! Builds the hierarchy over bounds, primitive i being bounds[i]. Large hierarchies are built on
+	//! threadCount threads, 0 uses every logical processor.
+	void Build (const std::vector<Aabb3> & bounds, EBvhBuilder builder = BVH_BUILDER_SAH, uint threadCount = 0);
+	//! Uses nodes and indices owned by someone else, storage is kept alive as long as they are used
+	void SetView (
+		const BvhNode *                     nodes,
+		uint32                              nodeCount,
+		const uint32 *                      indices,
+		uint32                              indexCount,
+		const std::shared_ptr<const void> & storage
+	);
+	void Clear ();
+
+	//! Fits every node around bounds again, after primitives moved. The hierarchy keeps its shape.
+	void Refit (const std::vector<Aabb3> & bounds);
+	//! Builds the subtree at node, which is depth nodes below the root, again in the nodes it takes.
+	//! Returns false and leaves the subtree alone when the new one would need more nodes.
+	bool RebuildSubtree (uint32 node, uint32 depth, const std::vector<Aabb3> & bounds, EBvhBuilder builder = BVH_BUILDER_SAH);
+
+	//! Checks the hierarchy only references its own nodes and primitives below primitiveCount, and
+	//! is shallow enough to traverse
+	bool Validate (uint32 primitiveCount) const;
+
+	//! Expected cost of tracing a ray, in primitive intersections, by the surface area heuristic
+	float32 ComputeSahCost () const;
+
+	inline bool            IsEmpty () const { return mNodeCount == 0; }
+	inline const BvhNode * GetNodes () const { return mNodes; }
+	inline uint32          GetNodeCount () const { return mNodeCount; }
+	inline const uint32 *  GetIndices () const { return mIndices; }
+	inline uint32          GetIndexCount () const { return mIndexCount; }
+	//! Bytes taken by the nodes and primitive indices
+	inline uint64          GetMemorySize () const { return uint64(mNodeCount) * sizeof(BvhNode) + uint64(mIndexCount) * sizeof(uint32); }
+
+	//! Calls intersect(primitive, maxTime) for the primitives of every leaf the ray reaches before
+	//! maxTime, nearest leaves first. intersect lowers maxTime when it finds a closer hit.
+	template <typename TIntersect>
+	void Traverse (const Ray3 & ray, float32 maxTime, TIntersect && intersect) const;
+
+private:
+	void MakeOwned ();
+
+	// Data
+	const BvhNode *             mNodes;
+	uint32                      mNodeCount;
+	const uint32 *              mIndices;
+	uint32                      mIndexCount;
+
+	std::vector<BvhNode>        mOwnedNodes;	// Empty when viewing someone else's storage
+	std::vector<uint32>         mOwnedIndices;
+	std::shared_ptr<const void> mStorage;
+};
+
+
+
+//=============================================================================
+// Slab test, NaNs from rays lying in a slab plane are ignored by the ordering of the compares
+inline bool SlabTest (
+	const float32   min[3],
+	const float32   max[3],
+	const Vector3 & origin,
+	const Vector3 & invDirection,
+	float32         maxTime,
+	float32 *       entryTime
+) {
+	float32 tmin = 0.0f;
+	float32 tmax = maxTime;
+
+	for (uint axis = 0; axis < 3; ++axis)
+	{
+		float32 t0 = (min[axis] - origin[axis]) * invDirection[axis];
+		float32 t1 = (max[axis] - origin[axis]) * invDirection[axis];
+		if (t0 > t1)
+			std::swap(t0, t1);
+
+		tmin = t0 > tmin ? t0 : tmin;
+		tmax = t1 < tmax ? t1 : tmax;
+	}
+
+	*entryTime = tmin;
+	return tmin <= tmax;
+}
+
+//=============================================================================
+template <typename TIntersect>
+void Bvh::Traverse (const Ray3 & ray, float32 maxTime, TIntersect && intersect) const
+{
+	if (!mNodeCount)
+		return;
+
+	const Vector3 origin = ray.origin;
+	const Vector3 invDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+	struct Entry
+	{
+		uint32  node;
+		float32 time;
+	};
+
+	Entry  stack[MAX_DEPTH];
+	uint32 top = 0;
+
+	float32 rootTime;
+	if (!SlabTest(mNodes[0].min, mNodes[0].max, origin, invDirection, maxTime, &rootTime))
+		return;
+
+	stack[top++] = { 0, rootTime };
+
+	// Counted here and added once, the thread local is not kept in a register
+	RT_STATS_ONLY(uint32 visits = 0;)
+
+	while (top)
+	{
+		const Entry entry = stack[--top];
+		if (entry.time > maxTime)
+			continue;
+
+		RT_STATS_ONLY(++visits;)
+
+		const BvhNode & node = mNodes[entry.node];
+		if (node.count)
+		{
+			RT_STAT_ADD(STAT_PRIMITIVE_TESTS, node.count);
+			for (uint32 i = 0; i < node.count; ++i)
+				intersect(mIndices[node.offset + i], maxTime);
+
+			continue;
+		}
+
+		Entry first  = { entry.node + 1, 0.0f };
+		Entry second = { node.offset, 0.0f };
+		const bool hitFirst  = SlabTest(mNodes[first.node].min, mNodes[first.node].max, origin, invDirection, maxTime, &first.time);
+		const bool hitSecond = SlabTest(mNodes[second.node].min, mNodes[second.node].max, origin, invDirection, maxTime, &second.time);
+
+		if (hitFirst && hitSecond)
+		{
+			// Nearest on top
+			if (second.time < first.time)
+				std::swap(first, second);
+
+			ASSERT(top + 2 <= MAX_DEPTH);
+			stack[top++] = second;
+			stack[top++] = first;
+		}
+		else if (hitFirst)
+		{
+			stack[top++] = first;
+		}
+		else if (hitSecond)
+		{
+			stack[top++] = second;
+		}
+	}
+
+	RT_STAT_ADD(STAT_NODE_VISITS, visits);
+}
+
+} // namespace RT
+
+#endif //BVH_H
@@ -34,15 +34,18 @@ void Camera::Setup (
 	
 }
 
-void Camera::Setup (
-    const Json::CValue & json,
-    float32 aspect
-) {
+void Camera::Setup (const CameraDesc & desc, float32 aspect)
+{
+    Setup(desc.eye, desc.lookat, desc.up, desc.distance, desc.width, aspect);
+}
+
+bool ParseCamera (const Json::CValue & json, CameraDesc * out)
+{
     using namespace Json;
 
     const auto * settings = json.As<ObjectType>();
     if (!settings)
-        return;
+        return false;
 
     const auto & eyeValue      = json[{"eye"}];
     const auto & lookatValue   = json[{"lookat"}];
@@ -56,23 +59,27 @@ void Camera::Setup (
         distanceValue == null ||
         widthValue == null
     ) {
-        return;
+        return false;
     }
 
-    Vector3 eye, at, up;
-    if (!ParseVector3(eyeValue, &eye))
-        return;
+    if (!ParsePoint3(eyeValue, &out->eye))
+        return false;
+
+    if (!ParsePoint3(lookatValue, &out->lookat))
+        return false;
 
-    if (!ParseVector3(lookatValue, &at))
-        return;
+    if (!ParseVector3(upValue, &out->up))
+        return false;
 
-    if (!ParseVector3(upValue, &up))
-        return;
+    const auto * distance = distanceValue.As<NumberType>();
+    const auto * width    = widthValue.As<NumberType>();
+    if (!distance || !width)
+        return false;
 
-    const float32 distance = float32(*distanceValue.As<NumberType>());
-    const float32 width = float32(*widthValue.As<NumberType>());
+    out->distance = float32(*distance);
+    out->width    = float32(*width);
 
-    Setup(eye, at, up, distance, width, aspect);
+    return true;
 }
 
-} //namespace RT
\ No newline at end of file
+} //namespace RT
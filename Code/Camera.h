@@ -12,6 +12,21 @@
 namespace RT
 {
 
+//==================================================================================================
+//
+// Parameters a camera is built from, before the aspect ratio of the output is known
+//==================================================================================================
+struct CameraDesc
+{
+	Point3  eye;
+	Point3  lookat;
+	Vector3 up;
+	float32 distance;
+	float32 width;
+};
+
+bool ParseCamera (const Json::CValue & json, CameraDesc * out);
+
 //==================================================================================================
 //
 // Class which represents the virtual camera in a raytraced scene
@@ -28,7 +43,7 @@ public:
         float32 width,
         float32 aspect
     );
-    void Setup (const Json::CValue & json, float32 aspect);
+    void Setup (const CameraDesc & desc, float32 aspect);
 	inline Ray3 GetRay (float64 u, float64 v) const;
 	inline Ray3 GetRay (const Vector2 & uv) const;
 	inline Point3 GetEye () const { return mEye; }
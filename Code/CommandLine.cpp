@@ -0,0 +1,311 @@
+//==================================================================================================
+//
+// File:	CommandLine.cpp
+//
+// Parses the command line into render options.
+//
+//=================================================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Pch.h"
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+//=============================================================================
+static bool ParseUint (const char * str, uint * out)
+{
+    if (!str || !*str)
+        return false;
+
+    char * end = null;
+    const unsigned long value = strtoul(str, &end, 10);
+    if (*end != '\0')
+        return false;
+
+    *out = uint(value);
+    return true;
+}
+
+//=============================================================================
+static bool ParseFloat (const char * str, float32 * out)
+{
+    if (!str || !*str)
+        return false;
+
+    char * end = null;
+    const double value = strtod(str, &end);
+    if (*end != '\0' || value < 0.0)
+        return false;
+
+    *out = float32(value);
+    return true;
+}
+
+//=============================================================================
+// Parses "BEGIN:END"
+static bool ParseRange (const char * str, uint * begin, uint * end)
+{
+    if (!str)
+        return false;
+
+    char * it = null;
+    const unsigned long a = strtoul(str, &it, 10);
+    if (*it != ':' || it == str)
+        return false;
+
+    const char * rest = it + 1;
+    const unsigned long b = strtoul(rest, &it, 10);
+    if (*it != '\0' || it == rest || b <= a)
+        return false;
+
+    *begin = uint(a);
+    *end   = uint(b);
+    return true;
+}
+
+//=============================================================================
+// Parses "WIDTHxHEIGHT"
+static bool ParseSize (const char * str, uint * width, uint * height)
+{
+    if (!str)
+        return false;
+
+    char * end = null;
+    const unsigned long w = strtoul(str, &end, 10);
+    if (*end != 'x' && *end != 'X')
+        return false;
+
+    const char * rest = end + 1;
+    const unsigned long h = strtoul(rest, &end, 10);
+    if (*end != '\0' || end == rest)
+        return false;
+
+    if (!w || !h)
+        return false;
+
+    *width  = uint(w);
+    *height = uint(h);
+    return true;
+}
+
+
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+bool ParseCommandLine (int argc, char * argv[], RenderOptions * out)
+{
+    ASSERT(out);
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char * arg   = argv[i];
+        const char * value = i + 1 < argc ? argv[i + 1] : null;
+
+        bool ok = true;
+        bool consumed = true;
+
+        if      (!strcmp(arg, "--scene"))         ok = (out->scenePath = value) != null;
+        else if (!strcmp(arg, "--output"))        ok = (out->outputPath = value) != null;
+        else if (!strcmp(arg, "--width"))         ok = ParseUint(value, &out->width) && out->width;
+        else if (!strcmp(arg, "--height"))        ok = ParseUint(value, &out->height) && out->height;
+        else if (!strcmp(arg, "--size"))          ok = ParseSize(value, &out->width, &out->height);
+        else if (!strcmp(arg, "--spp"))           ok = ParseUint(value, &out->spp) && out->spp;
+        else if (!strcmp(arg, "--threads"))       ok = ParseUint(value, &out->threads);
+        else if (!strcmp(arg, "--affinity"))      ok = value && RT::ParseAffinity(value, &out->affinity);
+        else if (!strcmp(arg, "--time-budget"))   ok = ParseFloat(value, &out->timeBudget);
+        else if (!strcmp(arg, "--progress-interval")) ok = ParseFloat(value, &out->progressInterval) && out->progressInterval > 0.0f;
+        else if (!strcmp(arg, "--progress-json")) ok = (out->progressJsonPath = value) != null;
+        else if (!strcmp(arg, "--cost-map"))      ok = (out->costMapPath = value) != null;
+        else if (!strcmp(arg, "--preview"))       ok = (out->previewPath = value) != null;
+        else if (!strcmp(arg, "--trace"))         ok = (out->tracePath = value) != null;
+        else if (!strcmp(arg, "--daemon"))        ok = (out->daemon = value) != null;
+        else if (!strcmp(arg, "--jobs"))          ok = ParseUint(value, &out->jobs) && out->jobs;
+        else if (!strcmp(arg, "--coordinator"))   ok = (out->coordinator = value) != null;
+        else if (!strcmp(arg, "--worker"))        ok = (out->worker = value) != null;
+        else if (!strcmp(arg, "--workers"))       ok = ParseUint(value, &out->workers);
+        else if (!strcmp(arg, "--tile-size"))     ok = ParseUint(value, &out->tileSize) && out->tileSize;
+        else if (!strcmp(arg, "--lease-timeout")) ok = ParseFloat(value, &out->leaseTimeout);
+        else if (!strcmp(arg, "--samples"))       ok = ParseRange(value, &out->sampleBegin, &out->sampleEnd);
+        else if (!strcmp(arg, "--accumulation"))  ok = (out->accumulationPath = value) != null;
+        else if (!strcmp(arg, "--scene-cache"))   ok = (out->sceneCache = value) != null;
+        else if (!strcmp(arg, "--compile-scene")) ok = (out->compileScene = value) != null;
+        else if (!strcmp(arg, "--generate"))      ok = (out->generate = value && RT::ParseStressScene(value, &out->stressScene.kind));
+        else if (!strcmp(arg, "--count"))         ok = ParseUint(value, &out->stressScene.count) && out->stressScene.count;
+        else if (!strcmp(arg, "--density"))       ok = ParseFloat(value, &out->stressScene.density) && out->stressScene.density > 0.0f && out->stressScene.density <= 1.0f;
+        else if (!strcmp(arg, "--overlap"))       ok = ParseFloat(value, &out->stressScene.overlap) && out->stressScene.overlap >= 0.0f && out->stressScene.overlap <= 1.0f;
+        else if (!strcmp(arg, "--seed"))          ok = ParseUint(value, &out->stressScene.seed);
+        else if (!strcmp(arg, "--frames"))        ok = ParseRange(value, &out->frameBegin, &out->frameEnd);
+        else if (!strcmp(arg, "--bvh"))           ok = value && RT::ParseBvhBuilder(value, &out->bvhBuilder);
+        else if (!strcmp(arg, "--render-bench"))  ok = (out->renderBench = value) != null;
+        else if (!strcmp(arg, "--bvh-nodes"))     ok = (out->hasBvhNodes = value && RT::ParseBvhNodes(value, &out->bvhNodes));
+        else if (!strcmp(arg, "--merge"))
+        {
+            // Everything after the output image is a shard
+            out->mergeOutput     = value;
+            out->mergeInputs     = argv + i + 2;
+            out->mergeInputCount = uint(Max(0, argc - i - 2));
+            ok = value && out->mergeInputCount;
+            if (ok)
+                break;
+        }
+        else
+        {
+            consumed = false;
+
+            if      (!strcmp(arg, "--headless"))                   out->headless = true;
+            else if (!strcmp(arg, "--predict-cost"))               out->predictCost = true;
+            else if (!strcmp(arg, "--no-jitter"))                  out->noJitter = true;
+            else if (!strcmp(arg, "--gbuffer"))                    out->gbuffer = true;
+            else if (!strcmp(arg, "--watch"))                      out->watch = true;
+            else if (!strcmp(arg, "--compare-local"))              out->compareLocal = true;
+            else if (!strcmp(arg, "--bvh-bench"))                  out->bvhBench = true;
+            else if (!strcmp(arg, "--primitive-bench"))            out->primitiveBench = true;
+            else if (!strcmp(arg, "--help") || !strcmp(arg, "-h")) out->help = true;
+            else
+            {
+                fprintf(stderr, "Unknown argument '%s'\n", arg);
+                return false;
+            }
+        }
+
+        if (!ok)
+        {
+            fprintf(stderr, "Invalid value for '%s'\n", arg);
+            return false;
+        }
+
+        if (consumed)
+            ++i;
+    }
+
+    // Overriding only one dimension would silently change the aspect ratio
+    if (!out->width != !out->height)
+    {
+        fprintf(stderr, "--width and --height must be given together\n");
+        return false;
+    }
+
+    // Built-in scenes have no scene file to cache or compile
+    if ((out->sceneCache || out->compileScene) && !out->scenePath)
+    {
+        fprintf(stderr, "--scene-cache and --compile-scene need --scene\n");
+        return false;
+    }
+
+    // Generated scenes are written, not rendered
+    if (out->generate && !out->outputPath)
+    {
+        fprintf(stderr, "--generate needs --output\n");
+        return false;
+    }
+
+    // Every frame is written next to --output, and a frame is always rendered whole
+    if (out->frameEnd)
+    {
+        if (!out->scenePath || !out->outputPath)
+        {
+            fprintf(stderr, "--frames needs --scene and --output\n");
+            return false;
+        }
+
+        if (out->daemon || out->coordinator || out->worker)
+        {
+            fprintf(stderr, "--frames can not be combined with distributed rendering\n");
+            return false;
+        }
+    }
+
+    // Requests name files to write, so they are only taken from whoever can reach a local socket
+    if (out->daemon && RT::IsTcpAddress(out->daemon))
+    {
+        fprintf(stderr, "--daemon takes a unix domain socket path, not host:port\n");
+        return false;
+    }
+
+    // Re-renders copy the pixels a material edit can't reach from the render before, so every
+    // render has to be whole
+    if (out->watch)
+    {
+        if (!out->scenePath || !out->outputPath)
+        {
+            fprintf(stderr, "--watch needs --scene and --output\n");
+            return false;
+        }
+
+        if (out->frameEnd || out->previewPath || out->timeBudget > 0.0f || out->daemon || out->coordinator || out->worker)
+        {
+            fprintf(stderr, "--watch can not be combined with --frames, --preview, --time-budget or distributed rendering\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//=============================================================================
+void PrintUsage (const char * exe)
+{
+    printf(
+        "Usage: %s [options]\n"
+        "  --scene <file>          Scene json or binary scene to render (default: built-in scenes)\n"
+        "  --scene-cache <file>    Load --scene through this binary scene, rebuilt when out of date\n"
+        "  --compile-scene <file>  Write --scene as a binary scene with its bvh and exit\n"
+        "  --bvh <sah|lbvh>        Build hierarchies with the surface area heuristic or Morton codes\n"
+        "  --bvh-bench             Report the bvh build time, its SAH cost and primary rays per second\n"
+        "  --bvh-nodes <full|quantized>  Trace meshes with full or 8 bit quantized nodes (default: scene's)\n"
+        "  --primitive-bench       Time every shape's Intersect against IntersectBatch and exit\n"
+        "  --render-bench <file>   Render the benchmark scenes with 1 to --threads threads, write json\n"
+        "  --generate <kind>       Write a spheres, ellipsoids, city or lights scene to --output and exit,\n"
+        "                          as json when it ends in .json and as a binary scene otherwise\n"
+        "  --count <n>             Primitives, or lights, of the generated scene (default 1000)\n"
+        "  --density <f>           Fraction of the volume, or ground, they fill (default 0.1)\n"
+        "  --overlap <f>           0 keeps them apart, 1 places them independently (default 1)\n"
+        "  --seed <n>              Seed of the generated scene (default 1)\n"
+        "  --output <file>         Output tga (default: time stamped name)\n"
+        "  --frames <a>:<b>        Render frames [a, b) of an animated scene to --output with _NNNN added,\n"
+        "                          and to --accumulation the same way\n"
+        "  --size <W>x<H>          Output resolution\n"
+        "  --width <W> --height <H>\n"
+        "  --spp <n>               Samples per pixel\n"
+        "  --threads <n>           Render threads (default: logical processors)\n"
+        "  --affinity <none|compact|scatter>  Pin render threads, filling cores or spreading over\n"
+        "                          cores and sockets first (default none)\n"
+        "  --time-budget <sec>     Stop handing out blocks after this many seconds\n"
+        "  --headless              No progress output, print stats json on exit\n"
+        "  --progress-interval <sec>  Seconds between progress reports (default 1)\n"
+        "  --progress-json <file>  Stream progress and time left as json lines to a file or pipe\n"
+        "  --predict-cost          Render the blocks a sparse pre-pass finds most expensive first\n"
+        "  --no-jitter             Send every sample of a pixel through its center\n"
+        "  --gbuffer               Trace camera rays once and keep their hits, for every sample, or\n"
+        "                          for every pixel with --no-jitter\n"
+        "  --cost-map <file>       Write the render time of every block as a heatmap tga\n"
+        "  --preview <file>        Refine the image in place, reading camera moves from stdin\n"
+        "  --watch                 Render --scene again whenever it changes. When only materials\n"
+        "                          changed the scene is not reloaded, and only the pixels whose\n"
+        "                          paths touched a changed material are rendered again\n"
+        "  --trace <file>          Write a Chrome trace json timeline of the render threads on exit\n"
+        "  --daemon <socket>       Serve render requests on a unix domain socket path, which can\n"
+        "                          not look like host:port (use ./name:x for such a name)\n"
+        "  --jobs <n>              Render requests the daemon runs at once on its threads (default 4)\n"
+        "  --coordinator <addr>    Lease tiles of --scene to workers on host:port or a socket path.\n"
+        "                          Workers open --scene by its absolute path, remote ones need the\n"
+        "                          same file tree\n"
+        "  --workers <n>           Start n local worker processes for the coordinator\n"
+        "  --tile-size <n>         Tile size leased to workers\n"
+        "  --lease-timeout <sec>   Lease tiles again after a worker is silent this long\n"
+        "  --compare-local         Also render in this process and report the speedup\n"
+        "  --worker <addr>         Render tiles for the coordinator at addr\n"
+        "  --samples <a>:<b>       Only render samples [a, b) of every pixel, out of --spp\n"
+        "  --accumulation <file>   Write the per pixel sample sums and counts\n"
+        "  --merge <out> <acc>...  Merge accumulation files into one image (and --accumulation)\n",
+        exe
+    );
+}
@@ -0,0 +1,82 @@
+//==================================================================================================
+//
+// File:	CommandLine.h
+//
+// Options which control a single render, filled in from the command line. Anything left at its
+// default falls back to the scene file or the built-in scenes.
+//=================================================================================================
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+struct RenderOptions
+{
+    const char * scenePath  = null;  // Scene file to render, null for the built-in scenes
+    const char * outputPath = null;  // Image to write, null for a time stamped name
+    uint         width      = 0;     // 0 keeps the scene resolution
+    uint         height     = 0;
+    uint         spp        = 0;     // 0 keeps the scene samples per pixel
+    uint         threads    = 0;     // 0 is one per logical processor
+    RT::EAffinity affinity  = RT::AFFINITY_NONE; // How render threads are pinned to processors
+    float32      timeBudget = 0.0f;  // Seconds before no more blocks are handed out, 0 is unlimited
+    bool         predictCost = false; // Hand out the blocks a pre-pass predicts are the most expensive first
+    bool         noJitter   = false; // Every sample of a pixel goes through its center
+    bool         gbuffer    = false; // Keep camera ray hits, per sample or per pixel without jitter
+    const char * costMapPath = null;  // Image of the render time of every block to write
+    bool         headless   = false; // No progress output, print stats as json on exit
+    float32      progressInterval = 1.0f; // Seconds between progress reports
+    const char * progressJsonPath = null; // File or pipe to stream progress to as json lines
+    const char * previewPath = null; // Image to refine progressively while reading camera moves from stdin
+    bool         watch      = false; // Render again whenever --scene changes, keeping what a material edit can't touch
+    const char * tracePath  = null;  // Chrome trace json of the render threads to write on exit
+    const char * daemon     = null;  // Socket to serve render requests on instead of rendering once
+    uint         jobs       = 0;     // Render requests the daemon runs at once, 0 picks a default
+
+    // Binary scenes
+    const char * sceneCache   = null;  // Binary scene to load the scene through, rewritten when stale
+    const char * compileScene = null;  // Write the scene as a binary scene here instead of rendering
+
+    // Procedural scenes
+    bool                generate = false;  // Write stressScene to outputPath instead of rendering
+    RT::StressSceneDesc stressScene;
+
+    // Hierarchies
+    RT::EBvhBuilder bvhBuilder = RT::BVH_BUILDER_SAH;
+    bool            bvhBench   = false; // Time tracing primary rays before rendering and report it
+    bool            primitiveBench = false; // Benchmark every shape's intersection test and exit
+    const char *    renderBench    = null;  // Run the end to end benchmark, writing its json here
+    RT::EBvhNodes   bvhNodes   = RT::BVH_NODES_FULL;
+    bool            hasBvhNodes = false; // Whether bvhNodes overrides the scene's choice
+
+    // Animation
+    uint         frameBegin = 0;     // Render frames [frameBegin, frameEnd) of an animated scene
+    uint         frameEnd   = 0;     // 0 renders a single image
+
+    // Sample sharding
+    uint         sampleBegin      = 0;     // Render samples [sampleBegin, sampleEnd) of every pixel
+    uint         sampleEnd        = 0;     // 0 is up to spp
+    const char * accumulationPath = null;  // Where to write the sum and count of the samples
+    const char * mergeOutput      = null;  // Merge shards into this image instead of rendering
+    char **      mergeInputs      = null;
+    uint         mergeInputCount  = 0;
+
+    // Distributed rendering
+    const char * coordinator  = null;  // Address to lease tiles to workers from
+    const char * worker       = null;  // Address of the coordinator to render tiles for
+    uint         workers      = 0;     // Worker processes the coordinator starts itself
+    uint         tileSize     = 0;     // 0 picks a default
+    float32      leaseTimeout = 0.0f;  // Seconds of silence before a worker's tiles are leased again
+    bool         compareLocal = false; // Also render in one process and report the speedup
+    bool         help       = false;
+};
+
+bool ParseCommandLine (int argc, char * argv[], RenderOptions * out);
+
+//! The nodes to trace meshes with, the command line wins over the scene file
+inline RT::EBvhNodes ResolveBvhNodes (const RenderOptions & options, const RT::SceneSettings & settings)
+{
+    return options.hasBvhNodes ? options.bvhNodes : settings.bvhNodes;
+}
+
+void PrintUsage (const char * exe);
+
+#endif //COMMANDLINE_H
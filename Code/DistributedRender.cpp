@@ -0,0 +1,795 @@
+//==================================================================================================
+//
+// File:	DistributedRender.cpp
+//
+// Coordinator and worker processes for rendering one frame across several processes.
+//
+//=================================================================================================
+
+#if !defined(_WIN32)
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <climits>
+#include <cstdlib>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+#include "Pch.h"
+
+const uint    DEFAULT_WIDTH         = 512;
+const uint    DEFAULT_HEIGHT        = 384;
+const uint    DEFAULT_SPP           = 100;
+const uint    DEFAULT_TILE_SIZE     = 32;
+const float32 DEFAULT_LEASE_TIMEOUT = 10.0f;	// Seconds without hearing from a worker
+const uint    HEARTBEAT_MS          = 1000;
+const uint    RETRY_MS              = 50;		// Worker back off while the last tiles are out
+const uint32  MAX_MESSAGE_BYTES     = 256 * 1024 * 1024;
+
+
+
+//=============================================================================
+// Protocol
+//=============================================================================
+
+enum EMessage
+{
+	MESSAGE_HELLO,			// worker -> coordinator
+	MESSAGE_JOB,			// coordinator -> worker, JobMessage
+	MESSAGE_LEASE_REQUEST,	// worker -> coordinator
+	MESSAGE_LEASE,			// coordinator -> worker, LeaseMessage
+	MESSAGE_WAIT,			// coordinator -> worker, nothing to lease right now, ask again
+	MESSAGE_NO_WORK,		// coordinator -> worker, the frame is done
+	MESSAGE_RESULT,			// worker -> coordinator, ResultMessage then sums and counts
+	MESSAGE_HEARTBEAT,		// worker -> coordinator
+};
+
+struct MessageHeader
+{
+	uint32 type;
+	uint32 bytes;
+};
+
+struct JobMessage
+{
+	uint32 width;
+	uint32 height;
+	uint32 spp;
+	char   scene[1024];
+};
+
+struct LeaseMessage
+{
+	uint32    tile;
+	RT::Block block;
+};
+
+struct ResultMessage
+{
+	uint32 tile;
+	uint32 width;
+	uint32 height;
+};
+
+//=============================================================================
+static bool SendMessage (RT::SocketHandle s, EMessage type, const void * payload = null, uint32 bytes = 0)
+{
+	const MessageHeader header = { uint32(type), bytes };
+	if (!RT::SocketSend(s, &header, sizeof(header)))
+		return false;
+
+	return !bytes || RT::SocketSend(s, payload, bytes);
+}
+
+//=============================================================================
+static bool RecvMessage (RT::SocketHandle s, MessageHeader * header, std::vector<uint8> * payload)
+{
+	if (!RT::SocketRecv(s, header, sizeof(*header)))
+		return false;
+
+	if (header->bytes > MAX_MESSAGE_BYTES)
+		return false;
+
+	payload->resize(header->bytes);
+	return !header->bytes || RT::SocketRecv(s, payload->data(), header->bytes);
+}
+
+//=============================================================================
+static size_t ResultBytes (uint32 width, uint32 height)
+{
+	const size_t pixels = size_t(width) * height;
+	return sizeof(ResultMessage) + pixels * 3 * sizeof(float32) + pixels * sizeof(uint32);
+}
+
+
+
+namespace RT
+{
+
+//==================================================================================================
+// RemoteRenderManager - hands out blocks leased from a coordinator and sends back the results
+//==================================================================================================
+class RemoteRenderManager : public RenderManager
+{
+public:
+	RemoteRenderManager (
+		const Scene & scene,
+		const Camera & camera,
+		CImage & backbuffer,
+		SocketHandle socket,
+		std::mutex & socketLock
+	) :
+		RenderManager(scene, camera, backbuffer),
+		mSocket(socket),
+		mSocketLock(socketLock),
+		mSums(backbuffer.GetWidth(), backbuffer.GetHeight())
+	{
+		SetAccumulationBuffer(&mSums);
+	}
+
+	~RemoteRenderManager ()
+	{
+		StopRenderers();
+	}
+
+protected:
+	virtual void CreateBlocks () override
+	{
+	}
+
+	virtual bool GetBlock (Block & out) override;
+	virtual void CompleteBlock (const Block & block) override;
+
+private:
+	static uint64 BlockKey (const Block & block) { return (uint64(block.x) << 32) | block.y; }
+
+	SocketHandle           mSocket;
+	std::mutex &           mSocketLock;		// Shared with the heartbeat
+	std::map<uint64, uint32> mLeases;		// Block position to tile id, guarded by mSocketLock
+	CAccumulationBuffer    mSums;			// What gets sent back for each block
+};
+
+//=============================================================================
+bool RemoteRenderManager::GetBlock (Block & out)
+{
+	for (;;)
+	{
+		MessageHeader header;
+		std::vector<uint8> payload;
+		{
+			std::lock_guard<std::mutex> lock(mSocketLock);
+			if (!SendMessage(mSocket, MESSAGE_LEASE_REQUEST) || !RecvMessage(mSocket, &header, &payload))
+				header.type = MESSAGE_NO_WORK;
+
+			if (header.type == MESSAGE_LEASE && payload.size() == sizeof(LeaseMessage))
+			{
+				LeaseMessage lease;
+				memcpy(&lease, payload.data(), sizeof(lease));
+
+				mLeases[BlockKey(lease.block)] = lease.tile;
+				mIssuedBlocks++;
+				out = lease.block;
+			}
+		}
+
+		if (header.type == MESSAGE_LEASE)
+			return true;
+
+		if (header.type == MESSAGE_WAIT)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(RETRY_MS));
+			continue;
+		}
+
+		// Done, or the coordinator is gone
+		mbDrained = true;
+		SignalIfDone();
+		return false;
+	}
+}
+
+//=============================================================================
+void RemoteRenderManager::CompleteBlock (const Block & block)
+{
+	const uint32 pixels = block.width * block.height;
+
+	std::vector<uint8> payload(ResultBytes(block.width, block.height));
+	ResultMessage * result = (ResultMessage *)payload.data();
+	float32 *       sums   = (float32 *)(result + 1);
+	uint32 *        counts = (uint32 *)(sums + pixels * 3);
+
+	result->width  = block.width;
+	result->height = block.height;
+
+	for (uint y = 0; y < block.height; ++y)
+	{
+		for (uint x = 0; x < block.width; ++x)
+		{
+			const uint  i   = y * block.width + x;
+			const Color sum = mSums.GetSum(block.x + x, block.y + y);
+			sums[i * 3 + 0] = sum.r;
+			sums[i * 3 + 1] = sum.g;
+			sums[i * 3 + 2] = sum.b;
+			counts[i]       = mSums.GetCount(block.x + x, block.y + y);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mSocketLock);
+		result->tile = mLeases[BlockKey(block)];
+		mLeases.erase(BlockKey(block));
+		SendMessage(mSocket, MESSAGE_RESULT, payload.data(), uint32(payload.size()));
+	}
+
+	RenderManager::CompleteBlock(block);
+}
+
+} // namespace RT
+
+
+
+//=============================================================================
+// RenderCoordinator
+//=============================================================================
+
+//=============================================================================
+RenderCoordinator::RenderCoordinator (const RenderOptions & options) :
+	mOptions(options),
+	mWidth(0),
+	mHeight(0),
+	mSpp(0),
+	mCompletedTiles(0),
+	mReleasedTiles(0),
+	mbDone(false)
+{
+}
+
+//=============================================================================
+RenderCoordinator::~RenderCoordinator ()
+{
+}
+
+//=============================================================================
+int RenderCoordinator::Run (const char * address)
+{
+	if (!mOptions.scenePath)
+	{
+		std::cerr << "--coordinator needs --scene" << std::endl;
+		return 1;
+	}
+
+	// The scene is loaded here for its settings, and for the local comparison render
+	mScene.SetBvhBuilder(mOptions.bvhBuilder);
+	if (!RT::LoadScene(mOptions.scenePath, &mScene, &mSettings))
+	{
+		std::cerr << "Failed to load scene '" << mOptions.scenePath << "'" << std::endl;
+		return 2;
+	}
+
+	if (ResolveBvhNodes(mOptions, mSettings) == RT::BVH_NODES_QUANTIZED)
+		mScene.QuantizeMeshBvhs();
+
+	// Workers started elsewhere resolve the path against their own working directory
+#if !defined(_WIN32)
+	char absolute[PATH_MAX];
+	mScenePath = realpath(mOptions.scenePath, absolute) ? absolute : mOptions.scenePath;
+#else
+	mScenePath = mOptions.scenePath;
+#endif
+	if (mScenePath.size() >= sizeof(JobMessage::scene))
+	{
+		std::cerr << "Scene path '" << mScenePath << "' is too long to send to workers" << std::endl;
+		return 2;
+	}
+
+	mWidth  = mOptions.width  ? mOptions.width  : mSettings.width  ? mSettings.width  : DEFAULT_WIDTH;
+	mHeight = mOptions.height ? mOptions.height : mSettings.height ? mSettings.height : DEFAULT_HEIGHT;
+	mSpp    = mOptions.spp    ? mOptions.spp    : mSettings.spp    ? mSettings.spp    : DEFAULT_SPP;
+
+	// Tiles
+	{
+		const uint tileSize = mOptions.tileSize ? mOptions.tileSize : DEFAULT_TILE_SIZE;
+		for (uint y = 0; y < mHeight; y += tileSize)
+		{
+			for (uint x = 0; x < mWidth; x += tileSize)
+			{
+				Tile tile;
+				tile.block.x      = x;
+				tile.block.y      = y;
+				tile.block.width  = Min(tileSize, mWidth - x);
+				tile.block.height = Min(tileSize, mHeight - y);
+				tile.state        = TILE_STATE_PENDING;
+				tile.worker       = 0;
+				mTiles.push_back(tile);
+			}
+		}
+
+		for (uint32 i = uint32(mTiles.size()); i-- > 0; )
+			mPending.push_back(i);
+
+		mAccumulation.Resize(mWidth, mHeight);
+	}
+
+	const RT::SocketHandle listener = RT::SocketListen(address);
+	if (listener == RT::INVALID_SOCKET_HANDLE)
+	{
+		std::cerr << "Failed to listen on '" << address << "': " << strerror(errno) << std::endl;
+		return 2;
+	}
+
+	const Time::Point startTick = Time::GetRealTime();
+
+	std::thread acceptor(&RenderCoordinator::AcceptWorkers, this, listener);
+
+	bool bFailed = mOptions.workers && !SpawnWorkers(address);
+	if (bFailed)
+		std::cerr << "Failed to start worker processes" << std::endl;
+
+	const float32 leaseTimeout = mOptions.leaseTimeout > 0.0f ? mOptions.leaseTimeout : DEFAULT_LEASE_TIMEOUT;
+	Time::Point lastReport = startTick;
+
+	while (!bFailed)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		ReapSpawnedWorkers();
+
+		std::lock_guard<std::mutex> lock(mLock);
+		if (mCompletedTiles == mTiles.size())
+			break;
+
+		// Started with our own workers, nothing else is going to finish the frame once they are all gone
+		if (mOptions.workers && mChildren.empty())
+		{
+			bool bConnected = false;
+			for (auto & worker : mWorkers)
+				bConnected |= worker->connected;
+
+			if (!bConnected)
+			{
+				std::cerr << "Every worker process exited with " << mTiles.size() - mCompletedTiles << " tiles left" << std::endl;
+				bFailed = true;
+				break;
+			}
+		}
+
+		// Cut off workers which went quiet, their connection thread hands the tiles back
+		const Time::Point now = Time::GetRealTime();
+		for (auto & worker : mWorkers)
+		{
+			if (worker->connected && (now - worker->lastSeen).GetSeconds() > leaseTimeout)
+				RT::SocketShutdown(worker->socket);
+		}
+
+		if (!mOptions.headless && (now - lastReport).GetSeconds() >= 1.0f)
+		{
+			lastReport = now;
+			std::cout
+				<< std::fixed
+				<< std::setprecision(2)
+				<< std::setw(6)
+				<< mCompletedTiles * 100.0f / mTiles.size()
+				<< "%  "
+				<< mWorkers.size()
+				<< " workers"
+				<< std::endl;
+		}
+	}
+
+	const Time::Point endTick = Time::GetRealTime();
+
+	// Stop taking workers, then drop the ones still connected
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mbDone = true;
+	}
+
+	RT::SocketShutdown(listener);
+	acceptor.join();
+	RT::SocketClose(listener);
+
+	for (auto & worker : mWorkers)
+	{
+		RT::SocketShutdown(worker->socket);
+		worker->thread.join();
+		RT::SocketClose(worker->socket);
+	}
+
+	WaitForSpawnedWorkers();
+
+	if (bFailed)
+		return 2;
+
+	// Merge
+	RT::CImage backbuffer(mWidth, mHeight);
+	mAccumulation.Resolve(backbuffer, 0, 0);
+
+	if (mOptions.outputPath && !backbuffer.Save(mOptions.outputPath))
+	{
+		std::cerr << "Failed to write '" << mOptions.outputPath << "'" << std::endl;
+		return 2;
+	}
+
+	const float32 renderTime = (endTick - startTick).GetSeconds();
+	const float32 localTime  = mOptions.compareLocal ? RenderLocal() : 0.0f;
+
+	std::cout
+		<< std::fixed
+		<< std::setprecision(3)
+		<< "{\"scene\":"           << JsonString(mOptions.scenePath)
+		<< ",\"output\":"          << JsonString(mOptions.outputPath)
+		<< ",\"width\":"           << mWidth
+		<< ",\"height\":"          << mHeight
+		<< ",\"spp\":"             << mSpp
+		<< ",\"tiles\":"           << mTiles.size()
+		<< ",\"tiles_released\":"  << mReleasedTiles
+		<< ",\"workers\":"         << mWorkers.size()
+		<< ",\"render_seconds\":"  << renderTime;
+
+	if (mOptions.compareLocal)
+	{
+		std::cout
+			<< ",\"local_seconds\":" << localTime
+			<< ",\"speedup\":"       << (renderTime > 0.0f ? localTime / renderTime : 0.0f);
+	}
+
+	std::cout << ",\"tiles_per_worker\":[";
+	for (size_t i = 0; i < mWorkers.size(); ++i)
+		std::cout << (i ? "," : "") << mWorkers[i]->tilesCompleted;
+	std::cout << "]}" << std::endl;
+
+	return 0;
+}
+
+//=============================================================================
+void RenderCoordinator::AcceptWorkers (RT::SocketHandle listener)
+{
+	for (;;)
+	{
+		const RT::SocketHandle socket = RT::SocketAccept(listener);
+
+		std::lock_guard<std::mutex> lock(mLock);
+		if (mbDone)
+		{
+			RT::SocketClose(socket);
+			return;
+		}
+
+		if (socket == RT::INVALID_SOCKET_HANDLE)
+			continue;
+
+		std::unique_ptr<WorkerConnection> worker(new WorkerConnection);
+		worker->id             = uint32(mWorkers.size()) + 1;
+		worker->socket         = socket;
+		worker->lastSeen       = Time::GetRealTime();
+		worker->connected      = true;
+		worker->tilesCompleted = 0;
+		worker->thread         = std::thread(&RenderCoordinator::ServeWorker, this, worker.get());
+		mWorkers.push_back(std::move(worker));
+	}
+}
+
+//=============================================================================
+void RenderCoordinator::ServeWorker (WorkerConnection * worker)
+{
+	MessageHeader header;
+	std::vector<uint8> payload;
+
+	while (RecvMessage(worker->socket, &header, &payload))
+	{
+		std::unique_lock<std::mutex> lock(mLock);
+		worker->lastSeen = Time::GetRealTime();
+
+		switch (header.type)
+		{
+			case MESSAGE_HELLO:
+			{
+				JobMessage job;
+				memset(&job, 0, sizeof(job));
+				job.width  = mWidth;
+				job.height = mHeight;
+				job.spp    = mSpp;
+				strncpy(job.scene, mScenePath.c_str(), sizeof(job.scene) - 1);
+
+				lock.unlock();
+				SendMessage(worker->socket, MESSAGE_JOB, &job, sizeof(job));
+			}
+			break;
+
+			case MESSAGE_LEASE_REQUEST:
+			{
+				if (mPending.empty())
+				{
+					const bool done = mCompletedTiles == mTiles.size();
+					lock.unlock();
+					SendMessage(worker->socket, done ? MESSAGE_NO_WORK : MESSAGE_WAIT);
+					break;
+				}
+
+				LeaseMessage lease;
+				lease.tile  = mPending.back();
+				lease.block = mTiles[lease.tile].block;
+				mPending.pop_back();
+
+				mTiles[lease.tile].state  = TILE_STATE_LEASED;
+				mTiles[lease.tile].worker = worker->id;
+
+				lock.unlock();
+				SendMessage(worker->socket, MESSAGE_LEASE, &lease, sizeof(lease));
+			}
+			break;
+
+			case MESSAGE_RESULT:
+			{
+				if (payload.size() < sizeof(ResultMessage))
+					break;
+
+				const ResultMessage * result = (const ResultMessage *)payload.data();
+				if (result->tile >= mTiles.size())
+					break;
+
+				Tile & tile = mTiles[result->tile];
+				if (result->width != tile.block.width || result->height != tile.block.height)
+					break;
+
+				if (payload.size() != ResultBytes(result->width, result->height))
+					break;
+
+				// A tile can come back twice when its first worker was presumed lost
+				if (tile.state == TILE_STATE_DONE)
+					break;
+
+				const uint32    pixels = result->width * result->height;
+				const float32 * sums   = (const float32 *)(result + 1);
+				const uint32 *  counts = (const uint32 *)(sums + pixels * 3);
+				for (uint y = 0; y < result->height; ++y)
+				{
+					for (uint x = 0; x < result->width; ++x)
+					{
+						const uint i = y * result->width + x;
+						mAccumulation.AddSamples(
+							tile.block.x + x,
+							tile.block.y + y,
+							Color(sums[i * 3 + 0], sums[i * 3 + 1], sums[i * 3 + 2]),
+							counts[i]
+						);
+					}
+				}
+
+				// If this tile was handed out again, take it back off the queue
+				if (tile.state == TILE_STATE_PENDING)
+					mPending.erase(std::find(mPending.begin(), mPending.end(), result->tile));
+
+				tile.state = TILE_STATE_DONE;
+				worker->tilesCompleted++;
+				mCompletedTiles++;
+			}
+			break;
+
+			case MESSAGE_HEARTBEAT:
+			default:
+			break;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mLock);
+	worker->connected = false;
+	ReleaseTiles(worker->id);
+}
+
+//=============================================================================
+// Called with mLock held
+void RenderCoordinator::ReleaseTiles (uint32 workerId)
+{
+	for (uint32 i = 0; i < mTiles.size(); ++i)
+	{
+		Tile & tile = mTiles[i];
+		if (tile.state != TILE_STATE_LEASED || tile.worker != workerId)
+			continue;
+
+		tile.state  = TILE_STATE_PENDING;
+		tile.worker = 0;
+		mPending.push_back(i);
+		mReleasedTiles++;
+	}
+}
+
+//=============================================================================
+bool RenderCoordinator::SpawnWorkers (const char * address)
+{
+#if !defined(_WIN32)
+	const uint numLogicProc = ThreadLogicalProcessorCount();
+	const uint threads      = mOptions.threads ? mOptions.threads : Max<uint>(1, numLogicProc / mOptions.workers);
+
+	char threadsArg[16];
+	snprintf(threadsArg, sizeof(threadsArg), "%u", threads);
+
+	for (uint i = 0; i < mOptions.workers; ++i)
+	{
+		const pid_t pid = fork();
+		if (pid < 0)
+			return false;
+
+		if (pid == 0)
+		{
+			const char * args[] = {
+				"RayTracer",
+				"--worker", address,
+				"--threads", threadsArg,
+				"--bvh", RT::GetBvhBuilderName(mOptions.bvhBuilder),
+				"--bvh-nodes", RT::GetBvhNodesName(ResolveBvhNodes(mOptions, mSettings)),
+				"--headless",
+				null
+			};
+
+			execv("/proc/self/exe", (char * const *)args);
+			_exit(127);
+		}
+
+		mChildren.push_back(pid);
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+//=============================================================================
+// Forgets the worker processes which have exited, without waiting on the others
+void RenderCoordinator::ReapSpawnedWorkers ()
+{
+#if !defined(_WIN32)
+	for (size_t i = 0; i < mChildren.size(); )
+	{
+		int status;
+		if (waitpid(mChildren[i], &status, WNOHANG) == 0)
+		{
+			++i;
+			continue;
+		}
+
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			std::cerr << "Worker process " << mChildren[i] << " failed" << std::endl;
+
+		mChildren.erase(mChildren.begin() + i);
+	}
+#endif
+}
+
+//=============================================================================
+void RenderCoordinator::WaitForSpawnedWorkers ()
+{
+#if !defined(_WIN32)
+	for (int pid : mChildren)
+	{
+		int status;
+		waitpid(pid, &status, 0);
+	}
+#endif
+
+	mChildren.clear();
+}
+
+//=============================================================================
+// The same frame rendered in this process, to measure the speedup against
+float32 RenderCoordinator::RenderLocal ()
+{
+	RT::CImage backbuffer(mWidth, mHeight);
+	RT::Camera camera;
+	camera.Setup(mSettings.camera, mWidth / float32(mHeight));
+
+	const Time::Point startTick = Time::GetRealTime();
+
+	RT::RenderManager manager(mScene, camera, backbuffer);
+	manager.SetSamplesPerPixel(mSpp);
+	manager.SetThreadCount(mOptions.threads);
+	manager.SetAffinity(mOptions.affinity);
+	manager.Start();
+
+	manager.WaitForCompletion();
+
+	return (Time::GetRealTime() - startTick).GetSeconds();
+}
+
+
+
+//=============================================================================
+// RenderWorker
+//=============================================================================
+
+//=============================================================================
+RenderWorker::RenderWorker (const RenderOptions & options) :
+	mOptions(options)
+{
+}
+
+//=============================================================================
+int RenderWorker::Run (const char * address)
+{
+	const RT::SocketHandle socket = RT::SocketConnect(address);
+	if (socket == RT::INVALID_SOCKET_HANDLE)
+	{
+		std::cerr << "Failed to connect to '" << address << "'" << std::endl;
+		return 2;
+	}
+
+	JobMessage job;
+	{
+		MessageHeader header;
+		std::vector<uint8> payload;
+		if (
+			!SendMessage(socket, MESSAGE_HELLO) ||
+			!RecvMessage(socket, &header, &payload) ||
+			header.type != MESSAGE_JOB ||
+			payload.size() != sizeof(JobMessage)
+		) {
+			std::cerr << "No job from coordinator" << std::endl;
+			RT::SocketClose(socket);
+			return 2;
+		}
+
+		memcpy(&job, payload.data(), sizeof(job));
+		job.scene[sizeof(job.scene) - 1] = '\0';
+	}
+
+	RT::Scene         scene;
+	RT::SceneSettings settings;
+	scene.SetBvhBuilder(mOptions.bvhBuilder);
+	if (!RT::LoadScene(job.scene, &scene, &settings))
+	{
+		std::cerr << "Failed to load scene '" << job.scene << "'" << std::endl;
+		RT::SocketClose(socket);
+		return 2;
+	}
+
+	if (ResolveBvhNodes(mOptions, settings) == RT::BVH_NODES_QUANTIZED)
+		scene.QuantizeMeshBvhs();
+
+	RT::CImage backbuffer(job.width, job.height);
+	RT::Camera camera;
+	camera.Setup(settings.camera, job.width / float32(job.height));
+
+	std::mutex              socketLock;
+	std::mutex              heartbeatLock;
+	std::condition_variable heartbeatStop;
+	bool                    bStopping = false;
+
+	// Keeps the leases alive while the renderers are busy
+	std::thread heartbeat([&] {
+		std::unique_lock<std::mutex> lock(heartbeatLock);
+		while (!heartbeatStop.wait_for(lock, std::chrono::milliseconds(HEARTBEAT_MS), [&] { return bStopping; }))
+		{
+			std::lock_guard<std::mutex> sendLock(socketLock);
+			SendMessage(socket, MESSAGE_HEARTBEAT);
+		}
+	});
+
+	{
+		RT::RemoteRenderManager manager(scene, camera, backbuffer, socket, socketLock);
+		manager.SetSamplesPerPixel(job.spp);
+		manager.SetThreadCount(mOptions.threads);
+		manager.SetAffinity(mOptions.affinity);
+		manager.Start();
+
+		manager.WaitForCompletion();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(heartbeatLock);
+		bStopping = true;
+	}
+	heartbeatStop.notify_one();
+	heartbeat.join();
+
+	RT::SocketClose(socket);
+	return 0;
+}
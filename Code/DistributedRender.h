@@ -0,0 +1,109 @@
+//==================================================================================================
+//
+// File:	DistributedRender.h
+//
+// Splits one frame across several processes. A coordinator owns the tiles of the frame and
+// leases them to worker processes, which connect over tcp or a unix domain socket, render what
+// they are leased and send back an accumulation buffer per tile. Workers heartbeat while they
+// render; tiles leased to a worker which disconnects or goes quiet are leased again.
+//
+// Workers are sent the absolute path of the scene, not its contents, so workers on other machines
+// need the scene and its meshes at the same paths, on a shared file system or a copy of the tree.
+//
+// A tile renders the same wherever it runs and results are merged by position, so the final
+// image does not depend on which worker rendered which tile. Messages are in native byte order,
+// every process is expected to run on the same architecture.
+//=================================================================================================
+#ifndef DISTRIBUTEDRENDER_H
+#define DISTRIBUTEDRENDER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//==================================================================================================
+// RenderCoordinator
+//==================================================================================================
+class RenderCoordinator
+{
+public:
+	RenderCoordinator(const RenderOptions & options);
+	~RenderCoordinator();
+
+	//! Renders the scene from the options with whichever workers connect, returns the exit code
+	int Run(const char * address);
+
+private:
+	enum ETileState
+	{
+		TILE_STATE_PENDING,
+		TILE_STATE_LEASED,
+		TILE_STATE_DONE,
+	};
+
+	struct Tile
+	{
+		RT::Block  block;
+		ETileState state;
+		uint32     worker;
+	};
+
+	struct WorkerConnection
+	{
+		uint32           id;
+		RT::SocketHandle socket;
+		Time::Point      lastSeen;
+		bool             connected;
+		uint32           tilesCompleted;
+		std::thread      thread;
+	};
+
+	void AcceptWorkers(RT::SocketHandle listener);
+	void ServeWorker(WorkerConnection * worker);
+	void ReleaseTiles(uint32 workerId);
+	bool SpawnWorkers(const char * address);
+	void ReapSpawnedWorkers();
+	void WaitForSpawnedWorkers();
+	float32 RenderLocal();
+
+	// Data
+	RenderOptions                                  mOptions;
+	RT::Scene                                      mScene;
+	RT::SceneSettings                              mSettings;
+	std::string                                    mScenePath;	// Absolute, as sent to workers
+	uint32                                         mWidth;
+	uint32                                         mHeight;
+	uint32                                         mSpp;
+
+	std::mutex                                     mLock;
+	std::vector<Tile>                              mTiles;
+	std::vector<uint32>                            mPending;	// Tile indices, leased from the back
+	uint32                                         mCompletedTiles;
+	uint32                                         mReleasedTiles;	// Leases taken back from lost workers
+	bool                                           mbDone;
+	std::vector<std::unique_ptr<WorkerConnection>> mWorkers;
+	RT::CAccumulationBuffer                        mAccumulation;
+
+	std::vector<int>                               mChildren;	// Worker processes we started
+};
+
+
+
+//==================================================================================================
+// RenderWorker
+//==================================================================================================
+class RenderWorker
+{
+public:
+	RenderWorker(const RenderOptions & options);
+
+	//! Renders tiles for the coordinator at address until it runs out, returns the exit code
+	int Run(const char * address);
+
+private:
+	RenderOptions mOptions;
+};
+
+#endif //DISTRIBUTEDRENDER_H
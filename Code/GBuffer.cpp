@@ -0,0 +1,53 @@
+//==================================================================================================
+//
+// File:	GBuffer.cpp
+//
+// Camera ray hits kept between samples and renders.
+//
+//=================================================================================================
+
+#include <algorithm>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+GBuffer::GBuffer () :
+	mWidth(0),
+	mHeight(0),
+	mSamplesPerPixel(1)
+{
+}
+
+//=============================================================================
+void GBuffer::Resize (uint width, uint height, uint samplesPerPixel)
+{
+	ASSERT(samplesPerPixel);
+
+	if (width == mWidth && height == mHeight && samplesPerPixel == mSamplesPerPixel)
+		return;
+
+	mWidth           = width;
+	mHeight          = height;
+	mSamplesPerPixel = samplesPerPixel;
+
+	const uint64 count = uint64(width) * height * samplesPerPixel;
+	mHits.resize(count);
+	mbStored.assign(count, 0);
+}
+
+//=============================================================================
+void GBuffer::Clear ()
+{
+	std::fill(mbStored.begin(), mbStored.end(), 0);
+}
+
+//=============================================================================
+uint64 GBuffer::GetMemorySize (uint width, uint height, uint samplesPerPixel)
+{
+	return uint64(width) * height * samplesPerPixel * (sizeof(PrimaryHit) + sizeof(uint8));
+}
+
+} // namespace RT
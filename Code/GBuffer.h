@@ -0,0 +1,81 @@
+//==================================================================================================
+//
+// File:	GBuffer.h
+//
+// What the camera rays of a frame hit, kept between samples and renders while the camera and the
+// geometry stay put, so shading can start from the first hit without tracing the ray again.
+//=================================================================================================
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <vector>
+
+namespace RT
+{
+
+class Object;
+
+//! The first hit of a camera ray, object is null for a ray that hit nothing
+struct PrimaryHit
+{
+	const Object * object;
+	Point3         point;
+	Vector3        normal;
+};
+
+//==================================================================================================
+//
+// A hit per sample of every pixel, or a single one per pixel when every sample of a pixel goes
+// through its center and they all hit the same thing. Sample s of a pixel always has the same
+// camera ray, so a hit per sample gives the same image as tracing it every time. Renderers fill
+// it as they go and blocks never overlap, so there are no locks. Whoever moves the camera or the
+// geometry has to Clear it.
+//==================================================================================================
+class GBuffer
+{
+public:
+	GBuffer ();
+
+	//! Clears the hits if the layout changed
+	void Resize (uint width, uint height, uint samplesPerPixel);
+	void Clear ();
+
+	inline uint GetWidth () const { return mWidth; }
+	inline uint GetHeight () const { return mHeight; }
+	//! 1 when every sample shares the hit of the pixel center
+	inline uint GetSamplesPerPixel () const { return mSamplesPerPixel; }
+	//! Memory a buffer of the layout takes
+	static uint64 GetMemorySize (uint width, uint height, uint samplesPerPixel);
+	inline uint64 GetMemorySize () const { return GetMemorySize(mWidth, mHeight, mSamplesPerPixel); }
+
+	//! null until the sample's hit is stored
+	inline const PrimaryHit * Find (uint x, uint y, uint sample) const
+	{
+		const uint64 i = GetIndex(x, y, sample);
+		return mbStored[i] ? &mHits[i] : null;
+	}
+
+	inline void Store (uint x, uint y, uint sample, const PrimaryHit & hit)
+	{
+		const uint64 i = GetIndex(x, y, sample);
+		mHits[i]    = hit;
+		mbStored[i] = 1;
+	}
+
+private:
+	inline uint64 GetIndex (uint x, uint y, uint sample) const
+	{
+		ASSERT(x < mWidth && y < mHeight);
+		return (uint64(y) * mWidth + x) * mSamplesPerPixel + (mSamplesPerPixel > 1 ? sample : 0);
+	}
+
+	uint                    mWidth;
+	uint                    mHeight;
+	uint                    mSamplesPerPixel;
+	std::vector<PrimaryHit> mHits;
+	std::vector<uint8>      mbStored;	// Bytes rather than bits, so renderers never share a word
+};
+
+} // namespace RT
+
+#endif //GBUFFER_H
@@ -1,6 +1,8 @@
 #define _CRT_SECURE_NO_WARNINGS
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 
 #include "Pch.h"
 
@@ -39,9 +41,11 @@ Color CImage::GetPixel (uint x, uint y) const
     return m_pixels[index];
 }
 
-void CImage::Save (const char filename[]) const
+bool CImage::Save (const char filename[]) const
 {
     FILE * f = fopen(filename, "wb");
+    if (!f)
+        return false;
 
 #include <pshpack1.h>
     struct TgaHeader {
@@ -64,7 +68,7 @@ void CImage::Save (const char filename[]) const
     header.width  = m_width;
     header.height = m_height;
 
-    fwrite(&header, sizeof(TgaHeader), 1, f);
+    bool ok = fwrite(&header, sizeof(TgaHeader), 1, f) == 1;
 
     for (const Color & c : m_pixels) {
         const uint r = Min(FloatToUint(c.r * 255), uint(255));
@@ -75,7 +79,144 @@ void CImage::Save (const char filename[]) const
         fputc(r, f);
     }
 
+    ok = ok && !ferror(f);
+    return fclose(f) == 0 && ok;
+}
+
+
+CAccumulationBuffer::CAccumulationBuffer (uint width, uint height) :
+    m_width(0),
+    m_height(0)
+{
+    Resize(width, height);
+}
+
+void CAccumulationBuffer::Resize (uint width, uint height)
+{
+    m_width = width;
+    m_height = height;
+    m_sums.assign(size_t(width) * height * 3, 0.0f);
+    m_counts.assign(size_t(width) * height, 0);
+}
+
+void CAccumulationBuffer::Clear ()
+{
+    std::fill(m_sums.begin(), m_sums.end(), 0.0f);
+    std::fill(m_counts.begin(), m_counts.end(), 0);
+}
+
+void CAccumulationBuffer::AddSamples (uint x, uint y, const Color & sum, uint32 count)
+{
+    ASSERT(x < m_width);
+    ASSERT(y < m_height);
+
+    const size_t index = size_t(y) * m_width + x;
+    m_sums[index * 3 + 0] += sum.r;
+    m_sums[index * 3 + 1] += sum.g;
+    m_sums[index * 3 + 2] += sum.b;
+    m_counts[index]       += count;
+}
+
+Color CAccumulationBuffer::GetSum (uint x, uint y) const
+{
+    ASSERT(x < m_width);
+    ASSERT(y < m_height);
+
+    const size_t index = size_t(y) * m_width + x;
+    return Color(m_sums[index * 3 + 0], m_sums[index * 3 + 1], m_sums[index * 3 + 2]);
+}
+
+uint32 CAccumulationBuffer::GetCount (uint x, uint y) const
+{
+    ASSERT(x < m_width);
+    ASSERT(y < m_height);
+
+    return m_counts[size_t(y) * m_width + x];
+}
+
+void CAccumulationBuffer::Merge (const CAccumulationBuffer & src, uint x, uint y)
+{
+    ASSERT(x + src.m_width <= m_width);
+    ASSERT(y + src.m_height <= m_height);
+
+    for (uint j = 0; j < src.m_height; ++j)
+    {
+        for (uint i = 0; i < src.m_width; ++i)
+            AddSamples(x + i, y + j, src.GetSum(i, j), src.GetCount(i, j));
+    }
+}
+
+void CAccumulationBuffer::Resolve (CImage & out, uint x, uint y) const
+{
+    for (uint j = 0; j < m_height; ++j)
+    {
+        for (uint i = 0; i < m_width; ++i)
+        {
+            const uint32 count = GetCount(i, j);
+            if (count)
+                out.SetPixel(x + i, y + j, GetSum(i, j) / float32(count));
+        }
+    }
+}
+
+
+namespace
+{
+    const char   ACCUMULATION_MAGIC[4] = { 'R', 'T', 'A', 'C' };
+    const uint32 ACCUMULATION_VERSION  = 1;
+
+    struct AccumulationHeader
+    {
+        char        magic[4];
+        uint32      version;
+        uint32      width;
+        uint32      height;
+        SampleRange range;
+    };
+}
+
+bool CAccumulationBuffer::Save (const char filename[], const SampleRange & range) const
+{
+    FILE * f = fopen(filename, "wb");
+    if (!f)
+        return false;
+
+    AccumulationHeader header;
+    memcpy(header.magic, ACCUMULATION_MAGIC, sizeof(header.magic));
+    header.version = ACCUMULATION_VERSION;
+    header.width   = m_width;
+    header.height  = m_height;
+    header.range   = range;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && fwrite(m_sums.data(), sizeof(float32), m_sums.size(), f) == m_sums.size();
+    ok = ok && fwrite(m_counts.data(), sizeof(uint32), m_counts.size(), f) == m_counts.size();
+
     fclose(f);
+    return ok;
 }
 
-}
\ No newline at end of file
+bool CAccumulationBuffer::Load (const char filename[], SampleRange * range)
+{
+    FILE * f = fopen(filename, "rb");
+    if (!f)
+        return false;
+
+    AccumulationHeader header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1;
+    ok = ok && !memcmp(header.magic, ACCUMULATION_MAGIC, sizeof(header.magic));
+    ok = ok && header.version == ACCUMULATION_VERSION;
+
+    if (ok)
+    {
+        Resize(header.width, header.height);
+        ok = ok && fread(m_sums.data(), sizeof(float32), m_sums.size(), f) == m_sums.size();
+        ok = ok && fread(m_counts.data(), sizeof(uint32), m_counts.size(), f) == m_counts.size();
+        *range = header.range;
+    }
+
+    fclose(f);
+    return ok;
+}
+
+}
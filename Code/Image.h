@@ -1,4 +1,6 @@
 
+#include <vector>
+
 #include "Basics/Thread.h"
 
 namespace RT
@@ -37,7 +39,7 @@ public:
     void SetPixel (uint x, uint y, const Color & color);
     Color GetPixel (uint x, uint y) const;
 
-    void Save (const char filename[]) const;
+    bool Save (const char filename[]) const;
 private:
     uint m_width;
     uint m_height;
@@ -45,4 +47,61 @@ private:
 };
 
 
+//=============================================================================
+// Which samples of each pixel a render took, out of the total for the frame
+//=============================================================================
+struct SampleRange
+{
+    uint32 total;
+    uint32 begin;
+    uint32 end;
+};
+
+
+//=============================================================================
+// Sum of samples and sample count per pixel. Partial renders of the same
+// pixels can be merged by adding them together, in any order.
+//=============================================================================
+class CAccumulationBuffer
+{
+public:
+    CAccumulationBuffer () :
+        m_width(0),
+        m_height(0)
+    {}
+    CAccumulationBuffer (uint width, uint height);
+
+    void Resize (uint width, uint height);
+    void Clear ();
+
+    uint GetWidth () const { return m_width; }
+    uint GetHeight () const { return m_height; }
+
+    void AddSamples (uint x, uint y, const Color & sum, uint32 count);
+    Color GetSum (uint x, uint y) const;
+    uint32 GetCount (uint x, uint y) const;
+
+    // Adds all of src into this buffer with src's origin at (x, y)
+    void Merge (const CAccumulationBuffer & src, uint x, uint y);
+
+    // Writes the average of every pixel with samples into the image at (x, y)
+    void Resolve (CImage & out, uint x, uint y) const;
+
+    bool Save (const char filename[], const SampleRange & range) const;
+    bool Load (const char filename[], SampleRange * range);
+
+    // Raw access for sending over the wire, three floats and one count per pixel
+    float32 * GetSums () { return m_sums.data(); }
+    uint32 * GetCounts () { return m_counts.data(); }
+    const float32 * GetSums () const { return m_sums.data(); }
+    const uint32 * GetCounts () const { return m_counts.data(); }
+
+private:
+    uint            m_width;
+    uint            m_height;
+    std::vector<float32> m_sums;
+    std::vector<uint32>  m_counts;
+};
+
+
 } // namespace RT
\ No newline at end of file
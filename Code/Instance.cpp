@@ -0,0 +1,251 @@
+//==================================================================================================
+//
+// File:	Instance.cpp
+//
+// Instances intersect their asset with the ray brought into the asset's space. The direction is
+// not normalized again, so hit times along the local ray are hit times along the world ray.
+//
+//=================================================================================================
+
+#include <cmath>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+bool ParseTransformDesc (const Json::CValue & json, TransformDesc * out)
+{
+	using namespace Json;
+
+	out->scale     = Vector3(1.0f, 1.0f, 1.0f);
+	out->axis      = Vector3::UnitZ;
+	out->angle     = 0.0f;
+	out->translate = Vector3::Zero;
+
+	const CValue & jsonScale = json[{"scale"}];
+	if (jsonScale.GetType() == EType::Number)
+	{
+		const float32 uniform = float32(*jsonScale.As<NumberType>());
+		out->scale = Vector3(uniform, uniform, uniform);
+	}
+	else if (jsonScale.GetType() == EType::Array && !ParseVector3(jsonScale, &out->scale))
+	{
+		return false;
+	}
+
+	const CValue & jsonRotate = json[{"rotate"}];
+	if (jsonRotate.GetType() == EType::Object)
+	{
+		if (!ParseVector3(jsonRotate[{"axis"}], &out->axis) || Dot(out->axis, out->axis) == 0.0f)
+			return false;
+
+		const CValue & jsonAngle = jsonRotate[{"angle"}];
+		if (jsonAngle.GetType() != EType::Number)
+			return false;
+
+		out->angle = float32(*jsonAngle.As<NumberType>());
+	}
+
+	const CValue & jsonTranslate = json[{"translate"}];
+	if (jsonTranslate.GetType() == EType::Array && !ParseVector3(jsonTranslate, &out->translate))
+		return false;
+
+	return true;
+}
+
+//=============================================================================
+bool ComputeTransform (const TransformDesc & desc, Matrix33 * linear)
+{
+	if (Dot(desc.axis, desc.axis) == 0.0f)
+		return false;
+
+	// Rodrigues' formula, the columns are the rotated unit axes
+	const Vector3 k = Normalize(desc.axis);
+	const Radian  angle(Degree(desc.angle));
+	const float32 c = Cos(angle);
+	const float32 s = Sin(angle);
+	const float32 t = 1.0f - c;
+
+	const Vector3 u = Vector3(c + k.x * k.x * t,       k.y * k.x * t + k.z * s, k.z * k.x * t - k.y * s) * desc.scale.x;
+	const Vector3 v = Vector3(k.x * k.y * t - k.z * s, c + k.y * k.y * t,       k.z * k.y * t + k.x * s) * desc.scale.y;
+	const Vector3 w = Vector3(k.x * k.z * t + k.y * s, k.y * k.z * t - k.x * s, c + k.z * k.z * t)       * desc.scale.z;
+
+	// The instance needs to map rays back into the asset
+	if (Dot(u, Cross(v, w)) == 0.0f)
+		return false;
+
+	*linear = Matrix33(
+		u.x, v.x, w.x,
+		u.y, v.y, w.y,
+		u.z, v.z, w.z
+	);
+
+	return true;
+}
+
+//=============================================================================
+TransformDesc BlendTransforms (const TransformDesc & a, const TransformDesc & b, float32 t)
+{
+	TransformDesc out;
+	out.scale     = a.scale + (b.scale - a.scale) * t;
+	out.axis      = a.axis + (b.axis - a.axis) * t;
+	out.angle     = a.angle + (b.angle - a.angle) * t;
+	out.translate = a.translate + (b.translate - a.translate) * t;
+	return out;
+}
+
+
+
+//=============================================================================
+// Instance
+//=============================================================================
+
+//=============================================================================
+Instance::Instance(
+	const std::shared_ptr<const Object> & asset,
+	const Matrix33 &                      linear,
+	const Vector3 &                       translation,
+	const Material &                      material
+) :
+	Object(material),
+	mAsset(asset),
+	mObjectToWorld(linear),
+	mWorldToObject(Inverse(linear)),
+	mTranslation(translation)
+{
+}
+
+//=============================================================================
+Instance * Instance::Clone() const
+{
+	return new Instance(mAsset, mObjectToWorld, mTranslation, mMaterial);
+}
+
+//=============================================================================
+void Instance::SetTransform(const Matrix33 & linear, const Vector3 & translation)
+{
+	mObjectToWorld = linear;
+	mWorldToObject = Inverse(linear);
+	mTranslation   = translation;
+}
+
+//=============================================================================
+Vector3 Instance::GetAxis(uint i) const
+{
+	ASSERT(i < 3);
+
+	Vector3 unit = Vector3::Zero;
+	unit[i] = 1.0f;
+	return mObjectToWorld * unit;
+}
+
+//=============================================================================
+// The asset's box is turned into the box around its transformed corners, see Arvo's
+// "Transforming Axis-Aligned Bounding Boxes" in Graphics Gems
+Aabb3 Instance::GetBounds() const
+{
+	const Aabb3   bounds = mAsset->GetBounds();
+	const Vector3 center = (Vector3(bounds.max) + Vector3(bounds.min)) * 0.5f;
+	const Vector3 extent = (Vector3(bounds.max) - Vector3(bounds.min)) * 0.5f;
+
+	const Vector3 worldCenter = mObjectToWorld * center + mTranslation;
+
+	Vector3 worldExtent = Vector3::Zero;
+	for (uint i = 0; i < 3; ++i)
+	{
+		const Vector3 axis = GetAxis(i);
+		for (uint row = 0; row < 3; ++row)
+			worldExtent[row] += std::fabs(axis[row]) * extent[i];
+	}
+
+	return Aabb3(Point3(worldCenter - worldExtent), Point3(worldCenter + worldExtent));
+}
+
+//=============================================================================
+bool Instance::Intersect(Result & out, const Ray3 & ray) const
+{
+	const Ray3 local(
+		Point3(mWorldToObject * (Vector3(ray.origin) - mTranslation)),
+		mWorldToObject * ray.direction
+	);
+
+	// Meshes are intersected directly, which side they face depends on the instance's material
+	if (mAsset->GetShapeType() == SHAPE_TYPE_MESH)
+	{
+		if (!static_cast<const TriangleMesh *>(mAsset.get())->GetMesh()->Intersect(out, local))
+			return false;
+	}
+	else if (!mAsset->Intersect(out, local))
+	{
+		return false;
+	}
+
+	// Normals transform by the inverse transpose
+	out.point  = ray.origin + ray.direction * out.time;
+	out.normal = Normalize(Transpose(mWorldToObject) * out.normal);
+
+	if (mAsset->GetShapeType() == SHAPE_TYPE_MESH && mMaterial.type != MATERIAL_TYPE_REFRACT && Dot(out.normal, ray.direction) > 0.0f)
+		out.normal = -out.normal;
+
+	return true;
+}
+
+
+
+//=============================================================================
+// SceneAssets
+//=============================================================================
+
+//=============================================================================
+SceneAssets::SceneAssets (const std::string & directory, EBvhBuilder builder) :
+	mDirectory(directory),
+	mBuilder(builder)
+{
+}
+
+//=============================================================================
+std::string SceneAssets::ResolvePath (const std::string & directory, const std::string & filename)
+{
+	const bool absolute = !filename.empty() && (filename[0] == '/' || filename[0] == '\\' || filename.find(':') != std::string::npos);
+	return absolute || directory.empty() ? filename : directory + "/" + filename;
+}
+
+//=============================================================================
+std::shared_ptr<const Mesh> SceneAssets::GetMesh (const std::string & filename)
+{
+	const std::string path = ResolvePath(mDirectory, filename);
+
+	const auto it = mMeshes.find(path);
+	if (it != mMeshes.end())
+		return it->second;
+
+	std::shared_ptr<const Mesh> mesh = LoadMesh(path.c_str(), mBuilder);
+	if (mesh)
+		mMeshes[path] = mesh;
+
+	return mesh;
+}
+
+//=============================================================================
+bool SceneAssets::AddShape (const std::string & name, const std::shared_ptr<const Object> & shape)
+{
+	return mShapes.emplace(name, shape).second;
+}
+
+//=============================================================================
+std::shared_ptr<const Object> SceneAssets::FindShape (const std::string & name) const
+{
+	const auto it = mShapes.find(name);
+	if (it == mShapes.end())
+		return null;
+
+	return it->second;
+}
+
+} // namespace RT
@@ -0,0 +1,102 @@
+//==================================================================================================
+//
+// File:	Instance.h
+//
+// Instances place a shared shape or mesh in the scene with an affine transform of their own. The
+// shape and its bvh are stored once however many instances use it, the scene's bvh over the
+// instances is the top level and each mesh's bvh the bottom level.
+//=================================================================================================
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace RT
+{
+
+//==================================================================================================
+//
+// An instance's transform by its parts, the asset is scaled, then rotated, then translated. Kept
+// apart from the matrix it makes so keyframes can be blended.
+//==================================================================================================
+struct TransformDesc
+{
+	Vector3 scale;
+	Vector3 axis;		//!< Of the rotation
+	float32 angle;		//!< Degrees
+	Vector3 translate;
+};
+
+//! Parses the optional "scale" (a number or one per axis), "rotate" ({"axis", "angle"}) and
+//! "translate" of json
+bool ParseTransformDesc (const Json::CValue & json, TransformDesc * out);
+//! Returns false when the transform can not be inverted
+bool ComputeTransform (const TransformDesc & desc, Matrix33 * linear);
+//! Blends every part on its own, t is 0 for a and 1 for b
+TransformDesc BlendTransforms (const TransformDesc & a, const TransformDesc & b, float32 t);
+
+//==================================================================================================
+// Instance
+//==================================================================================================
+class Instance : public Object
+{
+public:
+	//! The asset is transformed by linear and then moved by translation, its material is not used
+	Instance(
+		const std::shared_ptr<const Object> & asset,
+		const Matrix33 &                      linear,
+		const Vector3 &                       translation,
+		const Material &                      material
+	);
+
+	virtual bool       Intersect(Result & out, const Ray3 & ray) const;
+	virtual Instance * Clone() const;
+	virtual Aabb3      GetBounds() const;
+	virtual EShapeType GetShapeType() const { return SHAPE_TYPE_INSTANCE; }
+
+	const std::shared_ptr<const Object> & GetAsset() const { return mAsset; }
+	//! Returns the world space image of the asset's axis i
+	Vector3         GetAxis(uint i) const;
+	const Vector3 & GetTranslation() const { return mTranslation; }
+
+	//! Moves the instance, the bvh it is in has to be refitted or rebuilt afterwards
+	void SetTransform(const Matrix33 & linear, const Vector3 & translation);
+
+private:
+	std::shared_ptr<const Object> mAsset;
+	Matrix33                      mObjectToWorld;
+	Matrix33                      mWorldToObject;
+	Vector3                       mTranslation;
+};
+
+//==================================================================================================
+//
+// Shapes and meshes shared by the objects of one scene while it is read. Meshes are loaded once
+// per file and named shapes are what instances refer to.
+//==================================================================================================
+class SceneAssets
+{
+public:
+	//! Relative mesh paths are looked up in directory, their hierarchies are built with builder
+	SceneAssets (const std::string & directory, EBvhBuilder builder);
+
+	std::shared_ptr<const Mesh> GetMesh (const std::string & filename);
+	//! Where GetMesh looks for filename, relative to the scene's directory unless it is absolute
+	static std::string ResolvePath (const std::string & directory, const std::string & filename);
+
+	//! Returns false when name is already taken
+	bool                          AddShape (const std::string & name, const std::shared_ptr<const Object> & shape);
+	std::shared_ptr<const Object> FindShape (const std::string & name) const;
+
+private:
+	std::string                                          mDirectory;
+	EBvhBuilder                                          mBuilder;
+	std::map<std::string, std::shared_ptr<const Mesh>>   mMeshes;
+	std::map<std::string, std::shared_ptr<const Object>> mShapes;
+};
+
+} // namespace RT
+
+#endif //INSTANCE_H
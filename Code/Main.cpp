@@ -1,10 +1,73 @@
 #define USES_ENGINE_STRING
 #include "Pch.h"
 
-int wmain () 
+//=============================================================================
+static int Run (const RenderOptions & options)
+{
+	if (options.generate)
+		return WriteStressScene(options);
+
+	if (options.renderBench)
+		return RunRenderBenchmarks(options);
+
+	if (options.mergeOutput)
+		return MergeShards(options);
+
+	if (options.coordinator)
+	{
+		RenderCoordinator coordinator(options);
+		return coordinator.Run(options.coordinator);
+	}
+
+	if (options.worker)
+	{
+		RenderWorker worker(options);
+		return worker.Run(options.worker);
+	}
+
+	if (options.daemon)
+	{
+		RenderService service(options);
+		return service.Run(options.daemon);
+	}
+
+	Application app(options);
+	return app.Run();
+}
+
+//=============================================================================
+int main (int argc, char * argv[]) 
 {	
-	Application app;
-	app.Run();
+	RenderOptions options;
+	if (!ParseCommandLine(argc, argv, &options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	if (options.help)
+	{
+		PrintUsage(argv[0]);
+		return 0;
+	}
+
+	if (options.tracePath)
+	{
+		RT::SetTraceThreadName("Main");
+		RT::StartTrace();
+	}
+
+	const int result = Run(options);
+
+	if (options.tracePath)
+	{
+		RT::StopTrace();
+		if (!RT::WriteTrace(options.tracePath))
+		{
+			fprintf(stderr, "Failed to write '%s'\n", options.tracePath);
+			return result ? result : 2;
+		}
+	}
 
-	return 0;
-}
\ No newline at end of file
+	return result;
+}
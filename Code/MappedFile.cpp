@@ -0,0 +1,138 @@
+//==================================================================================================
+//
+// File:	MappedFile.cpp
+//
+// Memory mapped files, mmap on posix platforms and file mappings on windows.
+//
+//=================================================================================================
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+MappedFile::MappedFile () :
+    mData(null),
+    mSize(0)
+#if defined(_WIN32)
+    , mFile(INVALID_HANDLE_VALUE)
+    , mMapping(null)
+#endif
+{
+}
+
+//=============================================================================
+MappedFile::~MappedFile ()
+{
+    Close();
+}
+
+#if defined(_WIN32)
+
+//=============================================================================
+bool MappedFile::Open (const char * filename)
+{
+    Close();
+
+    mFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, null, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, null);
+    if (mFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mFile, &size) || size.QuadPart <= 0)
+    {
+        Close();
+        return false;
+    }
+
+    mMapping = CreateFileMappingA(mFile, null, PAGE_READONLY, 0, 0, null);
+    if (!mMapping)
+    {
+        Close();
+        return false;
+    }
+
+    mData = MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!mData)
+    {
+        Close();
+        return false;
+    }
+
+    mSize = uint64(size.QuadPart);
+    return true;
+}
+
+//=============================================================================
+void MappedFile::Close ()
+{
+    if (mData)
+        UnmapViewOfFile(mData);
+
+    if (mMapping)
+        CloseHandle(mMapping);
+
+    if (mFile != INVALID_HANDLE_VALUE)
+        CloseHandle(mFile);
+
+    mData    = null;
+    mSize    = 0;
+    mMapping = null;
+    mFile    = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+//=============================================================================
+bool MappedFile::Open (const char * filename)
+{
+    Close();
+
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    // The mapping keeps the file alive, the descriptor is not needed past this point
+    void * data = mmap(null, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    mData = data;
+    mSize = uint64(info.st_size);
+    return true;
+}
+
+//=============================================================================
+void MappedFile::Close ()
+{
+    if (mData)
+        munmap(const_cast<void *>(mData), size_t(mSize));
+
+    mData = null;
+    mSize = 0;
+}
+
+#endif
+
+} // namespace RT
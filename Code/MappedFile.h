@@ -0,0 +1,40 @@
+//==================================================================================================
+//
+// File:	MappedFile.h
+//
+// Read only view of a whole file mapped into memory. Pages are loaded as they are touched, so
+// opening a large file costs almost nothing until its contents are used.
+//=================================================================================================
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+namespace RT
+{
+
+class MappedFile
+{
+public:
+    MappedFile ();
+    ~MappedFile ();
+
+    bool Open (const char * filename);
+    void Close ();
+
+    inline const void * GetData () const { return mData; }
+    inline uint64       GetSize () const { return mSize; }
+
+private:
+    MappedFile (const MappedFile &) = delete;
+    MappedFile & operator= (const MappedFile &) = delete;
+
+    const void * mData;
+    uint64       mSize;
+#if defined(_WIN32)
+    void *       mFile;
+    void *       mMapping;
+#endif
+};
+
+} // namespace RT
+
+#endif //MAPPEDFILE_H
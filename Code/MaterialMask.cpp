@@ -0,0 +1,42 @@
+//==================================================================================================
+//
+// File:	MaterialMask.cpp
+//
+// Per pixel material bits kept between renders.
+//
+//=================================================================================================
+
+#include <algorithm>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+const uint64 MaterialMask::ALL_MATERIALS;
+
+//=============================================================================
+MaterialMask::MaterialMask () :
+	mWidth(0),
+	mHeight(0)
+{
+}
+
+//=============================================================================
+void MaterialMask::Resize (uint width, uint height)
+{
+	if (width == mWidth && height == mHeight)
+		return;
+
+	mWidth  = width;
+	mHeight = height;
+	mMasks.assign(uint64(width) * height, ALL_MATERIALS);
+}
+
+//=============================================================================
+void MaterialMask::Clear ()
+{
+	std::fill(mMasks.begin(), mMasks.end(), ALL_MATERIALS);
+}
+
+} // namespace RT
@@ -0,0 +1,69 @@
+//==================================================================================================
+//
+// File:	MaterialMask.h
+//
+// Which materials the paths through every pixel touched, kept between renders so that once
+// materials change only the pixels which saw one of them have to be rendered again.
+//=================================================================================================
+#ifndef MATERIALMASK_H
+#define MATERIALMASK_H
+
+#include <vector>
+
+namespace RT
+{
+
+//! The bit of a material index from Scene::IndexMaterials. Scenes with up to 64 distinct materials
+//! give each its own bit, past that materials share bits, and a change to one of them looks like
+//! a change to all that share its bit.
+inline uint64 GetMaterialBit (uint32 materialIndex)
+{
+	return uint64(1) << (materialIndex % 64);
+}
+
+//==================================================================================================
+//
+// The material bits of every path rendered through a pixel. Sample s of a pixel follows the same
+// path for as long as it meets the same materials, so pixels which never touched a changed
+// material would come out exactly as they did. Renderers fill it as they go and blocks never
+// overlap, so there are no locks. Whoever moves the camera or the geometry has to Clear it.
+//==================================================================================================
+class MaterialMask
+{
+public:
+	MaterialMask ();
+
+	//! Clears the mask if the size changed
+	void Resize (uint width, uint height);
+	void Clear ();
+
+	inline uint GetWidth () const { return mWidth; }
+	inline uint GetHeight () const { return mHeight; }
+	inline uint64 GetMemorySize () const { return mMasks.size() * sizeof(uint64); }
+
+	//! Material bits of every path rendered through the pixel since the last Clear, all of them
+	//! until the pixel was rendered
+	inline uint64 Get (uint x, uint y) const { return mMasks[GetIndex(x, y)]; }
+	inline void Add (uint x, uint y, uint64 materials)
+	{
+		uint64 & pixel = mMasks[GetIndex(x, y)];
+		pixel = (pixel == ALL_MATERIALS ? 0 : pixel) | materials;
+	}
+
+private:
+	static const uint64 ALL_MATERIALS = ~0ull;
+
+	inline uint64 GetIndex (uint x, uint y) const
+	{
+		ASSERT(x < mWidth && y < mHeight);
+		return uint64(y) * mWidth + x;
+	}
+
+	uint                mWidth;
+	uint                mHeight;
+	std::vector<uint64> mMasks;
+};
+
+} // namespace RT
+
+#endif //MATERIALMASK_H
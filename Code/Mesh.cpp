@@ -0,0 +1,273 @@
+//==================================================================================================
+//
+// File:	Mesh.cpp
+//
+// Triangle meshes and the watertight ray/triangle test of Woop, Benthin and Wald, "Watertight
+// Ray/Triangle Intersection" (JCGT 2013). Rays through shared edges and vertices always hit
+// exactly one of the triangles sharing them, so closed meshes never leak rays through cracks.
+//
+//=================================================================================================
+
+#include <cmath>
+#include <limits>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+//=============================================================================
+// The ray is sheared and scaled so it points down +z, which only has to happen once per ray
+struct WatertightRay
+{
+	uint    kx;
+	uint    ky;
+	uint    kz;
+	float32 sx;
+	float32 sy;
+	float32 sz;
+	Point3  origin;
+
+	WatertightRay (const Ray3 & ray) :
+		origin(ray.origin)
+	{
+		const Vector3 & d = ray.direction;
+
+		kz = 0;
+		if (std::fabs(d.y) > std::fabs(d[kz])) kz = 1;
+		if (std::fabs(d.z) > std::fabs(d[kz])) kz = 2;
+
+		kx = (kz + 1) % 3;
+		ky = (kx + 1) % 3;
+
+		// Keep the winding of the triangles
+		if (d[kz] < 0.0f)
+			std::swap(kx, ky);
+
+		sx = d[kx] / d[kz];
+		sy = d[ky] / d[kz];
+		sz = 1.0f / d[kz];
+	}
+};
+
+//=============================================================================
+// Returns the hit time when the triangle is hit between 0 and maxTime
+static bool IntersectTriangle (
+	const WatertightRay & ray,
+	const float32 *       p0,
+	const float32 *       p1,
+	const float32 *       p2,
+	float32               maxTime,
+	float32 *             time
+) {
+	const Vector3 a(p0[0] - ray.origin.x, p0[1] - ray.origin.y, p0[2] - ray.origin.z);
+	const Vector3 b(p1[0] - ray.origin.x, p1[1] - ray.origin.y, p1[2] - ray.origin.z);
+	const Vector3 c(p2[0] - ray.origin.x, p2[1] - ray.origin.y, p2[2] - ray.origin.z);
+
+	const float32 ax = a[ray.kx] - ray.sx * a[ray.kz];
+	const float32 ay = a[ray.ky] - ray.sy * a[ray.kz];
+	const float32 bx = b[ray.kx] - ray.sx * b[ray.kz];
+	const float32 by = b[ray.ky] - ray.sy * b[ray.kz];
+	const float32 cx = c[ray.kx] - ray.sx * c[ray.kz];
+	const float32 cy = c[ray.ky] - ray.sy * c[ray.kz];
+
+	float32 u = cx * by - cy * bx;
+	float32 v = ax * cy - ay * cx;
+	float32 w = bx * ay - by * ax;
+
+	// Exactly on an edge, redo the edge functions with enough precision to break the tie
+	if (u == 0.0f || v == 0.0f || w == 0.0f)
+	{
+		u = float32(float64(cx) * float64(by) - float64(cy) * float64(bx));
+		v = float32(float64(ax) * float64(cy) - float64(ay) * float64(cx));
+		w = float32(float64(bx) * float64(ay) - float64(by) * float64(ax));
+	}
+
+	if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
+		return false;
+
+	const float32 det = u + v + w;
+	if (det == 0.0f)
+		return false;
+
+	const float32 az = ray.sz * a[ray.kz];
+	const float32 bz = ray.sz * b[ray.kz];
+	const float32 cz = ray.sz * c[ray.kz];
+	const float32 t  = u * az + v * bz + w * cz;
+
+	// Compare before dividing, t / det has the sign of the hit time
+	if (det < 0.0f ? (t >= 0.0f || t < maxTime * det) : (t <= 0.0f || t > maxTime * det))
+		return false;
+
+	*time = t / det;
+	return true;
+}
+
+
+
+//=============================================================================
+// Mesh
+//=============================================================================
+
+//=============================================================================
+Mesh::Mesh () :
+	mPositions(null),
+	mVertexCount(0),
+	mIndices(null),
+	mTriangleCount(0),
+	mBounds(Point3(0.0f, 0.0f, 0.0f), Point3(0.0f, 0.0f, 0.0f))
+{
+}
+
+//=============================================================================
+bool Mesh::Build (std::vector<float32> && positions, std::vector<uint32> && indices, EBvhBuilder builder)
+{
+	if (positions.size() % 3 || indices.size() % 3 || indices.empty())
+		return false;
+
+	const uint32 vertexCount = uint32(positions.size() / 3);
+	for (uint32 index : indices)
+	{
+		if (index >= vertexCount)
+			return false;
+	}
+
+	mStorage.reset();
+	mQuantizedBvh.Clear();
+	mOwnedPositions = std::move(positions);
+	mOwnedIndices   = std::move(indices);
+
+	mPositions     = mOwnedPositions.data();
+	mVertexCount   = vertexCount;
+	mIndices       = mOwnedIndices.data();
+	mTriangleCount = uint32(mOwnedIndices.size() / 3);
+
+	std::vector<Aabb3> bounds(mTriangleCount);
+	for (uint32 i = 0; i < mTriangleCount; ++i)
+	{
+		Aabb3 & box = bounds[i];
+		for (uint axis = 0; axis < 3; ++axis)
+		{
+			const float32 a = mPositions[mIndices[i * 3 + 0] * 3 + axis];
+			const float32 b = mPositions[mIndices[i * 3 + 1] * 3 + axis];
+			const float32 c = mPositions[mIndices[i * 3 + 2] * 3 + axis];
+			box.min[axis] = Min(a, Min(b, c));
+			box.max[axis] = Max(a, Max(b, c));
+		}
+	}
+
+	mBvh.Build(bounds, builder);
+	ComputeBounds();
+
+	return true;
+}
+
+//=============================================================================
+bool Mesh::SetView (
+	const float32 *                     positions,
+	uint32                              vertexCount,
+	const uint32 *                      indices,
+	uint32                              triangleCount,
+	const Bvh &                         bvh,
+	const std::shared_ptr<const void> & storage
+) {
+	if (!triangleCount || !bvh.Validate(triangleCount))
+		return false;
+
+	for (uint32 i = 0; i < triangleCount * 3; ++i)
+	{
+		if (indices[i] >= vertexCount)
+			return false;
+	}
+
+	mOwnedPositions.clear();
+	mOwnedIndices.clear();
+	mQuantizedBvh.Clear();
+
+	mPositions     = positions;
+	mVertexCount   = vertexCount;
+	mIndices       = indices;
+	mTriangleCount = triangleCount;
+	mBvh           = bvh;
+	mStorage       = storage;
+
+	ComputeBounds();
+
+	return true;
+}
+
+//=============================================================================
+// The root of the bvh already bounds every triangle
+void Mesh::ComputeBounds ()
+{
+	if (mBvh.IsEmpty())
+		return;
+
+	const BvhNode & root = mBvh.GetNodes()[0];
+	mBounds = Aabb3(
+		Point3(root.min[0], root.min[1], root.min[2]),
+		Point3(root.max[0], root.max[1], root.max[2])
+	);
+}
+
+//=============================================================================
+bool Mesh::Quantize ()
+{
+	if (IsQuantized())
+		return true;
+
+	if (!mQuantizedBvh.Build(mBvh))
+		return false;
+
+	mBvh.Clear();
+	return true;
+}
+
+//=============================================================================
+bool Mesh::Intersect (Result & out, const Ray3 & ray) const
+{
+	const WatertightRay sheared(ray);
+
+	uint32  hit  = mTriangleCount;
+	float32 best = std::numeric_limits<float32>::infinity();
+
+	auto intersect = [&](uint32 triangle, float32 & maxTime) {
+		const uint32 * index = mIndices + triangle * 3;
+
+		float32 time;
+		if (IntersectTriangle(sheared, mPositions + index[0] * 3, mPositions + index[1] * 3, mPositions + index[2] * 3, maxTime, &time))
+		{
+			hit     = triangle;
+			maxTime = time;
+			best    = time;
+		}
+	};
+
+	if (IsQuantized())
+		mQuantizedBvh.Traverse(ray, best, intersect);
+	else
+		mBvh.Traverse(ray, best, intersect);
+
+	if (hit == mTriangleCount)
+		return false;
+
+	const uint32 * index = mIndices + hit * 3;
+	const float32 * p0 = mPositions + index[0] * 3;
+	const float32 * p1 = mPositions + index[1] * 3;
+	const float32 * p2 = mPositions + index[2] * 3;
+
+	const Vector3 e1(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]);
+	const Vector3 e2(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]);
+
+	out.time   = best;
+	out.point  = ray.origin + ray.direction * best;
+	out.normal = Normalize(Cross(e1, e2));
+
+	return true;
+}
+
+} // namespace RT
@@ -0,0 +1,78 @@
+//==================================================================================================
+//
+// File:	Mesh.h
+//
+// Triangle geometry shared between the objects which use it. A mesh owns its vertex and index
+// buffers and a bvh over its triangles, or views them in someone else's storage such as a mapped
+// scene file.
+//=================================================================================================
+#ifndef MESH_H
+#define MESH_H
+
+#include <memory>
+#include <vector>
+
+namespace RT
+{
+
+//==================================================================================================
+// Mesh
+//==================================================================================================
+class Mesh
+{
+public:
+	Mesh ();
+
+	//! Takes over the buffers and builds the bvh, positions holds x, y, z for every vertex and
+	//! indices three vertices for every triangle
+	bool Build (std::vector<float32> && positions, std::vector<uint32> && indices, EBvhBuilder builder = BVH_BUILDER_SAH);
+	//! Uses buffers and a bvh owned by someone else, storage is kept alive as long as they are used
+	bool SetView (
+		const float32 *                     positions,
+		uint32                              vertexCount,
+		const uint32 *                      indices,
+		uint32                              triangleCount,
+		const Bvh &                         bvh,
+		const std::shared_ptr<const void> & storage
+	);
+
+	//! Traces the triangles through a QuantizedBvh from now on and frees the full bvh. Returns
+	//! false, keeping the full one, when the hierarchy can not be quantized.
+	bool Quantize ();
+
+	//! Finds the closest hit, the normal is the geometric normal following the winding
+	bool Intersect (Result & out, const Ray3 & ray) const;
+
+	inline const Aabb3 &   GetBounds () const { return mBounds; }
+	inline const float32 * GetPositions () const { return mPositions; }
+	inline uint32          GetVertexCount () const { return mVertexCount; }
+	inline const uint32 *  GetIndices () const { return mIndices; }
+	inline uint32          GetTriangleCount () const { return mTriangleCount; }
+	inline const Bvh &     GetBvh () const { return mBvh; }
+	inline bool            IsQuantized () const { return !mQuantizedBvh.IsEmpty(); }
+	//! Bytes of hierarchy this mesh is traced with, mapped storage included
+	inline uint64          GetBvhMemorySize () const { return IsQuantized() ? mQuantizedBvh.GetMemorySize() : mBvh.GetMemorySize(); }
+
+private:
+	Mesh (const Mesh &) = delete;
+	Mesh & operator= (const Mesh &) = delete;
+
+	void ComputeBounds ();
+
+	// Data
+	const float32 *             mPositions;
+	uint32                      mVertexCount;
+	const uint32 *              mIndices;
+	uint32                      mTriangleCount;
+	Bvh                         mBvh;		// Over the triangles, empty once quantized
+	QuantizedBvh                mQuantizedBvh;
+	Aabb3                       mBounds;
+
+	std::vector<float32>        mOwnedPositions;	// Empty when viewing someone else's storage
+	std::vector<uint32>         mOwnedIndices;
+	std::shared_ptr<const void> mStorage;
+};
+
+} // namespace RT
+
+#endif //MESH_H
@@ -0,0 +1,861 @@
+//==================================================================================================
+//
+// File:	MeshLoader.cpp
+//
+// OBJ and PLY mesh loading. The file is split into chunks at line (or row) boundaries which are
+// parsed on their own threads, then stitched together in order.
+//
+//=================================================================================================
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+// Constants
+//=============================================================================
+static const uint64 MIN_CHUNK_BYTES = 1 << 20;	// Smaller files are not worth a thread
+static const uint32 MIN_CHUNK_ROWS  = 1 << 14;
+
+
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+//=============================================================================
+static uint32 GetChunkCount (uint64 work, uint64 minWork)
+{
+	const uint64 chunks = Max<uint64>(1, work / minWork);
+	return uint32(Min<uint64>(chunks, Max<uint>(1, ThreadLogicalProcessorCount())));
+}
+
+//=============================================================================
+static inline bool IsSpace (char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+//=============================================================================
+static inline void SkipSpaces (const char *& it, const char * end)
+{
+	while (it < end && IsSpace(*it))
+		++it;
+}
+
+//=============================================================================
+static inline void SkipLine (const char *& it, const char * end)
+{
+	const void * newline = memchr(it, '\n', size_t(end - it));
+	it = newline ? static_cast<const char *>(newline) + 1 : end;
+}
+
+//=============================================================================
+static inline void SkipToken (const char *& it, const char * end)
+{
+	while (it < end && !IsSpace(*it) && *it != '\n')
+		++it;
+}
+
+//=============================================================================
+// The mapped file is not null terminated, so strtod and friends can not be used on it
+static bool ParseInt (const char *& it, const char * end, sint64 * out)
+{
+	bool negative = false;
+	if (it < end && (*it == '-' || *it == '+'))
+		negative = *it++ == '-';
+
+	const char * digits = it;
+	sint64 value = 0;
+	while (it < end && *it >= '0' && *it <= '9')
+		value = value * 10 + (*it++ - '0');
+
+	if (it == digits)
+		return false;
+
+	*out = negative ? -value : value;
+	return true;
+}
+
+//=============================================================================
+static bool ParseFloat (const char *& it, const char * end, float32 * out)
+{
+	bool negative = false;
+	if (it < end && (*it == '-' || *it == '+'))
+		negative = *it++ == '-';
+
+	uint64 mantissa = 0;
+	sint32 exponent = 0;
+	uint32 digits   = 0;
+
+	for (; it < end && *it >= '0' && *it <= '9'; ++it, ++digits)
+	{
+		if (mantissa < 100000000000000000ull)
+			mantissa = mantissa * 10 + (*it - '0');
+		else
+			++exponent;
+	}
+
+	if (it < end && *it == '.')
+	{
+		for (++it; it < end && *it >= '0' && *it <= '9'; ++it, ++digits)
+		{
+			if (mantissa < 100000000000000000ull)
+			{
+				mantissa = mantissa * 10 + (*it - '0');
+				--exponent;
+			}
+		}
+	}
+
+	if (!digits)
+		return false;
+
+	if (it < end && (*it == 'e' || *it == 'E'))
+	{
+		++it;
+		sint64 e;
+		if (!ParseInt(it, end, &e))
+			return false;
+
+		exponent += sint32(Max<sint64>(-1000, Min<sint64>(1000, e)));
+	}
+
+	const float64 value = float64(mantissa) * std::pow(10.0, float64(exponent));
+	*out = float32(negative ? -value : value);
+	return true;
+}
+
+//=============================================================================
+// Adds a triangle fan over polygon
+static void AddPolygon (std::vector<uint32> & indices, const uint32 * polygon, uint32 count)
+{
+	for (uint32 i = 2; i < count; ++i)
+	{
+		indices.push_back(polygon[0]);
+		indices.push_back(polygon[i - 1]);
+		indices.push_back(polygon[i]);
+	}
+}
+
+//=============================================================================
+static std::shared_ptr<Mesh> BuildMesh (std::vector<float32> && positions, std::vector<uint32> && indices, EBvhBuilder builder)
+{
+	std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+	if (!mesh->Build(std::move(positions), std::move(indices), builder))
+		return null;
+
+	return mesh;
+}
+
+
+
+//=============================================================================
+// Obj
+//=============================================================================
+
+//=============================================================================
+struct ObjChunk
+{
+	const char *         begin;
+	const char *         end;
+	std::vector<float32> positions;
+	std::vector<uint32>  indices;
+	std::vector<uint32>  relative;	// Entries of indices counted from the chunk's first vertex
+	bool                 ok;
+};
+
+//=============================================================================
+static void ParseObjChunk (ObjChunk & chunk)
+{
+	const char * it  = chunk.begin;
+	const char * end = chunk.end;
+
+	std::vector<uint32> polygon;
+	std::vector<bool>   polygonRelative;
+
+	chunk.ok = true;
+	while (it < end)
+	{
+		SkipSpaces(it, end);
+		if (it + 1 >= end || !IsSpace(it[1]))
+		{
+			SkipLine(it, end);
+			continue;
+		}
+
+		if (*it == 'v')
+		{
+			it += 2;
+			for (uint axis = 0; axis < 3; ++axis)
+			{
+				SkipSpaces(it, end);
+
+				float32 value;
+				if (!ParseFloat(it, end, &value))
+				{
+					chunk.ok = false;
+					return;
+				}
+
+				chunk.positions.push_back(value);
+			}
+		}
+		else if (*it == 'f')
+		{
+			it += 2;
+			polygon.clear();
+			polygonRelative.clear();
+
+			for (;;)
+			{
+				SkipSpaces(it, end);
+				if (it >= end || *it == '\n' || *it == '#')
+					break;
+
+				// Only the position of "v/vt/vn" matters
+				sint64 index;
+				if (!ParseInt(it, end, &index) || index == 0)
+				{
+					chunk.ok = false;
+					return;
+				}
+				SkipToken(it, end);
+
+				// Negative indices count back from the latest vertex, which may be in an earlier
+				// chunk. Unsigned wrap around makes adding the chunk's first vertex later work out.
+				const uint32 vertexCount = uint32(chunk.positions.size() / 3);
+				polygon.push_back(index > 0 ? uint32(index - 1) : vertexCount + uint32(sint32(index)));
+				polygonRelative.push_back(index < 0);
+			}
+
+			for (uint32 i = 2; i < polygon.size(); ++i)
+			{
+				const uint32 corners[3] = { 0, i - 1, i };
+				for (uint32 corner : corners)
+				{
+					if (polygonRelative[corner])
+						chunk.relative.push_back(uint32(chunk.indices.size()));
+					chunk.indices.push_back(polygon[corner]);
+				}
+			}
+		}
+
+		SkipLine(it, end);
+	}
+}
+
+//=============================================================================
+std::shared_ptr<Mesh> LoadObj (const char * filename, EBvhBuilder builder)
+{
+	MappedFile file;
+	if (!file.Open(filename))
+		return null;
+
+	const char * data = static_cast<const char *>(file.GetData());
+	const char * end  = data + file.GetSize();
+
+	// Split at line starts
+	const uint32 chunkCount = GetChunkCount(file.GetSize(), MIN_CHUNK_BYTES);
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char * begin = data;
+	for (uint32 i = 0; i < chunkCount; ++i)
+	{
+		const char * split = i + 1 < chunkCount ? data + file.GetSize() * (i + 1) / chunkCount : end;
+		if (split < begin)
+			split = begin;
+		if (split < end && split > data && split[-1] != '\n')
+			SkipLine(split, end);
+
+		chunks[i].begin = begin;
+		chunks[i].end   = split;
+		begin = split;
+	}
+
+	ParallelFor(chunkCount, [&](uint32 i) { ParseObjChunk(chunks[i]); });
+
+	// Stitch the chunks together
+	size_t positionCount = 0;
+	size_t indexCount    = 0;
+	for (const ObjChunk & chunk : chunks)
+	{
+		if (!chunk.ok)
+			return null;
+
+		positionCount += chunk.positions.size();
+		indexCount    += chunk.indices.size();
+	}
+
+	if (positionCount / 3 > 0xffffffffull)
+		return null;
+
+	std::vector<float32> positions;
+	std::vector<uint32>  indices;
+	positions.reserve(positionCount);
+	indices.reserve(indexCount);
+
+	for (ObjChunk & chunk : chunks)
+	{
+		const uint32 firstVertex = uint32(positions.size() / 3);
+		const size_t firstIndex  = indices.size();
+
+		positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+		indices.insert(indices.end(), chunk.indices.begin(), chunk.indices.end());
+
+		for (uint32 entry : chunk.relative)
+			indices[firstIndex + entry] += firstVertex;
+
+		std::vector<float32>().swap(chunk.positions);
+		std::vector<uint32>().swap(chunk.indices);
+	}
+
+	return BuildMesh(std::move(positions), std::move(indices), builder);
+}
+
+
+
+//=============================================================================
+// Ply
+//=============================================================================
+
+//=============================================================================
+enum EPlyType
+{
+	PLY_TYPE_INVALID,
+	PLY_TYPE_INT8,
+	PLY_TYPE_UINT8,
+	PLY_TYPE_INT16,
+	PLY_TYPE_UINT16,
+	PLY_TYPE_INT32,
+	PLY_TYPE_UINT32,
+	PLY_TYPE_FLOAT32,
+	PLY_TYPE_FLOAT64,
+};
+
+enum EPlyFormat
+{
+	PLY_FORMAT_ASCII,
+	PLY_FORMAT_BINARY_LITTLE_ENDIAN,
+	PLY_FORMAT_BINARY_BIG_ENDIAN,
+};
+
+struct PlyProperty
+{
+	std::string name;
+	EPlyType    type;
+	EPlyType    countType;	// PLY_TYPE_INVALID unless this is a list
+};
+
+struct PlyElement
+{
+	std::string              name;
+	uint64                   count;
+	std::vector<PlyProperty> properties;
+};
+
+//=============================================================================
+static EPlyType ParsePlyType (const std::string & name)
+{
+	if (name == "char"   || name == "int8")    return PLY_TYPE_INT8;
+	if (name == "uchar"  || name == "uint8")   return PLY_TYPE_UINT8;
+	if (name == "short"  || name == "int16")   return PLY_TYPE_INT16;
+	if (name == "ushort" || name == "uint16")  return PLY_TYPE_UINT16;
+	if (name == "int"    || name == "int32")   return PLY_TYPE_INT32;
+	if (name == "uint"   || name == "uint32")  return PLY_TYPE_UINT32;
+	if (name == "float"  || name == "float32") return PLY_TYPE_FLOAT32;
+	if (name == "double" || name == "float64") return PLY_TYPE_FLOAT64;
+	return PLY_TYPE_INVALID;
+}
+
+//=============================================================================
+static uint32 GetPlyTypeSize (EPlyType type)
+{
+	switch (type)
+	{
+		case PLY_TYPE_INT8:
+		case PLY_TYPE_UINT8:   return 1;
+		case PLY_TYPE_INT16:
+		case PLY_TYPE_UINT16:  return 2;
+		case PLY_TYPE_INT32:
+		case PLY_TYPE_UINT32:
+		case PLY_TYPE_FLOAT32: return 4;
+		case PLY_TYPE_FLOAT64: return 8;
+		default:               return 0;
+	}
+}
+
+//=============================================================================
+static inline bool IsLittleEndian ()
+{
+	const uint16 probe = 1;
+	return *reinterpret_cast<const uint8 *>(&probe) == 1;
+}
+
+//=============================================================================
+static float64 ReadPlyValue (const char * data, EPlyType type, bool swap)
+{
+	uint8 bytes[8];
+	const uint32 size = GetPlyTypeSize(type);
+	memcpy(bytes, data, size);
+	if (swap)
+		std::reverse(bytes, bytes + size);
+
+	switch (type)
+	{
+		case PLY_TYPE_INT8:    { sint8   v; memcpy(&v, bytes, 1); return v; }
+		case PLY_TYPE_UINT8:   { uint8   v; memcpy(&v, bytes, 1); return v; }
+		case PLY_TYPE_INT16:   { sint16  v; memcpy(&v, bytes, 2); return v; }
+		case PLY_TYPE_UINT16:  { uint16  v; memcpy(&v, bytes, 2); return v; }
+		case PLY_TYPE_INT32:   { sint32  v; memcpy(&v, bytes, 4); return v; }
+		case PLY_TYPE_UINT32:  { uint32  v; memcpy(&v, bytes, 4); return v; }
+		case PLY_TYPE_FLOAT32: { float32 v; memcpy(&v, bytes, 4); return v; }
+		case PLY_TYPE_FLOAT64: { float64 v; memcpy(&v, bytes, 8); return v; }
+		default:               return 0.0;
+	}
+}
+
+//=============================================================================
+static bool ParsePlyHeader (const char *& it, const char * end, EPlyFormat * format, std::vector<PlyElement> * elements)
+{
+	auto nextLine = [&](std::vector<std::string> & words) {
+		words.clear();
+		if (it >= end)
+			return false;
+
+		const char * lineEnd = it;
+		SkipLine(lineEnd, end);
+
+		while (it < lineEnd)
+		{
+			SkipSpaces(it, lineEnd);
+			const char * word = it;
+			SkipToken(it, lineEnd);
+			if (it > word)
+				words.emplace_back(word, it);
+			if (it < lineEnd && *it == '\n')
+				++it;
+		}
+
+		it = lineEnd;
+		return true;
+	};
+
+	std::vector<std::string> words;
+	if (!nextLine(words) || words.size() != 1 || words[0] != "ply")
+		return false;
+
+	bool hasFormat = false;
+	while (nextLine(words))
+	{
+		if (words.empty() || words[0] == "comment" || words[0] == "obj_info")
+			continue;
+
+		if (words[0] == "end_header")
+			return hasFormat;
+
+		if (words[0] == "format" && words.size() >= 2)
+		{
+			hasFormat = true;
+			if      (words[1] == "ascii")                *format = PLY_FORMAT_ASCII;
+			else if (words[1] == "binary_little_endian") *format = PLY_FORMAT_BINARY_LITTLE_ENDIAN;
+			else if (words[1] == "binary_big_endian")    *format = PLY_FORMAT_BINARY_BIG_ENDIAN;
+			else return false;
+		}
+		else if (words[0] == "element" && words.size() == 3)
+		{
+			PlyElement element;
+			element.name  = words[1];
+			element.count = strtoull(words[2].c_str(), null, 10);
+			elements->push_back(element);
+		}
+		else if (words[0] == "property" && !elements->empty())
+		{
+			PlyProperty property;
+			if (words.size() == 5 && words[1] == "list")
+			{
+				property.countType = ParsePlyType(words[2]);
+				property.type      = ParsePlyType(words[3]);
+				property.name      = words[4];
+				if (property.countType == PLY_TYPE_INVALID)
+					return false;
+			}
+			else if (words.size() == 3)
+			{
+				property.countType = PLY_TYPE_INVALID;
+				property.type      = ParsePlyType(words[1]);
+				property.name      = words[2];
+			}
+			else
+			{
+				return false;
+			}
+
+			if (property.type == PLY_TYPE_INVALID)
+				return false;
+
+			elements->back().properties.push_back(property);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return false;
+}
+
+//=============================================================================
+// Where x, y and z are among the properties of the vertex element
+struct PlyVertexLayout
+{
+	sint32 property[3];
+	uint32 offset[3];	// Bytes into a binary row
+	uint32 stride;		// Bytes per binary row, 0 if a row has lists
+};
+
+//=============================================================================
+static bool GetPlyVertexLayout (const PlyElement & element, PlyVertexLayout * layout)
+{
+	static const char * NAMES[3] = { "x", "y", "z" };
+
+	layout->stride = 0;
+	bool fixed = true;
+	for (uint axis = 0; axis < 3; ++axis)
+		layout->property[axis] = -1;
+
+	for (uint32 i = 0; i < element.properties.size(); ++i)
+	{
+		const PlyProperty & property = element.properties[i];
+		for (uint axis = 0; axis < 3; ++axis)
+		{
+			if (property.name == NAMES[axis] && property.countType == PLY_TYPE_INVALID)
+			{
+				layout->property[axis] = sint32(i);
+				layout->offset[axis]   = layout->stride;
+			}
+		}
+
+		fixed = fixed && property.countType == PLY_TYPE_INVALID;
+		layout->stride += GetPlyTypeSize(property.type);
+	}
+
+	if (!fixed)
+		layout->stride = 0;
+
+	return layout->property[0] >= 0 && layout->property[1] >= 0 && layout->property[2] >= 0;
+}
+
+//=============================================================================
+static sint32 GetPlyFaceProperty (const PlyElement & element)
+{
+	for (uint32 i = 0; i < element.properties.size(); ++i)
+	{
+		const PlyProperty & property = element.properties[i];
+		if (property.countType != PLY_TYPE_INVALID && (property.name == "vertex_indices" || property.name == "vertex_index"))
+			return sint32(i);
+	}
+
+	return -1;
+}
+
+//=============================================================================
+// Reads one binary row, calling list(property, count, items) for lists. Returns false past end.
+template <typename TList>
+static bool ReadPlyBinaryRow (const char *& it, const char * end, const PlyElement & element, bool swap, TList && list)
+{
+	for (uint32 i = 0; i < element.properties.size(); ++i)
+	{
+		const PlyProperty & property = element.properties[i];
+		if (property.countType == PLY_TYPE_INVALID)
+		{
+			const uint32 size = GetPlyTypeSize(property.type);
+			if (uint64(end - it) < size)
+				return false;
+
+			it += size;
+			continue;
+		}
+
+		const uint32 countSize = GetPlyTypeSize(property.countType);
+		if (uint64(end - it) < countSize)
+			return false;
+
+		const float64 count = ReadPlyValue(it, property.countType, swap);
+		it += countSize;
+
+		const uint64 bytes = uint64(Max(0.0, count)) * GetPlyTypeSize(property.type);
+		if (uint64(end - it) < bytes)
+			return false;
+
+		list(i, uint32(count), it);
+		it += bytes;
+	}
+
+	return true;
+}
+
+//=============================================================================
+// Splits the next count rows (one per line) into chunks, returns past the last row
+static const char * SplitPlyAsciiRows (const char * it, const char * end, uint64 count, std::vector<const char *> * starts, uint32 rowsPerChunk)
+{
+	for (uint64 row = 0; row < count; ++row)
+	{
+		if (it >= end)
+			return null;
+
+		if (row % rowsPerChunk == 0)
+			starts->push_back(it);
+
+		SkipLine(it, end);
+	}
+
+	starts->push_back(it);
+	return it;
+}
+
+//=============================================================================
+std::shared_ptr<Mesh> LoadPly (const char * filename, EBvhBuilder builder)
+{
+	MappedFile file;
+	if (!file.Open(filename))
+		return null;
+
+	const char * it  = static_cast<const char *>(file.GetData());
+	const char * end = it + file.GetSize();
+
+	EPlyFormat              format = PLY_FORMAT_ASCII;
+	std::vector<PlyElement> elements;
+	if (!ParsePlyHeader(it, end, &format, &elements))
+		return null;
+
+	const bool swap = format != PLY_FORMAT_ASCII && (format == PLY_FORMAT_BINARY_LITTLE_ENDIAN) != IsLittleEndian();
+
+	std::vector<float32> positions;
+	std::vector<uint32>  indices;
+
+	for (const PlyElement & element : elements)
+	{
+		const bool isVertex = element.name == "vertex";
+		const bool isFace   = element.name == "face";
+
+		if (isVertex && element.count > 0xffffffffull)
+			return null;
+
+		if (format == PLY_FORMAT_ASCII)
+		{
+			const uint32 chunkCount = GetChunkCount(element.count, MIN_CHUNK_ROWS);
+			const uint32 rowsPerChunk = uint32(Max<uint64>(1, (element.count + chunkCount - 1) / chunkCount));
+
+			std::vector<const char *> starts;
+			it = SplitPlyAsciiRows(it, end, element.count, &starts, rowsPerChunk);
+			if (!it)
+				return null;
+
+			if (isVertex)
+			{
+				PlyVertexLayout layout;
+				if (!GetPlyVertexLayout(element, &layout) || layout.stride == 0)
+					return null;
+
+				positions.resize(size_t(element.count) * 3);
+
+				std::atomic<bool> ok(true);
+				ParallelFor(uint32(starts.size() - 1), [&](uint32 chunk) {
+					const char * row = starts[chunk];
+					const char * rowsEnd = starts[chunk + 1];
+					for (uint64 vertex = uint64(chunk) * rowsPerChunk; row < rowsEnd; ++vertex)
+					{
+						for (uint32 i = 0; i < element.properties.size(); ++i)
+						{
+							SkipSpaces(row, rowsEnd);
+
+							float32 value;
+							if (!ParseFloat(row, rowsEnd, &value))
+							{
+								ok = false;
+								return;
+							}
+
+							for (uint axis = 0; axis < 3; ++axis)
+							{
+								if (layout.property[axis] == sint32(i))
+									positions[vertex * 3 + axis] = value;
+							}
+						}
+
+						SkipLine(row, rowsEnd);
+					}
+				});
+
+				if (!ok)
+					return null;
+			}
+			else if (isFace)
+			{
+				const sint32 faceProperty = GetPlyFaceProperty(element);
+				if (faceProperty < 0)
+					return null;
+
+				std::vector<std::vector<uint32>> chunkIndices(starts.size() - 1);
+				std::atomic<bool> ok(true);
+				ParallelFor(uint32(starts.size() - 1), [&](uint32 chunk) {
+					const char * row = starts[chunk];
+					const char * rowsEnd = starts[chunk + 1];
+					std::vector<uint32> polygon;
+
+					while (row < rowsEnd)
+					{
+						for (uint32 i = 0; i < element.properties.size(); ++i)
+						{
+							const bool list = element.properties[i].countType != PLY_TYPE_INVALID;
+
+							SkipSpaces(row, rowsEnd);
+							sint64 count = 1;
+							if (list && !ParseInt(row, rowsEnd, &count))
+							{
+								ok = false;
+								return;
+							}
+
+							polygon.clear();
+							for (sint64 item = 0; item < count; ++item)
+							{
+								SkipSpaces(row, rowsEnd);
+
+								sint64 value;
+								const char * token = row;
+								if (sint32(i) == faceProperty)
+								{
+									if (!ParseInt(row, rowsEnd, &value) || value < 0)
+									{
+										ok = false;
+										return;
+									}
+									polygon.push_back(uint32(value));
+								}
+
+								row = token;
+								SkipToken(row, rowsEnd);
+							}
+
+							if (sint32(i) == faceProperty)
+								AddPolygon(chunkIndices[chunk], polygon.data(), uint32(polygon.size()));
+						}
+
+						SkipLine(row, rowsEnd);
+					}
+				});
+
+				if (!ok)
+					return null;
+
+				for (const std::vector<uint32> & chunk : chunkIndices)
+					indices.insert(indices.end(), chunk.begin(), chunk.end());
+			}
+
+			continue;
+		}
+
+		// Binary
+		if (isVertex)
+		{
+			PlyVertexLayout layout;
+			if (!GetPlyVertexLayout(element, &layout) || layout.stride == 0)
+				return null;
+
+			if (uint64(end - it) / layout.stride < element.count)
+				return null;
+
+			positions.resize(size_t(element.count) * 3);
+
+			const uint32 chunkCount = GetChunkCount(element.count, MIN_CHUNK_ROWS);
+			const char * rows = it;
+			ParallelFor(chunkCount, [&](uint32 chunk) {
+				const uint64 first = element.count * chunk / chunkCount;
+				const uint64 last  = element.count * (chunk + 1) / chunkCount;
+				for (uint64 vertex = first; vertex < last; ++vertex)
+				{
+					const char * row = rows + vertex * layout.stride;
+					for (uint axis = 0; axis < 3; ++axis)
+					{
+						const EPlyType type = element.properties[layout.property[axis]].type;
+						positions[vertex * 3 + axis] = float32(ReadPlyValue(row + layout.offset[axis], type, swap));
+					}
+				}
+			});
+
+			it += element.count * layout.stride;
+		}
+		else
+		{
+			// Rows of lists have no fixed size, so faces and anything else are read in order
+			const sint32 faceProperty = isFace ? GetPlyFaceProperty(element) : -1;
+			if (isFace && faceProperty < 0)
+				return null;
+
+			if (isFace)
+				indices.reserve(size_t(element.count) * 3);
+
+			std::vector<uint32> polygon;
+			for (uint64 row = 0; row < element.count; ++row)
+			{
+				const bool read = ReadPlyBinaryRow(it, end, element, swap, [&](uint32 property, uint32 count, const char * items) {
+					if (sint32(property) != faceProperty)
+						return;
+
+					const EPlyType type = element.properties[property].type;
+					const uint32   size = GetPlyTypeSize(type);
+
+					polygon.resize(count);
+					for (uint32 i = 0; i < count; ++i)
+						polygon[i] = uint32(ReadPlyValue(items + i * size, type, swap));
+
+					AddPolygon(indices, polygon.data(), count);
+				});
+
+				if (!read)
+					return null;
+			}
+		}
+	}
+
+	return BuildMesh(std::move(positions), std::move(indices), builder);
+}
+
+
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+std::shared_ptr<Mesh> LoadMesh (const char * filename, EBvhBuilder builder)
+{
+	const char * extension = strrchr(filename, '.');
+	if (!extension)
+		return null;
+
+	std::string lower(extension);
+	for (char & c : lower)
+		c = char(tolower(c));
+
+	if (lower == ".obj")
+		return LoadObj(filename, builder);
+
+	if (lower == ".ply")
+		return LoadPly(filename, builder);
+
+	return null;
+}
+
+} // namespace RT
@@ -0,0 +1,24 @@
+//==================================================================================================
+//
+// File:	MeshLoader.h
+//
+// Loads triangle meshes from Wavefront OBJ and PLY files. Files are memory mapped and parsed on
+// every logical processor, polygons are split into triangle fans. Only positions are read.
+//=================================================================================================
+#ifndef MESHLOADER_H
+#define MESHLOADER_H
+
+#include <memory>
+
+namespace RT
+{
+
+//! Loads an .obj or .ply file by its extension, null when the file can not be read
+std::shared_ptr<Mesh> LoadMesh (const char * filename, EBvhBuilder builder = BVH_BUILDER_SAH);
+
+std::shared_ptr<Mesh> LoadObj (const char * filename, EBvhBuilder builder = BVH_BUILDER_SAH);
+std::shared_ptr<Mesh> LoadPly (const char * filename, EBvhBuilder builder = BVH_BUILDER_SAH);
+
+} // namespace RT
+
+#endif //MESHLOADER_H
@@ -1,5 +1,6 @@
 #include "Pch.h"
 #include <cassert>
+#include <limits>
 
 namespace RT
 {
@@ -8,6 +9,70 @@ namespace RT
 // Helpers
 //=============================================================================
 
+//=============================================================================
+// Nearest positive root of a t^2 + 2 b t + c, written without branches so loops over rays can be
+// vectorized. Returns whether it is before maxTime.
+static inline bool NearestRoot (float32 a, float32 b, float32 c, float32 maxTime, float32 * time)
+{
+	const float32 disc = b * b - a * c;
+	const float32 root = Sqrt(Max(disc, 0.0f));
+	const float32 near = (-b - root) / a;
+	const float32 far  = (-b + root) / a;
+
+	*time = near > 0.0f ? near : far;
+	return disc >= 0.0f && *time > 0.0f && *time < maxTime;
+}
+
+//=============================================================================
+// An instance's transform is either "matrix", nine numbers row by row, or made of parts
+static bool ParseTransform (const Json::CValue & jsonShape, Matrix33 * linear, Vector3 * translation)
+{
+    using namespace Json;
+
+    const CValue & jsonMatrix = jsonShape[{"matrix"}];
+    if (jsonMatrix.GetType() != EType::Array)
+    {
+        TransformDesc desc;
+        if (!ParseTransformDesc(jsonShape, &desc) || !ComputeTransform(desc, linear))
+            return false;
+
+        *translation = desc.translate;
+        return true;
+    }
+
+    *translation = Vector3::Zero;
+    const CValue & jsonTranslate = jsonShape[{"translate"}];
+    if (jsonTranslate.GetType() == EType::Array && !ParseVector3(jsonTranslate, translation))
+        return false;
+
+    const ArrayType & array = *jsonMatrix.As<ArrayType>();
+    if (array.Count() != 9)
+        return false;
+
+    float32 m[9];
+    for (uint i = 0; i < 9; ++i)
+    {
+        if (array[i].GetType() != EType::Number)
+            return false;
+
+        m[i] = float32(*array[i].As<NumberType>());
+    }
+
+    const Vector3 u(m[0], m[3], m[6]);
+    const Vector3 v(m[1], m[4], m[7]);
+    const Vector3 w(m[2], m[5], m[8]);
+    if (Dot(u, Cross(v, w)) == 0.0f)
+        return false;
+
+    *linear = Matrix33(
+        m[0], m[1], m[2],
+        m[3], m[4], m[5],
+        m[6], m[7], m[8]
+    );
+
+    return true;
+}
+
 
 
 //=============================================================================
@@ -15,15 +80,19 @@ namespace RT
 //=============================================================================
 
 //=============================================================================
-Object * ParseObject (const Json::CValue & json)
+Object * ParseObject (const Json::CValue & json, SceneAssets * assets)
 {
-    using namespace Json;
-
     Material material;
     if (!ParseMaterial(json[{"material"}], &material))
         return null;
 
-    const CValue & jsonShape = json[{"shape"}];
+    return ParseShape(json[{"shape"}], material, assets);
+}
+
+//=============================================================================
+Object * ParseShape (const Json::CValue & jsonShape, const Material & material, SceneAssets * assets)
+{
+    using namespace Json;
 
     const CValue & jsonType = jsonShape[{"type"}];
     if (jsonType.GetType() != EType::String)
@@ -32,11 +101,65 @@ Object * ParseObject (const Json::CValue & json)
     const StringType & type = *jsonType.As<StringType>();
     if (type == "sphere")
     {
-        ASSERT(false);
+        Point3 center;
+        if (!ParsePoint3(jsonShape[{"center"}], &center))
+            return null;
+
+        const CValue & jsonRadius = jsonShape[{"radius"}];
+        if (jsonRadius.GetType() != EType::Number)
+            return null;
+
+        const float32 radius = float32(*jsonRadius.As<NumberType>());
+        if (radius <= 0.0f)
+            return null;
+
+        return new RT::Sphere(center, radius, material);
     }
     else if (type == "ellipsoid")
     {
-        ASSERT(false);
+        Point3 center;
+        if (!ParsePoint3(jsonShape[{"center"}], &center))
+            return null;
+
+        // Either radii along the world axes or the three semi-axes
+        Vector3 radii;
+        if (ParseVector3(jsonShape[{"radii"}], &radii))
+            return new RT::Ellipsoid(center, radii, material);
+
+        Vector3 u, v, w;
+        if (!ParseVector3(jsonShape[{"u"}], &u) || !ParseVector3(jsonShape[{"v"}], &v) || !ParseVector3(jsonShape[{"w"}], &w))
+            return null;
+
+        return new RT::Ellipsoid(center, u, v, w, material);
+    }
+    else if (type == "mesh")
+    {
+        const CValue & jsonFile = jsonShape[{"file"}];
+        if (jsonFile.GetType() != EType::String || !assets)
+            return null;
+
+        const std::shared_ptr<const Mesh> mesh = assets->GetMesh(jsonFile.As<StringType>()->Ptr());
+        if (!mesh)
+            return null;
+
+        return new RT::TriangleMesh(mesh, material);
+    }
+    else if (type == "instance")
+    {
+        const CValue & jsonAsset = jsonShape[{"asset"}];
+        if (jsonAsset.GetType() != EType::String || !assets)
+            return null;
+
+        const std::shared_ptr<const Object> asset = assets->FindShape(jsonAsset.As<StringType>()->Ptr());
+        if (!asset)
+            return null;
+
+        Matrix33 linear;
+        Vector3  translation;
+        if (!ParseTransform(jsonShape, &linear, &translation))
+            return null;
+
+        return new RT::Instance(asset, linear, translation, material);
     }
     else if (type == "aabb")
     {
@@ -62,10 +185,22 @@ Object * ParseObject (const Json::CValue & json)
 
 //=============================================================================
 Object::Object(const Material & material) :
-    mMaterial(material)
+    mMaterial(material),
+    mMaterialIndex(0)
 {
 }
 
+//=============================================================================
+void Object::IntersectBatch(RayBatch & batch, uint32 begin, uint32 end) const
+{
+	for (uint32 i = begin; i < end; ++i)
+	{
+		Result result;
+		if (Intersect(result, batch.GetRay(i)) && result.time < batch.time[i])
+			batch.SetHit(i, this, result.time, result.normal.x, result.normal.y, result.normal.z);
+	}
+}
+
 
 
 //=============================================================================
@@ -86,6 +221,13 @@ Sphere * Sphere::Clone() const
 	return new Sphere(mSphere.center, mSphere.radius, mMaterial);
 }
 
+//=============================================================================
+Aabb3 Sphere::GetBounds() const
+{
+	const Vector3 extent(mSphere.radius, mSphere.radius, mSphere.radius);
+	return Aabb3(mSphere.center - extent, mSphere.center + extent);
+}
+
 //=============================================================================
 bool Sphere::Intersect( Result & out, const Ray3 & ray ) const
 {
@@ -102,6 +244,38 @@ bool Sphere::Intersect( Result & out, const Ray3 & ray ) const
 	return false;
 }
 
+//=============================================================================
+void Sphere::IntersectBatch(RayBatch & batch, uint32 begin, uint32 end) const
+{
+	const float32 cx        = mSphere.center.x;
+	const float32 cy        = mSphere.center.y;
+	const float32 cz        = mSphere.center.z;
+	const float32 r2        = mSphere.radius * mSphere.radius;
+	const float32 invRadius = 1.0f / mSphere.radius;
+
+	for (uint32 i = begin; i < end; ++i)
+	{
+		const float32 ox = batch.originX[i] - cx;
+		const float32 oy = batch.originY[i] - cy;
+		const float32 oz = batch.originZ[i] - cz;
+		const float32 dx = batch.directionX[i];
+		const float32 dy = batch.directionY[i];
+		const float32 dz = batch.directionZ[i];
+
+		float32 time;
+		const bool hit = NearestRoot(
+			dx * dx + dy * dy + dz * dz,
+			ox * dx + oy * dy + oz * dz,
+			ox * ox + oy * oy + oz * oz - r2,
+			batch.time[i],
+			&time
+		);
+
+		if (hit)
+			batch.SetHit(i, this, time, (ox + dx * time) * invRadius, (oy + dy * time) * invRadius, (oz + dz * time) * invRadius);
+	}
+}
+
 //=============================================================================
 // Ellipsoid
 //=============================================================================
@@ -109,46 +283,64 @@ bool Sphere::Intersect( Result & out, const Ray3 & ray ) const
 //=============================================================================
 Ellipsoid::Ellipsoid(const Point3 & pos, const Vector3 & u, const Vector3 & v, const Vector3 & w, const Material & material) :
 	Object(material),
-	mCenter(pos),
-	mObjectToWorld(
-		u.x, v.x, w.x,
-		u.y, v.y, w.y,
-		u.z, v.z, w.z
-	)
+	mCenter(pos)
 {
 	assert(Dot(u, v) < 1e-4);
 	assert(Dot(v, w) < 1e-4);
 	assert(Dot(w, u) < 1e-4);
 
-	mObjectToWorldI  = Inverse(mObjectToWorld);
-	mObjectToWorldT  = Transpose(mObjectToWorld);
-	mObjectToWorldIT = Transpose(mObjectToWorldI);
+	SetObjectToWorldI(Inverse(Matrix33(
+		u.x, v.x, w.x,
+		u.y, v.y, w.y,
+		u.z, v.z, w.z
+	)));
 }
 
 //=============================================================================
 Ellipsoid::Ellipsoid(const Point3 & pos, const Vector3 & radii, const Material & material) :
 	Object(material),
-	mCenter(pos),
-	mObjectToWorld(
+	mCenter(pos)
+{
+	SetObjectToWorldI(Inverse(Matrix33(
 		radii.x, 0.0f,    0.0f,
 		0.0f,    radii.y, 0.0f,
 		0.0f,    0.0f,    radii.z
-	)
+	)));
+}
+
+//=============================================================================
+Ellipsoid::Ellipsoid(const Point3 & pos, const Matrix33 & objectToWorldI, const Material & material) :
+	Object(material),
+	mCenter(pos)
 {
-	mObjectToWorldI  = Inverse(mObjectToWorld);
-	mObjectToWorldT  = Transpose(mObjectToWorld);
-	mObjectToWorldIT = Transpose(mObjectToWorldI);
+	SetObjectToWorldI(objectToWorldI);
 }
 
 //=============================================================================
-Ellipsoid::Ellipsoid(const Ellipsoid & e) :
-	Object(e.mMaterial),
-	mCenter(e.mCenter),
-	mObjectToWorld(e.mObjectToWorld),
-	mObjectToWorldI(e.mObjectToWorldI),
-	mObjectToWorldT(e.mObjectToWorldT),
-	mObjectToWorldIT(e.mObjectToWorldIT)
+// The extent along each world axis is the length of that row of the object to world matrix.
+// The bounds come from the inverse alone, so an ellipsoid read back from a scene file gets
+// exactly the box it was saved with.
+void Ellipsoid::SetObjectToWorldI(const Matrix33 & objectToWorldI)
 {
+	mObjectToWorldI = objectToWorldI;
+
+	const Matrix33 objectToWorld = Inverse(objectToWorldI);
+
+	Vector3 axes[3];
+	for (uint i = 0; i < 3; ++i)
+	{
+		Vector3 unit = Vector3::Zero;
+		unit[i] = 1.0f;
+		axes[i] = objectToWorld * unit;
+	}
+
+	const Vector3 extent(
+		Sqrt(Sq(axes[0].x) + Sq(axes[1].x) + Sq(axes[2].x)),
+		Sqrt(Sq(axes[0].y) + Sq(axes[1].y) + Sq(axes[2].y)),
+		Sqrt(Sq(axes[0].z) + Sq(axes[1].z) + Sq(axes[2].z))
+	);
+
+	mBounds = Aabb3(mCenter - extent, mCenter + extent);
 }
 
 //=============================================================================
@@ -164,7 +356,7 @@ bool Ellipsoid::Intersect(Result & out, const Ray3 & ray) const
 		if ( info.time > 0.0f )
 		{
 			out.point  = ray.origin + ray.direction * info.time;//mObjectToWorld * info.point;
-			out.normal = mObjectToWorldIT * info.normal;
+			out.normal = Transpose(mObjectToWorldI) * info.normal;
 			out.time   = info.time;
 
 			return true;
@@ -174,12 +366,57 @@ bool Ellipsoid::Intersect(Result & out, const Ray3 & ray) const
 	return false;
 }
 
+//=============================================================================
+// The same test as Intersect, one ray at a time through the unit sphere space
+void Ellipsoid::IntersectBatch(RayBatch & batch, uint32 begin, uint32 end) const
+{
+	const Matrix33 objectToWorldIT = Transpose(mObjectToWorldI);
+
+	for (uint32 i = begin; i < end; ++i)
+	{
+		const Vector3 origin    = mObjectToWorldI * (Vector3(batch.originX[i], batch.originY[i], batch.originZ[i]) - Vector3(mCenter));
+		const Vector3 direction = mObjectToWorldI * Vector3(batch.directionX[i], batch.directionY[i], batch.directionZ[i]);
+
+		float32 time;
+		const bool hit = NearestRoot(
+			Dot(direction, direction),
+			Dot(origin, direction),
+			Dot(origin, origin) - 1.0f,
+			batch.time[i],
+			&time
+		);
+
+		if (!hit)
+			continue;
+
+		const Vector3 normal = objectToWorldIT * (origin + direction * time);
+		batch.SetHit(i, this, time, normal.x, normal.y, normal.z);
+	}
+}
+
 //=============================================================================
 Ellipsoid * Ellipsoid::Clone() const
 {
 	return new Ellipsoid(*this);
 }
 
+//=============================================================================
+Vector3 Ellipsoid::GetAxis(uint i) const
+{
+	ASSERT(i < 3);
+
+	// Only scene exports ask, so the inverse is inverted back rather than the axes kept
+	Vector3 unit = Vector3::Zero;
+	unit[i] = 1.0f;
+	return Inverse(mObjectToWorldI) * unit;
+}
+
+//=============================================================================
+Aabb3 Ellipsoid::GetBounds() const
+{
+	return mBounds;
+}
+
 
 //=============================================================================
 // Aabb
@@ -199,6 +436,94 @@ Aabb * Aabb::Clone() const
 	return new Aabb(mAabb.min, mAabb.max, mMaterial);
 }
 
+//=============================================================================
+Aabb3 Aabb::GetBounds() const
+{
+	return mAabb;
+}
+
+//=============================================================================
+// Slab test per ray. The normal is that of the slab the ray enters through, or leaves through
+// when it starts inside, facing out of the box.
+void Aabb::IntersectBatch(RayBatch & batch, uint32 begin, uint32 end) const
+{
+	const float32 * origins[3]    = { batch.originX.data(), batch.originY.data(), batch.originZ.data() };
+	const float32 * directions[3] = { batch.directionX.data(), batch.directionY.data(), batch.directionZ.data() };
+
+	for (uint32 i = begin; i < end; ++i)
+	{
+		float32 tnear    = -std::numeric_limits<float32>::infinity();
+		float32 tfar     =  std::numeric_limits<float32>::infinity();
+		uint    nearAxis = 0;
+		uint    farAxis  = 0;
+
+		for (uint axis = 0; axis < 3; ++axis)
+		{
+			const float32 invDirection = 1.0f / directions[axis][i];
+			float32 t0 = (mAabb.min[axis] - origins[axis][i]) * invDirection;
+			float32 t1 = (mAabb.max[axis] - origins[axis][i]) * invDirection;
+			if (t0 > t1)
+				std::swap(t0, t1);
+
+			nearAxis = t0 > tnear ? axis : nearAxis;
+			tnear    = t0 > tnear ? t0 : tnear;
+			farAxis  = t1 < tfar ? axis : farAxis;
+			tfar     = t1 < tfar ? t1 : tfar;
+		}
+
+		const bool    inside = tnear <= 0.0f;
+		const float32 time   = inside ? tfar : tnear;
+		if (tnear > tfar || time <= 0.0f || time >= batch.time[i])
+			continue;
+
+		// Against the ray when entering, along it when leaving
+		const uint    axis = inside ? farAxis : nearAxis;
+		const float32 sign = (directions[axis][i] > 0.0f) == inside ? 1.0f : -1.0f;
+
+		float32 normal[3] = { 0.0f, 0.0f, 0.0f };
+		normal[axis] = sign;
+		batch.SetHit(i, this, time, normal[0], normal[1], normal[2]);
+	}
+}
+
+
+//=============================================================================
+// TriangleMesh
+//=============================================================================
+
+//=============================================================================
+TriangleMesh::TriangleMesh(const std::shared_ptr<const Mesh> & mesh, const Material & material) :
+	Object(material),
+	mMesh(mesh)
+{
+}
+
+//=============================================================================
+TriangleMesh * TriangleMesh::Clone() const
+{
+	return new TriangleMesh(mMesh, mMaterial);
+}
+
+//=============================================================================
+Aabb3 TriangleMesh::GetBounds() const
+{
+	return mMesh->GetBounds();
+}
+
+//=============================================================================
+bool TriangleMesh::Intersect(Result & out, const Ray3 & ray) const
+{
+	if (!mMesh->Intersect(out, ray))
+		return false;
+
+	// Meshes are rarely closed or consistently wound, so the surface faces whoever looks at it.
+	// Refraction needs to know inside from outside and keeps the winding.
+	if (mMaterial.type != MATERIAL_TYPE_REFRACT && Dot(out.normal, ray.direction) > 0.0f)
+		out.normal = -out.normal;
+
+	return true;
+}
+
 //=============================================================================
 bool Aabb::Intersect(Result & out, const Ray3 & ray) const
 {
@@ -9,6 +9,8 @@
 #ifndef OBJECT_H
 #define OBJECT_H
 
+#include <memory>
+
 namespace RT
 {
 
@@ -25,6 +27,7 @@ enum EMaterialType
 	MATERIAL_TYPE_DIFFUSE,
 	MATERIAL_TYPE_REFLECT,
 	MATERIAL_TYPE_REFRACT,
+	MATERIAL_TYPE_COUNT
 };
 
 struct Material
@@ -34,11 +37,26 @@ struct Material
 	Color         emissive;
 };
 
+enum EShapeType
+{
+	SHAPE_TYPE_SPHERE,
+	SHAPE_TYPE_ELLIPSOID,
+	SHAPE_TYPE_AABB,
+	SHAPE_TYPE_MESH,
+	SHAPE_TYPE_INSTANCE,
+};
+
 
 class Object;
+class Mesh;
+class SceneAssets;
+struct RayBatch;
 
 
-Object * ParseObject (const Json::CValue & json);
+//! Parses an object of a scene file, the meshes and shapes it refers to are found in assets
+Object * ParseObject (const Json::CValue & json, SceneAssets * assets);
+//! Parses the shape of an object of a scene file
+Object * ParseShape (const Json::CValue & jsonShape, const Material & material, SceneAssets * assets);
 
 
 
@@ -49,14 +67,25 @@ class Object
 {
 public:
 	Object(const Material & material);
+	virtual ~Object() { }
 
-	virtual bool     Intersect(Result & out, const Ray3 & ray) const = 0;
-	virtual Object * Clone() const = 0;
+	virtual bool       Intersect(Result & out, const Ray3 & ray) const = 0;
+	//! Intersects rays [begin, end) of batch, keeping the closer of each ray's hit and this object's.
+	//! Shapes with a closed form test override this with a loop over the arrays.
+	virtual void       IntersectBatch(RayBatch & batch, uint32 begin, uint32 end) const;
+	virtual Object *   Clone() const = 0;
+	virtual Aabb3      GetBounds() const = 0;
+	virtual EShapeType GetShapeType() const = 0;
 
 	const Material & GetMaterial() const { return mMaterial; }
+	void SetMaterial(const Material & material) { mMaterial = material; }
+	//! Number of the object's material among the scene's distinct ones, see Scene::IndexMaterials
+	uint32 GetMaterialIndex() const { return mMaterialIndex; }
+	void SetMaterialIndex(uint32 index) { mMaterialIndex = index; }
 
 protected:
 	Material	mMaterial;
+	uint32		mMaterialIndex;
 
 };
 
@@ -70,8 +99,13 @@ class Sphere : public Object
 public:
 	Sphere(const Point3 & pos, float32 radius, const Material & material);
 
-	virtual bool Intersect(Result & out, const Ray3 & ray) const;
-	virtual Sphere * Clone() const;
+	virtual bool       Intersect(Result & out, const Ray3 & ray) const;
+	virtual void       IntersectBatch(RayBatch & batch, uint32 begin, uint32 end) const;
+	virtual Sphere *   Clone() const;
+	virtual Aabb3      GetBounds() const;
+	virtual EShapeType GetShapeType() const { return SHAPE_TYPE_SPHERE; }
+
+	const Sphere3 & GetSphere() const { return mSphere; }
 
 private:
 	Sphere3		mSphere;
@@ -87,17 +121,27 @@ class Ellipsoid : public Object
 public:
 	Ellipsoid(const Point3 & pos, const Vector3 & radii, const Material & material);
 	Ellipsoid(const Point3 & pos, const Vector3 & u, const Vector3 & v, const Vector3 & w, const Material & material);
-	Ellipsoid(const Ellipsoid & e);
+	//! From the world to unit sphere transform GetObjectToWorldI returns, scene files keep it as is
+	Ellipsoid(const Point3 & pos, const Matrix33 & objectToWorldI, const Material & material);
 
-	virtual bool Intersect(Result & out, const Ray3 & ray) const;
+	virtual bool        Intersect(Result & out, const Ray3 & ray) const;
+	virtual void        IntersectBatch(RayBatch & batch, uint32 begin, uint32 end) const;
 	virtual Ellipsoid * Clone() const;
+	virtual Aabb3       GetBounds() const;
+	virtual EShapeType  GetShapeType() const { return SHAPE_TYPE_ELLIPSOID; }
+
+	const Point3 &   GetCenter() const { return mCenter; }
+	const Matrix33 & GetObjectToWorldI() const { return mObjectToWorldI; }
+	//! Returns the world space semi-axis i, one of the u, v, w the ellipsoid was built from up to rounding
+	Vector3          GetAxis(uint i) const;
 
 private:
-	Point3   mCenter;
-	Matrix33 mObjectToWorldIT;
+	void SetObjectToWorldI(const Matrix33 & objectToWorldI);
+
+	// Only the world to object transform is kept, normals go through its transpose
 	Matrix33 mObjectToWorldI;
-	Matrix33 mObjectToWorldT;
-	Matrix33 mObjectToWorld;
+	Point3   mCenter;
+	Aabb3    mBounds;
 };
 
 
@@ -110,13 +154,39 @@ class Aabb : public Object
 public: 
 	Aabb(const Point3 & min, const Point3 & max, const Material & material);
 
-	virtual bool Intersect(Result & out, const Ray3 & ray) const;
-	virtual Aabb * Clone() const;
+	virtual bool       Intersect(Result & out, const Ray3 & ray) const;
+	virtual void       IntersectBatch(RayBatch & batch, uint32 begin, uint32 end) const;
+	virtual Aabb *     Clone() const;
+	virtual Aabb3      GetBounds() const;
+	virtual EShapeType GetShapeType() const { return SHAPE_TYPE_AABB; }
+
+	const Aabb3 & GetAabb() const { return mAabb; }
 
 private:
 	Aabb3 mAabb;
 };
 
+
+
+//==================================================================================================
+// TriangleMesh - an instance of a mesh, which may be shared with other objects
+//==================================================================================================
+class TriangleMesh : public Object
+{
+public:
+	TriangleMesh(const std::shared_ptr<const Mesh> & mesh, const Material & material);
+
+	virtual bool           Intersect(Result & out, const Ray3 & ray) const;
+	virtual TriangleMesh * Clone() const;
+	virtual Aabb3          GetBounds() const;
+	virtual EShapeType     GetShapeType() const { return SHAPE_TYPE_MESH; }
+
+	const std::shared_ptr<const Mesh> & GetMesh() const { return mMesh; }
+
+private:
+	std::shared_ptr<const Mesh> mMesh;
+};
+
 } // namespace RT
 
 #endif //OBJECT_H
\ No newline at end of file
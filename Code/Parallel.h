@@ -0,0 +1,35 @@
+//==================================================================================================
+//
+// File:	Parallel.h
+//
+// Helpers for splitting work over threads outside of the render threads, such as loading meshes
+// and building hierarchies.
+//=================================================================================================
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+
+namespace RT
+{
+
+//=============================================================================
+// Runs fn(i) for i in [0, count), each on its own thread
+template <typename TFunction>
+void ParallelFor (uint32 count, TFunction && fn)
+{
+	std::vector<std::thread> threads;
+	for (uint32 i = 1; i < count; ++i)
+		threads.emplace_back([&fn, i] { fn(i); });
+
+	if (count)
+		fn(0);
+
+	for (std::thread & thread : threads)
+		thread.join();
+}
+
+} // namespace RT
+
+#endif //PARALLEL_H
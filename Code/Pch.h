@@ -11,8 +11,35 @@
 #include "Image.h"
 #include "Camera.h"
 #include "Object.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "RayBatch.h"
+#include "Parallel.h"
+#include "Topology.h"
+#include "Bvh.h"
+#include "QuantizedBvh.h"
+#include "Mesh.h"
+#include "MeshLoader.h"
+#include "Instance.h"
+#include "Animation.h"
 #include "Scene.h"
+#include "MappedFile.h"
+#include "SceneFile.h"
+#include "SceneGenerator.h"
+#include "GBuffer.h"
+#include "MaterialMask.h"
 #include "Renderer.h"
+#include "RenderScheduler.h"
 #include "RenderManager.h"
+#include "Progress.h"
+#include "Preview.h"
+#include "CommandLine.h"
+#include "Report.h"
+#include "PrimitiveBench.h"
+#include "RenderBench.h"
 #include "RayTracerApplication.h"
+#include "Socket.h"
+#include "RenderService.h"
+#include "DistributedRender.h"
+#include "ShardMerge.h"
 #include "Light.h"
\ No newline at end of file
@@ -0,0 +1,130 @@
+//==================================================================================================
+//
+// File:	Preview.cpp
+//
+// Progressive preview rendering.
+//
+//=================================================================================================
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+PreviewSession::PreviewSession (const Scene & scene, uint width, uint height, uint spp, RenderScheduler & scheduler) :
+	mScene(scene),
+	mScheduler(scheduler),
+	mCameraDesc(),
+	mSpp(spp),
+	mImage(width, height),
+	mPassImage(width, height),
+	mLowImage(Max(1u, width / LOW_RES_DIVISOR), Max(1u, height / LOW_RES_DIVISOR)),
+	mAccumulation(width, height),
+	mbJitter(true),
+	mbGBuffer(false),
+	mbLowResPass(false),
+	mPassSamples(0),
+	mSamples(0),
+	mFirstImageSeconds(0.0f)
+{
+	ASSERT(spp);
+}
+
+//=============================================================================
+PreviewSession::~PreviewSession ()
+{
+	// Cancels the pass in flight and waits for the scheduler to let go of it
+	mpPass.reset();
+}
+
+//=============================================================================
+void PreviewSession::SetSampling (bool jitter, bool gbuffer)
+{
+	ASSERT(!mpPass);
+
+	mbJitter  = jitter;
+	mbGBuffer = gbuffer;
+	if (mbGBuffer)
+		mGBuffer.Resize(mImage.GetWidth(), mImage.GetHeight(), mbJitter ? mSpp : 1);
+}
+
+//=============================================================================
+void PreviewSession::SetCamera (const CameraDesc & camera)
+{
+	mpPass.reset();
+
+	mCameraDesc = camera;
+	mCamera.Setup(camera, mImage.GetWidth() / float32(mImage.GetHeight()));
+	mAccumulation.Clear();
+	mGBuffer.Clear();
+	mSamples    = 0;
+	mCameraTime = Time::GetRealTime();
+
+	mbLowResPass = true;
+	StartPass();
+}
+
+//=============================================================================
+void PreviewSession::StartPass ()
+{
+	// The quick pass renders the first sample too, it is just thrown away
+	const uint begin = mbLowResPass ? 0 : mSamples;
+	mPassSamples = mbLowResPass ? 1 : Min(Min(Max(1u, mSamples), MAX_PASS_SAMPLES), mSpp - mSamples);
+
+	mpPass.reset(new RenderManager(mScene, mCamera, mbLowResPass ? mLowImage : mPassImage));
+	mpPass->SetSamplesPerPixel(mSpp);
+	mpPass->SetSampleRange(begin, begin + mPassSamples);
+	mpPass->SetJitter(mbJitter);
+	if (!mbLowResPass)
+	{
+		mpPass->SetAccumulationBuffer(&mAccumulation);
+		if (mbGBuffer)
+			mpPass->SetGBuffer(&mGBuffer);
+	}
+
+	mpPass->Start(mScheduler);
+}
+
+//=============================================================================
+bool PreviewSession::Update (float32 seconds)
+{
+	if (!mpPass)
+		return false;
+
+	if (!mpPass->WaitForProgress(seconds))
+		return false;
+
+	mpPass.reset();
+
+	if (mbLowResPass)
+	{
+		// Nearest neighbour, every low resolution pixel becomes a block of the image
+		const uint lowWidth  = mLowImage.GetWidth();
+		const uint lowHeight = mLowImage.GetHeight();
+		for (uint y = 0; y < mImage.GetHeight(); ++y)
+		{
+			for (uint x = 0; x < mImage.GetWidth(); ++x)
+			{
+				const uint lowX = Min(x * lowWidth / mImage.GetWidth(), lowWidth - 1);
+				const uint lowY = Min(y * lowHeight / mImage.GetHeight(), lowHeight - 1);
+				mImage.SetPixel(x, y, mLowImage.GetPixel(lowX, lowY));
+			}
+		}
+
+		mFirstImageSeconds = (Time::GetRealTime() - mCameraTime).GetSeconds();
+		mbLowResPass       = false;
+	}
+	else
+	{
+		mSamples += mPassSamples;
+		mAccumulation.Resolve(mImage, 0, 0);
+	}
+
+	if (!IsConverged())
+		StartPass();
+
+	return true;
+}
+
+} // namespace RT
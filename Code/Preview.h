@@ -0,0 +1,80 @@
+//==================================================================================================
+//
+// File:	Preview.h
+//
+// Progressive rendering for setting up shots. A quick pass at a fraction of the resolution and
+// one sample comes first, then passes of whole samples are added into an accumulation buffer
+// until the frame has every sample of the final render. Moving the camera throws the samples
+// away and starts over from the quick pass, while the scene and its hierarchies are kept.
+//=================================================================================================
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include <memory>
+
+namespace RT
+{
+
+//==================================================================================================
+//
+// Sample s of a pixel is seeded by the pixel and s alone, so once every sample is in the image
+// is the same as a final render with the same samples per pixel
+//==================================================================================================
+class PreviewSession
+{
+public:
+	//! The quick pass is this many times smaller along each side
+	static const uint LOW_RES_DIVISOR = 8;
+	//! Passes grow to this many samples, fewer while the image is young so it changes often
+	static const uint MAX_PASS_SAMPLES = 8;
+
+	PreviewSession (const Scene & scene, uint width, uint height, uint spp, RenderScheduler & scheduler);
+	~PreviewSession ();
+
+	//! Before the first SetCamera. The full resolution passes share a G-buffer, which without
+	//! jitter saves every pass after the first from tracing camera rays.
+	void SetSampling (bool jitter, bool gbuffer);
+
+	//! Drops every sample and starts over from the quick pass
+	void SetCamera (const CameraDesc & camera);
+	inline const CameraDesc & GetCamera () const { return mCameraDesc; }
+
+	//! Waits up to seconds for the pass in flight, and starts the next one if it is done.
+	//! Returns whether the image changed.
+	bool Update (float32 seconds);
+
+	inline const CImage & GetImage () const { return mImage; }
+	//! Full resolution samples per pixel in the image, 0 while it only shows the quick pass
+	inline uint GetSamples () const { return mSamples; }
+	inline bool IsConverged () const { return mSamples == mSpp; }
+	//! Seconds from the last SetCamera to the first image
+	inline float32 GetFirstImageSeconds () const { return mFirstImageSeconds; }
+
+private:
+	void StartPass ();
+
+	const Scene &       mScene;
+	RenderScheduler &   mScheduler;
+	CameraDesc          mCameraDesc;
+	Camera              mCamera;
+	uint                mSpp;
+
+	CImage              mImage;			// What gets shown
+	CImage              mPassImage;		// Backbuffer of the pass in flight, only its accumulation is used
+	CImage              mLowImage;		// The quick pass
+	CAccumulationBuffer mAccumulation;
+	GBuffer             mGBuffer;
+	bool                mbJitter;
+	bool                mbGBuffer;
+
+	std::unique_ptr<RenderManager> mpPass;
+	bool                mbLowResPass;	// The pass in flight is the quick one
+	uint                mPassSamples;	// Of the pass in flight
+	uint                mSamples;
+	Time::Point         mCameraTime;
+	float32             mFirstImageSeconds;
+};
+
+} // namespace RT
+
+#endif //PREVIEW_H
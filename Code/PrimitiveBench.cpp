@@ -0,0 +1,200 @@
+//==================================================================================================
+//
+// File:	PrimitiveBench.cpp
+//
+// Every shape is shot at with the same rays, about half of which hit it, aimed at random points
+// of a box a little larger than its bounds from random points around it.
+//
+//=================================================================================================
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+static const uint32 BENCH_RAY_COUNT = 4096;
+
+//=============================================================================
+// A sphere of radius 1 made of latitude and longitude bands
+static std::shared_ptr<const Mesh> CreateSphereMesh (uint32 bands)
+{
+	std::vector<float32> positions;
+	std::vector<uint32>  indices;
+
+	for (uint32 y = 0; y <= bands; ++y)
+	{
+		const float32 theta = Math::Pi * y / bands;
+		for (uint32 x = 0; x <= 2 * bands; ++x)
+		{
+			const float32 phi = Math::Pi * x / bands;
+			positions.push_back(std::sin(theta) * std::cos(phi));
+			positions.push_back(std::sin(theta) * std::sin(phi));
+			positions.push_back(std::cos(theta));
+		}
+	}
+
+	const uint32 stride = 2 * bands + 1;
+	for (uint32 y = 0; y < bands; ++y)
+	{
+		for (uint32 x = 0; x < 2 * bands; ++x)
+		{
+			const uint32 a = y * stride + x;
+			const uint32 b = a + stride;
+			indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+		}
+	}
+
+	std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+	mesh->Build(std::move(positions), std::move(indices));
+	return mesh;
+}
+
+//=============================================================================
+static void CreateRays (const Aabb3 & bounds, Random & random, RayBatch * batch)
+{
+	const Vector3 center = (Vector3(bounds.min) + Vector3(bounds.max)) * 0.5f;
+	const Vector3 extent = (Vector3(bounds.max) - Vector3(bounds.min)) * 0.5f;
+	const float32 radius = Sqrt(Dot(extent, extent));
+
+	batch->Resize(BENCH_RAY_COUNT);
+	for (uint32 i = 0; i < BENCH_RAY_COUNT; ++i)
+	{
+		Vector3 from;
+		Vector3 to;
+		for (uint axis = 0; axis < 3; ++axis)
+		{
+			from[axis] = center[axis] + (random.GetFloat32() * 2.0f - 1.0f) * radius * 3.0f;
+			to[axis]   = center[axis] + (random.GetFloat32() * 2.0f - 1.0f) * extent[axis] * 1.5f;
+		}
+
+		batch->SetRay(i, Ray3(Point3(from), Normalize(to - from)), std::numeric_limits<float32>::infinity());
+	}
+}
+
+//=============================================================================
+// Runs pass until it took at least seconds and returns rays per second
+template <typename TPass>
+static float64 MeasureRays (float32 seconds, TPass && pass)
+{
+	const Time::Point start = Time::GetRealTime();
+
+	uint64  rays    = 0;
+	float64 elapsed = 0.0;
+	while (elapsed < seconds)
+	{
+		pass();
+
+		rays   += BENCH_RAY_COUNT;
+		elapsed = (Time::GetRealTime() - start).GetSeconds();
+	}
+
+	return rays / elapsed;
+}
+
+
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+void RunPrimitiveBenchmarks (std::ostream & out, float32 seconds)
+{
+	Material material;
+	material.type     = MATERIAL_TYPE_DIFFUSE;
+	material.diffuse  = Color(1.0f, 1.0f, 1.0f);
+	material.emissive = Color::Black;
+
+	const std::shared_ptr<const Object> sphere(new Sphere(Point3(0.0f, 0.0f, 0.0f), 1.0f, material));
+	// A quarter turn about z at twice the size
+	const Matrix33 linear(
+		0.0f, -2.0f, 0.0f,
+		2.0f,  0.0f, 0.0f,
+		0.0f,  0.0f, 2.0f
+	);
+
+	struct Shape
+	{
+		const char *                  name;
+		std::shared_ptr<const Object> object;
+	};
+
+	const Shape shapes[] = {
+		{ "sphere",    sphere },
+		{ "ellipsoid", std::make_shared<Ellipsoid>(Point3(0.0f, 0.0f, 0.0f), Vector3(3.0f, 1.0f, 2.0f), material) },
+		{ "aabb",      std::make_shared<Aabb>(Point3(-1.0f, -2.0f, -1.0f), Point3(1.0f, 2.0f, 1.0f), material) },
+		{ "mesh",      std::make_shared<TriangleMesh>(CreateSphereMesh(32), material) },
+		{ "instance",  std::make_shared<Instance>(sphere, linear, Vector3(1.0f, 0.0f, 0.0f), material) },
+	};
+
+	for (const Shape & shape : shapes)
+	{
+		const Object & object = *shape.object;
+
+		Random random;
+		random.Seed(1);
+
+		RayBatch rays;
+		CreateRays(object.GetBounds(), random, &rays);
+
+		// One ray at a time, through the virtual call
+		uint32 scalarHits = 0;
+		std::vector<float32> scalarTimes(BENCH_RAY_COUNT);
+		const float64 scalarRate = MeasureRays(seconds, [&] {
+			scalarHits = 0;
+			for (uint32 i = 0; i < BENCH_RAY_COUNT; ++i)
+			{
+				Result result;
+				const bool hit = object.Intersect(result, rays.GetRay(i));
+				scalarTimes[i] = hit ? result.time : -1.0f;
+				scalarHits    += hit;
+			}
+		});
+
+		// The whole stream per call, the hit records are reset every pass
+		RayBatch batch = rays;
+		const float64 batchRate = MeasureRays(seconds, [&] {
+			std::fill(batch.time.begin(), batch.time.end(), std::numeric_limits<float32>::infinity());
+			std::fill(batch.object.begin(), batch.object.end(), null);
+			object.IntersectBatch(batch, 0, BENCH_RAY_COUNT);
+		});
+
+		// Both paths have to agree on what was hit, to a relative tolerance on where
+		uint32 batchHits  = 0;
+		uint32 mismatches = 0;
+		for (uint32 i = 0; i < BENCH_RAY_COUNT; ++i)
+		{
+			const bool hit = batch.object[i] != null;
+			batchHits += hit;
+
+			if (hit != (scalarTimes[i] >= 0.0f) || (hit && std::fabs(batch.time[i] - scalarTimes[i]) > 1e-3f * Max(1.0f, scalarTimes[i])))
+				++mismatches;
+		}
+
+		out
+			<< std::fixed
+			<< std::setprecision(1)
+			<< "{\"shape\":"                     << JsonString(shape.name)
+			<< ",\"rays\":"                      << BENCH_RAY_COUNT
+			<< ",\"hits\":"                      << scalarHits
+			<< ",\"batch_hits\":"                << batchHits
+			<< ",\"mismatches\":"                << mismatches
+			<< ",\"rays_per_second\":"           << scalarRate
+			<< ",\"batch_rays_per_second\":"     << batchRate
+			<< ",\"speedup\":"                   << std::setprecision(3) << batchRate / scalarRate
+			<< "}"
+			<< std::endl;
+	}
+}
+
+} // namespace RT
@@ -0,0 +1,22 @@
+//==================================================================================================
+//
+// File:	PrimitiveBench.h
+//
+// Microbenchmarks of the intersection tests of every shape, one ray at a time through
+// Object::Intersect against whole streams through Object::IntersectBatch.
+//=================================================================================================
+#ifndef PRIMITIVEBENCH_H
+#define PRIMITIVEBENCH_H
+
+#include <iosfwd>
+
+namespace RT
+{
+
+//! Prints one json line per shape with the rays per second of both paths and how many of their
+//! hits disagree. Every shape is timed for at least seconds.
+void RunPrimitiveBenchmarks (std::ostream & out, float32 seconds);
+
+} // namespace RT
+
+#endif //PRIMITIVEBENCH_H
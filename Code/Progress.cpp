@@ -0,0 +1,81 @@
+//==================================================================================================
+//
+// File:	Progress.cpp
+//
+// Render progress and time left.
+//
+//=================================================================================================
+
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+ProgressEstimator::ProgressEstimator (float32 timeConstant) :
+	mTimeConstant(timeConstant),
+	mSeconds(0.0f),
+	mProgress(0.0f),
+	mRate(0.0f)
+{
+	ASSERT(timeConstant > 0.0f);
+}
+
+//=============================================================================
+// Until the first progress the rate is unknown, after it the average so far is
+// the best guess, and from then on every interval pulls the rate towards its own
+void ProgressEstimator::Update (float32 seconds, float32 progress)
+{
+	const float32 delta = seconds - mSeconds;
+	if (delta <= 0.0f)
+		return;
+
+	const float32 rate = (progress - mProgress) / delta;
+
+	if (mRate > 0.0f)
+		mRate += (rate - mRate) * (1.0f - std::exp(-delta / mTimeConstant));
+	else if (progress > 0.0f)
+		mRate = progress / seconds;
+
+	mSeconds  = seconds;
+	mProgress = progress;
+}
+
+//=============================================================================
+float32 ProgressEstimator::GetSecondsLeft () const
+{
+	if (mRate <= 0.0f)
+		return -1.0f;
+
+	return Max(0.0f, 1.0f - mProgress) / mRate;
+}
+
+//=============================================================================
+void WriteProgressJson (
+	std::ostream &            out,
+	const char *              event,
+	const ProgressEstimator & estimator,
+	uint64                    samples,
+	uint64                    totalSamples
+) {
+	const float32 seconds = estimator.GetSeconds();
+
+	out
+		<< std::fixed
+		<< std::setprecision(3)
+		<< "{\"event\":"               << JsonString(event)
+		<< ",\"elapsed_seconds\":"     << seconds
+		<< ",\"progress\":"            << std::setprecision(5) << estimator.GetProgress() << std::setprecision(3)
+		<< ",\"samples\":"             << samples
+		<< ",\"total_samples\":"       << totalSamples
+		<< ",\"samples_per_second\":"  << (seconds > 0.0f ? samples / seconds : 0.0f)
+		<< ",\"eta_seconds\":"         << estimator.GetSecondsLeft()
+		<< "}"
+		<< std::endl;
+}
+
+} // namespace RT
@@ -0,0 +1,59 @@
+//==================================================================================================
+//
+// File:	Progress.h
+//
+// Turns readings of a render's pixel progress over time into a rate and an estimate of the time
+// left, smoothing the rate so one expensive stretch of blocks doesn't throw the estimate around.
+//=================================================================================================
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <iosfwd>
+
+namespace RT
+{
+
+//==================================================================================================
+//
+// Progress is the fraction of pixels done, between 0 and 1. The rate is an exponential moving
+// average with a time constant rather than a sample count, so it behaves the same at any update
+// interval.
+//==================================================================================================
+class ProgressEstimator
+{
+public:
+	//! Seconds it takes the smoothed rate to move most of the way to a new steady rate
+	static constexpr float32 DEFAULT_TIME_CONSTANT = 5.0f;
+
+	explicit ProgressEstimator (float32 timeConstant = DEFAULT_TIME_CONSTANT);
+
+	//! Feeds the progress seconds after the render started
+	void Update (float32 seconds, float32 progress);
+
+	inline float32 GetSeconds () const { return mSeconds; }
+	inline float32 GetProgress () const { return mProgress; }
+	//! Smoothed progress per second
+	inline float32 GetRate () const { return mRate; }
+	//! Seconds left at the smoothed rate, negative until there is a rate
+	float32 GetSecondsLeft () const;
+
+private:
+	float32 mTimeConstant;
+	float32 mSeconds;
+	float32 mProgress;
+	float32 mRate;
+};
+
+//! One json line for progress streams, with an event of "progress", "paused", "done" or
+//! "cancelled"
+void WriteProgressJson (
+	std::ostream &            out,
+	const char *              event,
+	const ProgressEstimator & estimator,
+	uint64                    samples,
+	uint64                    totalSamples
+);
+
+} // namespace RT
+
+#endif //PROGRESS_H
@@ -0,0 +1,214 @@
+//==================================================================================================
+//
+// File:	QuantizedBvh.cpp
+//
+// Compresses a built bvh. Boxes are quantized against their parent's box in the style of Ylitie,
+// Karras and Laine, "Efficient Incoherent Ray Traversal on GPUs Through Compressed Wide BVHs"
+// (HPG 2017), here for two children per node.
+//
+//=================================================================================================
+
+#include <cmath>
+#include <cstring>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+static const sint32 MIN_EXPONENT = -127;
+static const sint32 MAX_EXPONENT = 127;
+
+//=============================================================================
+// Quantizes the box of child c against the frame already in out, rounding outwards. The decoded
+// values are checked with the exact expression traversal uses, so rounding never shrinks a box.
+static bool QuantizeChild (const BvhNode & child, QuantizedBvhNode * out, uint c, const float32 scale[3])
+{
+	for (uint axis = 0; axis < 3; ++axis)
+	{
+		const float32 origin = out->origin[axis];
+		if (scale[axis] == 0.0f)
+		{
+			out->qmin[c][axis] = 0;
+			out->qmax[c][axis] = 0;
+			continue;
+		}
+
+		sint32 qmin = sint32(std::floor((child.min[axis] - origin) / scale[axis]));
+		sint32 qmax = sint32(std::ceil((child.max[axis] - origin) / scale[axis]));
+		qmin = Min(Max(qmin, 0), 255);
+		qmax = Min(Max(qmax, 0), 255);
+
+		while (qmin > 0 && origin + float32(qmin) * scale[axis] > child.min[axis])
+			--qmin;
+		while (qmax < 255 && origin + float32(qmax) * scale[axis] < child.max[axis])
+			++qmax;
+
+		if (origin + float32(qmin) * scale[axis] > child.min[axis] || origin + float32(qmax) * scale[axis] < child.max[axis])
+			return false;
+
+		out->qmin[c][axis] = uint8(qmin);
+		out->qmax[c][axis] = uint8(qmax);
+	}
+
+	return true;
+}
+
+
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+bool ParseBvhNodes (const char * name, EBvhNodes * out)
+{
+	if      (!strcmp(name, "full"))      *out = BVH_NODES_FULL;
+	else if (!strcmp(name, "quantized")) *out = BVH_NODES_QUANTIZED;
+	else return false;
+
+	return true;
+}
+
+//=============================================================================
+const char * GetBvhNodesName (EBvhNodes nodes)
+{
+	return nodes == BVH_NODES_QUANTIZED ? "quantized" : "full";
+}
+
+
+
+//=============================================================================
+// QuantizedBvh
+//=============================================================================
+
+//=============================================================================
+QuantizedBvh::QuantizedBvh ()
+{
+	memset(&mRoot, 0, sizeof(mRoot));
+}
+
+//=============================================================================
+void QuantizedBvh::Clear ()
+{
+	mNodes.clear();
+	mNodes.shrink_to_fit();
+	mIndices.clear();
+	mIndices.shrink_to_fit();
+}
+
+//=============================================================================
+bool QuantizedBvh::Build (const Bvh & bvh)
+{
+	Clear();
+
+	if (bvh.IsEmpty() || bvh.GetNodes()[0].count)
+		return false;
+
+	// Every interior node of the full hierarchy becomes one node here
+	mNodes.reserve(bvh.GetNodeCount() / 2);
+
+	bool ok = true;
+	BuildNode(bvh, 0, &ok);
+	if (!ok)
+	{
+		Clear();
+		return false;
+	}
+
+	mNodes.shrink_to_fit();
+	mIndices.assign(bvh.GetIndices(), bvh.GetIndices() + bvh.GetIndexCount());
+	mRoot = bvh.GetNodes()[0];
+
+	return true;
+}
+
+//=============================================================================
+// Returns the index the interior node was written to
+uint32 QuantizedBvh::BuildNode (const Bvh & bvh, uint32 index, bool * ok)
+{
+	const BvhNode & node   = bvh.GetNodes()[index];
+	const BvhNode & first  = bvh.GetNodes()[index + 1];
+	const BvhNode & second = bvh.GetNodes()[node.offset];
+
+	const uint32 out = uint32(mNodes.size());
+	mNodes.emplace_back();
+
+	QuantizedBvhNode quantized;
+	memset(&quantized, 0, sizeof(quantized));
+
+	// The smallest power of two steps which reach from min to max in 255 of them
+	float32 scale[3];
+	for (uint axis = 0; axis < 3; ++axis)
+	{
+		const float32 extent = node.max[axis] - node.min[axis];
+
+		sint32 exponent = MIN_EXPONENT;
+		if (extent > 0.0f)
+		{
+			exponent = Max(MIN_EXPONENT + 1, sint32(std::ceil(std::log2(extent / 255.0f))));
+			while (exponent <= MAX_EXPONENT && node.min[axis] + 255.0f * std::ldexp(1.0f, exponent) < node.max[axis])
+				++exponent;
+
+			if (exponent > MAX_EXPONENT)
+			{
+				*ok = false;
+				return out;
+			}
+		}
+
+		quantized.origin[axis]   = node.min[axis];
+		quantized.exponent[axis] = sint8(exponent);
+		scale[axis]              = GetScale(sint8(exponent));
+	}
+
+	if (first.count > MAX_LEAF_COUNT || second.count > MAX_LEAF_COUNT)
+	{
+		*ok = false;
+		return out;
+	}
+
+	// Two leaves share the one offset
+	if (first.count && second.count && second.offset != first.offset + first.count)
+	{
+		*ok = false;
+		return out;
+	}
+
+	if (!QuantizeChild(first, &quantized, 0, scale) || !QuantizeChild(second, &quantized, 1, scale))
+	{
+		*ok = false;
+		return out;
+	}
+
+	quantized.counts = uint8(first.count | (second.count << 4));
+	quantized.offset = first.count ? first.offset : second.offset;
+
+	if (!first.count)
+	{
+		BuildNode(bvh, index + 1, ok);
+		if (!*ok)
+			return out;
+	}
+
+	if (!second.count)
+	{
+		const uint32 child = BuildNode(bvh, node.offset, ok);
+		if (!*ok)
+			return out;
+
+		// With an interior first child offset is the second child, otherwise the second child
+		// is the one following this node
+		if (!first.count)
+			quantized.offset = child;
+	}
+
+	mNodes[out] = quantized;
+	return out;
+}
+
+} // namespace RT
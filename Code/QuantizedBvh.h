@@ -0,0 +1,202 @@
+//==================================================================================================
+//
+// File:	QuantizedBvh.h
+//
+// A compressed copy of a bvh for scenes whose hierarchies no longer fit in the caches. Every node
+// holds the boxes of both its children, in 8 bits per coordinate relative to its own box, and
+// leaves are folded into their parents, so a node is 32 bytes where a full one takes 64 for the
+// two children. Traversal decodes the boxes as it goes, trading a little arithmetic for memory.
+//=================================================================================================
+#ifndef QUANTIZEDBVH_H
+#define QUANTIZEDBVH_H
+
+#include <cstring>
+#include <vector>
+
+namespace RT
+{
+
+//==================================================================================================
+//
+// Coordinates of the children are origin + q * 2^exponent, rounded outwards so the decoded boxes
+// always hold the real ones. An interior first child directly follows its parent. offset is the
+// second child when both are interior, otherwise the first primitive of the leaf children, whose
+// primitives are next to each other when both are leaves.
+//==================================================================================================
+struct QuantizedBvhNode
+{
+	float32 origin[3];		//!< Min corner of this node's box
+	sint8   exponent[3];	//!< -127 for an axis the node is flat along
+	uint8   counts;			//!< Primitives of child 0 in the low nibble and child 1 in the high one, 0 for interior children
+	uint8   qmin[2][3];
+	uint8   qmax[2][3];
+	uint32  offset;
+};
+
+static_assert(sizeof(QuantizedBvhNode) == 32, "QuantizedBvhNode is meant to fill half a cache line");
+
+//! Which nodes the hierarchies of a scene's meshes are traced with
+enum EBvhNodes
+{
+	BVH_NODES_FULL,			//!< Float boxes, as built
+	BVH_NODES_QUANTIZED,	//!< QuantizedBvh, about half the memory
+};
+
+//! Parses "full" or "quantized"
+bool ParseBvhNodes (const char * name, EBvhNodes * out);
+const char * GetBvhNodesName (EBvhNodes nodes);
+
+//==================================================================================================
+// QuantizedBvh
+//==================================================================================================
+class QuantizedBvh
+{
+public:
+	static const uint32 MAX_LEAF_COUNT = 15;
+
+	QuantizedBvh ();
+
+	//! Compresses bvh. Returns false, leaving this empty, for hierarchies which can not be stored:
+	//! a single leaf, leaves of more than MAX_LEAF_COUNT primitives or boxes too large to quantize.
+	bool Build (const Bvh & bvh);
+	void Clear ();
+
+	inline bool   IsEmpty () const { return mNodes.empty(); }
+	inline uint32 GetNodeCount () const { return uint32(mNodes.size()); }
+	//! Bytes taken by the nodes and primitive indices
+	inline uint64 GetMemorySize () const { return mNodes.size() * sizeof(QuantizedBvhNode) + mIndices.size() * sizeof(uint32); }
+
+	//! Same as Bvh::Traverse
+	template <typename TIntersect>
+	void Traverse (const Ray3 & ray, float32 maxTime, TIntersect && intersect) const;
+
+private:
+	uint32 BuildNode (const Bvh & bvh, uint32 node, bool * ok);
+
+	static inline float32 GetScale (sint8 exponent);
+
+	// Data
+	std::vector<QuantizedBvhNode> mNodes;
+	std::vector<uint32>           mIndices;
+	BvhNode                       mRoot;	// Only its box is used
+};
+
+
+
+//=============================================================================
+// 2^exponent straight from the bits, -127 makes a zero scale
+inline float32 QuantizedBvh::GetScale (sint8 exponent)
+{
+	const uint32 bits = uint32(exponent + 127) << 23;
+
+	float32 scale;
+	memcpy(&scale, &bits, sizeof(scale));
+	return scale;
+}
+
+//=============================================================================
+template <typename TIntersect>
+void QuantizedBvh::Traverse (const Ray3 & ray, float32 maxTime, TIntersect && intersect) const
+{
+	if (mNodes.empty())
+		return;
+
+	const Vector3 origin = ray.origin;
+	const Vector3 invDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+	// Leaves are pushed like nodes so they are visited nearest first too
+	struct Entry
+	{
+		uint32  offset;		// Node, or first primitive of a leaf
+		uint32  count;		// 0 for a node
+		float32 time;
+	};
+
+	Entry  stack[Bvh::MAX_DEPTH];
+	uint32 top = 0;
+
+	float32 rootTime = 0.0f;
+	if (!SlabTest(mRoot.min, mRoot.max, origin, invDirection, maxTime, &rootTime))
+		return;
+
+	stack[top++] = { 0, 0, rootTime };
+
+	RT_STATS_ONLY(uint32 visits = 0;)
+
+	while (top)
+	{
+		const Entry entry = stack[--top];
+		if (entry.time > maxTime)
+			continue;
+
+		if (entry.count)
+		{
+			RT_STAT_ADD(STAT_PRIMITIVE_TESTS, entry.count);
+			for (uint32 i = 0; i < entry.count; ++i)
+				intersect(mIndices[entry.offset + i], maxTime);
+
+			continue;
+		}
+
+		RT_STATS_ONLY(++visits;)
+
+		const QuantizedBvhNode & node = mNodes[entry.offset];
+
+		const float32 scale[3] = { GetScale(node.exponent[0]), GetScale(node.exponent[1]), GetScale(node.exponent[2]) };
+
+		Entry child[2];
+		bool  hit[2];
+		for (uint c = 0; c < 2; ++c)
+		{
+			float32 min[3];
+			float32 max[3];
+			for (uint axis = 0; axis < 3; ++axis)
+			{
+				min[axis] = node.origin[axis] + float32(node.qmin[c][axis]) * scale[axis];
+				max[axis] = node.origin[axis] + float32(node.qmax[c][axis]) * scale[axis];
+			}
+
+			child[c].time = 0.0f;
+			hit[c] = SlabTest(min, max, origin, invDirection, maxTime, &child[c].time);
+		}
+
+		child[0].count = node.counts & 0xf;
+		child[1].count = node.counts >> 4;
+		if (child[0].count && child[1].count)
+		{
+			child[0].offset = node.offset;
+			child[1].offset = node.offset + child[0].count;
+		}
+		else
+		{
+			// The interior child follows this node unless both are interior
+			child[0].offset = child[0].count ? node.offset : entry.offset + 1;
+			child[1].offset = child[0].count ? entry.offset + 1 : node.offset;
+		}
+
+		if (hit[0] && hit[1])
+		{
+			// Nearest on top
+			if (child[1].time < child[0].time)
+				std::swap(child[0], child[1]);
+
+			ASSERT(top + 2 <= Bvh::MAX_DEPTH);
+			stack[top++] = child[1];
+			stack[top++] = child[0];
+		}
+		else if (hit[0])
+		{
+			stack[top++] = child[0];
+		}
+		else if (hit[1])
+		{
+			stack[top++] = child[1];
+		}
+	}
+
+	RT_STAT_ADD(STAT_NODE_VISITS, visits);
+}
+
+} // namespace RT
+
+#endif //QUANTIZEDBVH_H
@@ -0,0 +1,81 @@
+//==================================================================================================
+//
+// File:	RayBatch.cpp
+//
+// Structure of arrays ray streams.
+//
+//=================================================================================================
+
+#include <limits>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+void RayBatch::Resize (uint32 count)
+{
+	originX.resize(count);
+	originY.resize(count);
+	originZ.resize(count);
+	directionX.resize(count);
+	directionY.resize(count);
+	directionZ.resize(count);
+
+	time.assign(count, std::numeric_limits<float32>::infinity());
+	object.assign(count, null);
+	normalX.assign(count, 0.0f);
+	normalY.assign(count, 0.0f);
+	normalZ.assign(count, 0.0f);
+}
+
+//=============================================================================
+void RayBatch::SetRay (uint32 i, const Ray3 & ray, float32 maxTime)
+{
+	ASSERT(i < GetCount());
+
+	originX[i]    = ray.origin.x;
+	originY[i]    = ray.origin.y;
+	originZ[i]    = ray.origin.z;
+	directionX[i] = ray.direction.x;
+	directionY[i] = ray.direction.y;
+	directionZ[i] = ray.direction.z;
+
+	time[i]   = maxTime;
+	object[i] = null;
+}
+
+//=============================================================================
+Ray3 RayBatch::GetRay (uint32 i) const
+{
+	ASSERT(i < GetCount());
+
+	return Ray3(
+		Point3(originX[i], originY[i], originZ[i]),
+		Vector3(directionX[i], directionY[i], directionZ[i])
+	);
+}
+
+//=============================================================================
+bool RayBatch::GetHit (uint32 i, Result * out) const
+{
+	ASSERT(i < GetCount());
+
+	if (!object[i])
+		return false;
+
+	out->time   = time[i];
+	out->point  = Point3(originX[i], originY[i], originZ[i]) + Vector3(directionX[i], directionY[i], directionZ[i]) * time[i];
+	out->normal = Vector3(normalX[i], normalY[i], normalZ[i]);
+	return true;
+}
+
+//=============================================================================
+void IntersectBatch (const Object * const * objects, uint32 objectCount, RayBatch & batch)
+{
+	for (uint32 i = 0; i < objectCount; ++i)
+		objects[i]->IntersectBatch(batch, 0, batch.GetCount());
+}
+
+} // namespace RT
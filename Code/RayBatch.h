@@ -0,0 +1,68 @@
+//==================================================================================================
+//
+// File:	RayBatch.h
+//
+// A stream of rays stored as structure of arrays, with the closest hit of every ray kept next to
+// it. Objects intersect a whole batch per virtual call, so wavefront or packet style callers pay
+// for the dispatch once and the loops over rays are free to vectorize.
+//=================================================================================================
+#ifndef RAYBATCH_H
+#define RAYBATCH_H
+
+#include <vector>
+
+namespace RT
+{
+
+class Object;
+
+//==================================================================================================
+//
+// Hit records start out as "no hit before time", each intersect call only replaces those it
+// finds a closer hit for. The point of a hit is origin + direction * time.
+//==================================================================================================
+struct RayBatch
+{
+	//! Resizes to count rays, all of them without a hit
+	void Resize (uint32 count);
+	inline uint32 GetCount () const { return uint32(time.size()); }
+
+	//! Sets ray i, which may be hit up to maxTime
+	void SetRay (uint32 i, const Ray3 & ray, float32 maxTime);
+	Ray3 GetRay (uint32 i) const;
+
+	//! Returns whether ray i hit something, and fills out with the hit if it did
+	bool GetHit (uint32 i, Result * out) const;
+
+	//! Replaces the hit of ray i
+	inline void SetHit (uint32 i, const Object * pObject, float32 hitTime, float32 nx, float32 ny, float32 nz)
+	{
+		time[i]    = hitTime;
+		object[i]  = pObject;
+		normalX[i] = nx;
+		normalY[i] = ny;
+		normalZ[i] = nz;
+	}
+
+	// Rays
+	std::vector<float32> originX;
+	std::vector<float32> originY;
+	std::vector<float32> originZ;
+	std::vector<float32> directionX;
+	std::vector<float32> directionY;
+	std::vector<float32> directionZ;
+
+	// Hits
+	std::vector<float32>        time;		//!< The ray's max time until something is hit
+	std::vector<const Object *> object;		//!< null until something is hit
+	std::vector<float32>        normalX;
+	std::vector<float32>        normalY;
+	std::vector<float32>        normalZ;
+};
+
+//! Intersects every ray of the batch with every object, one virtual call per object
+void IntersectBatch (const Object * const * objects, uint32 objectCount, RayBatch & batch);
+
+} // namespace RT
+
+#endif //RAYBATCH_H
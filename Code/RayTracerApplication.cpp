@@ -1,6 +1,17 @@
 
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <deque>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
 #include "Pch.h"
 
 const uint WIDTH  = 512;
@@ -15,17 +26,22 @@ const Vector3  WALL_EXTENTS(120.0f, 100.0f, 100.0f);
 struct ToTime 
 {
 	ToTime(Time::Delta t) : 
-		time(t) 
+		seconds(t.GetSeconds()) 
 	{
 	}
 
-	Time::Delta time;
+	explicit ToTime(float32 s) :
+		seconds(s)
+	{
+	}
+
+	float32 seconds;
 };
 
 //=============================================================================
 std::ostream & operator<< (std::ostream & out, const ToTime & t)
 {
-	uint s = FloatToUint(t.time.GetSeconds());
+	uint s = FloatToUint(t.seconds);
 	
 	const uint SEC_IN_MIN  = 60;
 	const uint SEC_IN_HOUR = 60 * SEC_IN_MIN;
@@ -67,22 +83,72 @@ void find_replace (char * str, char what, char with) {
 }
 
 
+//=============================================================================
+// Signals
+//=============================================================================
+
+// How often the render loop looks at what the signals asked for
+const float32 SIGNAL_POLL_SECONDS = 0.1f;
+
+// Handlers can only set flags, the render loop acts on them. SIGINT and SIGTERM
+// cancel the render, SIGUSR1 pauses it and SIGUSR2 resumes it.
+static volatile sig_atomic_t s_cancelRequested = 0;
+static volatile sig_atomic_t s_pauseRequested  = 0;
+
+//=============================================================================
+static void OnCancelSignal (int)
+{
+	s_cancelRequested = 1;
+}
+
+#if !defined(_WIN32)
+//=============================================================================
+static void OnPauseSignal (int)
+{
+	s_pauseRequested = 1;
+}
+
+//=============================================================================
+static void OnResumeSignal (int)
+{
+	s_pauseRequested = 0;
+}
+#endif
+
+//=============================================================================
+static void SetRenderSignals (bool install)
+{
+	std::signal(SIGINT, install ? OnCancelSignal : SIG_DFL);
+	std::signal(SIGTERM, install ? OnCancelSignal : SIG_DFL);
+#if !defined(_WIN32)
+	std::signal(SIGUSR1, install ? OnPauseSignal : SIG_DFL);
+	std::signal(SIGUSR2, install ? OnResumeSignal : SIG_DFL);
+#endif
+}
+
+
 //=============================================================================
 // Application
 //=============================================================================
 
 //=============================================================================
-Application::Application() :
+Application::Application(const RenderOptions & options) :
+	mOptions(options),
 	mBackbuffer(WIDTH, HEIGHT),
+	mSceneCache(null),
+	mPrimaryRaysPerSecond(0.0f),
+	mBvhNodes(RT::BVH_NODES_FULL),
+	mQuantizedMeshes(0),
+	mQuantizeSeconds(0.0f),
+	mBvhFullMemory(0),
+	mPrimaryRaysPerSecondFull(0.0f),
 	mRenderManager(mScene, mCamera, mBackbuffer)
 {
-    //if (!TrySceneFromFile())
-    {
-	    mRenderManager.SetSamplesPerPixel(100);
-	    SceneCreateWalls();
-	    SceneCreateSpheres();
-	    SceneCreateReddit();
-    }
+	// What the built-in scenes, which have no file to read settings from, go by
+	mSceneSettings.width    = 0;
+	mSceneSettings.height   = 0;
+	mSceneSettings.spp      = 0;
+	mSceneSettings.bvhNodes = RT::BVH_NODES_FULL;
 }
 
 //=============================================================================
@@ -91,143 +157,875 @@ Application::~Application()
 }
 
 //=============================================================================
-void Application::Run() 
+int Application::Run() 
 {
+	if (mOptions.primitiveBench)
+	{
+		RT::RunPrimitiveBenchmarks(std::cout, 0.25f);
+		return 0;
+	}
+
+	const Time::Point loadTick = Time::GetRealTime();
+	RT::TraceScope    loadTrace(RT::TRACE_LOAD_SCENE);
+
+	mScene.SetBvhBuilder(mOptions.bvhBuilder);
+
+	if (mOptions.scenePath)
+	{
+		if (!TrySceneFromFile(mOptions.scenePath))
+		{
+			std::cerr << "Failed to load scene '" << mOptions.scenePath << "'" << std::endl;
+			return 2;
+		}
+
+		if (mOptions.compileScene)
+		{
+			if (!RT::SaveBinaryScene(mOptions.compileScene, mScene, mSceneSettings, 0))
+			{
+				std::cerr << "Failed to write '" << mOptions.compileScene << "'" << std::endl;
+				return 2;
+			}
+
+			return 0;
+		}
+	}
+	else
+	{
+		mRenderManager.SetSamplesPerPixel(100);
+		ApplyOptions();
+		SceneCreateWalls();
+		SceneCreateSpheres();
+		SceneCreateReddit();
+		mScene.BuildBvh();
+	}
+
+	const Time::Point loadedTick = Time::GetRealTime();
+	loadTrace.End();
+
+	// Quantized nodes are benchmarked against the full ones they replace
+	mBvhFullMemory = mScene.GetBvhMemorySize();
+	mBvhNodes      = ResolveBvhNodes(mOptions, mSceneSettings);
+	if (mBvhNodes == RT::BVH_NODES_QUANTIZED)
+	{
+		if (mOptions.bvhBench)
+			mPrimaryRaysPerSecondFull = MeasurePrimaryRays();
+
+		const Time::Point quantizeTick = Time::GetRealTime();
+		mQuantizedMeshes = mScene.QuantizeMeshBvhs();
+		mQuantizeSeconds = (Time::GetRealTime() - quantizeTick).GetSeconds();
+	}
+
+	if (mOptions.bvhBench)
+		mPrimaryRaysPerSecond = MeasurePrimaryRays();
+
+	if (mOptions.previewPath)
+		return RunPreview();
+
+	if (mOptions.watch)
+		return RunWatch();
+
+	if (mOptions.frameEnd)
+		return RenderFrames((loadedTick - loadTick).GetSeconds());
+
+	SetupRenderManager(&mRenderManager, mOptions.accumulationPath ? &mAccumulation : null);
+
+	if (mOptions.gbuffer && !mOptions.headless)
+		std::cout << "G-buffer:  " << std::fixed << std::setprecision(1) << mGBuffer.GetMemorySize() / (1024.0 * 1024.0) << " MB" << std::endl;
+
+	// A pipe or file the job scheduler reads progress from, one json line per report
+	std::ofstream progressJson;
+	if (mOptions.progressJsonPath)
+	{
+		progressJson.open(mOptions.progressJsonPath);
+		if (!progressJson)
+		{
+			std::cerr << "Failed to open '" << mOptions.progressJsonPath << "'" << std::endl;
+			return 2;
+		}
+	}
+
 	const Time::Point startTick = Time::GetRealTime();
 
+	SetRenderSignals(true);
 	mRenderManager.Start();
 
-	while (!mRenderManager.IsDone())
-	{
-		const float32     currProgress = mRenderManager.GetProgress();
-		const Time::Point endTick      = Time::GetRealTime();
-
-		std::cout 
-            << '['
-			<< ToTime(endTick - startTick)
-            << ']'
-			<< std::setfill(' ')
-			<< std::fixed 
-			<< std::setprecision(2)
-			<< std::setw(6)
-			<< currProgress * 100.0f
-			<< "%  "
-				
+	// Reports go out on a timer, whatever the blocks are doing
+	RT::ProgressEstimator estimator;
+	float32               nextReport = mOptions.progressInterval;
+	while (!mRenderManager.WaitForProgress(Min(mOptions.progressInterval, SIGNAL_POLL_SECONDS)))
+	{
+		if (s_cancelRequested && !mRenderManager.IsCancelled())
+			mRenderManager.Cancel();
+
+		if (s_pauseRequested && !mRenderManager.IsPaused())
+			mRenderManager.Pause();
+		else if (!s_pauseRequested && mRenderManager.IsPaused())
+			mRenderManager.Resume();
+
+		const float32 seconds = (Time::GetRealTime() - startTick).GetSeconds();
+		if (seconds < nextReport)
+			continue;
+
+		nextReport = seconds + mOptions.progressInterval;
+		estimator.Update(seconds, mRenderManager.GetProgress());
+
+		if (!mOptions.headless)
+		{
+			const float32 secondsLeft = estimator.GetSecondsLeft();
+
+			std::cout 
+				<< '['
+				<< ToTime(estimator.GetSeconds())
+				<< ']'
+				<< std::setfill(' ')
+				<< std::fixed 
+				<< std::setprecision(2)
+				<< std::setw(6)
+				<< estimator.GetProgress() * 100.0f
+				<< "%  ";
+
+			if (mRenderManager.IsPaused())
+				std::cout << "paused";
+			else if (secondsLeft >= 0.0f)
+				std::cout << "ETA " << ToTime(secondsLeft);
+
+			std::cout << std::endl;
+		}
+
+		if (progressJson.is_open())
+			RT::WriteProgressJson(progressJson, mRenderManager.IsPaused() ? "paused" : "progress", estimator, mRenderManager.GetCompletedSamples(), mRenderManager.GetTotalSamples());
+	}
+
+	SetRenderSignals(false);
+
+	if (progressJson.is_open())
+	{
+		estimator.Update((Time::GetRealTime() - startTick).GetSeconds(), mRenderManager.GetProgress());
+		RT::WriteProgressJson(progressJson, mRenderManager.IsCancelled() ? "cancelled" : "done", estimator, mRenderManager.GetCompletedSamples(), mRenderManager.GetTotalSamples());
+	}
+
+	if (mRenderManager.IsCancelled())
+		std::cerr << "Cancelled, writing the completed blocks" << std::endl;
+
+	const Time::Point saveTick = Time::GetRealTime();
+	RT::TraceScope    saveTrace(RT::TRACE_SAVE_IMAGE);
+
+	if (mOptions.accumulationPath)
+	{
+		RT::SampleRange range;
+		range.total = mRenderManager.GetSamplesPerPixel();
+		range.begin = mRenderManager.GetSampleBegin();
+		range.end   = mRenderManager.GetSampleEnd();
+		if (!mAccumulation.Save(mOptions.accumulationPath, range))
+		{
+			std::cerr << "Failed to write '" << mOptions.accumulationPath << "'" << std::endl;
+			return 2;
+		}
+	}
+
+	if (mOptions.outputPath)
+	{
+		if (!mBackbuffer.Save(mOptions.outputPath))
+		{
+			std::cerr << "Failed to write '" << mOptions.outputPath << "'" << std::endl;
+			return 2;
+		}
+	}
+	else if (!mOptions.accumulationPath)
+	{
+		char filename[64];
+		strncpy_s(filename, "Image - " __DATE__ " - " __TIME__ ".tga", 64);
+		find_replace(filename, ':', '_');
+
+		if (!mBackbuffer.Save(filename))
+		{
+			std::cerr << "Failed to write '" << filename << "'" << std::endl;
+			return 2;
+		}
+	}
+
+	if (mOptions.costMapPath && !mRenderManager.SaveCostMap(mOptions.costMapPath))
+	{
+		std::cerr << "Failed to write '" << mOptions.costMapPath << "'" << std::endl;
+		return 2;
+	}
+
+	const Time::Point endTick = Time::GetRealTime();
+	saveTrace.End();
+
+	if (mOptions.headless)
+	{
+		PrintStats(
+			(loadedTick - loadTick).GetSeconds(),
+			(saveTick - startTick).GetSeconds(),
+			(endTick - saveTick).GetSeconds()
+		);
+	}
+#if RT_STATS
+	else
+	{
+		RT::RenderStats stats;
+		mRenderManager.GetStats(&stats);
+		RT::PrintRenderStats(std::cout, stats, (saveTick - startTick).GetSeconds());
+	}
+#endif
+
+	// Whatever was completed is written, but the caller has to know it is partial
+	return mRenderManager.IsCancelled() ? 3 : 0;
+}
+
+//=============================================================================
+// Command line overrides win over whatever the scene asked for
+void Application::ApplyOptions ()
+{
+	if (mOptions.width && mOptions.height)
+		mBackbuffer.Resize(mOptions.width, mOptions.height);
+
+	if (mOptions.spp)
+		mRenderManager.SetSamplesPerPixel(mOptions.spp);
+}
+
+//=============================================================================
+// Every render manager is set up here, so single images, frames and watch
+// renders all follow the same command line. mRenderManager holds the samples
+// per pixel the scene and --samples settled on.
+void Application::SetupRenderManager (RT::RenderManager * renderManager, RT::CAccumulationBuffer * accumulation)
+{
+	renderManager->SetSamplesPerPixel(mRenderManager.GetSamplesPerPixel());
+	renderManager->SetThreadCount(mOptions.threads);
+	renderManager->SetAffinity(mOptions.affinity);
+	renderManager->SetTimeBudget(mOptions.timeBudget);
+	renderManager->SetPredictCost(mOptions.predictCost);
+	renderManager->SetSampleRange(mOptions.sampleBegin, mOptions.sampleEnd);
+	renderManager->SetJitter(!mOptions.noJitter);
+
+	if (accumulation)
+	{
+		accumulation->Resize(mBackbuffer.GetWidth(), mBackbuffer.GetHeight());
+		accumulation->Clear();
+		renderManager->SetAccumulationBuffer(accumulation);
+	}
+
+	if (mOptions.gbuffer)
+	{
+		mGBuffer.Resize(mBackbuffer.GetWidth(), mBackbuffer.GetHeight(), mOptions.noJitter ? 1 : mRenderManager.GetSamplesPerPixel());
+		renderManager->SetGBuffer(&mGBuffer);
+	}
+}
+
+//=============================================================================
+void Application::PrintStats (float32 loadTime, float32 renderTime, float32 saveTime) const
+{
+	const uint64 samples = mRenderManager.GetCompletedPixels() * mRenderManager.GetSampleCount();
+	const uint64 rays    = mRenderManager.GetCompletedRays();
+
+	std::cout
+		<< std::fixed
+		<< std::setprecision(3)
+		<< "{\"scene\":"             << JsonString(mOptions.scenePath)
+		<< ",\"output\":"            << JsonString(mOptions.outputPath)
+		<< ",\"width\":"             << mBackbuffer.GetWidth()
+		<< ",\"height\":"            << mBackbuffer.GetHeight()
+		<< ",\"spp\":"               << mRenderManager.GetSamplesPerPixel()
+		<< ",\"sample_begin\":"      << mRenderManager.GetSampleBegin()
+		<< ",\"sample_end\":"        << mRenderManager.GetSampleEnd()
+		<< ",\"threads\":"           << mRenderManager.GetThreadCount()
+		<< ",\"affinity\":"          << JsonString(RT::GetAffinityName(mRenderManager.GetAffinity()))
+		<< ",\"objects\":"           << mScene.mpObjects.size()
+		<< ",\"bvh_nodes\":"         << mScene.mBvh.GetNodeCount()
+		<< ",\"bvh_builder\":"       << JsonString(RT::GetBvhBuilderName(mScene.mBvhBuilder))
+		<< ",\"bvh_build_seconds\":" << mScene.mBvhBuildSeconds
+		<< ",\"bvh_sah_cost\":"      << mScene.mBvh.ComputeSahCost()
+		<< ",\"primary_rays_per_second\":" << mPrimaryRaysPerSecond
+		<< ",\"bvh_node_format\":"   << JsonString(RT::GetBvhNodesName(mBvhNodes))
+		<< ",\"bvh_quantized_meshes\":" << mQuantizedMeshes
+		<< ",\"bvh_quantize_seconds\":" << mQuantizeSeconds
+		<< ",\"bvh_memory_bytes\":"  << mScene.GetBvhMemorySize()
+		<< ",\"bvh_full_memory_bytes\":" << mBvhFullMemory
+		<< ",\"primary_rays_per_second_full\":" << (mBvhNodes == RT::BVH_NODES_QUANTIZED ? mPrimaryRaysPerSecondFull : mPrimaryRaysPerSecond)
+		<< ",\"scene_cache\":"       << JsonString(mSceneCache)
+		<< ",\"blocks_total\":"      << mRenderManager.GetTotalBlocks()
+		<< ",\"blocks_completed\":"  << mRenderManager.GetCompletedBlocks()
+		<< ",\"complete\":"          << (mRenderManager.GetCompletedBlocks() == mRenderManager.GetTotalBlocks() ? "true" : "false")
+		<< ",\"cancelled\":"         << (mRenderManager.IsCancelled() ? "true" : "false")
+		<< ",\"samples\":"           << samples
+		<< ",\"load_seconds\":"      << loadTime
+		<< ",\"render_seconds\":"    << renderTime
+		<< ",\"predict_seconds\":"   << mRenderManager.GetPredictSeconds()
+		<< ",\"save_seconds\":"      << saveTime
+		<< ",\"samples_per_second\":" << (renderTime > 0.0f ? samples / renderTime : 0.0f)
+		<< ",\"rays\":"              << rays
+		<< ",\"rays_per_second\":"   << (renderTime > 0.0f ? rays / renderTime : 0.0f)
+		<< ",\"gbuffer_bytes\":"     << (mOptions.gbuffer ? mGBuffer.GetMemorySize() : 0)
+		<< ",\"peak_rss_bytes\":"    << GetPeakResidentBytes();
+
+#if RT_STATS
+	RT::RenderStats stats;
+	mRenderManager.GetStats(&stats);
+
+	std::cout << ",\"stats\":";
+	RT::WriteRenderStatsJson(std::cout, stats, renderTime);
+#endif
+
+	std::cout
+		<< "}"
+		<< std::endl;
+}
+
+//=============================================================================
+// frame.tga becomes frame_0000.tga, frame_0001.tga, ...
+static std::string GetFramePath (const std::string & path, uint frame)
+{
+	const size_t separator = path.find_last_of("/\\");
+	const size_t dot       = path.find_last_of('.');
+	const size_t extension = dot != std::string::npos && (separator == std::string::npos || dot > separator) ? dot : path.size();
+
+	char suffix[16];
+	snprintf(suffix, sizeof(suffix), "_%04u", frame);
+
+	return path.substr(0, extension) + suffix + path.substr(extension);
+}
+
+//=============================================================================
+// The scene is read once and every frame only moves its instances, so what a frame costs on top
+// of tracing it is the bvh update, which is reported on its own
+int Application::RenderFrames(float32 loadTime)
+{
+	if (!mScene.IsAnimated())
+		std::cerr << "'" << mOptions.scenePath << "' has no keyframes, every frame will be the same" << std::endl;
+
+	float64 updateTotal = 0.0;
+	float64 renderTotal = 0.0;
+	float64 saveTotal   = 0.0;
+	uint    updates[3]  = { 0, 0, 0 };
+	bool    bCancelled  = false;
+
+	SetRenderSignals(true);
+
+	for (uint frame = mOptions.frameBegin; frame < mOptions.frameEnd && !bCancelled; ++frame)
+	{
+		const Time::Point updateTick = Time::GetRealTime();
+
+		const RT::EBvhUpdate update = mScene.SetFrame(float32(frame));
+		++updates[update];
+
+		const Time::Point startTick = Time::GetRealTime();
+
+		// Render managers run once
+		RT::RenderManager renderManager(mScene, mCamera, mBackbuffer);
+		SetupRenderManager(&renderManager, mOptions.accumulationPath ? &mAccumulation : null);
+
+		// Primary hits of the last frame are wherever its instances were
+		if (mOptions.gbuffer)
+			mGBuffer.Clear();
+
+		renderManager.Start();
+
+		while (!renderManager.WaitForProgress(SIGNAL_POLL_SECONDS))
+		{
+			if (s_cancelRequested && !renderManager.IsCancelled())
+				renderManager.Cancel();
+		}
+
+		bCancelled = renderManager.IsCancelled();
+		if (bCancelled)
+			std::cerr << "Cancelled, writing the completed blocks of frame " << frame << std::endl;
+
+		const Time::Point saveTick = Time::GetRealTime();
+
+		const std::string path = GetFramePath(mOptions.outputPath, frame);
+		{
+			RT::TraceScope trace(RT::TRACE_SAVE_IMAGE);
+			if (!mBackbuffer.Save(path.c_str()))
+			{
+				std::cerr << "Failed to write '" << path << "'" << std::endl;
+				SetRenderSignals(false);
+				return 2;
+			}
+		}
+
+		if (mOptions.accumulationPath)
+		{
+			RT::SampleRange range;
+			range.total = renderManager.GetSamplesPerPixel();
+			range.begin = renderManager.GetSampleBegin();
+			range.end   = renderManager.GetSampleEnd();
+
+			const std::string accumulationPath = GetFramePath(mOptions.accumulationPath, frame);
+			if (!mAccumulation.Save(accumulationPath.c_str(), range))
+			{
+				std::cerr << "Failed to write '" << accumulationPath << "'" << std::endl;
+				SetRenderSignals(false);
+				return 2;
+			}
+		}
+
+		const Time::Point endTick = Time::GetRealTime();
+
+		const float32 updateTime = (startTick - updateTick).GetSeconds();
+		const float32 renderTime = (saveTick - startTick).GetSeconds();
+		const float32 saveTime   = (endTick - saveTick).GetSeconds();
+		const uint64  samples    = renderManager.GetCompletedPixels() * renderManager.GetSampleCount();
+
+		updateTotal += updateTime;
+		renderTotal += renderTime;
+		saveTotal   += saveTime;
+
+		if (mOptions.headless)
+		{
+			std::cout
+				<< std::fixed
+				<< std::setprecision(4)
+				<< "{\"frame\":"               << frame
+				<< ",\"output\":"              << JsonString(path.c_str())
+				<< ",\"bvh_update\":"          << JsonString(RT::GetBvhUpdateName(update))
+				<< ",\"bvh_sah_cost\":"        << mScene.mBvh.ComputeSahCost()
+				<< ",\"update_seconds\":"      << updateTime
+				<< ",\"render_seconds\":"      << renderTime
+				<< ",\"save_seconds\":"        << saveTime
+				<< ",\"samples_per_second\":"  << (renderTime > 0.0f ? samples / renderTime : 0.0f)
+				<< "}"
+				<< std::endl;
+		}
+		else
+		{
+			std::cout
+				<< "Frame " << frame
+				<< " (" << RT::GetBvhUpdateName(update) << " "
+				<< std::fixed << std::setprecision(1) << updateTime * 1000.0f << "ms) "
+				<< ToTime(saveTick - startTick)
+				<< std::endl;
+		}
+	}
+
+	if (mOptions.headless)
+	{
+		std::cout
+			<< std::fixed
+			<< std::setprecision(4)
+			<< "{\"scene\":"              << JsonString(mOptions.scenePath)
+			<< ",\"frames\":"             << mOptions.frameEnd - mOptions.frameBegin
+			<< ",\"objects\":"            << mScene.mpObjects.size()
+			<< ",\"animated\":"           << mScene.mTracks.size()
+			<< ",\"load_seconds\":"       << loadTime
+			<< ",\"update_seconds\":"     << updateTotal
+			<< ",\"render_seconds\":"     << renderTotal
+			<< ",\"save_seconds\":"       << saveTotal
+			<< ",\"refits\":"             << updates[RT::BVH_UPDATE_REFIT]
+			<< ",\"partial_rebuilds\":"   << updates[RT::BVH_UPDATE_PARTIAL]
+			<< ",\"rebuilds\":"           << updates[RT::BVH_UPDATE_REBUILD]
+			<< ",\"cancelled\":"          << (bCancelled ? "true" : "false")
+			<< "}"
 			<< std::endl;
+	}
+
+	SetRenderSignals(false);
+
+	// Frames up to the cancelled one are written, but the caller has to know the rest are missing
+	return bCancelled ? 3 : 0;
+}
+
+//=============================================================================
+static bool SameMaterial (const RT::Material & a, const RT::Material & b)
+{
+	return
+		a.type == b.type &&
+		a.diffuse.r == b.diffuse.r && a.diffuse.g == b.diffuse.g && a.diffuse.b == b.diffuse.b &&
+		a.emissive.r == b.emissive.r && a.emissive.g == b.emissive.g && a.emissive.b == b.emissive.b;
+}
+
+//=============================================================================
+// Every change to the scene file is found by its hash. When the file hashes the
+// same without its materials, only the materials are read again and the objects,
+// their hierarchies and the G-buffer, with --gbuffer, are kept. The material
+// mask records which materials every pixel's paths touched. Pixels whose paths
+// never touched a changed material come out exactly as before, so they are
+// copied from the last render. A new material type can change what rays hit, refractive meshes
+// are two sided, so it costs a render of every pixel but still no reload. Any
+// other change reloads the scene. Runs until SIGINT or SIGTERM.
+int Application::RunWatch()
+{
+	const char * scenePath = mOptions.scenePath;
 
-        mRenderManager.WaitForProgress();
+	uint64 sourceHash   = 0;
+	uint64 geometryHash = 0;
+	RT::HashSceneSource(scenePath, &sourceHash);
+	RT::HashSceneWithoutMaterials(scenePath, &geometryHash);
+
+	RT::CAccumulationBuffer previous;
+	RT::CAccumulationBuffer current;
+	RT::MaterialMask        materialMask;
+	uint32                  materialCount    = mScene.IndexMaterials();
+	uint64                  changedMaterials = 0;
+	bool                    bReuse           = false;
+	bool                    bLoaded          = true;
+
+	SetRenderSignals(true);
+
+	while (!s_cancelRequested)
+	{
+		if (bLoaded)
+		{
+			materialMask.Resize(mBackbuffer.GetWidth(), mBackbuffer.GetHeight());
+
+			const Time::Point startTick = Time::GetRealTime();
+
+			// Render managers run once
+			RT::RenderManager renderManager(mScene, mCamera, mBackbuffer);
+			SetupRenderManager(&renderManager, &current);
+			renderManager.SetMaterialMask(&materialMask);
+
+			if (bReuse)
+				renderManager.SetReuse(&previous, changedMaterials);
+			renderManager.Start();
+
+			while (!renderManager.WaitForProgress(SIGNAL_POLL_SECONDS))
+			{
+				if (s_cancelRequested && !renderManager.IsCancelled())
+					renderManager.Cancel();
+			}
+
+			if (renderManager.IsCancelled())
+				break;
+
+			const float32 renderTime = (Time::GetRealTime() - startTick).GetSeconds();
+			const uint64  pixels     = renderManager.GetCompletedPixels();
+			const uint64  reused     = renderManager.GetReusedPixels();
+			const float32 reuseRate  = pixels ? float32(float64(reused) / float64(pixels)) : 0.0f;
+
+			{
+				RT::TraceScope trace(RT::TRACE_SAVE_IMAGE);
+				if (!mBackbuffer.Save(mOptions.outputPath))
+				{
+					std::cerr << "Failed to write '" << mOptions.outputPath << "'" << std::endl;
+					SetRenderSignals(false);
+					return 2;
+				}
+			}
+
+			if (mOptions.headless)
+			{
+				std::cout
+					<< std::fixed
+					<< std::setprecision(4)
+					<< "{\"output\":"          << JsonString(mOptions.outputPath)
+					<< ",\"render_seconds\":"  << renderTime
+					<< ",\"pixels\":"          << pixels
+					<< ",\"reused_pixels\":"   << reused
+					<< ",\"reuse_rate\":"      << reuseRate
+					<< ",\"materials\":"       << materialCount
+					<< ",\"gbuffer_bytes\":"   << mGBuffer.GetMemorySize()
+					<< ",\"material_mask_bytes\":" << materialMask.GetMemorySize()
+					<< "}"
+					<< std::endl;
+			}
+			else
+			{
+				std::cout
+					<< "[watch] " << ToTime(renderTime) << ", "
+					<< pixels - reused << " of " << pixels << " pixels rendered, "
+					<< std::fixed << std::setprecision(1) << reuseRate * 100.0f << "% reused" << std::endl;
+			}
+
+			std::swap(previous, current);
+			bLoaded = false;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		uint64 hash;
+		if (!RT::HashSceneSource(scenePath, &hash) || hash == sourceHash)
+			continue;
+
+		sourceHash = hash;
+
+		const Time::Point reloadTick = Time::GetRealTime();
+
+		std::vector<RT::Material> materials;
+		if (
+			RT::HashSceneWithoutMaterials(scenePath, &hash) && hash == geometryHash &&
+			RT::LoadSceneMaterials(scenePath, &materials) && materials.size() == mScene.mpObjects.size()
+		) {
+			uint32 changed   = 0;
+			bool   bNewTypes = false;
+			changedMaterials = 0;
+
+			for (uint32 i = 0; i < materials.size(); ++i)
+			{
+				const RT::Object *   object = mScene.mpObjects[i];
+				const RT::Material & before = object->GetMaterial();
+				const RT::Material & after  = materials[i];
+				if (SameMaterial(before, after))
+					continue;
+
+				++changed;
+				bNewTypes        |= before.type != after.type;
+				changedMaterials |= RT::GetMaterialBit(object->GetMaterialIndex());
+				mScene.SetMaterial(i, after);
+			}
+
+			if (!changed)
+				continue;
+
+			// Nothing is reused, so the materials can be numbered again
+			if (bNewTypes)
+			{
+				materialCount = mScene.IndexMaterials();
+				mGBuffer.Clear();
+				materialMask.Clear();
+			}
+
+			bReuse  = !bNewTypes;
+			bLoaded = true;
+
+			if (!mOptions.headless)
+			{
+				std::cout
+					<< "[watch] " << changed << (changed == 1 ? " material" : " materials") << " changed, read in "
+					<< std::fixed << std::setprecision(1) << (Time::GetRealTime() - reloadTick).GetSeconds() * 1000.0f << "ms"
+					<< (bNewTypes ? ", a type changed so every pixel is rendered" : "")
+					<< std::endl;
+			}
+		}
+		else
+		{
+			mScene.Clear();
+			bLoaded = TrySceneFromFile(scenePath);
+			if (!bLoaded)
+			{
+				// Often a file still being written, the next change will load
+				std::cerr << "Failed to load scene '" << scenePath << "'" << std::endl;
+				continue;
+			}
+
+			if (mBvhNodes == RT::BVH_NODES_QUANTIZED)
+				mScene.QuantizeMeshBvhs();
+
+			RT::HashSceneWithoutMaterials(scenePath, &geometryHash);
+			materialCount = mScene.IndexMaterials();
+			mGBuffer.Clear();
+			materialMask.Clear();
+			bReuse = false;
+
+			if (!mOptions.headless)
+			{
+				std::cout
+					<< "[watch] scene reloaded in " << std::fixed << std::setprecision(1)
+					<< (Time::GetRealTime() - reloadTick).GetSeconds() * 1000.0f << "ms" << std::endl;
+			}
+		}
 	}
-    
-    char filename[64];
-    strncpy_s(filename, "Image - " __DATE__ " - " __TIME__ ".tga", 64);
-    find_replace(filename, ':', '_');
 
-    mBackbuffer.Save(filename);
+	// Stopping is the only way out short of a failed write, so it is not a failure
+	SetRenderSignals(false);
+	return 0;
 }
 
 //=============================================================================
-bool Application::TrySceneFromFile ()
+// Commands are read from stdin, one per line:
+//
+//   eye x y z | lookat x y z | up x y z   Moves the camera
+//   orbit <degrees>                       Turns the eye about the up axis through lookat
+//   dolly <factor>                        Scales the distance from the eye to lookat
+//   save <file>                           Writes the image as it is now
+//   quit
+//
+// Every pass overwrites the preview image, through a rename so viewers never see half a file. The
+// preview ends on quit, or once stdin is closed and every sample is in.
+int Application::RunPreview()
 {
-    using namespace Json;
+	const std::string preview   = mOptions.previewPath;
+	const std::string temporary = preview + ".tmp.tga";
 
-    CDocument doc;
-    doc.Parse("scene.json");
+	RT::RenderScheduler scheduler(mOptions.threads, mOptions.affinity);
+	RT::PreviewSession  session(mScene, mBackbuffer.GetWidth(), mBackbuffer.GetHeight(), mRenderManager.GetSamplesPerPixel(), scheduler);
+	session.SetSampling(!mOptions.noJitter, mOptions.gbuffer);
+	session.SetCamera(mSceneSettings.camera);
 
-    if (!doc.IsValid())
-        return false;
+	// Shared with the reader, which outlives the preview when a failed write ends it
+	struct Input
+	{
+		std::mutex              lock;
+		std::condition_variable commandReady;
+		std::deque<std::string> commands;
+		bool                    bClosed = false;
+	};
+	const std::shared_ptr<Input> input = std::make_shared<Input>();
 
-    const CValue & root = doc.GetValue();
-    if (root.GetType() != EType::Object)
-        return false;
-    
-    // Settings
-    breakable_scope
-    {
-        const CValue & settings = root[{"settings"}];
-        if (settings == null)
-            break;
-
-        // Size
-        breakable_scope
-        {
-            const CValue & jsonSize = settings[{"size"}];
-            if (jsonSize == null)
-                break;
-
-            Vector2 size;
-            if (!ParseVector2(jsonSize, &size))
-                break;
-
-            mBackbuffer.Resize(
-                FloatToUint(float32(size.x)),
-                FloatToUint(float32(size.y))
-            );
-        }
-
-        // Samples
-        breakable_scope
-        {
-            const CValue & samplesValue = settings[{"samples"}];
-            if (samplesValue == null)
-                break;
-
-            const auto * samples = samplesValue.As<NumberType>();
-            if (!samples)
-                break;
-
-            const uint spp = FloatToUint(*samples);
-            mRenderManager.SetSamplesPerPixel(spp);
-        }
-
-        // Background
-        mScene.SetBackgroundColor(Color::Black);
-        breakable_scope
-        {
-            const CValue & jsonBg = settings[{"background"}];
-            if (jsonBg == null)
-                break;
-            
-            Color color;
-            if (!ParseColor(jsonBg, &color))
-                break;
-
-            mScene.SetBackgroundColor(color);
-        }
-    }
-    
-    // Camera
-    breakable_scope
+	std::thread reader([input] {
+		std::string line;
+		while (std::getline(std::cin, line) && line != "quit")
+		{
+			std::lock_guard<std::mutex> guard(input->lock);
+			input->commands.push_back(line);
+			input->commandReady.notify_one();
+		}
+
+		std::lock_guard<std::mutex> guard(input->lock);
+		input->commands.push_back(std::cin ? "quit" : "");
+		input->bClosed = true;
+		input->commandReady.notify_one();
+	});
+
+	int  result = 0;
+	bool bQuit  = false;
+	while (!bQuit)
+	{
+		// A pass in flight is waited on, otherwise there is nothing to do but wait for a command
+		if (session.Update(SIGNAL_POLL_SECONDS))
+		{
+			if (!session.GetImage().Save(temporary.c_str()) || std::rename(temporary.c_str(), preview.c_str()) != 0)
+			{
+				// Still waiting on stdin, the reader is left to the process exit
+				std::cerr << "Failed to write '" << preview << "'" << std::endl;
+				reader.detach();
+				return 2;
+			}
+
+			std::cout << "[preview] ";
+			if (session.GetSamples())
+				std::cout << session.GetSamples() << "/" << mRenderManager.GetSamplesPerPixel() << " spp";
+			else
+				std::cout << "first image in " << std::fixed << std::setprecision(1) << session.GetFirstImageSeconds() * 1000.0f << "ms";
+			std::cout << std::endl;
+		}
+
+		std::deque<std::string> pending;
+		{
+			std::unique_lock<std::mutex> guard(input->lock);
+			if (session.IsConverged() && input->commands.empty())
+			{
+				if (input->bClosed)
+					break;
+
+				input->commandReady.wait(guard);
+			}
+
+			pending.swap(input->commands);
+		}
+
+		RT::CameraDesc camera = session.GetCamera();
+		bool bMoved = false;
+
+		for (const std::string & line : pending)
+		{
+			std::istringstream in(line);
+			std::string command;
+			in >> command;
+
+			Vector3 v;
+			float32 f = 0.0f;
+			if (command.empty())
+				continue;
+			else if (command == "quit")
+				bQuit = true;
+			else if (command == "eye" && in >> v.x >> v.y >> v.z)
+				camera.eye = Point3(v), bMoved = true;
+			else if (command == "lookat" && in >> v.x >> v.y >> v.z)
+				camera.lookat = Point3(v), bMoved = true;
+			else if (command == "up" && in >> v.x >> v.y >> v.z)
+				camera.up = v, bMoved = true;
+			else if (command == "orbit" && in >> f)
+			{
+				// Rodrigues' rotation of the view vector about up
+				const Vector3 k     = Normalize(camera.up);
+				const Vector3 view  = Vector3(camera.eye) - Vector3(camera.lookat);
+				const Radian  angle(f * Math::Pi / 180.0f);
+				const Vector3 turned = view * Cos(angle) + Cross(k, view) * Sin(angle) + k * Dot(k, view) * (1.0f - Cos(angle));
+
+				camera.eye = Point3(Vector3(camera.lookat) + turned);
+				bMoved = true;
+			}
+			else if (command == "dolly" && in >> f && f > 0.0f)
+			{
+				camera.eye = Point3(Vector3(camera.lookat) + (Vector3(camera.eye) - Vector3(camera.lookat)) * f);
+				bMoved = true;
+			}
+			else if (command == "save" && in >> std::ws && in.peek() != EOF)
+			{
+				std::string path;
+				std::getline(in, path);
+
+				// The preview goes on, but a save that was asked for and lost is not a success
+				if (!session.GetImage().Save(path.c_str()))
+				{
+					std::cerr << "Failed to write '" << path << "'" << std::endl;
+					result = 2;
+				}
+			}
+			else
+				std::cerr << "Unknown preview command '" << line << "'" << std::endl;
+		}
+
+		if (bMoved && !bQuit)
+			session.SetCamera(camera);
+	}
+
+	reader.join();
+	return result;
+}
+
+//=============================================================================
+// Traces a ray through the center of every pixel until a quarter of a second has passed, on this
+// thread only so the number reflects the hierarchy rather than the machine's width
+float32 Application::MeasurePrimaryRays () const
+{
+	const uint width  = mBackbuffer.GetWidth();
+	const uint height = mBackbuffer.GetHeight();
+
+	const Time::Point start = Time::GetRealTime();
+
+	uint64  rays    = 0;
+	float32 seconds = 0.0f;
+	while (seconds < 0.25f)
+	{
+		for (uint y = 0; y < height; ++y)
+		{
+			for (uint x = 0; x < width; ++x)
+			{
+				const float32 u = 2.0f * (x + 0.5f) / width - 1.0f;
+				const float32 v = 2.0f * (y + 0.5f) / height - 1.0f;
+
+				const RT::Object * pObject;
+				RT::Result         result;
+				mScene.FindObject(pObject, result, mCamera.GetRay(u, v));
+			}
+		}
+
+		rays   += uint64(width) * height;
+		seconds = (Time::GetRealTime() - start).GetSeconds();
+	}
+
+	return rays / seconds;
+}
+
+//=============================================================================
+bool Application::TrySceneFromFile (const char * filename)
+{
+    RT::SceneSettings & settings = mSceneSettings;
+    if (mOptions.sceneCache)
     {
-        const CValue & jsonCamera = root[{"camera"}];
-        if (jsonCamera == null)
+        bool hit;
+        if (!RT::LoadSceneCached(filename, mOptions.sceneCache, &mScene, &settings, &hit))
             return false;
-         
-        const float32 aspect = mBackbuffer.GetWidth() / float32(mBackbuffer.GetHeight());
-        mCamera.Setup(jsonCamera, aspect);
-    }
 
-    //Objects
-    breakable_scope
+        mSceneCache = hit ? "hit" : "miss";
+    }
+    else if (!RT::LoadScene(filename, &mScene, &settings))
     {
-        const CValue & jsonObjects = root[{"objects"}];
-        if (jsonObjects == null)
-            break;
+        return false;
+    }
 
-        if (jsonObjects.GetType() != EType::Array)
-            break;
+    if (settings.width && settings.height)
+        mBackbuffer.Resize(settings.width, settings.height);
 
-        for (const CValue & jsonObject : *jsonObjects.As<ArrayType>())
-        {
-            if (jsonObject.GetType() != EType::Object)
-                continue;
+    if (settings.spp)
+        mRenderManager.SetSamplesPerPixel(settings.spp);
 
-            RT::Object * object = RT::ParseObject(jsonObject);
-            if (!object)
-                continue;
+    ApplyOptions();
 
-            mScene.AddObject(object);
-        }
-    }
+    const float32 aspect = mBackbuffer.GetWidth() / float32(mBackbuffer.GetHeight());
+    mCamera.Setup(settings.camera, aspect);
 
     return true;
 }
@@ -338,16 +1136,17 @@ void Application::SceneCreateWalls()
 		mScene.AddObject(pObject);
 	}
 
-	// Camera
+	// Camera, kept in the settings so a preview can start from it
 	{
+		RT::CameraDesc & camera = mSceneSettings.camera;
+		camera.eye      = Point3(0.0f, -2.5f * WALL_EXTENTS.y, WALL_EXTENTS.z * 0.2f);
+		camera.lookat   = Point3(0.0f, 0.0f, 0.0f);
+		camera.up       = Vector3::UnitZ;
+		camera.distance = 1.0f;
+		camera.width    = 1.0f;
+
 		const float32 aspect = mBackbuffer.GetWidth() / (float32)mBackbuffer.GetHeight();
-		mCamera.Setup(
-            Vector3(0.0f, -2.5f * WALL_EXTENTS.y, WALL_EXTENTS.z * 0.2f),
-            Vector3::Zero,
-            Vector3::UnitZ,
-            1.0f,
-            1.0f,
-            aspect);
+		mCamera.Setup(camera, aspect);
 	}
 
 }
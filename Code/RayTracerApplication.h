@@ -2,25 +2,43 @@
 class Application : public System::CWindowNotify
 {
 public:
-	Application();
+	Application(const RenderOptions & options);
 	~Application();
 
-	void Run();
+	int Run();
     
 private:
 
 	// Data
-	RT::CImage        mBackbuffer;
-	System::IWindow * mWindow;
-	uint              mFrameTime;
-	uint              mAveFrameTime;
-	RT::Camera		  mCamera;
-	RT::Scene		  mScene;
-	RT::RenderManager mRenderManager;
+	RenderOptions           mOptions;
+	RT::CImage              mBackbuffer;
+	RT::CAccumulationBuffer mAccumulation;
+	RT::GBuffer             mGBuffer;
+	System::IWindow *       mWindow;
+	uint                    mFrameTime;
+	uint                    mAveFrameTime;
+	RT::Camera              mCamera;
+	RT::Scene               mScene;
+	RT::SceneSettings       mSceneSettings;
+	const char *            mSceneCache;	// "hit" or "miss" when loaded through --scene-cache
+	float32                 mPrimaryRaysPerSecond;	// Measured by --bvh-bench
+	RT::EBvhNodes           mBvhNodes;
+	uint32                  mQuantizedMeshes;
+	float32                 mQuantizeSeconds;
+	uint64                  mBvhFullMemory;			// Before quantizing
+	float32                 mPrimaryRaysPerSecondFull;	// Measured by --bvh-bench before quantizing
+	RT::RenderManager       mRenderManager;
 
 	// Helpers
 	void SceneCreateReddit();
 	void SceneCreateSpheres();
 	void SceneCreateWalls();
-    bool TrySceneFromFile();
+    bool TrySceneFromFile(const char * filename);
+	void ApplyOptions();
+	void SetupRenderManager(RT::RenderManager * renderManager, RT::CAccumulationBuffer * accumulation);
+	float32 MeasurePrimaryRays() const;
+	int RenderFrames(float32 loadTime);
+	int RunPreview();
+	int RunWatch();
+	void PrintStats(float32 loadTime, float32 renderTime, float32 saveTime) const;
 };
\ No newline at end of file
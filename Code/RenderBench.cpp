@@ -0,0 +1,312 @@
+//==================================================================================================
+//
+// File:	RenderBench.cpp
+//
+// End to end render benchmark.
+//
+//=================================================================================================
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Pch.h"
+
+const uint   BENCH_WIDTH  = 256;
+const uint   BENCH_HEIGHT = 192;
+const uint   BENCH_SPP    = 16;
+const uint32 BENCH_SEED   = 1;
+
+
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+//=============================================================================
+struct BenchScene
+{
+	std::string name;
+	std::string path;	// Empty for the built-in scenes
+};
+
+//=============================================================================
+// What the stats of one render say, see Application::PrintStats
+struct BenchRun
+{
+	uint    threads;
+	float64 wallSeconds;	// Measured around the whole process
+	float64 loadSeconds;
+	float64 renderSeconds;
+	float64 samples;
+	float64 rays;
+	float64 peakRss;
+	float64 objects;
+};
+
+//=============================================================================
+static bool FileExists (const char * filename)
+{
+	FILE * file = fopen(filename, "rb");
+	if (!file)
+		return false;
+
+	fclose(file);
+	return true;
+}
+
+//=============================================================================
+static float64 GetNumber (const Json::CValue & json, const char * key)
+{
+	const Json::CValue & value = json[{key}];
+	return value.GetType() == Json::EType::Number ? *value.As<Json::NumberType>() : 0.0;
+}
+
+//=============================================================================
+// Writes the sphere field of count spheres as a binary scene unless an earlier run already did
+static bool PrepareSphereField (uint32 count, const std::string & path)
+{
+	if (RT::IsBinaryScene(path.c_str()))
+		return true;
+
+	std::cout << "Generating " << path << std::endl;
+
+	RT::StressSceneDesc desc;
+	desc.kind  = RT::STRESS_SCENE_SPHERES;
+	desc.count = count;
+	desc.seed  = BENCH_SEED;
+
+	RT::Scene         scene;
+	RT::SceneSettings settings;
+	RT::GenerateStressScene(desc, &scene, &settings);
+	return RT::SaveBinaryScene(path.c_str(), scene, settings, 0);
+}
+
+//=============================================================================
+// Renders scene in a child process of this executable, whose stats go to statsPath
+static bool RunRender (
+	const RenderOptions & options,
+	const BenchScene &    scene,
+	uint                  threads,
+	const std::string &   statsPath,
+	BenchRun *            out
+) {
+#if !defined(_WIN32)
+	char threadsArg[16];
+	char sizeArg[32];
+	char sppArg[16];
+	snprintf(threadsArg, sizeof(threadsArg), "%u", threads);
+	snprintf(sizeArg, sizeof(sizeArg), "%ux%u", options.width ? options.width : BENCH_WIDTH, options.height ? options.height : BENCH_HEIGHT);
+	snprintf(sppArg, sizeof(sppArg), "%u", options.spp ? options.spp : BENCH_SPP);
+
+	std::vector<const char *> args = {
+		"RayTracer",
+		"--headless",
+		"--threads", threadsArg,
+		"--size", sizeArg,
+		"--spp", sppArg,
+		"--bvh", RT::GetBvhBuilderName(options.bvhBuilder),
+		"--affinity", RT::GetAffinityName(options.affinity),
+		"--output", "/dev/null",
+	};
+
+	if (!scene.path.empty())
+	{
+		args.push_back("--scene");
+		args.push_back(scene.path.c_str());
+	}
+
+	args.push_back(null);
+
+	const Time::Point startTick = Time::GetRealTime();
+
+	const pid_t pid = fork();
+	if (pid < 0)
+		return false;
+
+	if (pid == 0)
+	{
+		const int stats = open(statsPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (stats < 0 || dup2(stats, STDOUT_FILENO) < 0)
+			_exit(127);
+
+		execv("/proc/self/exe", (char * const *)args.data());
+		_exit(127);
+	}
+
+	int status;
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status))
+		return false;
+
+	out->wallSeconds = (Time::GetRealTime() - startTick).GetSeconds();
+
+	Json::CDocument doc;
+	doc.Parse(statsPath.c_str());
+	remove(statsPath.c_str());
+	if (!doc.IsValid())
+		return false;
+
+	const Json::CValue & stats = doc.GetValue();
+	out->threads       = threads;
+	out->loadSeconds   = GetNumber(stats, "load_seconds");
+	out->renderSeconds = GetNumber(stats, "render_seconds");
+	out->samples       = GetNumber(stats, "samples");
+	out->rays          = GetNumber(stats, "rays");
+	out->peakRss       = GetNumber(stats, "peak_rss_bytes");
+	out->objects       = GetNumber(stats, "objects");
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+int RunRenderBenchmarks (const RenderOptions & options)
+{
+	// results.json puts its scenes in results_spheres_1k.scene, ...
+	const std::string output    = options.renderBench;
+	const size_t      separator = output.find_last_of("/\\");
+	const size_t      dot       = output.find_last_of('.');
+	const std::string prefix    = output.substr(0, dot != std::string::npos && (separator == std::string::npos || dot > separator) ? dot : output.size());
+
+	// Procedural scenes are kept for the next run
+	std::vector<BenchScene> scenes;
+	scenes.push_back({ "builtin", "" });
+
+	const char * sceneFile = options.scenePath ? options.scenePath : "scene.json";
+	if (FileExists(sceneFile))
+		scenes.push_back({ sceneFile, sceneFile });
+	else
+		std::cerr << "'" << sceneFile << "' not found, skipped" << std::endl;
+
+	const struct { const char * name; uint32 count; } fields[] = {
+		{ "spheres_1k",   1000    },
+		{ "spheres_100k", 100000  },
+		{ "spheres_1m",   1000000 },
+	};
+
+	for (const auto & field : fields)
+	{
+		const std::string path = prefix + "_" + field.name + ".scene";
+		if (!PrepareSphereField(field.count, path))
+		{
+			std::cerr << "Failed to write '" << path << "'" << std::endl;
+			return 2;
+		}
+
+		scenes.push_back({ field.name, path });
+	}
+
+	// 1, 2, 4, ... up to every logical processor, or --threads
+	const uint maxThreads = options.threads ? options.threads : Max<uint>(1, ThreadLogicalProcessorCount());
+
+	std::vector<uint> threadCounts;
+	for (uint threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	std::ofstream out(output);
+	if (!out)
+	{
+		std::cerr << "Failed to write '" << output << "'" << std::endl;
+		return 2;
+	}
+
+	out
+		<< std::fixed
+		<< std::setprecision(4)
+		<< "{\"version\":1"
+		<< ",\"time\":"               << uint64(time(null))
+		<< ",\"logical_processors\":" << ThreadLogicalProcessorCount()
+		<< ",\"width\":"              << (options.width ? options.width : BENCH_WIDTH)
+		<< ",\"height\":"             << (options.height ? options.height : BENCH_HEIGHT)
+		<< ",\"spp\":"                << (options.spp ? options.spp : BENCH_SPP)
+		<< ",\"bvh_builder\":"        << JsonString(RT::GetBvhBuilderName(options.bvhBuilder))
+		<< ",\"affinity\":"           << JsonString(RT::GetAffinityName(options.affinity))
+		<< ",\"scenes\":[";
+
+	const std::string statsPath = prefix + "_stats.json";
+	for (size_t s = 0; s < scenes.size(); ++s)
+	{
+		const BenchScene & scene = scenes[s];
+
+		std::vector<BenchRun> runs;
+		for (uint threads : threadCounts)
+		{
+			BenchRun run;
+			if (!RunRender(options, scene, threads, statsPath, &run))
+			{
+				std::cerr << "Failed to render '" << scene.name << "' with " << threads << " threads" << std::endl;
+				return 2;
+			}
+
+			runs.push_back(run);
+		}
+
+		// Speedup over one thread per thread, 1 being perfect scaling
+		const float64 baseRate = runs[0].renderSeconds > 0.0 ? runs[0].samples / runs[0].renderSeconds : 0.0;
+
+		out
+			<< (s ? "," : "")
+			<< "{\"name\":"    << JsonString(scene.name.c_str())
+			<< ",\"objects\":" << uint64(runs[0].objects)
+			<< ",\"runs\":[";
+
+		for (size_t r = 0; r < runs.size(); ++r)
+		{
+			const BenchRun & run        = runs[r];
+			const float64    samplesSec = run.renderSeconds > 0.0 ? run.samples / run.renderSeconds : 0.0;
+			const float64    raysSec    = run.renderSeconds > 0.0 ? run.rays / run.renderSeconds : 0.0;
+			const float64    efficiency = baseRate > 0.0 ? samplesSec / (baseRate * run.threads) : 0.0;
+
+			out
+				<< (r ? "," : "")
+				<< "{\"threads\":"            << run.threads
+				<< ",\"wall_seconds\":"       << run.wallSeconds
+				<< ",\"load_seconds\":"       << run.loadSeconds
+				<< ",\"render_seconds\":"     << run.renderSeconds
+				<< ",\"samples\":"            << uint64(run.samples)
+				<< ",\"rays\":"               << uint64(run.rays)
+				<< ",\"samples_per_second\":" << samplesSec
+				<< ",\"rays_per_second\":"    << raysSec
+				<< ",\"peak_rss_bytes\":"     << uint64(run.peakRss)
+				<< ",\"scaling_efficiency\":" << efficiency
+				<< "}";
+
+			std::cout
+				<< std::left << std::setw(16) << scene.name << std::right
+				<< std::setw(4)  << run.threads << " threads "
+				<< std::fixed << std::setprecision(2)
+				<< std::setw(9)  << run.wallSeconds << "s wall "
+				<< std::setprecision(0)
+				<< std::setw(12) << raysSec << " rays/s "
+				<< std::setw(10) << samplesSec << " samples/s "
+				<< std::setw(6)  << uint64(run.peakRss) / (1024 * 1024) << " MB "
+				<< std::setprecision(2)
+				<< std::setw(5)  << efficiency << " efficiency"
+				<< std::endl;
+		}
+
+		out << "]}";
+	}
+
+	out << "]}" << std::endl;
+	return out ? 0 : 2;
+}
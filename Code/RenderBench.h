@@ -0,0 +1,17 @@
+//==================================================================================================
+//
+// File:	RenderBench.h
+//
+// End to end render benchmark. A fixed set of scenes is rendered at a fixed size and sample count
+// with 1, 2, 4, ... threads, each render in a fresh process so its memory is its own, and the
+// results are written as one json document that can be tracked from build to build.
+//=================================================================================================
+#ifndef RENDERBENCH_H
+#define RENDERBENCH_H
+
+//! Renders the benchmark scenes and writes the results to options.renderBench, returns the
+//! process exit code. --scene replaces scene.json, --threads caps the thread counts and --size
+//! and --spp override the defaults.
+int RunRenderBenchmarks (const RenderOptions & options);
+
+#endif //RENDERBENCH_H
@@ -9,17 +9,60 @@
 //
 //=================================================================================================
 
+#include <algorithm>
+#include <atomic>
+
 #include "Pch.h"
 
 namespace RT
 {
 
 //=============================================================================
-RenderManager::RenderManager (Scene & scene, Camera & camera, CImage & backbuffer) :
+// Helpers
+//=============================================================================
+
+// Every this many pixels of a block are probed by the cost pre-pass
+static const uint COST_PROBE_STRIDE = 8;
+
+//=============================================================================
+// Black through red and yellow to white as t goes from 0 to 1
+static Color GetHeatColor (float32 t)
+{
+	return Color(
+		Min(Max(t * 3.0f, 0.0f), 1.0f),
+		Min(Max(t * 3.0f - 1.0f, 0.0f), 1.0f),
+		Min(Max(t * 3.0f - 2.0f, 0.0f), 1.0f)
+	);
+}
+
+
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+RenderManager::RenderManager (const Scene & scene, const Camera & camera, CImage & backbuffer) :
+	mpScheduler(null),
 	mScene(scene),
 	mCamera(camera),
 	mBackbuffer(backbuffer),
-	mSpp(100)
+	mAccumulation(null),
+	mpGBuffer(null),
+	mpMaterialMask(null),
+	mbJitter(true),
+	mpReuse(null),
+	mChangedMaterials(0),
+	mTotalBlocks(0),
+	mTotalPixels(0),
+	mSpp(100),
+	mSampleBegin(0),
+	mSampleEnd(0),
+	mThreadCount(0),
+	mAffinity(AFFINITY_NONE),
+	mTimeBudget(0.0f),
+	mbPredictCost(false),
+	mPredictSeconds(0.0f)
 {
 
 
@@ -28,52 +71,244 @@ RenderManager::RenderManager (Scene & scene, Camera & camera, CImage & backbuffe
 //=============================================================================
 RenderManager::~RenderManager ()
 {
+	StopRenderers();
+}
+
+//=============================================================================
+void RenderManager::StopRenderers ()
+{
+	// Paused renderers would never get to be joined
+	if (!IsDone())
+		Cancel();
+
+	if (mpScheduler)
+	{
+		mpScheduler->Remove(this);
+		mpScheduler = null;
+
+		for (auto renderer : mRenderers)
+			delete renderer;
+		mRenderers.clear();
+		return;
+	}
+
 	for (auto renderer : mRenderers) {
 		renderer->Stop();
         delete renderer;
     }
+	mRenderers.clear();
 }
 
 //=============================================================================
 void RenderManager::Start ()
 {
-	// Blocks
+	// The calling thread only waits for the renderers so it doesn't get a processor of its own
+	const uint numLogicProc = ThreadLogicalProcessorCount();
+	const uint numRenderers = mThreadCount ? mThreadCount : Max<uint>(1, numLogicProc);
+
+	Prepare(numRenderers);
+
+	const std::vector<uint32> placement = GetThreadPlacement(mAffinity, numRenderers);
+
+	for (uint i = 0; i < numRenderers; ++i)
 	{
-		const uint w = mBackbuffer.GetWidth();
-		const uint h = mBackbuffer.GetHeight();
-
-		mBlocks.reserve(h * 2);
-		for (uint i = h; i-- > 0; )
-		{
-			Block block1 = { 0, i, w/2, 1 };
-			Block block2 = { w/2, i, w/2, 1 };
-			mBlocks.push_back(block1);
-			mBlocks.push_back(block2);
-		}
+		if (!placement.empty())
+			mRenderers[i]->SetProcessor(placement[i]);
 
-		mTotalBlocks = uint(mBlocks.size());
+		mRenderers[i]->Start();
 	}
+}
+
+//=============================================================================
+void RenderManager::Start (RenderScheduler & scheduler, uint32 priority, float32 weight)
+{
+	ASSERT(!mpScheduler);
+
+	Prepare(scheduler.GetThreadCount());
+
+	mpScheduler = &scheduler;
+	scheduler.Add(this, priority, weight);
+}
+
+//=============================================================================
+void RenderManager::Prepare (uint renderers)
+{
+	mStartTime = Time::GetRealTime();
+
+	if (!mSampleEnd || mSampleEnd > mSpp)
+		mSampleEnd = mSpp;
+	if (mSampleBegin > mSampleEnd)
+		mSampleBegin = mSampleEnd;
 
-	// Renderers
+	mCostMap.assign(mBackbuffer.GetWidth() * mBackbuffer.GetHeight(), 0.0f);
+
+	ASSERT(!mpGBuffer || (
+		mpGBuffer->GetWidth() == mBackbuffer.GetWidth() &&
+		mpGBuffer->GetHeight() == mBackbuffer.GetHeight() &&
+		mpGBuffer->GetSamplesPerPixel() == (mbJitter ? mSpp : 1)));
+	ASSERT(!mpMaterialMask || (
+		mpMaterialMask->GetWidth() == mBackbuffer.GetWidth() &&
+		mpMaterialMask->GetHeight() == mBackbuffer.GetHeight()));
+	ASSERT(!mpReuse || mpMaterialMask);
+
+	CreateBlocks();
+
+	if (mbPredictCost)
+		PredictBlockCosts(renderers);
+
+	for (uint i = 0; i < renderers; ++i)
 	{
-		const uint numLogicProc = ThreadLogicalProcessorCount();
-		const uint numRenderers = Max<sint>(1, numLogicProc - 1);
+		Renderer * renderer = new Renderer(mScene, mCamera, mBackbuffer, *this);
+		renderer->SetSamplesPerPixel(mSpp);
+		renderer->SetSampleRange(mSampleBegin, mSampleEnd);
+		renderer->SetJitter(mbJitter);
+		renderer->SetGBuffer(mpGBuffer);
+		renderer->SetMaterialMask(mpMaterialMask);
+		renderer->SetReuse(mpReuse, mChangedMaterials);
+		mRenderers.push_back(renderer);
+	}
+}
 
-		for (uint i = 0; i < numRenderers; ++i)
-			mRenderers.push_back(new Renderer(mScene, mCamera, mBackbuffer, *this));
+//=============================================================================
+void RenderManager::CreateBlocks ()
+{
+	const uint w = mBackbuffer.GetWidth();
+	const uint h = mBackbuffer.GetHeight();
+
+	// The right half takes the odd column, a single column image has no left half
+	mBlocks.reserve(h * 2);
+	for (uint i = h; i-- > 0; )
+	{
+		Block block1 = { 0, i, w/2, 1 };
+		Block block2 = { w/2, i, w - w/2, 1 };
+		if (block1.width)
+			mBlocks.push_back(block1);
+		mBlocks.push_back(block2);
 	}
 
-	for (auto renderer : mRenderers)
+	mTotalBlocks = uint(mBlocks.size());
+	mTotalPixels = uint64(w) * h;
+}
+
+//=============================================================================
+// The pre-pass runs before any renderer starts, on as many threads as there
+// will be renderers, which pull blocks off a shared counter
+void RenderManager::PredictBlockCosts (uint threads)
+{
+	if (mBlocks.empty())
+		return;
+
+	const Time::Point start = Time::GetRealTime();
+
+	std::vector<float32> costs(mBlocks.size());
+	std::atomic<uint>    next{0};
+
+	ParallelFor(threads, [&](uint32) {
+		Renderer probe(mScene, mCamera, mBackbuffer, *this);
+		probe.SetSamplesPerPixel(mSpp);
+		probe.SetSampleRange(mSampleBegin, mSampleEnd);
+
+		for (uint i = next++; i < mBlocks.size(); i = next++)
+			costs[i] = probe.MeasureBlock(mBlocks[i], COST_PROBE_STRIDE);
+	});
+
+	// Blocks are handed out from the back, ties keep their order
+	std::vector<uint> order(mBlocks.size());
+	for (uint i = 0; i < order.size(); ++i)
+		order[i] = i;
+
+	std::stable_sort(order.begin(), order.end(), [&](uint a, uint b) { return costs[a] < costs[b]; });
+
+	BlockList sorted;
+	sorted.reserve(mBlocks.size());
+	for (uint i : order)
+		sorted.push_back(mBlocks[i]);
+
+	mBlocks.swap(sorted);
+
+	mPredictSeconds = (Time::GetRealTime() - start).GetSeconds();
+}
+
+//=============================================================================
+void RenderManager::RecordBlockCost (const Block & block, float32 seconds)
+{
+	const uint    width    = mBackbuffer.GetWidth();
+	const float32 perPixel = seconds / float32(block.width * block.height);
+
+	for (uint y = block.y; y < block.y + block.height; ++y)
+		std::fill_n(mCostMap.begin() + y * width + block.x, block.width, perPixel);
+}
+
+//=============================================================================
+bool RenderManager::SaveCostMap (const char * path) const
+{
+	const uint width  = mBackbuffer.GetWidth();
+	const uint height = mBackbuffer.GetHeight();
+
+	const float32 maxCost = mCostMap.empty() ? 0.0f : *std::max_element(mCostMap.begin(), mCostMap.end());
+	const float32 scale   = maxCost > 0.0f ? 1.0f / maxCost : 0.0f;
+
+	CImage image(width, height);
+	for (uint y = 0; y < height; ++y)
 	{
-		renderer->SetSamplesPerPixel(mSpp);
-		renderer->Start();
+		for (uint x = 0; x < width; ++x)
+			image.SetPixel(x, y, GetHeatColor(mCostMap[y * width + x] * scale));
 	}
+
+	return image.Save(path);
 }
 
 //=============================================================================
 bool RenderManager::IsDone ()
 {
-	return mCompletedBlocks == mTotalBlocks;
+	return mbDrained && mCompletedBlocks + mAbortedBlocks == mIssuedBlocks;
+}
+
+//=============================================================================
+void RenderManager::Cancel ()
+{
+    mLockBlocks.Enter();
+    mbCancelled = true;
+    mBlocks.clear();
+    mbDrained = true;
+    mLockBlocks.Leave();
+
+    // Paused renderers wake up to stop
+    {
+        std::lock_guard<std::mutex> lock(mPauseLock);
+        mPauseCondition.notify_all();
+    }
+
+    SignalIfDone();
+}
+
+//=============================================================================
+void RenderManager::Pause ()
+{
+    mbPaused = true;
+}
+
+//=============================================================================
+void RenderManager::Resume ()
+{
+    {
+        std::lock_guard<std::mutex> lock(mPauseLock);
+        mbPaused = false;
+        mPauseCondition.notify_all();
+    }
+
+    if (mpScheduler)
+        mpScheduler->Wake();
+}
+
+//=============================================================================
+bool RenderManager::WaitForResume ()
+{
+    TraceScope trace(TRACE_PAUSED);
+
+    std::unique_lock<std::mutex> lock(mPauseLock);
+    mPauseCondition.wait(lock, [this] { return !mbPaused || mbCancelled; });
+    return !mbCancelled;
 }
 
 //=============================================================================
@@ -83,36 +318,87 @@ bool RenderManager::GetBlock (Block & out)
 
     mLockBlocks.Enter();
 
+    // Cancelled renders hand out nothing, mbDrained is already set
+    if (mbCancelled)
+        mBlocks.clear();
+
+    // Out of time, whatever is left stays unrendered
+    if (mTimeBudget > 0.0f && !mBlocks.empty())
+    {
+        const Time::Delta elapsed = Time::GetRealTime() - mStartTime;
+        if (elapsed.GetSeconds() >= mTimeBudget)
+            mBlocks.clear();
+    }
 
     if (!mBlocks.empty()) {
         ret =  true;
 
         out = mBlocks.back();
         mBlocks.pop_back();
+        mIssuedBlocks++;
     }
 
+    if (mBlocks.empty())
+        mbDrained = true;
+
     mLockBlocks.Leave();
-    mProgressEvent.Post();
+
+    if (!ret)
+        SignalIfDone();
 
     return ret;
 }
 
 //=============================================================================
-void RenderManager::CompleteBlock ()
+void RenderManager::CompleteBlock (const Block & block)
 {
+    mCompletedPixels += uint64(block.width) * block.height;
     mCompletedBlocks++;
+
+    SignalIfDone();
+}
+
+//=============================================================================
+void RenderManager::AbortBlock (const Block & block)
+{
+    (void)block;
+    mAbortedBlocks++;
+
+    SignalIfDone();
+}
+
+//=============================================================================
+void RenderManager::SignalIfDone ()
+{
+    if (!IsDone())
+        return;
+
+    // Taking the lock orders this after a waiter's check of IsDone, so the notify can't be lost
+    std::lock_guard<std::mutex> lock(mDoneLock);
+    mDoneCondition.notify_all();
 }
 
 //=============================================================================
 float32 RenderManager::GetProgress ()
 {
-	return mCompletedBlocks / float32(mTotalBlocks);
+	if (!mTotalPixels)
+		return 0.0f;
+
+	return float32(float64(mCompletedPixels) / float64(mTotalPixels));
+}
+
+//=============================================================================
+bool RenderManager::WaitForProgress (float32 seconds)
+{
+    std::unique_lock<std::mutex> lock(mDoneLock);
+    return mDoneCondition.wait_for(lock, std::chrono::duration<float32>(seconds), [this] { return IsDone(); });
 }
 
 //=============================================================================
-void RenderManager::WaitForProgress ()
+void RenderManager::WaitForCompletion ()
 {
-    mProgressEvent.Wait();
+    std::unique_lock<std::mutex> lock(mDoneLock);
+    mDoneCondition.wait(lock, [this] { return IsDone(); });
 }
 
 }// namespace RT
\ No newline at end of file
@@ -11,6 +11,8 @@
 #define RENDERMANAGER_H
 
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 namespace RT
 {
@@ -26,38 +28,171 @@ class RenderManager
 {
 	friend class Renderer;
 public:
-	RenderManager(Scene & scene, Camera & camera, CImage & backbuffer);
-	~RenderManager();
+	RenderManager(const Scene & scene, const Camera & camera, CImage & backbuffer);
+	virtual ~RenderManager();
 
+	//! Renders on threads of its own
 	void Start();
+	//! Renders on the threads of scheduler instead, sharing them with its other jobs
+	void Start(RenderScheduler & scheduler, uint32 priority = 0, float32 weight = 1.0f);
+
+	//! Renderers finish their pixel and stop, the blocks they were on are dropped so only whole
+	//! blocks are ever completed. Blocks still to be handed out are never rendered.
+	void Cancel();
+	//! Renderers wait after their current pixel, keeping their blocks, until Resume or Cancel
+	void Pause();
+	void Resume();
+	bool IsCancelled() const { return mbCancelled; }
+	bool IsPaused() const { return mbPaused; }
 
 	bool IsDone();
+	//! Fraction of the pixels in completed blocks. Pixel progress, cheap and expensive blocks count
+	//! alike, so the estimate of the time left assumes the rest costs what the done part did.
 	float32 GetProgress();
-    void WaitForProgress();
+	//! Blocks until every issued block is complete, or seconds have passed. Returns IsDone.
+	bool WaitForProgress(float32 seconds);
+	void WaitForCompletion();
 
 	void SetSamplesPerPixel(uint32 spp) { mSpp = spp; }
+	void SetThreadCount(uint32 threads) { mThreadCount = threads; }
+	void SetAffinity(EAffinity affinity) { mAffinity = affinity; }
+	void SetTimeBudget(float32 seconds) { mTimeBudget = seconds; }
+	//! Estimate what every block costs with a sparse one sample pre-pass, and hand out the
+	//! most expensive first so no long block is left to finish alone at the end
+	void SetPredictCost(bool predict) { mbPredictCost = predict; }
+
+	//! Only render samples [begin, end) of every pixel, end 0 is all of them
+	void SetSampleRange(uint32 begin, uint32 end) { mSampleBegin = begin; mSampleEnd = end; }
+	//! Completed blocks are also added into buffer, which must be the size of the backbuffer
+	void SetAccumulationBuffer(CAccumulationBuffer * buffer) { mAccumulation = buffer; }
+	//! Off sends every sample of a pixel through its center, so a pixel has one camera ray
+	void SetJitter(bool jitter) { mbJitter = jitter; }
+	//! Camera ray hits are reused from and added to gbuffer, which must be the size of the
+	//! backbuffer with a hit per sample, or a single one per pixel without jitter
+	void SetGBuffer(GBuffer * gbuffer) { mpGBuffer = gbuffer; }
+	//! The material bits of every rendered pixel's paths are added to mask, which must be the
+	//! size of the backbuffer
+	void SetMaterialMask(MaterialMask * mask) { mpMaterialMask = mask; }
+	//! After materials changed, pixels whose paths the material mask says never touched one of
+	//! changedMaterials copy their samples from previous, a render of the same samples before
+	//! the change, instead of being rendered. Needs SetMaterialMask.
+	void SetReuse(const CAccumulationBuffer * previous, uint64 changedMaterials) { mpReuse = previous; mChangedMaterials = changedMaterials; }
+
+	uint32 GetSamplesPerPixel() const { return mSpp; }
+	uint32 GetSampleBegin() const { return mSampleBegin; }
+	uint32 GetSampleEnd() const { return mSampleEnd; }
+	uint32 GetSampleCount() const { return mSampleEnd - mSampleBegin; }
+	uint32 GetThreadCount() const { return uint32(mRenderers.size()); }
+	EAffinity GetAffinity() const { return mAffinity; }
+	uint32 GetTotalBlocks() const { return mTotalBlocks; }
+	uint32 GetCompletedBlocks() const { return mCompletedBlocks; }
+	uint64 GetCompletedPixels() const { return mCompletedPixels; }
+	//! Samples of the completed pixels, out of GetTotalSamples. Every pixel takes the same number
+	//! of samples, so these track the pixel counts and say nothing about cost.
+	uint64 GetCompletedSamples() const { return mCompletedPixels * GetSampleCount(); }
+	uint64 GetTotalSamples() const { return mTotalPixels * GetSampleCount(); }
+	//! Camera and bounce rays traced for the completed blocks
+	uint64 GetCompletedRays() const { return mCompletedRays; }
+	//! Pixels of the completed blocks copied by SetReuse rather than rendered
+	uint64 GetReusedPixels() const { return mReusedPixels; }
+	//! Seconds the cost pre-pass took, 0 without one
+	float32 GetPredictSeconds() const { return mPredictSeconds; }
+
+	//! Writes the render time of every pixel's block per pixel as an image, black for the
+	//! cheapest through red to white for the most expensive. False if it could not be written.
+	bool SaveCostMap(const char * path) const;
+#if RT_STATS
+	//! Counters of the completed blocks
+	void GetStats(RenderStats * out) const { mStats.Get(out); }
+#endif
 
 protected:
 
-	bool GetBlock (Block & out);
-    void CompleteBlock ();
+	// Derived managers must call this in their destructor, renderers call back into them
+	void StopRenderers ();
+
+	// Overridden when blocks come from somewhere other than this process
+	virtual void CreateBlocks ();
+	virtual bool GetBlock (Block & out);
+    virtual void CompleteBlock (const Block & block);
+
+	// A renderer gives up a block it was issued without completing it
+	void AbortBlock (const Block & block);
+
+	// Wakes WaitForProgress once there is nothing left to wait for, called whenever mbDrained,
+	// mIssuedBlocks, mCompletedBlocks or mAbortedBlocks change
+	void SignalIfDone ();
+
+	// Renderers call this between pixels, it returns false once they should stop
+	inline bool WaitWhilePaused ()
+	{
+		// Scheduled jobs pause between blocks, so a paused job doesn't hold on to shared threads
+		if (!mbPaused.load(std::memory_order_relaxed) || mpScheduler)
+			return !mbCancelled.load(std::memory_order_relaxed);
+
+		return WaitForResume();
+	}
+
+	bool WaitForResume ();
+
+	// Everything Start does short of starting threads
+	void Prepare (uint renderers);
+
+	// Scheduler threads render a block with the renderer of their index
+	friend class RenderScheduler;
+	bool RenderBlock (uint thread) { return mRenderers[thread]->RenderNextBlock(); }
+
+	// Sorts mBlocks so the blocks predicted to be the most expensive are handed out first
+	void PredictBlockCosts (uint threads);
+	// Renderers report the time they spent on each block, blocks never overlap so no lock is needed
+	void RecordBlockCost (const Block & block, float32 seconds);
 
-private:
 	typedef std::vector<Renderer *> RendererList;
 	typedef std::vector<Block>    BlockList;
 
 	RendererList 	  mRenderers;
+	RenderScheduler * mpScheduler;       // null when the renderers are threads of their own
 
     CriticalSection   mLockBlocks;
 	BlockList	      mBlocks;
-    Event             mProgressEvent;
-
-	Scene & 		  mScene;
-	Camera & 	      mCamera;
+	std::vector<float32> mCostMap;        // Seconds per pixel of the block it was rendered in
+    std::mutex              mDoneLock;
+    std::condition_variable mDoneCondition;
+    std::mutex              mPauseLock;
+    std::condition_variable mPauseCondition;
+
+	const Scene &     mScene;
+	const Camera &    mCamera;
 	CImage &          mBackbuffer;
-    std::atomic<uint> mCompletedBlocks{0};
-	uint32            mTotalBlocks;
-	uint32            mSpp;
+	CAccumulationBuffer * mAccumulation;
+	GBuffer *         mpGBuffer;
+	MaterialMask *    mpMaterialMask;
+	bool              mbJitter;
+	const CAccumulationBuffer * mpReuse;
+	uint64            mChangedMaterials;
+    std::atomic<uint>   mCompletedBlocks{0};
+    std::atomic<uint>   mIssuedBlocks{0};
+    std::atomic<uint>   mAbortedBlocks{0};   // Issued, then given up on by a cancel
+    std::atomic<bool>   mbCancelled{false};
+    std::atomic<bool>   mbPaused{false};
+    std::atomic<bool>   mbDrained{false};    // No more blocks will be handed out
+    std::atomic<uint64> mCompletedPixels{0};
+    std::atomic<uint64> mCompletedRays{0};
+    std::atomic<uint64> mReusedPixels{0};
+#if RT_STATS
+    AtomicRenderStats   mStats;
+#endif
+	uint32              mTotalBlocks;
+	uint64              mTotalPixels;        // Of all blocks, whether they get rendered or not
+	uint32              mSpp;
+	uint32              mSampleBegin;
+	uint32              mSampleEnd;          // 0 until Start, then clamped to mSpp
+	uint32              mThreadCount;        // 0 is one per logical processor
+	EAffinity           mAffinity;
+	float32             mTimeBudget;         // Seconds, 0 is unlimited
+	bool                mbPredictCost;
+	float32             mPredictSeconds;
+	Time::Point         mStartTime;
 
 };
 
@@ -0,0 +1,140 @@
+//==================================================================================================
+//
+// File:	RenderScheduler.cpp
+//
+// Render threads shared between render managers.
+//
+//=================================================================================================
+
+#include <algorithm>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+RenderScheduler::RenderScheduler (uint32 threads, EAffinity affinity) :
+	mbStopping(false)
+{
+	const uint32 count = threads ? threads : Max<uint32>(1, ThreadLogicalProcessorCount());
+
+	const std::vector<uint32> placement = GetThreadPlacement(affinity, count);
+	for (uint32 i = 0; i < count; ++i)
+	{
+		const uint32 processor = placement.empty() ? uint32(Renderer::NO_PROCESSOR) : placement[i];
+		mThreads.emplace_back(&RenderScheduler::ThreadMain, this, i, processor);
+	}
+}
+
+//=============================================================================
+RenderScheduler::~RenderScheduler ()
+{
+	ASSERT(mJobs.empty());
+
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mbStopping = true;
+		mWorkReady.notify_all();
+	}
+
+	for (std::thread & thread : mThreads)
+		thread.join();
+}
+
+//=============================================================================
+void RenderScheduler::Add (RenderManager * manager, uint32 priority, float32 weight)
+{
+	ASSERT(weight > 0.0f);
+
+	std::lock_guard<std::mutex> lock(mLock);
+
+	// Level with the least served job it will compete with
+	float64 virtualTime = -1.0;
+	for (const Job * job : mJobs)
+	{
+		if (job->priority == priority && !job->drained && (virtualTime < 0.0 || job->virtualTime < virtualTime))
+			virtualTime = job->virtualTime;
+	}
+
+	mJobs.push_back(new Job{ manager, priority, weight, Max(0.0, virtualTime), 0, false });
+	mWorkReady.notify_all();
+}
+
+//=============================================================================
+void RenderScheduler::Remove (RenderManager * manager)
+{
+	std::unique_lock<std::mutex> lock(mLock);
+
+	auto it = std::find_if(mJobs.begin(), mJobs.end(), [manager](const Job * job) { return job->manager == manager; });
+	if (it == mJobs.end())
+		return;
+
+	Job * job = *it;
+	mJobIdle.wait(lock, [job] { return !job->active; });
+
+	mJobs.erase(std::find(mJobs.begin(), mJobs.end(), job));
+	delete job;
+}
+
+//=============================================================================
+void RenderScheduler::Wake ()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	mWorkReady.notify_all();
+}
+
+//=============================================================================
+// Called with mLock held
+RenderScheduler::Job * RenderScheduler::PickJob ()
+{
+	Job * best = null;
+	for (Job * job : mJobs)
+	{
+		if (job->drained || job->manager->IsPaused())
+			continue;
+
+		if (!best || job->priority > best->priority || (job->priority == best->priority && job->virtualTime < best->virtualTime))
+			best = job;
+	}
+
+	return best;
+}
+
+//=============================================================================
+void RenderScheduler::ThreadMain (uint32 thread, uint32 processor)
+{
+	SetTraceThreadName("Scheduler");
+
+	if (processor != Renderer::NO_PROCESSOR)
+		PinCurrentThread(processor);
+
+	std::unique_lock<std::mutex> lock(mLock);
+	while (!mbStopping)
+	{
+		Job * job = PickJob();
+		if (!job)
+		{
+			mWorkReady.wait(lock);
+			continue;
+		}
+
+		++job->active;
+		lock.unlock();
+
+		const Time::Point start = Time::GetRealTime();
+		const bool        more  = job->manager->RenderBlock(thread);
+		const float32     spent = (Time::GetRealTime() - start).GetSeconds();
+
+		lock.lock();
+		--job->active;
+		job->virtualTime += spent / job->weight;
+		if (!more)
+			job->drained = true;
+
+		if (!job->active)
+			mJobIdle.notify_all();
+	}
+}
+
+} // namespace RT
@@ -0,0 +1,70 @@
+//==================================================================================================
+//
+// File:	RenderScheduler.h
+//
+// One pool of render threads shared by every render manager started on it, so many renders can
+// run at once without each bringing a thread per processor. Threads take one block at a time from
+// whichever job is next in line, which keeps every thread busy while a job ramps up or drains.
+//=================================================================================================
+#ifndef RENDERSCHEDULER_H
+#define RENDERSCHEDULER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RT
+{
+
+class RenderManager;
+
+//==================================================================================================
+//
+// Jobs of a higher priority always go first. Jobs of the same priority share the threads in
+// proportion to their weights: every job keeps a virtual time, the render seconds it was given
+// divided by its weight, and the job furthest behind gets the next block. New jobs start level
+// with the jobs already running, so they neither starve them nor get starved.
+//==================================================================================================
+class RenderScheduler
+{
+public:
+	//! threads 0 is one per logical processor
+	explicit RenderScheduler (uint32 threads = 0, EAffinity affinity = AFFINITY_NONE);
+	//! Every job has to be removed first
+	~RenderScheduler ();
+
+	inline uint32 GetThreadCount () const { return uint32(mThreads.size()); }
+
+	//! Called by RenderManager::Start
+	void Add (RenderManager * manager, uint32 priority, float32 weight);
+	//! Waits for the threads to leave the job, called by the manager before it goes away
+	void Remove (RenderManager * manager);
+	//! Looks for work again, after a job was resumed
+	void Wake ();
+
+private:
+	struct Job
+	{
+		RenderManager * manager;
+		uint32          priority;
+		float32         weight;
+		float64         virtualTime;
+		uint32          active;		// Threads rendering a block of it
+		bool            drained;	// Its manager handed out its last block
+	};
+
+	void ThreadMain (uint32 thread, uint32 processor);
+	Job * PickJob ();
+
+	std::mutex               mLock;
+	std::condition_variable  mWorkReady;	// A job was added or resumed
+	std::condition_variable  mJobIdle;		// A thread left a job
+	std::vector<Job *>       mJobs;
+	std::vector<std::thread> mThreads;
+	bool                     mbStopping;
+};
+
+} // namespace RT
+
+#endif //RENDERSCHEDULER_H
@@ -0,0 +1,432 @@
+//==================================================================================================
+//
+// File:	RenderService.cpp
+//
+// Long running render process with a job queue, a shared render scheduler and a cache of parsed
+// scenes.
+//
+//=================================================================================================
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "Pch.h"
+
+const uint DEFAULT_WIDTH      = 512;
+const uint DEFAULT_HEIGHT     = 384;
+const uint DEFAULT_SPP        = 100;
+const uint MAX_CACHED_SCENES  = 8;
+const uint DEFAULT_JOBS       = 4;
+
+// A client gets this long to send its whole request line, the accept loop waits on it
+const float32 REQUEST_TIMEOUT_SECONDS = 2.0f;
+const size_t  MAX_REQUEST_LENGTH      = 4096;
+// Failed accepts wait twice as long as the last one up to the maximum, and the
+// service gives up after this many in a row
+const uint ACCEPT_BACKOFF_MS      = 10;
+const uint ACCEPT_BACKOFF_MAX_MS  = 1000;
+const uint MAX_ACCEPT_FAILURES    = 60;
+
+
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+//=============================================================================
+// Parses "x,y,z"
+static bool ParseTriple (const std::string & str, Vector3 * out)
+{
+	const char * it = str.c_str();
+	for (uint i = 0; i < 3; ++i)
+	{
+		char * end = null;
+		(*out)[i] = float32(strtod(it, &end));
+		if (end == it)
+			return false;
+
+		if (i < 2 && *end != ',')
+			return false;
+
+		it = end + 1;
+	}
+
+	return true;
+}
+
+//=============================================================================
+static std::string ErrorReply (const std::string & message)
+{
+	std::ostringstream out;
+	out << "{\"status\":\"error\",\"message\":" << JsonString(message.c_str()) << "}";
+	return out.str();
+}
+
+
+
+//=============================================================================
+// RenderService
+//=============================================================================
+
+//=============================================================================
+RenderService::RenderService (const RenderOptions & options) :
+	mOptions(options),
+	mbStopping(false),
+	mScheduler(options.threads, options.affinity),
+	mUseCounter(0),
+	mJobsCompleted(0),
+	mJobsFailed(0),
+	mCacheHits(0),
+	mCacheMisses(0)
+{
+}
+
+//=============================================================================
+RenderService::~RenderService ()
+{
+}
+
+//=============================================================================
+int RenderService::Run (const char * address)
+{
+	const RT::SocketHandle listener = RT::SocketListen(address);
+	if (listener == RT::INVALID_SOCKET_HANDLE)
+	{
+		std::cerr << "Failed to listen on '" << address << "': " << strerror(errno) << std::endl;
+		return 2;
+	}
+
+	if (!mOptions.headless)
+		std::cout << "Listening on " << address << std::endl;
+
+	// Each worker runs one job at a time, the scheduler shares the threads between them
+	std::vector<std::thread> workers;
+	for (uint i = 0; i < (mOptions.jobs ? mOptions.jobs : DEFAULT_JOBS); ++i)
+		workers.emplace_back(&RenderService::WorkerMain, this);
+
+	int  exitCode = 0;
+	uint failures = 0;
+	for (;;)
+	{
+		const RT::SocketHandle client = RT::SocketAccept(listener);
+		if (client == RT::INVALID_SOCKET_HANDLE)
+		{
+			// Out of descriptors and the like clear up on their own, a broken listener doesn't
+			if (++failures == MAX_ACCEPT_FAILURES)
+			{
+				std::cerr << "Failed to accept connections on '" << address << "', stopping" << std::endl;
+				exitCode = 2;
+				break;
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(Min(ACCEPT_BACKOFF_MS << Min(failures, 16u), ACCEPT_BACKOFF_MAX_MS)));
+			continue;
+		}
+
+		failures = 0;
+
+		// A client which connects and sends slowly, or never, can't hold up the others for long
+		std::string request;
+		if (!RT::SocketRecvLine(client, &request, MAX_REQUEST_LENGTH, REQUEST_TIMEOUT_SECONDS))
+		{
+			RT::SocketClose(client);
+			continue;
+		}
+
+		if (request == "shutdown")
+		{
+			RT::SocketSendLine(client, "{\"status\":\"ok\"}");
+			RT::SocketClose(client);
+			break;
+		}
+
+		if (request == "stats")
+		{
+			RT::SocketSendLine(client, StatsReply());
+			RT::SocketClose(client);
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(mLock);
+		mJobs.push_back(Job{client, request});
+		mJobReady.notify_one();
+	}
+
+	// Let the jobs in flight finish, refuse the rest
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mbStopping = true;
+		mJobReady.notify_all();
+	}
+
+	for (std::thread & worker : workers)
+		worker.join();
+
+	for (const Job & job : mJobs)
+	{
+		RT::SocketSendLine(job.client, ErrorReply("service shutting down"));
+		RT::SocketClose(job.client);
+	}
+	mJobs.clear();
+
+	RT::SocketClose(listener);
+	return exitCode;
+}
+
+//=============================================================================
+void RenderService::WorkerMain ()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mLock);
+			mJobReady.wait(lock, [this] { return mbStopping || !mJobs.empty(); });
+			if (mbStopping)
+				return;
+
+			job = mJobs.front();
+			mJobs.pop_front();
+		}
+
+		const std::string reply = RenderJob(job.request);
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			const std::string ok = "{\"status\":\"ok\"";
+			if (reply.compare(0, ok.size(), ok) == 0)
+				++mJobsCompleted;
+			else
+				++mJobsFailed;
+		}
+
+		RT::SocketSendLine(job.client, reply);
+		RT::SocketClose(job.client);
+	}
+}
+
+//=============================================================================
+std::string RenderService::RenderJob (const std::string & request)
+{
+	const Time::Point loadTick = Time::GetRealTime();
+
+	std::istringstream in(request);
+	std::string command;
+	in >> command;
+	if (command != "render")
+		return ErrorReply("unknown request '" + command + "'");
+
+	std::string scenePath, outputPath;
+	uint width = 0, height = 0, spp = 0, priority = 0;
+	float32 weight = 1.0f;
+	bool hasEye = false, hasLookat = false, hasUp = false;
+	Vector3 eye, lookat, up;
+
+	std::string token;
+	while (in >> token)
+	{
+		const size_t split = token.find('=');
+		if (split == std::string::npos)
+			return ErrorReply("expected key=value, got '" + token + "'");
+
+		const std::string key   = token.substr(0, split);
+		const std::string value = token.substr(split + 1);
+
+		bool ok = true;
+		if      (key == "scene")  scenePath  = value;
+		else if (key == "output") outputPath = value;
+		else if (key == "spp")    ok = (spp = uint(strtoul(value.c_str(), null, 10))) != 0;
+		else if (key == "size")   ok = sscanf(value.c_str(), "%ux%u", &width, &height) == 2 && width && height;
+		else if (key == "eye")    ok = hasEye    = ParseTriple(value, &eye);
+		else if (key == "lookat") ok = hasLookat = ParseTriple(value, &lookat);
+		else if (key == "up")     ok = hasUp     = ParseTriple(value, &up);
+		else if (key == "priority") priority = uint(strtoul(value.c_str(), null, 10));
+		else if (key == "weight") ok = (weight = float32(atof(value.c_str()))) > 0.0f;
+		else                      ok = false;
+
+		if (!ok)
+			return ErrorReply("bad argument '" + token + "'");
+	}
+
+	if (scenePath.empty() || outputPath.empty())
+		return ErrorReply("render needs scene= and output=");
+
+	bool cached = false;
+	std::string error;
+	const std::shared_ptr<CachedScene> entry = FindOrLoadScene(scenePath.c_str(), &cached, &error);
+	if (!entry)
+		return ErrorReply(error);
+
+	// Job settings win over the scene file
+	if (!width)
+	{
+		width  = entry->settings.width  ? entry->settings.width  : DEFAULT_WIDTH;
+		height = entry->settings.height ? entry->settings.height : DEFAULT_HEIGHT;
+	}
+
+	if (!spp)
+		spp = entry->settings.spp ? entry->settings.spp : DEFAULT_SPP;
+
+	RT::CameraDesc cameraDesc = entry->settings.camera;
+	if (hasEye)    cameraDesc.eye    = eye;
+	if (hasLookat) cameraDesc.lookat = lookat;
+	if (hasUp)     cameraDesc.up     = up;
+
+	RT::CImage backbuffer(width, height);
+	RT::Camera camera;
+	camera.Setup(cameraDesc, width / float32(height));
+
+	const Time::Point startTick = Time::GetRealTime();
+
+	{
+		RT::RenderManager manager(entry->scene, camera, backbuffer);
+		manager.SetSamplesPerPixel(spp);
+		manager.Start(mScheduler, priority, weight);
+
+		manager.WaitForCompletion();
+	}
+
+	const Time::Point saveTick = Time::GetRealTime();
+	if (!backbuffer.Save(outputPath.c_str()))
+		return ErrorReply("failed to save '" + outputPath + "'");
+	const Time::Point endTick = Time::GetRealTime();
+
+	std::ostringstream out;
+	out
+		<< std::fixed
+		<< std::setprecision(3)
+		<< "{\"status\":\"ok\""
+		<< ",\"scene\":"          << JsonString(scenePath.c_str())
+		<< ",\"output\":"         << JsonString(outputPath.c_str())
+		<< ",\"scene_hash\":\""   << std::hex << std::setw(16) << std::setfill('0') << entry->hash << std::dec << "\""
+		<< ",\"scene_cached\":"   << (cached ? "true" : "false")
+		<< ",\"width\":"          << width
+		<< ",\"height\":"         << height
+		<< ",\"spp\":"            << spp
+		<< ",\"priority\":"       << priority
+		<< ",\"weight\":"         << weight
+		<< ",\"load_seconds\":"   << (startTick - loadTick).GetSeconds()
+		<< ",\"render_seconds\":" << (saveTick - startTick).GetSeconds()
+		<< ",\"save_seconds\":"   << (endTick - saveTick).GetSeconds()
+		<< "}";
+
+	return out.str();
+}
+
+//=============================================================================
+std::string RenderService::StatsReply ()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	std::ostringstream out;
+	out
+		<< "{\"status\":\"ok\""
+		<< ",\"jobs_queued\":"    << mJobs.size()
+		<< ",\"jobs_completed\":" << mJobsCompleted
+		<< ",\"jobs_failed\":"    << mJobsFailed
+		<< ",\"cache_hits\":"     << mCacheHits
+		<< ",\"cache_misses\":"   << mCacheMisses
+		<< "}";
+
+	return out.str();
+}
+
+//=============================================================================
+std::shared_ptr<RenderService::CachedScene> RenderService::FindOrLoadScene (
+	const char * filename,
+	bool * cached,
+	std::string * error
+) {
+	uint64 hash;
+	if (!RT::HashSceneSource(filename, &hash))
+	{
+		*error = std::string("cannot read scene '") + filename + "'";
+		return null;
+	}
+
+	// The first request for a scene puts a placeholder in the cache and loads it outside the
+	// lock, later requests for the same scene wait on that load only
+	std::shared_ptr<CachedScene> entry;
+	std::promise<bool>           load;
+	{
+		std::lock_guard<std::mutex> cacheLock(mCacheLock);
+
+		for (auto & cachedEntry : mCache)
+		{
+			if (cachedEntry->hash == hash)
+			{
+				entry = cachedEntry;
+				break;
+			}
+		}
+
+		*cached = entry != null;
+		if (!entry)
+		{
+			// Evict the least recently used scene
+			if (mCache.size() >= MAX_CACHED_SCENES)
+			{
+				auto oldest = mCache.begin();
+				for (auto it = mCache.begin(); it != mCache.end(); ++it)
+				{
+					if ((*it)->lastUsed < (*oldest)->lastUsed)
+						oldest = it;
+				}
+				mCache.erase(oldest);
+			}
+
+			entry.reset(new CachedScene);
+			entry->hash   = hash;
+			entry->loaded = load.get_future().share();
+			mCache.push_back(entry);
+		}
+
+		entry->lastUsed = ++mUseCounter;
+	}
+
+	bool bLoaded;
+	if (*cached)
+	{
+		bLoaded = entry->loaded.get();
+	}
+	else
+	{
+		entry->scene.SetBvhBuilder(mOptions.bvhBuilder);
+		bLoaded = RT::LoadScene(filename, &entry->scene, &entry->settings);
+		if (bLoaded && ResolveBvhNodes(mOptions, entry->settings) == RT::BVH_NODES_QUANTIZED)
+			entry->scene.QuantizeMeshBvhs();
+
+		load.set_value(bLoaded);
+
+		// A failed load is not kept, the next request tries again
+		if (!bLoaded)
+		{
+			std::lock_guard<std::mutex> cacheLock(mCacheLock);
+			mCache.erase(std::remove(mCache.begin(), mCache.end(), entry), mCache.end());
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		if (*cached)
+			++mCacheHits;
+		else
+			++mCacheMisses;
+	}
+
+	if (!bLoaded)
+	{
+		*error = std::string("cannot parse scene '") + filename + "'";
+		return null;
+	}
+
+	return entry;
+}
@@ -0,0 +1,80 @@
+//==================================================================================================
+//
+// File:	RenderService.h
+//
+// A long running render process. Clients connect to a unix domain socket and send one request
+// per connection as a single line:
+//
+//   render scene=<file> output=<file> [spp=<n>] [size=<W>x<H>] [eye=x,y,z] [lookat=x,y,z] [up=x,y,z]
+//          [priority=<n>] [weight=<f>]
+//   stats
+//   shutdown
+//
+// Every request is answered with a single json line. Up to --jobs render jobs run at once on one
+// shared RenderScheduler, the rest wait in a queue. Jobs of a higher priority take the threads
+// first, jobs of the same priority share them by weight, so quick previews keep rendering next to
+// a long final render. Parsed scenes are kept between jobs, keyed by the scene file's source
+// hash (contents, path and mesh files), so a scene rendered again from a new camera skips loading.
+//=================================================================================================
+#ifndef RENDERSERVICE_H
+#define RENDERSERVICE_H
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class RenderService
+{
+public:
+	RenderService(const RenderOptions & options);
+	~RenderService();
+
+	//! Serves requests until a shutdown request arrives, returns the process exit code
+	int Run(const char * address);
+
+private:
+	struct Job
+	{
+		RT::SocketHandle client;
+		std::string      request;
+	};
+
+	struct CachedScene
+	{
+		uint64                    hash;
+		uint64                    lastUsed;
+		std::shared_future<bool>  loaded;	// Whether scene and settings loaded, once they are done
+		RT::Scene                 scene;
+		RT::SceneSettings         settings;
+	};
+
+	void WorkerMain();
+	std::string RenderJob(const std::string & request);
+	std::string StatsReply();
+	std::shared_ptr<CachedScene> FindOrLoadScene(const char * filename, bool * cached, std::string * error);
+
+	// Data
+	RenderOptions                             mOptions;
+
+	std::mutex                                mLock;
+	std::condition_variable                   mJobReady;
+	std::deque<Job>                           mJobs;
+	bool                                      mbStopping;
+
+	RT::RenderScheduler                       mScheduler;
+
+	std::mutex                                mCacheLock;	// Guards mCache and mUseCounter, scenes load outside it
+	std::vector<std::shared_ptr<CachedScene>> mCache;		// Evicted scenes live on until their jobs finish
+	uint64                                    mUseCounter;
+
+	uint64                                    mJobsCompleted;
+	uint64                                    mJobsFailed;
+	uint64                                    mCacheHits;
+	uint64                                    mCacheMisses;
+};
+
+#endif //RENDERSERVICE_H
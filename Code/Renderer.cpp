@@ -55,12 +55,22 @@ Vector3 CosineSampleInHemisphere(const Random & rand)
 }
 
 //=============================================================================
-Renderer::Renderer(Scene & scene, Camera & camera, CImage & backbuffer, RenderManager & manager) :
+Renderer::Renderer(const Scene & scene, const Camera & camera, CImage & backbuffer, RenderManager & manager) :
+	mbDone(false),
+	mbJitter(true),
+	mpGBuffer(null),
+	mpMaterialMask(null),
+	mpReuse(null),
+	mChangedMaterials(0),
+	mPathMaterials(0),
+	mManager(manager),
+	mBackbuffer(backbuffer),
 	mScene(scene),
 	mCamera(camera),
-	mBackbuffer(backbuffer),
-	mManager(manager),
-	mbDone(false)
+	mRays(0),
+	mReusedPixels(0),
+	mRenderSeconds(0.0f),
+	mProcessor(NO_PROCESSOR)
 {
     mPixelWidth  = 2.0 / mBackbuffer.GetWidth();
 	mPixelHeight = 2.0 / mBackbuffer.GetHeight();
@@ -72,96 +82,251 @@ void Renderer::SetSamplesPerPixel (uint spp)
 	mSpp                   = spp;
 	mSamplesStratifiedSide = FloatToUint(Floor(Sqrt(float32(mSpp))));
 	mSamplesRandom         = mSpp - Sq(mSamplesStratifiedSide);
+	mSampleBegin           = 0;
+	mSampleEnd             = spp;
 
 	mSubPixelWidth  = mPixelWidth  / float64(mSamplesStratifiedSide);
 	mSubPixelHeight = mPixelHeight / float64(mSamplesStratifiedSide);
 }
 
+//=============================================================================
+void Renderer::SetSampleRange (uint begin, uint end)
+{
+	ASSERT(begin <= end && end <= mSpp);
+
+	mSampleBegin = begin;
+	mSampleEnd   = end;
+}
+
 //=============================================================================
 void Renderer::Setup (const Block & block)
 {
 	mBlock = block;
-	mBuffer = CImage(mBlock.width, mBlock.height);
+	mBuffer.Resize(mBlock.width, mBlock.height);
 }
 
 //=============================================================================
 void Renderer::Cleanup()
 {
-    mManager.CompleteBlock();
+    mManager.mCompletedRays += mRays;
+    mRays = 0;
+    mManager.mReusedPixels += mReusedPixels;
+    mReusedPixels = 0;
+
+    mManager.RecordBlockCost(mBlock, mRenderSeconds);
+
+#if RT_STATS
+    mManager.mStats.Add(tl_renderStats);
+    tl_renderStats.Clear();
+#endif
+
+    TraceScope trace(TRACE_COMPLETE_BLOCK, mBlock.x, mBlock.y);
+    mManager.CompleteBlock(mBlock);
+}
+
+//=============================================================================
+// The rays were traced all the same, only the partial block is thrown away
+void Renderer::Abort()
+{
+    mManager.mCompletedRays += mRays;
+    mRays = 0;
+    mReusedPixels = 0;
+
+#if RT_STATS
+    mManager.mStats.Add(tl_renderStats);
+    tl_renderStats.Clear();
+#endif
+
+    mManager.AbortBlock(mBlock);
 }
 
 //=============================================================================
 // (x, y) = pixel coordinates of the pixel. (u, v) = camera coordinates of the pixel.
 // (j, k) = sub-pixel coordinates
-void Renderer::Render()
+bool Renderer::Render()
 {
-	const float64 left = -1.0 + mPixelWidth * (float64)mBlock.x;
-	const float64 top  = -1.0 + mPixelHeight * (float64)mBlock.y;
+	TraceScope trace(TRACE_RENDER, mBlock.x, mBlock.y);
+
+	const Time::Point start = Time::GetRealTime();
+
+	const float64 left  = -1.0 + mPixelWidth * (float64)mBlock.x;
+	const float64 top   = -1.0 + mPixelHeight * (float64)mBlock.y;
+	const uint32  count = mSampleEnd - mSampleBegin;
 
 	for (uint y = 0; y < mBlock.height; ++y )
 	{
 		const float64 v = top + mPixelHeight * y;
 		for (uint x = 0; x < mBlock.width; ++x)
 		{
+			// Every pixel's samples are a batch, a pause or cancel takes effect between them
+			if (!mManager.WaitWhilePaused())
+				return false;
+
+			const uint px = mBlock.x + x;
+			const uint py = mBlock.y + y;
+
+			if (mpReuse && !(mpMaterialMask->Get(px, py) & mChangedMaterials))
+			{
+				ASSERT(mpReuse->GetCount(px, py) == count);
+				mBuffer.AddSamples(x, y, mpReuse->GetSum(px, py), count);
+				++mReusedPixels;
+				continue;
+			}
+
 			const float64 u = left + mPixelWidth * x;
 
-			const Color color = SamplePixel(u, v);
-			mBuffer.SetPixel(x, y, color);
+			mPathMaterials = 0;
+			const Color sum = SamplePixel(px, py, u, v);
+			mBuffer.AddSamples(x, y, sum, count);
+
+			if (mpMaterialMask)
+				mpMaterialMask->Add(px, py, mPathMaterials);
 		}
 	}
+
+	mRenderSeconds = (Time::GetRealTime() - start).GetSeconds();
+	return true;
 }
 
 //=============================================================================
-Color Renderer::SamplePixel (const float64 & u, const float64 & v)
+// Pixels are picked along diagonals, so blocks a single row high are probed
+// as evenly as square ones
+float32 Renderer::MeasureBlock (const Block & block, uint stride)
 {
-	mRand.Seed(
-		FloatToUint(
-            Floor(
-			    float32(u * mBlock.width * 23.04124233 + v * mBlock.height * mBlock.width * 33676.53234236)
-		    )
-        )
-	);
+	ASSERT(stride);
+
+	const uint begin = mSampleBegin;
+	const uint end   = mSampleEnd;
+	mSampleEnd = Min(mSampleBegin + 1, end);
+
+	const Time::Point start = Time::GetRealTime();
+
+	for (uint y = 0; y < block.height; ++y)
+	{
+		const float64 v = -1.0 + mPixelHeight * float64(block.y + y);
+		for (uint x = (stride - (block.x + block.y + y) % stride) % stride; x < block.width; x += stride)
+		{
+			const float64 u = -1.0 + mPixelWidth * float64(block.x + x);
+			SamplePixel(block.x + x, block.y + y, u, v);
+		}
+	}
+
+	const float32 seconds = (Time::GetRealTime() - start).GetSeconds();
 
+	mSampleBegin = begin;
+	mSampleEnd   = end;
+	mRays        = 0;
+	return seconds;
+}
+
+//=============================================================================
+// Spreads the bits of the pixel and sample index over the whole seed
+static uint32 HashSample (uint x, uint y, uint sample)
+{
+	uint32 h = (x * 0x8da6b343u) ^ (y * 0xd8163841u) ^ (sample * 0xcb1ab31fu);
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+//=============================================================================
+// Returns the sum of samples [mSampleBegin, mSampleEnd) of the pixel. Every
+// sample is seeded by its pixel and index, so sample s comes out the same no
+// matter how the samples of a frame are split between renders.
+Color Renderer::SamplePixel (uint x, uint y, const float64 & u, const float64 & v)
+{
+	const uint stratified = Sq(mSamplesStratifiedSide);
 
 	Color color(0, 0, 0);
 
-	// Stratified sampling
+	for (uint s = mSampleBegin; s < mSampleEnd; ++s)
 	{
-		for (uint n = 0; n < mSamplesStratifiedSide; ++n)
+		mRand.Seed(HashSample(x, y, s));
+
+		// The offsets are drawn all the same, so the rest of the path doesn't change
+		if (!mbJitter)
+		{
+			mRand.GetFloat64();
+			mRand.GetFloat64();
+
+			const Ray3 ray = mCamera.GetRay(u + 0.5 * mPixelWidth, v + 0.5 * mPixelHeight);
+			color += SamplePrimary(x, y, s, ray);
+		}
+		// Stratified sampling
+		else if (s < stratified)
 		{
+			const uint m = s % mSamplesStratifiedSide;
+			const uint n = s / mSamplesStratifiedSide;
+
+			const float64 j = u + mSubPixelWidth  * m;
 			const float64 k = v + mSubPixelHeight * n;
-			for (uint m = 0; m < mSamplesStratifiedSide; ++m)
-			{
-				const float64 j = u + mSubPixelWidth * m;
 
-				const float64 rj    = mRand.GetFloat64();
-				const float64 rk    = mRand.GetFloat64();
+			const float64 rj    = mRand.GetFloat64();
+			const float64 rk    = mRand.GetFloat64();
 
-				const float64 randJ = mSubPixelWidth  * rj;
-				const float64 randK = mSubPixelHeight * rk;
+			const float64 randJ = mSubPixelWidth  * rj;
+			const float64 randK = mSubPixelHeight * rk;
 
-				const Ray3 ray = mCamera.GetRay(j + randJ, k + randK);
-				color += SampleScene(ray);
-			}
+			const Ray3 ray = mCamera.GetRay(j + randJ, k + randK);
+			color += SamplePrimary(x, y, s, ray);
+		}
+		// The rest of the sames are just randomly selected
+		// within the area of the entire pixel
+		else
+		{
+			const float64 randU = mPixelWidth  * mRand.GetFloat64();
+			const float64 randV = mPixelHeight * mRand.GetFloat64();
+			const Ray3 ray = mCamera.GetRay(u + randU, v + randV);
+			color += SamplePrimary(x, y, s, ray);
 		}
 	}
 
-	// The rest of the sames are just randomly selected
-	// within the area of the entire pixel
-	for (uint i = 0; i < mSamplesRandom; ++i)
+	return color;
+}
+
+//=============================================================================
+// Sample s of pixel (x, y) with the G-buffer's hit, tracing and storing it the
+// first time. The shading is the same as SampleScene's either way.
+Color Renderer::SamplePrimary (uint x, uint y, uint sample, const Ray3 & ray)
+{
+	if (!mpGBuffer)
+		return SampleScene(ray);
+
+	if (const PrimaryHit * hit = mpGBuffer->Find(x, y, sample))
 	{
-		const float64 randU = mPixelWidth  * mRand.GetFloat64();
-		const float64 randV = mPixelHeight * mRand.GetFloat64();
-		const Ray3 ray = mCamera.GetRay(u + randU, v + randV);
-		color += (SampleScene(ray));
+		RT_STATS_ONLY(ShadingTimer timer;)
+		RT_STAT_ADD(STAT_CACHED_PRIMARY_HITS, 1);
+
+		if (!hit->object)
+			return mScene.GetBackgroundColor();
 
+		RT_STATS_ONLY(timer.SetSlot(hit->object->GetMaterial().type);)
+		return ShadeHit(ray, *hit->object, hit->point, hit->normal, 0);
 	}
 
-	return color / (float32)mSpp;
+	RT_STATS_ONLY(ShadingTimer timer;)
+	RT_STAT_ADD(STAT_PRIMARY_RAYS, 1);
+
+	const Object * pObject = null;
+	Result result;
+	++mRays;
+	const bool bHit = mScene.FindObject(pObject, result, ray);
+
+	const PrimaryHit hit = { bHit ? pObject : null, result.point, result.normal };
+	mpGBuffer->Store(x, y, sample, hit);
+
+	if (!bHit)
+		return mScene.GetBackgroundColor();
+
+	RT_STATS_ONLY(timer.SetSlot(pObject->GetMaterial().type);)
+	return ShadeHit(ray, *pObject, result.point, result.normal, 0);
 }
 
 //=============================================================================
-static bool ComputeTransmission(
+bool ComputeTransmission(
 	const Vector3 & I, 
 	const Vector3 & N, 
 	const float32 nI,
@@ -208,12 +373,27 @@ static bool ComputeTransmission(
 //=============================================================================
 Color Renderer::SampleScene (const Ray3 & ray, unsigned recursiveDepth)
 {
+	RT_STATS_ONLY(ShadingTimer timer;)
+	RT_STAT_ADD(STAT_PRIMARY_RAYS, !recursiveDepth);
+	RT_STAT_ADD(STAT_SECONDARY_RAYS, !!recursiveDepth);
+
 	const Object * pObject = null;
 	Result bestResult;
+	++mRays;
 	if (!mScene.FindObject(pObject, bestResult, ray))
 		return mScene.GetBackgroundColor();
 
-	const Material & mat = pObject->GetMaterial();
+	RT_STATS_ONLY(timer.SetSlot(pObject->GetMaterial().type);)
+	return ShadeHit(ray, *pObject, bestResult.point, bestResult.normal, recursiveDepth);
+}
+
+//=============================================================================
+// Everything after finding what the ray hit, with the rays the surface spawns
+Color Renderer::ShadeHit (const Ray3 & ray, const Object & object, const Point3 & P, const Vector3 & N, uint32 recursiveDepth)
+{
+	mPathMaterials |= GetMaterialBit(object.GetMaterialIndex());
+
+	const Material & mat = object.GetMaterial();
 
 	Color f = mat.diffuse;
 	const float32 p = Max(f.r, f.g, f.b);
@@ -221,16 +401,17 @@ Color Renderer::SampleScene (const Ray3 & ray, unsigned recursiveDepth)
 	if (recursiveDepth > 5)
 	{
 		if (mRand.GetFloat32() >= p || recursiveDepth > 16)
+		{
+			RT_STAT_ADD(STAT_ROULETTE_KILLS, 1);
 			return mat.emissive;
+		}
 		f /= p;
 	}
 
 	//assert(Normalized(ray.direction));
-	//assert(Normalized(bestResult.normal));
+	//assert(Normalized(N));
 
-	const Point3 &  P = bestResult.point;
 	const Vector3 & D = ray.direction;
-	const Vector3 & N = bestResult.normal;
 
 	switch (mat.type)
 	{
@@ -310,34 +491,55 @@ Color Renderer::SampleScene (const Ray3 & ray, unsigned recursiveDepth)
 //=============================================================================
 void Renderer::CopyToBackbuffer()
 {
-    for (uint y = 0; y < mBlock.height; ++y)
-    {
-        for (uint x = 0; x < mBlock.width; ++x)
-        {
-            mBackbuffer.SetPixel(
-                mBlock.x + x,
-                mBlock.y + y,
-                mBuffer.GetPixel(x, y)
-            );
-        }
-    }
+    TraceScope trace(TRACE_COPY_TO_BACKBUFFER, mBlock.x, mBlock.y);
+
+    mBuffer.Resolve(mBackbuffer, mBlock.x, mBlock.y);
+
+    // Blocks never overlap, so renderers can merge without a lock
+    if (mManager.mAccumulation)
+        mManager.mAccumulation->Merge(mBuffer, mBlock.x, mBlock.y);
+}
+
+//=============================================================================
+bool Renderer::GetBlock (Block & out)
+{
+    TraceScope trace(TRACE_GET_BLOCK);
+    return mManager.GetBlock(out);
 }
 
 //=============================================================================
 void Renderer::ThreadEnter()
 {
-    
-    Block block;
-	while (mManager.GetBlock(block))
-	{
-		Setup(block);
-		Render();
-		CopyToBackbuffer();
-		Cleanup();
+	SetTraceThreadName("Renderer");
+
+	if (mProcessor != NO_PROCESSOR)
+		PinCurrentThread(mProcessor);
 
+	while (RenderNextBlock())
+	{
 	}
 
 	mbDone = true;
 }
 
+//=============================================================================
+bool Renderer::RenderNextBlock ()
+{
+	Block block;
+	if (!GetBlock(block))
+		return false;
+
+	Setup(block);
+
+	if (!Render())
+	{
+		Abort();
+		return true;
+	}
+
+	CopyToBackbuffer();
+	Cleanup();
+	return true;
+}
+
 }// namespace RT
\ No newline at end of file
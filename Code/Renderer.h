@@ -23,6 +23,27 @@ struct Block
 	uint height;
 };
 
+//! Directions about +x, weighted by the cosine to it
+Vector3 SampleInHemisphere (const Random & rand);
+//! Directions about +z, all equally likely
+Vector3 UniformSampleInHemisphere (const Random & rand);
+//! Directions about +z, weighted by the cosine to it
+Vector3 CosineSampleInHemisphere (const Random & rand);
+
+//! Splits the ray of direction I hitting a surface of normal N, going from a medium of index nI
+//! into one of index nT, into transmitted T and reflected R with the fraction of light each
+//! carries. Returns true on total internal reflection, T is left untouched then.
+bool ComputeTransmission (
+	const Vector3 & I,
+	const Vector3 & N,
+	const float32 nI,
+	const float32 nT,
+	Vector3 & T,
+	float32 & coeffT,
+	Vector3 & R,
+	float32 & coeffR
+);
+
 
 
 //==================================================================================================
@@ -35,24 +56,50 @@ class Renderer : public CThread
 {
 	
 public:
-	Renderer (Scene & scene, Camera & camera, CImage & backbuffer, RenderManager & manager);
+	static const uint NO_PROCESSOR = ~0u;
+
+	Renderer (const Scene & scene, const Camera & camera, CImage & backbuffer, RenderManager & manager);
     //Renderer (Renderer && rhs);
 
 	void SetSamplesPerPixel (uint spp);
+	void SetSampleRange (uint begin, uint end);
+	//! Off sends every sample of a pixel through its center
+	inline void SetJitter (bool jitter) { mbJitter = jitter; }
+	//! Camera ray hits are looked up in and added to gbuffer, which is null to trace them all
+	inline void SetGBuffer (GBuffer * gbuffer) { mpGBuffer = gbuffer; }
+	//! The material bits of every rendered pixel's paths are added to mask, which is null to skip it
+	inline void SetMaterialMask (MaterialMask * mask) { mpMaterialMask = mask; }
+	//! Pixels the material mask says never touched one of changedMaterials copy their samples from
+	//! previous instead of being rendered
+	inline void SetReuse (const CAccumulationBuffer * previous, uint64 changedMaterials) { mpReuse = previous; mChangedMaterials = changedMaterials; }
+	//! Pins the thread to processor once it starts
+	inline void SetProcessor (uint processor) { mProcessor = processor; }
 	inline bool IsDone () const { return mbDone; }
 
+	//! Takes a block from the manager and renders it on the calling thread, returns false when
+	//! the manager had no block left. This is all the thread does, in a loop.
+	bool RenderNextBlock ();
+
+	//! Seconds it takes to trace the first sample of every stride-th pixel of block, on the
+	//! calling thread, as a cheap estimate of what rendering it costs
+	float32 MeasureBlock (const Block & block, uint stride);
+
 private: // Thread
 	virtual void ThreadEnter();
 
 private: // Internal Private
 
-	Color SamplePixel (const float64 & u, const float64 & v);
+	Color SamplePixel (uint x, uint y, const float64 & u, const float64 & v);
+	Color SamplePrimary (uint x, uint y, uint sample, const Ray3 & ray);
 	Color SampleScene (const Ray3 & ray, uint32 recursiveDepth = 0);
+	Color ShadeHit (const Ray3 & ray, const Object & object, const Point3 & P, const Vector3 & N, uint32 recursiveDepth);
 
+	bool GetBlock (Block & out);
 	void Setup (const Block & block);
-	void Render();
+	bool Render();		// False when the render was cancelled part way through the block
 	void CopyToBackbuffer();
 	void Cleanup();
+	void Abort();
 
 	Block	mBlock;
 	bool	mbDone;		// Flag to that will be set when this renderer is finished with its work
@@ -60,21 +107,33 @@ private: // Internal Private
 	uint    mSpp;					// Total samples per pixel
 	uint	mSamplesStratifiedSide; // Number of samples per side of a pixel to be stratified
 	uint	mSamplesRandom;			// Number of samples which are left over from stratified
+	uint	mSampleBegin;			// Range of the samples of each pixel this renderer takes
+	uint	mSampleEnd;
 	//Vector2	mPixelSize; 			// Size of a pixel (Camera Space)
 	//Vector2    mSubPixelSize;			// Size of each sub-pixel area for stratified sampling (Camera Space)
 	float64 mPixelWidth;
 	float64 mPixelHeight;
 	float64 mSubPixelWidth;
 	float64 mSubPixelHeight;
+	bool    mbJitter;
+	GBuffer * mpGBuffer;
+	MaterialMask * mpMaterialMask;
+	const CAccumulationBuffer * mpReuse;
+	uint64  mChangedMaterials;
+	uint64  mPathMaterials;			// Material bits of the objects the pixel's paths touched so far
 
 
 	RenderManager & mManager;
 
-	CImage          mBuffer;     // The temporary buffer while rendering
+	CAccumulationBuffer mBuffer; // The temporary buffer while rendering
 	CImage &        mBackbuffer; // The output bitmap where this renderer will be drawing to
-	Scene           mScene;		 // The input scene of objects
-	Camera &        mCamera;	 // The camera this renderer will fetch primary rays from
+	const Scene &   mScene;		 // The input scene of objects, shared read-only between renderers
+	const Camera &  mCamera;	 // The camera this renderer will fetch primary rays from
 	Random          mRand;
+	uint64          mRays;		 // Traced in the current block, handed to the manager with it
+	uint64          mReusedPixels; // Of the current block, handed to the manager with it
+	float32         mRenderSeconds; // Time Render took for the current block
+	uint            mProcessor;  // NO_PROCESSOR leaves the thread wherever the OS puts it
 };
 
 }; // namespace RT
@@ -0,0 +1,76 @@
+//==================================================================================================
+//
+// File:	Report.cpp
+//
+// Helpers for writing machine-readable output.
+//
+//=================================================================================================
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif !defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+#include <cstdio>
+#include <ostream>
+
+#include "Pch.h"
+
+//=============================================================================
+std::ostream & operator<< (std::ostream & out, const JsonString & s)
+{
+	out << '"';
+	for (const char * it = s.str; *it != '\0'; ++it)
+	{
+		if (*it == '"' || *it == '\\')
+			out << '\\' << *it;
+		else if (*it == '\n')
+			out << "\\n";
+		else
+			out << *it;
+	}
+	out << '"';
+
+	return out;
+}
+
+//=============================================================================
+uint64 GetPeakResidentBytes ()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+
+	return counters.PeakWorkingSetSize;
+#elif defined(__linux__)
+	// Not getrusage, whose peak carries over from the process before an exec
+	FILE * status = fopen("/proc/self/status", "r");
+	if (!status)
+		return 0;
+
+	uint64 kilobytes = 0;
+	char   line[256];
+	while (fgets(line, sizeof(line), status))
+	{
+		unsigned long long value;
+		if (sscanf(line, "VmHWM: %llu kB", &value) == 1)
+		{
+			kilobytes = value;
+			break;
+		}
+	}
+
+	fclose(status);
+	return kilobytes * 1024;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage))
+		return 0;
+
+	return uint64(usage.ru_maxrss);
+#endif
+}
@@ -0,0 +1,30 @@
+//==================================================================================================
+//
+// File:	Report.h
+//
+// Helpers for writing machine-readable output (stats, replies to render clients).
+//=================================================================================================
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <iosfwd>
+
+//=============================================================================
+// JsonString - streams a quoted and escaped json string
+//=============================================================================
+struct JsonString
+{
+	JsonString(const char * s) :
+		str(s ? s : "")
+	{
+	}
+
+	const char * str;
+};
+
+std::ostream & operator<< (std::ostream & out, const JsonString & s);
+
+//! Most memory the process has had resident at once, in bytes, 0 where it can not be queried
+uint64 GetPeakResidentBytes ();
+
+#endif //REPORT_H
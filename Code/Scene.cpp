@@ -8,20 +8,84 @@
 //
 //=================================================================================================
 
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <tuple>
+
 #include "Pch.h"
 
 namespace RT
 {
 
+//=============================================================================
+// Helpers
+//=============================================================================
+
+// Refits are kept while the tree costs at most this much more than when it was built
+static const float32 REFIT_COST_RATIO   = 1.25f;
+// Subtrees which grew more than this since they were built are rebuilt
+static const float32 SUBTREE_AREA_RATIO = 2.0f;
+
+//=============================================================================
+// Calls fn with every node below node, and node itself
+template <typename TFunction>
+static void ForEachNode (const Bvh & bvh, uint32 node, TFunction && fn)
+{
+	const BvhNode * nodes = bvh.GetNodes();
+
+	std::vector<uint32> stack(1, node);
+	while (!stack.empty())
+	{
+		const uint32 index = stack.back();
+		stack.pop_back();
+
+		fn(index);
+
+		if (!nodes[index].count)
+		{
+			stack.push_back(index + 1);
+			stack.push_back(nodes[index].offset);
+		}
+	}
+}
+
+//=============================================================================
+const char * GetBvhUpdateName (EBvhUpdate update)
+{
+	switch (update)
+	{
+		case BVH_UPDATE_REFIT:   return "refit";
+		case BVH_UPDATE_PARTIAL: return "partial";
+		default:                 return "rebuild";
+	}
+}
+
+
+
+//=============================================================================
+// Scene
+//=============================================================================
+
 //=============================================================================
 Scene::Scene () :
-	mBackground(0.0f, 0.0f, 0.0f)
+	mBackground(0.0f, 0.0f, 0.0f),
+	mBvhBuilder(BVH_BUILDER_SAH),
+	mBvhBuildSeconds(0.0f),
+	mBvhBuildCost(0.0f)
 {
 }
 
 //=============================================================================
 Scene::Scene (const Scene & scene) :
-	mBackground(scene.mBackground)
+	mBackground(scene.mBackground),
+	mBvh(scene.mBvh),
+	mBvhBuilder(scene.mBvhBuilder),
+	mBvhBuildSeconds(scene.mBvhBuildSeconds),
+	mTracks(scene.mTracks),
+	mBvhBuildCost(scene.mBvhBuildCost),
+	mBvhBuildAreas(scene.mBvhBuildAreas)
 {
 	for( uint32 i = 0; i < scene.mpObjects.size(); ++i )
 	{
@@ -37,12 +101,252 @@ Scene::~Scene ()
 		delete mpObjects[i];
 }
 
+//=============================================================================
+void Scene::Clear ()
+{
+	for (const Object * pObject : mpObjects)
+		delete pObject;
+
+	mpObjects.clear();
+	mBvh.Clear();
+	mTracks.clear();
+	mBvhBuildAreas.clear();
+}
+
+//=============================================================================
+// The scene owns its objects, they are only const to whoever traces them
+void Scene::SetMaterial (uint32 index, const Material & material)
+{
+	ASSERT(index < mpObjects.size());
+	const_cast<Object *>(mpObjects[index])->SetMaterial(material);
+}
+
+//=============================================================================
+// Materials are equal when SameMaterial in watch mode would say so, by type,
+// diffuse and emissive color
+uint32 Scene::IndexMaterials ()
+{
+	typedef std::tuple<uint32, float32, float32, float32, float32, float32, float32> MaterialKey;
+
+	std::map<MaterialKey, uint32> indices;
+	for (const Object * pObject : mpObjects)
+	{
+		const Material & material = pObject->GetMaterial();
+		const MaterialKey key(
+			uint32(material.type),
+			material.diffuse.r, material.diffuse.g, material.diffuse.b,
+			material.emissive.r, material.emissive.g, material.emissive.b
+		);
+
+		const auto inserted = indices.insert(std::make_pair(key, uint32(indices.size())));
+		const_cast<Object *>(pObject)->SetMaterialIndex(inserted.first->second);
+	}
+
+	return uint32(indices.size());
+}
+
+//=============================================================================
+void Scene::BuildBvh ()
+{
+	const Time::Point start = Time::GetRealTime();
+
+	std::vector<Aabb3> bounds;
+	GetObjectBounds(&bounds);
+
+	mBvh.Build(bounds, mBvhBuilder);
+
+	// Animated scenes compare later frames' hierarchies to this one
+	mBvhBuildAreas.clear();
+	if (IsAnimated())
+	{
+		mBvhBuildCost = mBvh.ComputeSahCost();
+		for (uint32 i = 0; i < mBvh.GetNodeCount(); ++i)
+			mBvhBuildAreas.push_back(GetHalfArea(mBvh.GetNodes()[i]));
+	}
+
+	mBvhBuildSeconds = (Time::GetRealTime() - start).GetSeconds();
+}
+
+//=============================================================================
+void Scene::GetObjectBounds (std::vector<Aabb3> * bounds) const
+{
+	bounds->resize(mpObjects.size());
+	for (uint32 i = 0; i < mpObjects.size(); ++i)
+		(*bounds)[i] = mpObjects[i]->GetBounds();
+}
+
+//=============================================================================
+void Scene::GetMeshes (std::vector<const Mesh *> * meshes) const
+{
+	meshes->clear();
+	for (const Object * object : mpObjects)
+	{
+		if (object->GetShapeType() == SHAPE_TYPE_INSTANCE)
+			object = static_cast<const Instance *>(object)->GetAsset().get();
+
+		if (object->GetShapeType() == SHAPE_TYPE_MESH)
+			meshes->push_back(static_cast<const TriangleMesh *>(object)->GetMesh().get());
+	}
+
+	std::sort(meshes->begin(), meshes->end());
+	meshes->erase(std::unique(meshes->begin(), meshes->end()), meshes->end());
+}
+
+//=============================================================================
+uint32 Scene::QuantizeMeshBvhs ()
+{
+	std::vector<const Mesh *> meshes;
+	GetMeshes(&meshes);
+
+	// Meshes are shared as const by the objects using them, the scene is what owns them
+	uint32 quantized = 0;
+	for (const Mesh * mesh : meshes)
+	{
+		if (const_cast<Mesh *>(mesh)->Quantize())
+			++quantized;
+	}
+
+	return quantized;
+}
+
+//=============================================================================
+uint64 Scene::GetBvhMemorySize () const
+{
+	std::vector<const Mesh *> meshes;
+	GetMeshes(&meshes);
+
+	uint64 size = mBvh.GetMemorySize();
+	for (const Mesh * mesh : meshes)
+		size += mesh->GetBvhMemorySize();
+
+	return size;
+}
+
+//=============================================================================
+EBvhUpdate Scene::SetFrame (float32 frame)
+{
+	for (const AnimationTrack & track : mTracks)
+	{
+		ASSERT(track.object < mpObjects.size());
+		ASSERT(mpObjects[track.object]->GetShapeType() == SHAPE_TYPE_INSTANCE);
+
+		const TransformDesc desc = SampleAnimationTrack(track, frame);
+
+		// A blend which can not be inverted keeps the last frame's transform
+		Matrix33 linear;
+		if (!ComputeTransform(desc, &linear))
+			continue;
+
+		// The scene owns its objects, they are only const to everyone rendering it
+		Instance * instance = const_cast<Instance *>(static_cast<const Instance *>(mpObjects[track.object]));
+		instance->SetTransform(linear, desc.translate);
+	}
+
+	return UpdateBvh();
+}
+
+//=============================================================================
+// A refit is by far the cheapest update but the tree gets worse the further the instances move
+// from where they were built. Subtrees whose boxes grew the most are rebuilt in place first and
+// the whole tree only when that is not enough.
+EBvhUpdate Scene::UpdateBvh ()
+{
+	if (mBvh.IsEmpty() || mBvhBuildAreas.size() != mBvh.GetNodeCount())
+	{
+		BuildBvh();
+		return BVH_UPDATE_REBUILD;
+	}
+
+	std::vector<Aabb3> bounds;
+	GetObjectBounds(&bounds);
+
+	mBvh.Refit(bounds);
+	if (mBvh.ComputeSahCost() <= mBvhBuildCost * REFIT_COST_RATIO)
+		return BVH_UPDATE_REFIT;
+
+	// The top-most subtrees which grew too much, the root is what a full build is for
+	std::vector<uint32> grown;
+	std::vector<uint32> stack;
+	if (!mBvh.GetNodes()[0].count)
+	{
+		stack.push_back(1);
+		stack.push_back(mBvh.GetNodes()[0].offset);
+	}
+
+	std::vector<uint32> depths(mBvh.GetNodeCount(), 1);
+	while (!stack.empty())
+	{
+		const uint32    index = stack.back();
+		const BvhNode & node  = mBvh.GetNodes()[index];
+		stack.pop_back();
+
+		if (node.count)
+			continue;
+
+		// Leaves are left refitted, rebuilding one would only split it
+		if (GetHalfArea(node) > mBvhBuildAreas[index] * SUBTREE_AREA_RATIO)
+		{
+			grown.push_back(index);
+		}
+		else
+		{
+			depths[index + 1]    = depths[index] + 1;
+			depths[node.offset] = depths[index] + 1;
+			stack.push_back(index + 1);
+			stack.push_back(node.offset);
+		}
+	}
+
+	// A subtree whose new hierarchy would not fit in its nodes stays refitted
+	std::vector<uint32> rebuilt;
+	for (uint32 node : grown)
+	{
+		if (mBvh.RebuildSubtree(node, depths[node], bounds, mBvhBuilder))
+			rebuilt.push_back(node);
+	}
+
+	if (!rebuilt.empty())
+	{
+		// Ancestors of the rebuilt subtrees still bound their old boxes
+		mBvh.Refit(bounds);
+
+		if (mBvh.ComputeSahCost() <= mBvhBuildCost * REFIT_COST_RATIO)
+		{
+			for (uint32 node : rebuilt)
+				ForEachNode(mBvh, node, [&](uint32 index) { mBvhBuildAreas[index] = GetHalfArea(mBvh.GetNodes()[index]); });
+
+			return BVH_UPDATE_PARTIAL;
+		}
+	}
+
+	BuildBvh();
+	return BVH_UPDATE_REBUILD;
+}
+
 //=============================================================================
 bool Scene::FindObject (const Object *& pBestObject, Result & bestResult, const Ray3 & ray) const 
 {
 	pBestObject = null;
 	bestResult.time = std::numeric_limits<float32>::infinity();
 
+	if (!mBvh.IsEmpty())
+	{
+		mBvh.Traverse(ray, bestResult.time, [&](uint32 index, float32 & maxTime) {
+			const Object * pObject = mpObjects[index];
+
+			Result result;
+			if (pObject->Intersect(result, ray) && result.time < bestResult.time)
+			{
+				bestResult  = result;
+				pBestObject = pObject;
+				maxTime     = result.time;
+			}
+		});
+
+		return pBestObject != null;
+	}
+
+	RT_STAT_ADD(STAT_PRIMITIVE_TESTS, mpObjects.size());
 	for (uint32 i = 0; i < mpObjects.size(); ++i)
 	{
 		const Object * pObject = mpObjects[i];
@@ -61,6 +365,345 @@ bool Scene::FindObject (const Object *& pBestObject, Result & bestResult, const
 	return pBestObject != null;
 }
 
+//=============================================================================
+bool LoadScene (const char * filename, Scene * scene, SceneSettings * settings)
+{
+    ASSERT(scene);
+    ASSERT(settings);
+
+    using namespace Json;
+
+    settings->width    = 0;
+    settings->height   = 0;
+    settings->spp      = 0;
+    settings->bvhNodes = BVH_NODES_FULL;
+
+    if (IsBinaryScene(filename))
+        return LoadBinaryScene(filename, scene, settings, null);
+
+    CDocument doc;
+    doc.Parse(filename);
+
+    if (!doc.IsValid())
+        return false;
+
+    const CValue & root = doc.GetValue();
+    if (root.GetType() != EType::Object)
+        return false;
+    
+    // Settings
+    scene->SetBackgroundColor(Color::Black);
+    breakable_scope
+    {
+        const CValue & jsonSettings = root[{"settings"}];
+        if (jsonSettings == null)
+            break;
+
+        // Size
+        breakable_scope
+        {
+            const CValue & jsonSize = jsonSettings[{"size"}];
+            if (jsonSize == null)
+                break;
+
+            Vector2 size;
+            if (!ParseVector2(jsonSize, &size))
+                break;
+
+            settings->width  = FloatToUint(float32(size.x));
+            settings->height = FloatToUint(float32(size.y));
+        }
+
+        // Samples
+        breakable_scope
+        {
+            const CValue & samplesValue = jsonSettings[{"samples"}];
+            if (samplesValue == null)
+                break;
+
+            const auto * samples = samplesValue.As<NumberType>();
+            if (!samples)
+                break;
+
+            settings->spp = FloatToUint(float32(*samples));
+        }
+
+        // Bvh nodes
+        breakable_scope
+        {
+            const CValue & jsonNodes = jsonSettings[{"bvh_nodes"}];
+            if (jsonNodes.GetType() != EType::String)
+                break;
+
+            ParseBvhNodes(jsonNodes.As<StringType>()->Ptr(), &settings->bvhNodes);
+        }
+
+        // Background
+        breakable_scope
+        {
+            const CValue & jsonBg = jsonSettings[{"background"}];
+            if (jsonBg == null)
+                break;
+            
+            Color color;
+            if (!ParseColor(jsonBg, &color))
+                break;
+
+            scene->SetBackgroundColor(color);
+        }
+    }
+    
+    // Camera
+    if (!ParseCamera(root[{"camera"}], &settings->camera))
+        return false;
+
+    // Mesh files are relative to the scene
+    const std::string path      = filename;
+    const size_t      separator = path.find_last_of("/\\");
+    SceneAssets assets(separator == std::string::npos ? std::string() : path.substr(0, separator), scene->mBvhBuilder);
+
+    // Assets, shapes which are only placed in the scene by instances
+    breakable_scope
+    {
+        const CValue & jsonAssets = root[{"assets"}];
+        if (jsonAssets == null)
+            break;
+
+        if (jsonAssets.GetType() != EType::Array)
+            break;
+
+        // Instances bring their own material
+        Material material;
+        material.type     = MATERIAL_TYPE_DIFFUSE;
+        material.diffuse  = Color(1.0f, 1.0f, 1.0f);
+        material.emissive = Color::Black;
+
+        for (const CValue & jsonAsset : *jsonAssets.As<ArrayType>())
+        {
+            const CValue & jsonName = jsonAsset[{"name"}];
+            if (jsonName.GetType() != EType::String)
+                continue;
+
+            Object * shape = ParseShape(jsonAsset[{"shape"}], material, &assets);
+            if (!shape)
+                continue;
+
+            // Instances of instances are not supported
+            if (shape->GetShapeType() == SHAPE_TYPE_INSTANCE)
+            {
+                delete shape;
+                continue;
+            }
+
+            assets.AddShape(jsonName.As<StringType>()->Ptr(), std::shared_ptr<const Object>(shape));
+        }
+    }
+
+    //Objects
+    std::vector<AnimationTrack> tracks;
+    breakable_scope
+    {
+        const CValue & jsonObjects = root[{"objects"}];
+        if (jsonObjects == null)
+            break;
+
+        if (jsonObjects.GetType() != EType::Array)
+            break;
+
+        for (const CValue & jsonObject : *jsonObjects.As<ArrayType>())
+        {
+            if (jsonObject.GetType() != EType::Object)
+                continue;
+
+            Object * object = ParseObject(jsonObject, &assets);
+            if (!object)
+                continue;
+
+            // Instances can be keyframed
+            const CValue & jsonKeyframes = jsonObject[{"shape"}][{"keyframes"}];
+            if (object->GetShapeType() == SHAPE_TYPE_INSTANCE && jsonKeyframes.GetType() == EType::Array)
+            {
+                AnimationTrack track;
+                if (ParseAnimationTrack(jsonKeyframes, uint32(scene->mpObjects.size()), &track))
+                    tracks.push_back(std::move(track));
+            }
+
+            scene->AddObject(object);
+        }
+    }
+
+    if (!tracks.empty())
+    {
+        scene->SetAnimation(std::move(tracks));
+        scene->SetFrame(0.0f);
+    }
+    else
+    {
+        scene->BuildBvh();
+    }
+
+    return true;
+}
+
+//=============================================================================
+// Objects whose shape fails to parse are left out by LoadScene, which this
+// can't tell without loading the shapes, so callers compare the count
+bool LoadSceneMaterials (const char * filename, std::vector<Material> * materials)
+{
+    ASSERT(materials);
+
+    using namespace Json;
+
+    materials->clear();
+
+    if (IsBinaryScene(filename))
+        return false;
+
+    CDocument doc;
+    doc.Parse(filename);
+
+    if (!doc.IsValid())
+        return false;
+
+    const CValue & jsonObjects = doc.GetValue()[{"objects"}];
+    if (jsonObjects.GetType() != EType::Array)
+        return true;
+
+    for (const CValue & jsonObject : *jsonObjects.As<ArrayType>())
+    {
+        if (jsonObject.GetType() != EType::Object)
+            continue;
+
+        Material material;
+        if (!ParseMaterial(jsonObject[{"material"}], &material))
+            return false;
+
+        materials->push_back(material);
+    }
+
+    return true;
+}
+
+//=============================================================================
+// Streams a vector, point or color as a json array
+struct JsonTriple
+{
+    JsonTriple (float32 x, float32 y, float32 z) :
+        v{ x, y, z }
+    {
+    }
+
+    float32 v[3];
+};
+
+//=============================================================================
+static std::ostream & operator<< (std::ostream & out, const JsonTriple & t)
+{
+    return out << '[' << t.v[0] << ',' << t.v[1] << ',' << t.v[2] << ']';
+}
+
+//=============================================================================
+template <typename T>
+static JsonTriple ToJson (const T & v)
+{
+    return JsonTriple(v[0], v[1], v[2]);
+}
+
+//=============================================================================
+static JsonTriple ToJson (const Color & c)
+{
+    return JsonTriple(c.r, c.g, c.b);
+}
+
+//=============================================================================
+bool SaveJsonScene (const char * filename, const Scene & scene, const SceneSettings & settings)
+{
+    if (scene.IsAnimated())
+        return false;
+
+    for (const Object * pObject : scene.mpObjects)
+    {
+        const EShapeType type = pObject->GetShapeType();
+        if (type != SHAPE_TYPE_SPHERE && type != SHAPE_TYPE_ELLIPSOID && type != SHAPE_TYPE_AABB)
+            return false;
+    }
+
+    std::ofstream out(filename);
+    if (!out)
+        return false;
+
+    // Enough digits for every float to read back the same
+    out << std::setprecision(9);
+
+    out << "{\n\t\"settings\" : {";
+    if (settings.width && settings.height)
+        out << "\"size\" : [" << settings.width << ", " << settings.height << "], ";
+    if (settings.spp)
+        out << "\"samples\" : " << settings.spp << ", ";
+    if (settings.bvhNodes != BVH_NODES_FULL)
+        out << "\"bvh_nodes\" : " << JsonString(GetBvhNodesName(settings.bvhNodes)) << ", ";
+    out << "\"background\" : " << ToJson(scene.GetBackgroundColor()) << "},\n";
+
+    const CameraDesc & camera = settings.camera;
+    out
+        << "\t\"camera\" : {"
+        << "\"eye\" : "        << ToJson(camera.eye)
+        << ", \"lookat\" : "   << ToJson(camera.lookat)
+        << ", \"up\" : "       << ToJson(camera.up)
+        << ", \"distance\" : " << camera.distance
+        << ", \"width\" : "    << camera.width
+        << "},\n";
+
+    // One object per line
+    static const char * const MATERIAL_NAMES[] = { "diffuse", "reflect", "refract" };
+
+    out << "\t\"objects\" : [\n";
+    for (size_t i = 0; i < scene.mpObjects.size(); ++i)
+    {
+        const Object *   pObject  = scene.mpObjects[i];
+        const Material & material = pObject->GetMaterial();
+
+        out
+            << "\t\t{\"material\" : {\"type\" : \"" << MATERIAL_NAMES[material.type] << '"'
+            << ", \"diffuse\" : "  << ToJson(material.diffuse)
+            << ", \"emissive\" : " << ToJson(material.emissive)
+            << "}, \"shape\" : {";
+
+        switch (pObject->GetShapeType())
+        {
+            case SHAPE_TYPE_SPHERE:
+            {
+                const Sphere3 & sphere = static_cast<const Sphere *>(pObject)->GetSphere();
+                out << "\"type\" : \"sphere\", \"center\" : " << ToJson(sphere.center) << ", \"radius\" : " << sphere.radius;
+            }
+            break;
+
+            case SHAPE_TYPE_ELLIPSOID:
+            {
+                const Ellipsoid * pEllipsoid = static_cast<const Ellipsoid *>(pObject);
+                out
+                    << "\"type\" : \"ellipsoid\", \"center\" : " << ToJson(pEllipsoid->GetCenter())
+                    << ", \"u\" : " << ToJson(pEllipsoid->GetAxis(0))
+                    << ", \"v\" : " << ToJson(pEllipsoid->GetAxis(1))
+                    << ", \"w\" : " << ToJson(pEllipsoid->GetAxis(2));
+            }
+            break;
+
+            default:
+            {
+                const Aabb3 & aabb = static_cast<const Aabb *>(pObject)->GetAabb();
+                out << "\"type\" : \"aabb\", \"min\" : " << ToJson(aabb.min) << ", \"max\" : " << ToJson(aabb.max);
+            }
+            break;
+        }
+
+        out << "}}" << (i + 1 < scene.mpObjects.size() ? ",\n" : "\n");
+    }
+    out << "\t]\n}\n";
+
+    return bool(out);
+}
+
 }// namespace RT
 
 
@@ -15,6 +15,16 @@ namespace RT
 class Object;
 class Light;
 
+//! How SetFrame brought the bvh up to date
+enum EBvhUpdate
+{
+	BVH_UPDATE_REFIT,		//!< Refitted, the hierarchy kept its shape
+	BVH_UPDATE_PARTIAL,		//!< Refitted with the subtrees that grew the most rebuilt
+	BVH_UPDATE_REBUILD,		//!< Built from scratch
+};
+
+const char * GetBvhUpdateName (EBvhUpdate update);
+
 //==================================================================================================
 //
 // Represents all the objects and properties of the raytraced environments
@@ -26,16 +36,46 @@ public:
 	Scene (const Scene & scene);
 	~Scene ();
 
-	//! Adds an object to the scene, the scene takes over this object
-	inline void AddObject (const Object * pObj) { mpObjects.push_back(pObj); }
+	//! Adds an object to the scene, the scene takes over this object. Call BuildBvh once done adding.
+	inline void AddObject (const Object * pObj) { mpObjects.push_back(pObj); mBvh.Clear(); }
 	//! Adds a light to the scene, the scene takes over this object
 	inline void AddLight (const Light * pLight) { mpLights.push_back(pLight); }
 
+	//! Deletes every object and the bvh over them
+	void Clear ();
+
+	//! Changes the material of object index in place, the bvh stays as it is. Not while rendering.
+	//! The object keeps its material index.
+	void SetMaterial (uint32 index, const Material & material);
+
+	//! Numbers the distinct materials of the objects, objects with equal materials get the same
+	//! material index. Returns how many distinct materials there are.
+	uint32 IndexMaterials ();
+
 	//! Sets the color to be used when no object is hit
 	inline void SetBackgroundColor (const Color & color) { mBackground = color; }
 
 	inline Color GetBackgroundColor () const { return mBackground; }
 	
+	//! Picks how BuildBvh and the meshes LoadScene reads build their hierarchies
+	inline void SetBvhBuilder (EBvhBuilder builder) { mBvhBuilder = builder; }
+
+	//! Builds the hierarchy FindObject uses, without one every object is tested against every ray
+	void BuildBvh ();
+
+	//! Animates the scene's instances, the scene takes over the tracks
+	inline void SetAnimation (std::vector<AnimationTrack> && tracks) { mTracks = std::move(tracks); }
+	inline bool IsAnimated () const { return !mTracks.empty(); }
+
+	//! Moves the animated instances to where they are at frame and updates the bvh around them
+	EBvhUpdate SetFrame (float32 frame);
+
+	//! Switches the meshes of the scene, instanced ones included, to quantized hierarchies. The
+	//! scene's own bvh stays full so it can still be refitted. Returns how many meshes switched.
+	uint32 QuantizeMeshBvhs ();
+	//! Bytes taken by the scene's bvh and those of every mesh, each mesh counted once
+	uint64 GetBvhMemorySize () const;
+
 	bool FindObject (const Object *& pBestObjectOut, Result & bestResultsOut, const Ray3 & ray) const;
 
 
@@ -43,8 +83,43 @@ public:
 	std::vector<const Object *>	mpObjects;	//!< List of objects in the scene
 	std::vector<const Light *>	mpLights;	//!< List of lights in the scene
 	Color 						mBackground;	//!< The color to be used when no object is intersected
+	Bvh							mBvh;		//!< Over mpObjects, indices are positions in mpObjects
+	EBvhBuilder					mBvhBuilder;
+	float32						mBvhBuildSeconds;	//!< How long the last BuildBvh took
+
+	std::vector<AnimationTrack>	mTracks;
+	float32						mBvhBuildCost;		//!< Sah cost of the last full build
+	std::vector<float32>		mBvhBuildAreas;		//!< Area of every node when it was last built
+
+private:
+	EBvhUpdate UpdateBvh ();
+	void GetObjectBounds (std::vector<Aabb3> * bounds) const;
+	void GetMeshes (std::vector<const Mesh *> * meshes) const;
 };
 
+//==================================================================================================
+//
+// Everything in a scene file which is not an object
+//==================================================================================================
+struct SceneSettings
+{
+	uint       width;		//!< 0 if the file does not specify a size
+	uint       height;
+	uint       spp;			//!< 0 if the file does not specify samples
+	EBvhNodes  bvhNodes;	//!< Full unless the file asks for quantized mesh hierarchies
+	CameraDesc camera;
+};
+
+//! Loads a json or binary scene file, adding its objects to the scene and building its bvh
+bool LoadScene (const char * filename, Scene * scene, SceneSettings * settings);
+//! Reads only the materials of a json scene file, one for every object in the order LoadScene adds
+//! them. False for binary scenes and when an object's material doesn't parse.
+bool LoadSceneMaterials (const char * filename, std::vector<Material> * materials);
+
+//! Writes scene as a json scene file. Only spheres, ellipsoids and boxes can be written, scenes
+//! with meshes, instances or keyframes are refused.
+bool SaveJsonScene (const char * filename, const Scene & scene, const SceneSettings & settings);
+
 } // namespace RT
 
 
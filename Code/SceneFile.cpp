@@ -0,0 +1,1095 @@
+//==================================================================================================
+//
+// File:	SceneFile.cpp
+//
+// Reads and writes binary scene files. Everything is stored in native byte order, a file is only
+// meant to be read on the architecture which wrote it.
+//
+//=================================================================================================
+
+#if !defined(_WIN32)
+#include <climits>
+#include <cstdlib>
+#endif
+#include <sys/stat.h>
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+// Format
+//=============================================================================
+static const char   SCENE_FILE_MAGIC[4]  = { 'R', 'T', 'S', 'B' };
+static const uint32 SCENE_FILE_VERSION   = 5;	// 2 added meshes, 3 instances, 4 ellipsoid inverses, 5 bvh nodes
+static const uint64 SCENE_FILE_ALIGNMENT = 16;	// Of every section, from the start of the file
+
+struct SceneFileSection
+{
+	uint64 offset;
+	uint64 count;
+};
+
+struct SceneFileHeader
+{
+	char             magic[4];
+	uint32           version;
+	uint64           sourceHash;
+
+	uint32           width;
+	uint32           height;
+	uint32           spp;
+	uint32           bvhNodes;	// EBvhNodes the scene asks for
+	float32          background[3];
+
+	float32          eye[3];
+	float32          lookat[3];
+	float32          up[3];
+	float32          distance;
+	float32          cameraWidth;
+
+	SceneFileSection materials;
+	SceneFileSection spheres;
+	SceneFileSection ellipsoids;
+	SceneFileSection aabbs;
+	SceneFileSection meshObjects;
+	SceneFileSection instances;
+	SceneFileSection nodes;		// BvhNode
+	SceneFileSection indices;	// uint32, objects are numbered spheres, ellipsoids, aabbs, mesh objects then instances
+
+	SceneFileSection meshes;
+	SceneFileSection meshPositions;	// float32, x y z per vertex
+	SceneFileSection meshIndices;	// uint32, three per triangle
+	SceneFileSection meshNodes;		// BvhNode
+	SceneFileSection meshBvhIndices;	// uint32
+
+	SceneFileSection assets;
+};
+
+struct PackedMaterial
+{
+	uint32  type;
+	float32 diffuse[3];
+	float32 emissive[3];
+};
+
+struct PackedSphere
+{
+	float32 center[3];
+	float32 radius;
+	uint32  material;
+};
+
+// Ellipsoids keep the world to unit sphere transform they render with, by columns
+struct PackedEllipsoid
+{
+	float32 center[3];
+	float32 objectToWorldI[3][3];
+	uint32  material;
+};
+
+struct PackedAabb
+{
+	float32 min[3];
+	float32 max[3];
+	uint32  material;
+};
+
+struct PackedMeshObject
+{
+	uint32 mesh;
+	uint32 material;
+};
+
+// The shape an instance refers to, data holds the fields of the matching packed shape
+struct PackedAsset
+{
+	uint32  type;		// EShapeType, never an instance
+	uint32  material;
+	uint32  mesh;
+	float32 data[12];
+};
+
+struct PackedInstance
+{
+	uint32  asset;
+	uint32  material;
+	float32 axes[3][3];
+	float32 translation[3];
+};
+
+// Ranges of the mesh sections, in items
+struct PackedMesh
+{
+	uint64 firstPosition;
+	uint64 firstIndex;
+	uint64 firstNode;
+	uint64 firstBvhIndex;
+	uint32 vertexCount;
+	uint32 triangleCount;
+	uint32 nodeCount;
+	uint32 bvhIndexCount;
+};
+
+
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+//=============================================================================
+static void Pack (float32 * out, const Vector3 & v)
+{
+	out[0] = v.x;
+	out[1] = v.y;
+	out[2] = v.z;
+}
+
+//=============================================================================
+static Vector3 Unpack (const float32 * in)
+{
+	return Vector3(in[0], in[1], in[2]);
+}
+
+//=============================================================================
+// Nine floats, one column after the other
+static void PackColumns (float32 * out, const Matrix33 & m)
+{
+	for (uint i = 0; i < 3; ++i)
+	{
+		Vector3 unit = Vector3::Zero;
+		unit[i] = 1.0f;
+		Pack(out + i * 3, m * unit);
+	}
+}
+
+//=============================================================================
+static Matrix33 UnpackColumns (const float32 * in)
+{
+	return Matrix33(
+		in[0], in[3], in[6],
+		in[1], in[4], in[7],
+		in[2], in[5], in[8]
+	);
+}
+
+//=============================================================================
+static PackedMaterial Pack (const Material & material)
+{
+	PackedMaterial out;
+	memset(&out, 0, sizeof(out));
+
+	out.type        = uint32(material.type);
+	out.diffuse[0]  = material.diffuse.r;
+	out.diffuse[1]  = material.diffuse.g;
+	out.diffuse[2]  = material.diffuse.b;
+	out.emissive[0] = material.emissive.r;
+	out.emissive[1] = material.emissive.g;
+	out.emissive[2] = material.emissive.b;
+
+	return out;
+}
+
+//=============================================================================
+static Material Unpack (const PackedMaterial & material)
+{
+	Material out;
+	out.type     = EMaterialType(material.type);
+	out.diffuse  = Color(material.diffuse[0], material.diffuse[1], material.diffuse[2]);
+	out.emissive = Color(material.emissive[0], material.emissive[1], material.emissive[2]);
+	return out;
+}
+
+//=============================================================================
+// Returns the section's items when it lies inside the file and is aligned, otherwise null
+template <typename T>
+static const T * GetSection (const MappedFile & file, const SceneFileSection & section)
+{
+	if (!section.count)
+		return null;
+
+	const uint64 size = file.GetSize();
+	if (section.offset % SCENE_FILE_ALIGNMENT || section.offset > size)
+		return null;
+
+	if (section.count > (size - section.offset) / sizeof(T))
+		return null;
+
+	return reinterpret_cast<const T *>(static_cast<const char *>(file.GetData()) + section.offset);
+}
+
+//=============================================================================
+static uint64 AlignSection (uint64 offset)
+{
+	return (offset + SCENE_FILE_ALIGNMENT - 1) / SCENE_FILE_ALIGNMENT * SCENE_FILE_ALIGNMENT;
+}
+
+//=============================================================================
+template <typename T>
+static void AddSection (SceneFileSection * section, uint64 * offset, const std::vector<T> & items)
+{
+	*offset = AlignSection(*offset);
+
+	section->offset = *offset;
+	section->count  = items.size();
+
+	*offset += items.size() * sizeof(T);
+}
+
+//=============================================================================
+template <typename T>
+static bool WriteSection (FILE * file, uint64 * written, const SceneFileSection & section, const std::vector<T> & items)
+{
+	static const char PADDING[SCENE_FILE_ALIGNMENT] = { };
+
+	if (!items.size())
+		return true;
+
+	const size_t padding = size_t(section.offset - *written);
+	if (padding && fwrite(PADDING, 1, padding, file) != padding)
+		return false;
+
+	if (fwrite(items.data(), sizeof(T), items.size(), file) != items.size())
+		return false;
+
+	*written = section.offset + items.size() * sizeof(T);
+	return true;
+}
+
+//=============================================================================
+static bool ReadHeader (const char * filename, SceneFileHeader * header)
+{
+	FILE * file = fopen(filename, "rb");
+	if (!file)
+		return false;
+
+	const bool read = fread(header, sizeof(*header), 1, file) == 1;
+	fclose(file);
+
+	return read
+		&& !memcmp(header->magic, SCENE_FILE_MAGIC, sizeof(header->magic))
+		&& header->version == SCENE_FILE_VERSION;
+}
+
+
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+bool IsBinaryScene (const char * filename)
+{
+	FILE * file = fopen(filename, "rb");
+	if (!file)
+		return false;
+
+	char magic[sizeof(SCENE_FILE_MAGIC)];
+	const bool read = fread(magic, sizeof(magic), 1, file) == 1;
+	fclose(file);
+
+	return read && !memcmp(magic, SCENE_FILE_MAGIC, sizeof(magic));
+}
+
+//=============================================================================
+bool LoadBinaryScene (const char * filename, Scene * scene, SceneSettings * settings, uint64 * sourceHash)
+{
+	ASSERT(scene);
+	ASSERT(settings);
+
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (!file->Open(filename))
+		return false;
+
+	if (file->GetSize() < sizeof(SceneFileHeader))
+		return false;
+
+	const SceneFileHeader & header = *static_cast<const SceneFileHeader *>(file->GetData());
+	if (memcmp(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic)) || header.version != SCENE_FILE_VERSION)
+		return false;
+
+	if (header.bvhNodes > BVH_NODES_QUANTIZED)
+		return false;
+
+	const PackedMaterial *   materials      = GetSection<PackedMaterial>(*file, header.materials);
+	const PackedSphere *     spheres        = GetSection<PackedSphere>(*file, header.spheres);
+	const PackedEllipsoid *  ellipsoids     = GetSection<PackedEllipsoid>(*file, header.ellipsoids);
+	const PackedAabb *       aabbs          = GetSection<PackedAabb>(*file, header.aabbs);
+	const PackedMeshObject * meshObjects    = GetSection<PackedMeshObject>(*file, header.meshObjects);
+	const PackedInstance *   instances      = GetSection<PackedInstance>(*file, header.instances);
+	const BvhNode *          nodes          = GetSection<BvhNode>(*file, header.nodes);
+	const uint32 *           indices        = GetSection<uint32>(*file, header.indices);
+
+	const PackedMesh *       meshes         = GetSection<PackedMesh>(*file, header.meshes);
+	const float32 *          meshPositions  = GetSection<float32>(*file, header.meshPositions);
+	const uint32 *           meshIndices    = GetSection<uint32>(*file, header.meshIndices);
+	const BvhNode *          meshNodes      = GetSection<BvhNode>(*file, header.meshNodes);
+	const uint32 *           meshBvhIndices = GetSection<uint32>(*file, header.meshBvhIndices);
+
+	const PackedAsset *      assets         = GetSection<PackedAsset>(*file, header.assets);
+
+	if (
+		(header.materials.count      && !materials)      ||
+		(header.spheres.count        && !spheres)        ||
+		(header.ellipsoids.count     && !ellipsoids)     ||
+		(header.aabbs.count          && !aabbs)          ||
+		(header.meshObjects.count    && !meshObjects)    ||
+		(header.instances.count      && !instances)      ||
+		(header.nodes.count          && !nodes)          ||
+		(header.indices.count        && !indices)        ||
+		(header.meshes.count         && !meshes)         ||
+		(header.meshPositions.count  && !meshPositions)  ||
+		(header.meshIndices.count    && !meshIndices)    ||
+		(header.meshNodes.count      && !meshNodes)      ||
+		(header.meshBvhIndices.count && !meshBvhIndices) ||
+		(header.assets.count         && !assets)
+	) {
+		return false;
+	}
+
+	const uint64 primitiveCount = header.spheres.count + header.ellipsoids.count + header.aabbs.count + header.meshObjects.count + header.instances.count;
+	if (primitiveCount > 0xffffffffull || header.nodes.count > 0xffffffffull || header.indices.count > 0xffffffffull)
+		return false;
+
+	// Materials
+	std::vector<Material> sceneMaterials(size_t(header.materials.count));
+	for (uint32 i = 0; i < header.materials.count; ++i)
+	{
+		if (materials[i].type > MATERIAL_TYPE_REFRACT)
+			return false;
+
+		sceneMaterials[i] = Unpack(materials[i]);
+	}
+
+	auto validMaterial = [&](uint32 material) { return material < sceneMaterials.size(); };
+
+	// Meshes, viewed in place
+	auto inSection = [](uint64 first, uint64 count, const SceneFileSection & section) {
+		return first <= section.count && count <= section.count - first;
+	};
+
+	std::vector<std::shared_ptr<const Mesh>> sceneMeshes(size_t(header.meshes.count));
+	for (uint32 i = 0; i < header.meshes.count; ++i)
+	{
+		const PackedMesh & packed = meshes[i];
+		if (
+			!inSection(packed.firstPosition, uint64(packed.vertexCount) * 3, header.meshPositions) ||
+			!inSection(packed.firstIndex, uint64(packed.triangleCount) * 3, header.meshIndices) ||
+			!inSection(packed.firstNode, packed.nodeCount, header.meshNodes) ||
+			!inSection(packed.firstBvhIndex, packed.bvhIndexCount, header.meshBvhIndices)
+		) {
+			return false;
+		}
+
+		Bvh bvh;
+		bvh.SetView(meshNodes + packed.firstNode, packed.nodeCount, meshBvhIndices + packed.firstBvhIndex, packed.bvhIndexCount, file);
+
+		std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+		if (!mesh->SetView(meshPositions + packed.firstPosition, packed.vertexCount, meshIndices + packed.firstIndex, packed.triangleCount, bvh, file))
+			return false;
+
+		sceneMeshes[i] = mesh;
+	}
+
+	// Assets, shared by the instances
+	std::vector<std::shared_ptr<const Object>> sceneAssets(size_t(header.assets.count));
+	for (uint32 i = 0; i < header.assets.count; ++i)
+	{
+		const PackedAsset & asset = assets[i];
+		if (!validMaterial(asset.material))
+			return false;
+
+		const Material & material = sceneMaterials[asset.material];
+		const float32 *  data     = asset.data;
+
+		switch (asset.type)
+		{
+			case SHAPE_TYPE_SPHERE:
+				sceneAssets[i] = std::make_shared<Sphere>(Unpack(data), data[3], material);
+				break;
+
+			case SHAPE_TYPE_ELLIPSOID:
+				sceneAssets[i] = std::make_shared<Ellipsoid>(Unpack(data), UnpackColumns(data + 3), material);
+				break;
+
+			case SHAPE_TYPE_AABB:
+				sceneAssets[i] = std::make_shared<Aabb>(Unpack(data), Unpack(data + 3), material);
+				break;
+
+			case SHAPE_TYPE_MESH:
+				if (asset.mesh >= sceneMeshes.size())
+					return false;
+
+				sceneAssets[i] = std::make_shared<TriangleMesh>(sceneMeshes[asset.mesh], material);
+				break;
+
+			default:
+				return false;
+		}
+	}
+
+	// Objects, in the order the bvh numbers them
+	scene->mpObjects.reserve(scene->mpObjects.size() + size_t(primitiveCount));
+	const size_t firstObject = scene->mpObjects.size();
+
+	for (uint32 i = 0; i < header.spheres.count; ++i)
+	{
+		const PackedSphere & sphere = spheres[i];
+		if (!validMaterial(sphere.material))
+			return false;
+
+		scene->AddObject(new Sphere(Unpack(sphere.center), sphere.radius, sceneMaterials[sphere.material]));
+	}
+
+	for (uint32 i = 0; i < header.ellipsoids.count; ++i)
+	{
+		const PackedEllipsoid & ellipsoid = ellipsoids[i];
+		if (!validMaterial(ellipsoid.material))
+			return false;
+
+		scene->AddObject(new Ellipsoid(
+			Unpack(ellipsoid.center),
+			UnpackColumns(ellipsoid.objectToWorldI[0]),
+			sceneMaterials[ellipsoid.material]
+		));
+	}
+
+	for (uint32 i = 0; i < header.aabbs.count; ++i)
+	{
+		const PackedAabb & aabb = aabbs[i];
+		if (!validMaterial(aabb.material))
+			return false;
+
+		scene->AddObject(new Aabb(Unpack(aabb.min), Unpack(aabb.max), sceneMaterials[aabb.material]));
+	}
+
+	for (uint32 i = 0; i < header.meshObjects.count; ++i)
+	{
+		const PackedMeshObject & meshObject = meshObjects[i];
+		if (!validMaterial(meshObject.material) || meshObject.mesh >= sceneMeshes.size())
+			return false;
+
+		scene->AddObject(new TriangleMesh(sceneMeshes[meshObject.mesh], sceneMaterials[meshObject.material]));
+	}
+
+	for (uint32 i = 0; i < header.instances.count; ++i)
+	{
+		const PackedInstance & instance = instances[i];
+		if (!validMaterial(instance.material) || instance.asset >= sceneAssets.size())
+			return false;
+
+		const Vector3 u = Unpack(instance.axes[0]);
+		const Vector3 v = Unpack(instance.axes[1]);
+		const Vector3 w = Unpack(instance.axes[2]);
+		if (Dot(u, Cross(v, w)) == 0.0f)
+			return false;
+
+		const Matrix33 linear(
+			u.x, v.x, w.x,
+			u.y, v.y, w.y,
+			u.z, v.z, w.z
+		);
+
+		scene->AddObject(new Instance(sceneAssets[instance.asset], linear, Unpack(instance.translation), sceneMaterials[instance.material]));
+	}
+
+	// The bvh numbers the file's primitives, it only fits a scene which had nothing else in it
+	if (firstObject == 0)
+	{
+		scene->mBvh.SetView(nodes, uint32(header.nodes.count), indices, uint32(header.indices.count), file);
+		if (!scene->mBvh.Validate(uint32(primitiveCount)))
+			return false;
+	}
+	else
+	{
+		scene->BuildBvh();
+	}
+
+	// Settings
+	scene->SetBackgroundColor(Color(header.background[0], header.background[1], header.background[2]));
+
+	settings->width           = header.width;
+	settings->height          = header.height;
+	settings->spp             = header.spp;
+	settings->bvhNodes        = EBvhNodes(header.bvhNodes);
+	settings->camera.eye      = Unpack(header.eye);
+	settings->camera.lookat   = Unpack(header.lookat);
+	settings->camera.up       = Unpack(header.up);
+	settings->camera.distance = header.distance;
+	settings->camera.width    = header.cameraWidth;
+
+	if (sourceHash)
+		*sourceHash = header.sourceHash;
+
+	return true;
+}
+
+//=============================================================================
+bool SaveBinaryScene (const char * filename, const Scene & scene, const SceneSettings & settings, uint64 sourceHash)
+{
+	if (scene.IsAnimated())
+		return false;
+
+	// Only full hierarchies are stored, quantized meshes have let go of theirs
+	for (const Object * object : scene.mpObjects)
+	{
+		if (object->GetShapeType() == SHAPE_TYPE_INSTANCE)
+			object = static_cast<const Instance *>(object)->GetAsset().get();
+
+		if (object->GetShapeType() == SHAPE_TYPE_MESH && static_cast<const TriangleMesh *>(object)->GetMesh()->IsQuantized())
+			return false;
+	}
+
+	struct MaterialLess
+	{
+		bool operator() (const PackedMaterial & a, const PackedMaterial & b) const
+		{
+			return memcmp(&a, &b, sizeof(a)) < 0;
+		}
+	};
+
+	std::vector<PackedMaterial>                    materials;
+	std::map<PackedMaterial, uint32, MaterialLess> materialIndices;
+	std::vector<PackedSphere>                      spheres;
+	std::vector<PackedEllipsoid>                   ellipsoids;
+	std::vector<PackedAabb>                        aabbs;
+	std::vector<PackedMeshObject>                  meshObjects;
+	std::vector<PackedInstance>                    instances;
+	std::vector<PackedAsset>                       assets;
+	std::map<const Object *, uint32>               assetIndices;
+	std::vector<PackedMesh>                        meshes;
+	std::map<const Mesh *, uint32>                 meshIndices;
+	std::vector<float32>                           meshPositions;
+	std::vector<uint32>                            meshTriangles;
+	std::vector<BvhNode>                           meshNodes;
+	std::vector<uint32>                            meshBvhIndices;
+
+	auto addMaterial = [&](const Material & material) {
+		const PackedMaterial packed = Pack(material);
+		const auto it = materialIndices.find(packed);
+		if (it != materialIndices.end())
+			return it->second;
+
+		const uint32 index = uint32(materials.size());
+		materials.push_back(packed);
+		materialIndices[packed] = index;
+		return index;
+	};
+
+	// Meshes shared between objects are stored once
+	auto addMesh = [&](const Mesh & mesh) {
+		const auto it = meshIndices.find(&mesh);
+		if (it != meshIndices.end())
+			return it->second;
+
+		PackedMesh packed;
+		packed.firstPosition = meshPositions.size();
+		packed.firstIndex    = meshTriangles.size();
+		packed.firstNode     = meshNodes.size();
+		packed.firstBvhIndex = meshBvhIndices.size();
+		packed.vertexCount   = mesh.GetVertexCount();
+		packed.triangleCount = mesh.GetTriangleCount();
+		packed.nodeCount     = mesh.GetBvh().GetNodeCount();
+		packed.bvhIndexCount = mesh.GetBvh().GetIndexCount();
+
+		meshPositions.insert(meshPositions.end(), mesh.GetPositions(), mesh.GetPositions() + packed.vertexCount * 3);
+		meshTriangles.insert(meshTriangles.end(), mesh.GetIndices(), mesh.GetIndices() + packed.triangleCount * 3);
+		meshNodes.insert(meshNodes.end(), mesh.GetBvh().GetNodes(), mesh.GetBvh().GetNodes() + packed.nodeCount);
+		meshBvhIndices.insert(meshBvhIndices.end(), mesh.GetBvh().GetIndices(), mesh.GetBvh().GetIndices() + packed.bvhIndexCount);
+
+		const uint32 index = uint32(meshes.size());
+		meshes.push_back(packed);
+		meshIndices[&mesh] = index;
+		return index;
+	};
+
+	// Assets shared between instances are stored once
+	auto addAsset = [&](const Object & asset) {
+		const auto it = assetIndices.find(&asset);
+		if (it != assetIndices.end())
+			return it->second;
+
+		PackedAsset packed;
+		memset(&packed, 0, sizeof(packed));
+		packed.type     = uint32(asset.GetShapeType());
+		packed.material = addMaterial(asset.GetMaterial());
+
+		switch (asset.GetShapeType())
+		{
+			case SHAPE_TYPE_SPHERE:
+			{
+				const Sphere3 & sphere = static_cast<const Sphere &>(asset).GetSphere();
+				Pack(packed.data, sphere.center);
+				packed.data[3] = sphere.radius;
+			}
+			break;
+
+			case SHAPE_TYPE_ELLIPSOID:
+			{
+				const Ellipsoid & ellipsoid = static_cast<const Ellipsoid &>(asset);
+				Pack(packed.data, ellipsoid.GetCenter());
+				PackColumns(packed.data + 3, ellipsoid.GetObjectToWorldI());
+			}
+			break;
+
+			case SHAPE_TYPE_AABB:
+			{
+				const Aabb3 & aabb = static_cast<const Aabb &>(asset).GetAabb();
+				Pack(packed.data, aabb.min);
+				Pack(packed.data + 3, aabb.max);
+			}
+			break;
+
+			case SHAPE_TYPE_MESH:
+				packed.mesh = addMesh(*static_cast<const TriangleMesh &>(asset).GetMesh());
+				break;
+
+			case SHAPE_TYPE_INSTANCE:
+				ASSERT(false);
+				break;
+		}
+
+		const uint32 index = uint32(assets.size());
+		assets.push_back(packed);
+		assetIndices[&asset] = index;
+		return index;
+	};
+
+	// Pool the primitives by shape, remembering where each object went within its pool
+	const uint32 objectCount = uint32(scene.mpObjects.size());
+	std::vector<uint32> poolIndex(objectCount);
+
+	for (uint32 i = 0; i < objectCount; ++i)
+	{
+		const Object * pObject = scene.mpObjects[i];
+		const uint32 material = addMaterial(pObject->GetMaterial());
+
+		switch (pObject->GetShapeType())
+		{
+			case SHAPE_TYPE_SPHERE:
+			{
+				const Sphere3 & sphere = static_cast<const Sphere *>(pObject)->GetSphere();
+
+				PackedSphere packed;
+				Pack(packed.center, sphere.center);
+				packed.radius   = sphere.radius;
+				packed.material = material;
+
+				poolIndex[i] = uint32(spheres.size());
+				spheres.push_back(packed);
+			}
+			break;
+
+			case SHAPE_TYPE_ELLIPSOID:
+			{
+				const Ellipsoid * pEllipsoid = static_cast<const Ellipsoid *>(pObject);
+
+				PackedEllipsoid packed;
+				Pack(packed.center, pEllipsoid->GetCenter());
+				PackColumns(packed.objectToWorldI[0], pEllipsoid->GetObjectToWorldI());
+				packed.material = material;
+
+				poolIndex[i] = uint32(ellipsoids.size());
+				ellipsoids.push_back(packed);
+			}
+			break;
+
+			case SHAPE_TYPE_AABB:
+			{
+				const Aabb3 & aabb = static_cast<const Aabb *>(pObject)->GetAabb();
+
+				PackedAabb packed;
+				Pack(packed.min, aabb.min);
+				Pack(packed.max, aabb.max);
+				packed.material = material;
+
+				poolIndex[i] = uint32(aabbs.size());
+				aabbs.push_back(packed);
+			}
+			break;
+
+			case SHAPE_TYPE_MESH:
+			{
+				PackedMeshObject packed;
+				packed.mesh     = addMesh(*static_cast<const TriangleMesh *>(pObject)->GetMesh());
+				packed.material = material;
+
+				poolIndex[i] = uint32(meshObjects.size());
+				meshObjects.push_back(packed);
+			}
+			break;
+
+			case SHAPE_TYPE_INSTANCE:
+			{
+				const Instance * pInstance = static_cast<const Instance *>(pObject);
+
+				PackedInstance packed;
+				packed.asset    = addAsset(*pInstance->GetAsset());
+				packed.material = material;
+				for (uint axis = 0; axis < 3; ++axis)
+					Pack(packed.axes[axis], pInstance->GetAxis(axis));
+				Pack(packed.translation, pInstance->GetTranslation());
+
+				poolIndex[i] = uint32(instances.size());
+				instances.push_back(packed);
+			}
+			break;
+		}
+	}
+
+	// Renumber the bvh's primitives the way the loader will create them
+	Bvh bvh = scene.mBvh;
+	if (bvh.IsEmpty() || bvh.GetIndexCount() != objectCount)
+	{
+		std::vector<Aabb3> bounds(objectCount);
+		for (uint32 i = 0; i < objectCount; ++i)
+			bounds[i] = scene.mpObjects[i]->GetBounds();
+
+		bvh.Build(bounds);
+	}
+
+	const std::vector<BvhNode> nodes(bvh.GetNodes(), bvh.GetNodes() + bvh.GetNodeCount());
+	std::vector<uint32> indices(bvh.GetIndexCount());
+	for (uint32 i = 0; i < indices.size(); ++i)
+	{
+		const uint32 object = bvh.GetIndices()[i];
+
+		uint32 first = 0;
+		switch (scene.mpObjects[object]->GetShapeType())
+		{
+			case SHAPE_TYPE_SPHERE:    first = 0; break;
+			case SHAPE_TYPE_ELLIPSOID: first = uint32(spheres.size()); break;
+			case SHAPE_TYPE_AABB:      first = uint32(spheres.size() + ellipsoids.size()); break;
+			case SHAPE_TYPE_MESH:      first = uint32(spheres.size() + ellipsoids.size() + aabbs.size()); break;
+			case SHAPE_TYPE_INSTANCE:  first = uint32(spheres.size() + ellipsoids.size() + aabbs.size() + meshObjects.size()); break;
+		}
+
+		indices[i] = first + poolIndex[object];
+	}
+
+	// Header
+	SceneFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+	header.version     = SCENE_FILE_VERSION;
+	header.sourceHash  = sourceHash;
+	header.width       = settings.width;
+	header.height      = settings.height;
+	header.spp         = settings.spp;
+	header.bvhNodes    = uint32(settings.bvhNodes);
+	header.distance    = settings.camera.distance;
+	header.cameraWidth = settings.camera.width;
+
+	const Color background = scene.GetBackgroundColor();
+	header.background[0] = background.r;
+	header.background[1] = background.g;
+	header.background[2] = background.b;
+
+	Pack(header.eye, settings.camera.eye);
+	Pack(header.lookat, settings.camera.lookat);
+	Pack(header.up, settings.camera.up);
+
+	uint64 offset = sizeof(header);
+	AddSection(&header.materials, &offset, materials);
+	AddSection(&header.spheres, &offset, spheres);
+	AddSection(&header.ellipsoids, &offset, ellipsoids);
+	AddSection(&header.aabbs, &offset, aabbs);
+	AddSection(&header.meshObjects, &offset, meshObjects);
+	AddSection(&header.instances, &offset, instances);
+	AddSection(&header.nodes, &offset, nodes);
+	AddSection(&header.indices, &offset, indices);
+	AddSection(&header.meshes, &offset, meshes);
+	AddSection(&header.meshPositions, &offset, meshPositions);
+	AddSection(&header.meshIndices, &offset, meshTriangles);
+	AddSection(&header.meshNodes, &offset, meshNodes);
+	AddSection(&header.meshBvhIndices, &offset, meshBvhIndices);
+	AddSection(&header.assets, &offset, assets);
+
+	// Write to a temporary and rename so a reader never maps a half written file
+	const std::string temporary = std::string(filename) + ".tmp";
+	FILE * file = fopen(temporary.c_str(), "wb");
+	if (!file)
+		return false;
+
+	uint64 written = sizeof(header);
+	const bool ok =
+		fwrite(&header, sizeof(header), 1, file) == 1 &&
+		WriteSection(file, &written, header.materials, materials) &&
+		WriteSection(file, &written, header.spheres, spheres) &&
+		WriteSection(file, &written, header.ellipsoids, ellipsoids) &&
+		WriteSection(file, &written, header.aabbs, aabbs) &&
+		WriteSection(file, &written, header.meshObjects, meshObjects) &&
+		WriteSection(file, &written, header.instances, instances) &&
+		WriteSection(file, &written, header.nodes, nodes) &&
+		WriteSection(file, &written, header.indices, indices) &&
+		WriteSection(file, &written, header.meshes, meshes) &&
+		WriteSection(file, &written, header.meshPositions, meshPositions) &&
+		WriteSection(file, &written, header.meshIndices, meshTriangles) &&
+		WriteSection(file, &written, header.meshNodes, meshNodes) &&
+		WriteSection(file, &written, header.meshBvhIndices, meshBvhIndices) &&
+		WriteSection(file, &written, header.assets, assets);
+
+	if (fclose(file) != 0 || !ok)
+	{
+		remove(temporary.c_str());
+		return false;
+	}
+
+	remove(filename);
+	return rename(temporary.c_str(), filename) == 0;
+}
+
+//=============================================================================
+// FNV-1a
+static void HashBytes (uint64 * value, const void * data, uint64 bytes)
+{
+	const uint8 * it = static_cast<const uint8 *>(data);
+	for (uint64 i = 0; i < bytes; ++i)
+	{
+		*value ^= it[i];
+		*value *= 1099511628211ull;
+	}
+}
+
+//=============================================================================
+// Returns where the json string starting at data[i] ends, past its closing quote
+static uint64 SkipJsonString (const char * data, uint64 size, uint64 i)
+{
+	for (++i; i < size && data[i] != '"'; ++i)
+	{
+		if (data[i] == '\\')
+			++i;
+	}
+
+	return Min(i + 1, size);
+}
+
+//=============================================================================
+// Returns where the json value starting at or after data[i] ends, which is the
+// comma or closing bracket after it
+static uint64 SkipJsonValue (const char * data, uint64 size, uint64 i)
+{
+	uint32 depth = 0;
+	while (i < size)
+	{
+		const char c = data[i];
+		if (c == '"')
+		{
+			i = SkipJsonString(data, size, i);
+			continue;
+		}
+
+		if (c == '{' || c == '[')
+		{
+			++depth;
+		}
+		else if (c == '}' || c == ']')
+		{
+			if (!depth)
+				return i;
+			if (!--depth)
+				return i + 1;
+		}
+		else if (c == ',' && !depth)
+		{
+			return i;
+		}
+
+		++i;
+	}
+
+	return size;
+}
+
+//=============================================================================
+// The json string starting at data[i] is a key if a colon follows it, returns
+// where the value after the colon starts or 0 if it is not a key
+static uint64 FindKeyValue (const char * data, uint64 size, uint64 i)
+{
+	while (i < size && isspace(uint8(data[i])))
+		++i;
+
+	if (i >= size || data[i] != ':')
+		return 0;
+
+	for (++i; i < size && isspace(uint8(data[i])); ++i)
+		;
+
+	return i;
+}
+
+//=============================================================================
+// What a scene depends on besides its own bytes: where it is, which tells two
+// copies apart whose relative mesh paths lead to different files, and the size
+// and modification time of every mesh file it names
+static void HashSceneDependencies (uint64 * value, const char * filename, const char * data, uint64 size)
+{
+#if !defined(_WIN32)
+	char absolute[PATH_MAX];
+	const std::string path = realpath(filename, absolute) ? absolute : filename;
+#else
+	const std::string path = filename;
+#endif
+	HashBytes(value, path.data(), path.size());
+
+	const size_t      separator = path.find_last_of("/\\");
+	const std::string directory = separator == std::string::npos ? std::string() : path.substr(0, separator);
+
+	// Meshes are the only "file" values in a scene
+	uint64 i = 0;
+	while (i < size)
+	{
+		if (data[i] != '"')
+		{
+			++i;
+			continue;
+		}
+
+		const uint64 end   = SkipJsonString(data, size, i);
+		const bool   bFile = end - i == 6 && !memcmp(data + i, "\"file\"", 6);
+		i = end;
+
+		const uint64 fileValue = bFile ? FindKeyValue(data, size, i) : 0;
+		if (!fileValue || fileValue >= size || data[fileValue] != '"')
+			continue;
+
+		i = SkipJsonString(data, size, fileValue);
+		const std::string mesh = SceneAssets::ResolvePath(directory, std::string(data + fileValue + 1, i - fileValue - 2));
+		HashBytes(value, mesh.data(), mesh.size());
+
+		// A missing mesh hashes as zeros, and hashes differently once it appears
+		struct stat info;
+		uint64 stamp[3] = { 0, 0, 0 };
+		if (stat(mesh.c_str(), &info) == 0)
+		{
+			stamp[0] = uint64(info.st_size);
+#if !defined(_WIN32)
+			stamp[1] = uint64(info.st_mtim.tv_sec);
+			stamp[2] = uint64(info.st_mtim.tv_nsec);
+#else
+			stamp[1] = uint64(info.st_mtime);
+#endif
+		}
+		HashBytes(value, stamp, sizeof(stamp));
+	}
+}
+
+//=============================================================================
+// Sources are read rather than mapped: watch hashes files an editor may be
+// truncating, and touching a mapped page past the new end raises SIGBUS
+static bool ReadSource (const char * filename, std::vector<char> * data)
+{
+	FILE * file = fopen(filename, "rb");
+	if (!file)
+		return false;
+
+	data->clear();
+	char   buffer[64 * 1024];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		data->insert(data->end(), buffer, buffer + read);
+
+	// Empty is refused as a mapping would be, a file just truncated is no change yet
+	const bool bError = ferror(file) != 0;
+	fclose(file);
+	return !bError && !data->empty();
+}
+
+//=============================================================================
+// FNV-1a over the file contents and its dependencies
+bool HashSceneSource (const char * filename, uint64 * hash)
+{
+	std::vector<char> source;
+	if (!ReadSource(filename, &source))
+		return false;
+
+	const char * data = source.data();
+
+	uint64 value = 14695981039346656037ull;
+	HashBytes(&value, data, source.size());
+	HashSceneDependencies(&value, filename, data, source.size());
+
+	*hash = value;
+	return true;
+}
+
+//=============================================================================
+// Strings are hashed whole, so braces and "material" inside them are never
+// taken for structure or keys
+bool HashSceneWithoutMaterials (const char * filename, uint64 * hash)
+{
+	std::vector<char> source;
+	if (!ReadSource(filename, &source))
+		return false;
+
+	const char * data = source.data();
+	const uint64 size = source.size();
+
+	uint64 value = 14695981039346656037ull;
+	uint64 i     = 0;
+	while (i < size)
+	{
+		const uint64 end = data[i] == '"' ? SkipJsonString(data, size, i) : i + 1;
+		HashBytes(&value, data + i, end - i);
+
+		const bool bMaterial = end - i == 10 && !memcmp(data + i, "\"material\"", 10);
+		i = end;
+
+		// Only a key is followed by a colon, a string value of "material" is left alone
+		if (bMaterial)
+		{
+			if (const uint64 materialValue = FindKeyValue(data, size, i))
+				i = SkipJsonValue(data, size, materialValue);
+		}
+	}
+
+	HashSceneDependencies(&value, filename, data, size);
+
+	*hash = value;
+	return true;
+}
+
+//=============================================================================
+bool LoadSceneCached (
+	const char *    filename,
+	const char *    cachePath,
+	Scene *         scene,
+	SceneSettings * settings,
+	bool *          cacheHit
+) {
+	*cacheHit = false;
+
+	uint64 hash;
+	if (!HashSceneSource(filename, &hash))
+		return false;
+
+	SceneFileHeader header;
+	if (ReadHeader(cachePath, &header) && header.sourceHash == hash)
+	{
+		// A cache which fails to load is rebuilt like a stale one, unless it already added objects
+		const size_t objectCount = scene->mpObjects.size();
+		if (LoadBinaryScene(cachePath, scene, settings, null))
+		{
+			*cacheHit = true;
+			return true;
+		}
+
+		if (scene->mpObjects.size() != objectCount)
+			return false;
+	}
+
+	if (!LoadScene(filename, scene, settings))
+		return false;
+
+	// Failing to write the cache only costs the next load its speed
+	SaveBinaryScene(cachePath, *scene, *settings, hash);
+	return true;
+}
+
+} // namespace RT
@@ -0,0 +1,44 @@
+//==================================================================================================
+//
+// File:	SceneFile.h
+//
+// Binary scene files. Scenes are authored as json, the binary form holds the same scene as flat
+// pools of materials and primitives together with a prebuilt bvh. The file is memory mapped and
+// the bvh is used in place, so loading a large scene costs little more than creating its objects.
+//=================================================================================================
+#ifndef SCENEFILE_H
+#define SCENEFILE_H
+
+namespace RT
+{
+
+//! True when the file starts like a binary scene
+bool IsBinaryScene (const char * filename);
+
+//! Loads a binary scene, sourceHash is the hash of the json it was compiled from (can be null)
+bool LoadBinaryScene (const char * filename, Scene * scene, SceneSettings * settings, uint64 * sourceHash);
+
+//! Writes scene as a binary scene, building a bvh for it if it has none. Keyframes and quantized
+//! hierarchies are not stored, so animated scenes and quantized meshes are refused.
+bool SaveBinaryScene (const char * filename, const Scene & scene, const SceneSettings & settings, uint64 sourceHash);
+
+//! Hash used to tell whether a binary scene is still up to date with its source. Covers the file
+//! contents, its canonical path and the size and modification time of every mesh file it names.
+bool HashSceneSource (const char * filename, uint64 * hash);
+//! The same hash with the value of every "material" key left out, so two versions of a json scene
+//! which differ in nothing but materials hash the same
+bool HashSceneWithoutMaterials (const char * filename, uint64 * hash);
+
+//! Loads filename through the binary scene at cachePath, which is written again when it is missing
+//! or was compiled from a different version of filename
+bool LoadSceneCached (
+	const char *    filename,
+	const char *    cachePath,
+	Scene *         scene,
+	SceneSettings * settings,
+	bool *          cacheHit
+);
+
+} // namespace RT
+
+#endif //SCENEFILE_H
@@ -0,0 +1,421 @@
+//==================================================================================================
+//
+// File:	SceneGenerator.cpp
+//
+// Procedural scenes.
+//
+//=================================================================================================
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+static const float32 FIELD_SIDE  = 200.0f;
+static const float32 CITY_SIDE   = 400.0f;
+static const float32 LIGHT_POWER = 0.2f * FIELD_SIDE * FIELD_SIDE;	// Emissive times area of all lights together
+
+static const char * const STRESS_SCENE_NAMES[] = { "spheres", "ellipsoids", "city", "lights" };
+
+//=============================================================================
+static Material MakeDiffuse (const Color & color)
+{
+	Material material;
+	material.type     = MATERIAL_TYPE_DIFFUSE;
+	material.diffuse  = color;
+	material.emissive = Color::Black;
+	return material;
+}
+
+//=============================================================================
+// Mostly diffuse, with some mirrors and glass
+static Material MakeRandomMaterial (Random & random)
+{
+	Material material = MakeDiffuse(Color(
+		0.2f + 0.7f * random.GetFloat32(),
+		0.2f + 0.7f * random.GetFloat32(),
+		0.2f + 0.7f * random.GetFloat32()
+	));
+
+	const float32 type = random.GetFloat32();
+	if (type < 0.1f)
+		material.type = MATERIAL_TYPE_REFLECT;
+	else if (type < 0.15f)
+		material.type = MATERIAL_TYPE_REFRACT;
+
+	return material;
+}
+
+//=============================================================================
+static Vector3 GetRandomDirection (Random & random)
+{
+	for (;;)
+	{
+		const Vector3 v(
+			random.GetFloat32() * 2.0f - 1.0f,
+			random.GetFloat32() * 2.0f - 1.0f,
+			random.GetFloat32() * 2.0f - 1.0f
+		);
+
+		const float32 lengthSq = Dot(v, v);
+		if (lengthSq > 1e-4f && lengthSq <= 1.0f)
+			return v * (1.0f / Sqrt(lengthSq));
+	}
+}
+
+//=============================================================================
+// A grid of cells over bounds. Cells are handed out in a random order, so a grid larger than the
+// count still fills evenly, and primitives are put at random spots inside them. A lattice hands
+// them out in order and puts primitives at their centers instead.
+class CellGrid
+{
+public:
+	CellGrid (const Aabb3 & bounds, const uint32 cells[3], uint32 count, bool lattice, Random & random) :
+		mBounds(bounds),
+		mLattice(lattice)
+	{
+		for (uint axis = 0; axis < 3; ++axis)
+		{
+			mCells[axis]    = cells[axis];
+			mCellSize[axis] = (bounds.max[axis] - bounds.min[axis]) / cells[axis];
+		}
+
+		mOrder.resize(cells[0] * cells[1] * cells[2]);
+		for (uint32 i = 0; i < mOrder.size(); ++i)
+			mOrder[i] = i;
+
+		for (uint32 i = 0; !lattice && i < count && i + 1 < mOrder.size(); ++i)
+			std::swap(mOrder[i], mOrder[i + uint32(random.GetFloat64() * (mOrder.size() - i))]);
+	}
+
+	//! The smallest side of a cell
+	inline float32 GetCellSize () const { return Min(Min(mCellSize[0], mCellSize[1]), mCellSize[2]); }
+
+	//! Center for primitive i reaching extent out from it, see StressSceneDesc::overlap
+	Point3 Place (uint32 i, const Vector3 & extent, float32 overlap, Random & random) const
+	{
+		uint32 cell = mOrder[i];
+
+		Point3 center;
+		for (uint axis = 0; axis < 3; ++axis)
+		{
+			const uint32  index   = cell % mCells[axis];
+			const float32 cellMin = mBounds.min[axis] + index * mCellSize[axis];
+			cell /= mCells[axis];
+
+			const float32 inCell   = mLattice
+				? cellMin + mCellSize[axis] * 0.5f
+				: cellMin + extent[axis] + random.GetFloat32() * Max(0.0f, mCellSize[axis] - 2.0f * extent[axis]);
+			const float32 anywhere = mBounds.min[axis] + extent[axis] + random.GetFloat32() * Max(0.0f, mBounds.max[axis] - mBounds.min[axis] - 2.0f * extent[axis]);
+			center[axis] = inCell + (anywhere - inCell) * overlap;
+		}
+
+		return center;
+	}
+
+private:
+	Aabb3               mBounds;
+	uint32              mCells[3];
+	float32             mCellSize[3];
+	std::vector<uint32> mOrder;
+	bool                mLattice;
+};
+
+//=============================================================================
+// Cells per side of a cube holding count cells or more
+static uint32 GetCellsPerSide (uint32 count, uint dimensions)
+{
+	uint32 side = Max(1u, uint32(std::floor(std::pow(float64(count), 1.0 / dimensions))));
+	while (std::pow(float64(side), float64(dimensions)) < count)
+		++side;
+
+	return side;
+}
+
+//=============================================================================
+static void AddFloor (float32 z, float32 halfSize, const Color & color, Scene * scene)
+{
+	scene->AddObject(new Aabb(
+		Point3(-halfSize, -halfSize, z - 1.0f),
+		Point3(+halfSize, +halfSize, z),
+		MakeDiffuse(color)
+	));
+}
+
+//=============================================================================
+static void GenerateSpheres (const StressSceneDesc & desc, Random & random, Scene * scene)
+{
+	const float32 half   = FIELD_SIDE * 0.5f;
+	const float32 radius = FIELD_SIDE * std::cbrt(desc.density * 3.0f / (4.0f * Math::Pi * Max(desc.count, 1u)));
+
+	const uint32 side     = GetCellsPerSide(desc.count, 3);
+	const uint32 cells[3] = { side, side, side };
+	const CellGrid grid(Aabb3(Point3(-half, -half, -half), Point3(half, half, half)), cells, desc.count, false, random);
+
+	const float32 maxRadius = desc.overlap > 0.0f ? half : grid.GetCellSize() * 0.5f;
+
+	scene->SetBackgroundColor(Color(0.8f, 0.85f, 1.0f));
+	AddFloor(-half, FIELD_SIDE * 2.0f, Color(0.6f, 0.6f, 0.6f), scene);
+
+	for (uint32 i = 0; i < desc.count; ++i)
+	{
+		const float32 r      = Min(radius * (0.5f + random.GetFloat32()), maxRadius);
+		const Point3  center = grid.Place(i, Vector3(r, r, r), desc.overlap, random);
+
+		scene->AddObject(new Sphere(center, r, MakeRandomMaterial(random)));
+	}
+}
+
+//=============================================================================
+static void GenerateEllipsoids (const StressSceneDesc & desc, Random & random, Scene * scene)
+{
+	const float32 half   = FIELD_SIDE * 0.5f;
+	const float32 radius = FIELD_SIDE * std::cbrt(desc.density * 3.0f / (4.0f * Math::Pi * Max(desc.count, 1u)));
+
+	const uint32 side     = GetCellsPerSide(desc.count, 3);
+	const uint32 cells[3] = { side, side, side };
+	const CellGrid grid(Aabb3(Point3(-half, -half, -half), Point3(half, half, half)), cells, desc.count, true, random);
+
+	const float32 maxRadius = desc.overlap > 0.0f ? half : grid.GetCellSize() * 0.5f;
+
+	scene->SetBackgroundColor(Color(0.8f, 0.85f, 1.0f));
+	AddFloor(-half, FIELD_SIDE * 2.0f, Color(0.6f, 0.6f, 0.6f), scene);
+
+	for (uint32 i = 0; i < desc.count; ++i)
+	{
+		// Stretched along a random direction, about as much volume as a sphere of radius
+		const float32 stretch = 0.5f + random.GetFloat32() * 1.5f;
+		const float32 squash  = 1.0f / Sqrt(stretch);
+		const float32 radii[3] = {
+			Min(radius * stretch, maxRadius),
+			Min(radius * squash, maxRadius),
+			Min(radius * squash, maxRadius),
+		};
+
+		Vector3 u, v, w;
+		BuildBasis(GetRandomDirection(random), u, v, w);
+
+		const float32 reach  = radii[0];
+		const Point3  center = grid.Place(i, Vector3(reach, reach, reach), desc.overlap, random);
+
+		scene->AddObject(new Ellipsoid(center, u * radii[0], v * radii[1], w * radii[2], MakeRandomMaterial(random)));
+	}
+}
+
+//=============================================================================
+static void GenerateCity (const StressSceneDesc & desc, Random & random, Scene * scene)
+{
+	const float32 half = CITY_SIDE * 0.5f;
+
+	const uint32 side     = GetCellsPerSide(desc.count, 2);
+	const uint32 cells[3] = { side, side, 1 };
+	const CellGrid grid(Aabb3(Point3(-half, -half, 0.0f), Point3(half, half, 0.0f)), cells, desc.count, false, random);
+
+	// Footprints cover density of the ground on average
+	const float32 block     = CITY_SIDE / side;
+	const float32 footprint = block * Sqrt(Min(desc.density, 1.0f) * float32(side * side) / Max(desc.count, 1u)) * 0.5f;
+	const float32 maxHalf   = desc.overlap > 0.0f ? half : block * 0.5f;
+
+	scene->SetBackgroundColor(Color(0.8f, 0.85f, 1.0f));
+	AddFloor(0.0f, CITY_SIDE, Color(0.4f, 0.4f, 0.4f), scene);
+
+	for (uint32 i = 0; i < desc.count; ++i)
+	{
+		const float32 halfX  = Min(footprint * (0.6f + 0.8f * random.GetFloat32()), maxHalf);
+		const float32 halfY  = Min(footprint * (0.6f + 0.8f * random.GetFloat32()), maxHalf);
+		const float32 height = block * (0.5f + 4.0f * Sq(random.GetFloat32()));
+
+		const Point3 center = grid.Place(i, Vector3(halfX, halfY, 0.0f), desc.overlap, random);
+
+		scene->AddObject(new Aabb(
+			Point3(center.x - halfX, center.y - halfY, 0.0f),
+			Point3(center.x + halfX, center.y + halfY, height),
+			MakeDiffuse(Color(0.5f + 0.4f * random.GetFloat32(), 0.5f + 0.4f * random.GetFloat32(), 0.5f + 0.4f * random.GetFloat32()))
+		));
+	}
+}
+
+//=============================================================================
+// The lights share a fixed power however many there are, so images stay comparable
+static void GenerateLights (const StressSceneDesc & desc, Random & random, Scene * scene)
+{
+	const float32 half   = FIELD_SIDE * 0.5f;
+	const float32 radius = FIELD_SIDE * std::cbrt(desc.density * 3.0f / (4.0f * Math::Pi * Max(desc.count, 1u)));
+
+	// Lights fill the upper half of the cube
+	const uint32 side     = GetCellsPerSide(desc.count, 3);
+	const uint32 cells[3] = { side, side, side };
+	const CellGrid grid(Aabb3(Point3(-half, -half, 0.0f), Point3(half, half, half)), cells, desc.count, false, random);
+
+	const float32 maxRadius = desc.overlap > 0.0f ? half : grid.GetCellSize() * 0.5f;
+
+	scene->SetBackgroundColor(Color::Black);
+	AddFloor(-half, FIELD_SIDE * 2.0f, Color(0.7f, 0.7f, 0.7f), scene);
+
+	// Pillars for the lights to cast shadows with
+	const uint32  PILLARS = 8;
+	const float32 spacing = FIELD_SIDE / PILLARS;
+	for (uint32 y = 0; y < PILLARS; ++y)
+	{
+		for (uint32 x = 0; x < PILLARS; ++x)
+		{
+			const Point3 base(-half + (x + 0.5f) * spacing, -half + (y + 0.5f) * spacing, -half);
+			scene->AddObject(new Aabb(
+				base - Vector3(spacing * 0.15f, spacing * 0.15f, 0.0f),
+				base + Vector3(spacing * 0.15f, spacing * 0.15f, half * (0.3f + 0.5f * random.GetFloat32())),
+				MakeDiffuse(Color(0.6f, 0.6f, 0.6f))
+			));
+		}
+	}
+
+	for (uint32 i = 0; i < desc.count; ++i)
+	{
+		const float32 r      = Min(radius * (0.5f + random.GetFloat32()), maxRadius);
+		const Point3  center = grid.Place(i, Vector3(r, r, r), desc.overlap, random);
+
+		const float32 intensity = LIGHT_POWER / (Max(desc.count, 1u) * Sq(r));
+
+		Material material;
+		material.type     = MATERIAL_TYPE_DIFFUSE;
+		material.diffuse  = Color::Black;
+		material.emissive = Color(
+			intensity * (0.5f + 0.5f * random.GetFloat32()),
+			intensity * (0.5f + 0.5f * random.GetFloat32()),
+			intensity * (0.5f + 0.5f * random.GetFloat32())
+		);
+
+		scene->AddObject(new Sphere(center, r, material));
+	}
+}
+
+
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+bool ParseStressScene (const char * name, EStressScene * out)
+{
+	ASSERT(out);
+
+	for (uint i = 0; i < sizeof(STRESS_SCENE_NAMES) / sizeof(STRESS_SCENE_NAMES[0]); ++i)
+	{
+		if (!strcmp(name, STRESS_SCENE_NAMES[i]))
+		{
+			*out = EStressScene(i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//=============================================================================
+const char * GetStressSceneName (EStressScene kind)
+{
+	return STRESS_SCENE_NAMES[kind];
+}
+
+//=============================================================================
+void GenerateStressScene (const StressSceneDesc & desc, Scene * scene, SceneSettings * settings)
+{
+	ASSERT(scene);
+	ASSERT(settings);
+
+	Random random;
+	random.Seed(desc.seed);
+
+	switch (desc.kind)
+	{
+		case STRESS_SCENE_SPHERES:    GenerateSpheres(desc, random, scene);    break;
+		case STRESS_SCENE_ELLIPSOIDS: GenerateEllipsoids(desc, random, scene); break;
+		case STRESS_SCENE_CITY:       GenerateCity(desc, random, scene);       break;
+		case STRESS_SCENE_LIGHTS:     GenerateLights(desc, random, scene);     break;
+	}
+
+	scene->BuildBvh();
+
+	settings->width    = 0;
+	settings->height   = 0;
+	settings->spp      = 0;
+	settings->bvhNodes = BVH_NODES_FULL;
+
+	settings->camera.up       = Vector3(0.0f, 0.0f, 1.0f);
+	settings->camera.distance = 1.0f;
+	settings->camera.width    = 1.0f;
+
+	if (desc.kind == STRESS_SCENE_CITY)
+	{
+		settings->camera.eye    = Point3(-CITY_SIDE * 0.6f, -CITY_SIDE * 0.9f, CITY_SIDE * 0.35f);
+		settings->camera.lookat = Point3(0.0f, 0.0f, 0.0f);
+	}
+	else
+	{
+		settings->camera.eye    = Point3(0.0f, -FIELD_SIDE * 1.6f, FIELD_SIDE * 0.4f);
+		settings->camera.lookat = Point3(0.0f, 0.0f, 0.0f);
+	}
+}
+
+} // namespace RT
+
+
+
+//=============================================================================
+int WriteStressScene (const RenderOptions & options)
+{
+	const RT::StressSceneDesc & desc = options.stressScene;
+
+	RT::Scene         scene;
+	RT::SceneSettings settings;
+	scene.SetBvhBuilder(options.bvhBuilder);
+	RT::GenerateStressScene(desc, &scene, &settings);
+
+	// Keep a size or sample count given along with the scene
+	settings.width  = options.width;
+	settings.height = options.height;
+	settings.spp    = options.spp;
+
+	const std::string output = options.outputPath;
+	const bool        json   = output.size() >= 5 && output.compare(output.size() - 5, 5, ".json") == 0;
+
+	const bool written = json
+		? RT::SaveJsonScene(options.outputPath, scene, settings)
+		: RT::SaveBinaryScene(options.outputPath, scene, settings, 0);
+
+	if (!written)
+	{
+		std::cerr << "Failed to write '" << options.outputPath << "'" << std::endl;
+		return 2;
+	}
+
+	if (options.headless)
+	{
+		std::cout
+			<< "{\"scene\":"       << JsonString(RT::GetStressSceneName(desc.kind))
+			<< ",\"output\":"      << JsonString(options.outputPath)
+			<< ",\"format\":"      << JsonString(json ? "json" : "binary")
+			<< ",\"objects\":"     << scene.mpObjects.size()
+			<< ",\"count\":"       << desc.count
+			<< ",\"density\":"     << desc.density
+			<< ",\"overlap\":"     << desc.overlap
+			<< ",\"seed\":"        << desc.seed
+			<< ",\"bvh_nodes\":"   << scene.mBvh.GetNodeCount()
+			<< ",\"bvh_sah_cost\":" << scene.mBvh.ComputeSahCost()
+			<< "}"
+			<< std::endl;
+	}
+
+	return 0;
+}
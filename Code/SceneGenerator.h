@@ -0,0 +1,54 @@
+//==================================================================================================
+//
+// File:	SceneGenerator.h
+//
+// Procedural scenes of any size, for benchmarks and stress tests which need more primitives than
+// anyone would author by hand.
+//=================================================================================================
+#ifndef SCENEGENERATOR_H
+#define SCENEGENERATOR_H
+
+namespace RT
+{
+
+//! Layouts of generated scenes
+enum EStressScene
+{
+	STRESS_SCENE_SPHERES,		//!< Spheres scattered through a cube over a floor, lit by the sky
+	STRESS_SCENE_ELLIPSOIDS,	//!< A lattice of turned and stretched ellipsoids, lit by the sky
+	STRESS_SCENE_CITY,			//!< Boxes of random heights on a square of blocks, lit by the sky
+	STRESS_SCENE_LIGHTS,		//!< Small emissive spheres over pillars in the dark
+};
+
+//! Parses "spheres", "ellipsoids", "city" or "lights"
+bool ParseStressScene (const char * name, EStressScene * out);
+const char * GetStressSceneName (EStressScene kind);
+
+//==================================================================================================
+//
+// What to generate. Primitives get a cell each of a grid over the scene's bounds, overlap moves
+// them from a random spot in their cell, where they are clear of each other, to a random spot
+// anywhere. Without overlap primitives are shrunk to fit their cells, which caps the density.
+//==================================================================================================
+struct StressSceneDesc
+{
+	EStressScene kind    = STRESS_SCENE_SPHERES;
+	uint32       count   = 1000;	//!< Primitives, or lights for STRESS_SCENE_LIGHTS, besides the floor
+	float32      density = 0.1f;	//!< Fraction of the volume they fill, of the ground for cities
+	float32      overlap = 1.0f;	//!< 0 keeps primitives apart, 1 places them independently
+	uint32       seed    = 1;
+};
+
+//! Fills scene as desc asks and builds its bvh. The same desc always makes the same scene. Only
+//! the camera of settings is set, the size and samples are left to the caller.
+void GenerateStressScene (const StressSceneDesc & desc, Scene * scene, SceneSettings * settings);
+
+} // namespace RT
+
+struct RenderOptions;
+
+//! Generates options.stressScene into options.outputPath, as json when it ends in .json and as a
+//! binary scene otherwise. Returns the process exit code.
+int WriteStressScene (const RenderOptions & options);
+
+#endif //SCENEGENERATOR_H
@@ -0,0 +1,120 @@
+//==================================================================================================
+//
+// File:	ShardMerge.cpp
+//
+// Combines sample range shards of a frame into the final image.
+//
+//=================================================================================================
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "Pch.h"
+
+//=============================================================================
+int MergeShards (const RenderOptions & options)
+{
+	RT::CAccumulationBuffer      merged;
+	std::vector<RT::SampleRange> ranges;
+
+	for (uint i = 0; i < options.mergeInputCount; ++i)
+	{
+		const char * filename = options.mergeInputs[i];
+
+		RT::CAccumulationBuffer shard;
+		RT::SampleRange range;
+		if (!shard.Load(filename, &range))
+		{
+			std::cerr << "Failed to read shard '" << filename << "'" << std::endl;
+			return 2;
+		}
+
+		if (ranges.empty())
+		{
+			merged.Resize(shard.GetWidth(), shard.GetHeight());
+		}
+		else if (
+			shard.GetWidth()  != merged.GetWidth() ||
+			shard.GetHeight() != merged.GetHeight() ||
+			range.total       != ranges.front().total
+		) {
+			std::cerr << "Shard '" << filename << "' is from a different frame" << std::endl;
+			return 2;
+		}
+
+		merged.Merge(shard, 0, 0);
+		ranges.push_back(range);
+	}
+
+	// Overlapping shards still merge, they just weight those samples twice
+	std::sort(ranges.begin(), ranges.end(), [] (const RT::SampleRange & a, const RT::SampleRange & b) {
+		return a.begin < b.begin;
+	});
+
+	// Covered counts every sample once however many shards took it, the union of the ranges
+	uint32 covered  = 0;
+	uint32 overlaps = 0;
+	uint32 gaps     = 0;
+	uint32 next     = ranges.front().begin;
+	for (const RT::SampleRange & range : ranges)
+	{
+		if (range.begin < next)
+			++overlaps;
+		else if (range.begin > next)
+			++gaps;
+
+		covered += range.end > next ? range.end - Max(range.begin, next) : 0;
+		next     = Max(next, range.end);
+	}
+
+	if (overlaps)
+		std::cerr << overlaps << " shards overlap earlier ones" << std::endl;
+
+	if (covered < ranges.front().total)
+		std::cerr << "Shards cover " << covered << " of " << ranges.front().total << " samples" << std::endl;
+
+	// A merged accumulation records one range, which has to be exactly the samples in it
+	if (options.accumulationPath && (gaps || overlaps))
+	{
+		std::cerr << "Shards with gaps or overlaps between them can't be written as one accumulation" << std::endl;
+		return 2;
+	}
+
+	RT::CImage image(merged.GetWidth(), merged.GetHeight());
+	merged.Resolve(image, 0, 0);
+	if (!image.Save(options.mergeOutput))
+	{
+		std::cerr << "Failed to write '" << options.mergeOutput << "'" << std::endl;
+		return 2;
+	}
+
+	if (options.accumulationPath)
+	{
+		RT::SampleRange range;
+		range.total = ranges.front().total;
+		range.begin = ranges.front().begin;
+		range.end   = next;
+		if (!merged.Save(options.accumulationPath, range))
+		{
+			std::cerr << "Failed to write '" << options.accumulationPath << "'" << std::endl;
+			return 2;
+		}
+	}
+
+	if (options.headless)
+	{
+		std::cout
+			<< "{\"output\":"    << JsonString(options.mergeOutput)
+			<< ",\"shards\":"    << ranges.size()
+			<< ",\"width\":"     << merged.GetWidth()
+			<< ",\"height\":"    << merged.GetHeight()
+			<< ",\"spp\":"       << ranges.front().total
+			<< ",\"covered\":"   << covered
+			<< ",\"overlaps\":"  << overlaps
+			<< "}"
+			<< std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,14 @@
+//==================================================================================================
+//
+// File:	ShardMerge.h
+//
+// Combines accumulation files written by renders of different sample ranges of the same frame
+// (see --samples and --accumulation) into the final image.
+//=================================================================================================
+#ifndef SHARDMERGE_H
+#define SHARDMERGE_H
+
+//! Merges options.mergeInputs into options.mergeOutput, returns the process exit code
+int MergeShards (const RenderOptions & options);
+
+#endif //SHARDMERGE_H
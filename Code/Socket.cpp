@@ -0,0 +1,320 @@
+//==================================================================================================
+//
+// File:	Socket.cpp
+//
+// Blocking stream sockets. Only implemented on posix platforms, elsewhere every call fails.
+//
+//=================================================================================================
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include <cstring>
+#include <string>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+#if !defined(_WIN32)
+
+//=============================================================================
+bool IsTcpAddress (const char * address)
+{
+    return strchr(address, ':') && !strchr(address, '/');
+}
+
+//=============================================================================
+static bool MakeUnixAddress (const char * address, sockaddr_un * out)
+{
+    memset(out, 0, sizeof(*out));
+    out->sun_family = AF_UNIX;
+
+    if (strlen(address) >= sizeof(out->sun_path))
+        return false;
+
+    strcpy(out->sun_path, address);
+    return true;
+}
+
+//=============================================================================
+// Resolves "host:port", an empty host means any interface when listening
+static addrinfo * ResolveTcpAddress (const char * address, bool passive)
+{
+    const char * colon = strrchr(address, ':');
+    const std::string host(address, colon);
+    const std::string port(colon + 1);
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = passive ? AI_PASSIVE : 0;
+
+    addrinfo * result = null;
+    if (getaddrinfo(host.empty() ? null : host.c_str(), port.c_str(), &hints, &result) != 0)
+        return null;
+
+    return result;
+}
+
+//=============================================================================
+// Leases and results are small request/reply messages, don't let Nagle batch them
+static void SetNoDelay (SocketHandle s)
+{
+    const int on = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+//=============================================================================
+SocketHandle SocketListen (const char * address)
+{
+    if (IsTcpAddress(address))
+    {
+        addrinfo * info = ResolveTcpAddress(address, true);
+        if (!info)
+            return INVALID_SOCKET_HANDLE;
+
+        SocketHandle s = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (s >= 0)
+        {
+            const int on = 1;
+            setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+            if (bind(s, info->ai_addr, info->ai_addrlen) != 0 || listen(s, 64) != 0)
+            {
+                close(s);
+                s = INVALID_SOCKET_HANDLE;
+            }
+        }
+
+        freeaddrinfo(info);
+        return s < 0 ? INVALID_SOCKET_HANDLE : s;
+    }
+
+    sockaddr_un addr;
+    if (!MakeUnixAddress(address, &addr))
+        return INVALID_SOCKET_HANDLE;
+
+    const SocketHandle s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0)
+        return INVALID_SOCKET_HANDLE;
+
+    // A stale socket file from a previous run would make bind fail. Anything else at the
+    // path, or a socket something still listens on, is not ours to remove.
+    struct stat info;
+    if (lstat(address, &info) == 0)
+    {
+        if (!S_ISSOCK(info.st_mode) || connect(s, (const sockaddr *)&addr, sizeof(addr)) == 0)
+        {
+            close(s);
+            errno = EADDRINUSE;
+            return INVALID_SOCKET_HANDLE;
+        }
+
+        unlink(address);
+    }
+
+    if (bind(s, (const sockaddr *)&addr, sizeof(addr)) != 0 || listen(s, 64) != 0)
+    {
+        close(s);
+        return INVALID_SOCKET_HANDLE;
+    }
+
+    return s;
+}
+
+//=============================================================================
+SocketHandle SocketAccept (SocketHandle listener)
+{
+    for (;;)
+    {
+        const SocketHandle s = accept(listener, null, null);
+        if (s < 0 && errno == EINTR)
+            continue;
+
+        if (s < 0)
+            return INVALID_SOCKET_HANDLE;
+
+        sockaddr_storage addr;
+        socklen_t length = sizeof(addr);
+        if (getsockname(s, (sockaddr *)&addr, &length) == 0 && addr.ss_family != AF_UNIX)
+            SetNoDelay(s);
+
+        return s;
+    }
+}
+
+//=============================================================================
+SocketHandle SocketConnect (const char * address)
+{
+    if (IsTcpAddress(address))
+    {
+        addrinfo * info = ResolveTcpAddress(address, false);
+        if (!info)
+            return INVALID_SOCKET_HANDLE;
+
+        SocketHandle s = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (s >= 0 && connect(s, info->ai_addr, info->ai_addrlen) != 0)
+        {
+            close(s);
+            s = INVALID_SOCKET_HANDLE;
+        }
+
+        freeaddrinfo(info);
+        if (s < 0)
+            return INVALID_SOCKET_HANDLE;
+
+        SetNoDelay(s);
+        return s;
+    }
+
+    sockaddr_un addr;
+    if (!MakeUnixAddress(address, &addr))
+        return INVALID_SOCKET_HANDLE;
+
+    const SocketHandle s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0)
+        return INVALID_SOCKET_HANDLE;
+
+    if (connect(s, (const sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(s);
+        return INVALID_SOCKET_HANDLE;
+    }
+
+    return s;
+}
+
+//=============================================================================
+void SocketShutdown (SocketHandle socket)
+{
+    if (socket != INVALID_SOCKET_HANDLE)
+        shutdown(socket, SHUT_RDWR);
+}
+
+//=============================================================================
+void SocketClose (SocketHandle socket)
+{
+    if (socket != INVALID_SOCKET_HANDLE)
+    {
+        shutdown(socket, SHUT_RDWR);
+        close(socket);
+    }
+}
+
+//=============================================================================
+bool SocketSetRecvTimeout (SocketHandle socket, float32 seconds)
+{
+    timeval timeout;
+    timeout.tv_sec  = time_t(seconds);
+    timeout.tv_usec = suseconds_t((seconds - float32(timeout.tv_sec)) * 1e6f);
+    return setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0;
+}
+
+//=============================================================================
+bool SocketSend (SocketHandle socket, const void * data, size_t bytes)
+{
+    const char * it = (const char *)data;
+    while (bytes)
+    {
+        // No SIGPIPE when the other end has gone away, just fail the send
+        const ssize_t sent = send(socket, it, bytes, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+
+        it    += sent;
+        bytes -= size_t(sent);
+    }
+
+    return true;
+}
+
+//=============================================================================
+bool SocketRecv (SocketHandle socket, void * data, size_t bytes)
+{
+    char * it = (char *)data;
+    while (bytes)
+    {
+        const ssize_t received = recv(socket, it, bytes, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+
+        it    += received;
+        bytes -= size_t(received);
+    }
+
+    return true;
+}
+
+#else
+
+bool         IsTcpAddress (const char * address) { return strchr(address, ':') && !strchr(address, '/'); }
+SocketHandle SocketListen (const char *) { return INVALID_SOCKET_HANDLE; }
+SocketHandle SocketAccept (SocketHandle) { return INVALID_SOCKET_HANDLE; }
+SocketHandle SocketConnect (const char *) { return INVALID_SOCKET_HANDLE; }
+void         SocketShutdown (SocketHandle) { }
+void         SocketClose (SocketHandle) { }
+bool         SocketSetRecvTimeout (SocketHandle, float32) { return false; }
+bool         SocketSend (SocketHandle, const void *, size_t) { return false; }
+bool         SocketRecv (SocketHandle, void *, size_t) { return false; }
+
+#endif
+
+//=============================================================================
+bool SocketSendLine (SocketHandle socket, const std::string & line)
+{
+    return SocketSend(socket, line.data(), line.size()) && SocketSend(socket, "\n", 1);
+}
+
+//=============================================================================
+// Lines are short control messages, reading a byte at a time keeps this simple. The
+// receive timeout is set to what is left before every byte, a timeout alone would
+// restart with each one.
+bool SocketRecvLine (SocketHandle socket, std::string * line, size_t maxLength, float32 seconds)
+{
+    line->clear();
+
+    const Time::Point start = Time::GetRealTime();
+
+    for (;;)
+    {
+        if (seconds > 0.0f)
+        {
+            const float32 remaining = seconds - (Time::GetRealTime() - start).GetSeconds();
+            if (remaining <= 0.0f || !SocketSetRecvTimeout(socket, Max(remaining, 0.001f)))
+                return false;
+        }
+
+        char c;
+        if (!SocketRecv(socket, &c, 1))
+            return false;
+
+        if (c == '\n')
+            return true;
+
+        if (c != '\r')
+        {
+            if (line->size() == maxLength)
+                return false;
+
+            line->push_back(c);
+        }
+    }
+}
+
+} // namespace RT
@@ -0,0 +1,41 @@
+//==================================================================================================
+//
+// File:	Socket.h
+//
+// Thin blocking stream socket helpers used by the render service and distributed rendering.
+// Addresses of the form "host:port" are tcp, anything else is a unix domain socket path.
+//=================================================================================================
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include <string>
+
+namespace RT
+{
+
+typedef int SocketHandle;
+
+const SocketHandle INVALID_SOCKET_HANDLE = -1;
+
+//! Whether address is "host:port" rather than a unix domain socket path
+bool IsTcpAddress (const char * address);
+
+//! A unix socket path is only taken over from a socket nothing listens on, anything
+//! else there fails with errno EADDRINUSE
+SocketHandle SocketListen (const char * address);
+SocketHandle SocketAccept (SocketHandle listener);
+SocketHandle SocketConnect (const char * address);
+void         SocketShutdown (SocketHandle socket);	// Wakes anything blocked on the socket
+void         SocketClose (SocketHandle socket);
+//! Receives fail once nothing arrived for seconds, 0 waits forever
+bool         SocketSetRecvTimeout (SocketHandle socket, float32 seconds);
+
+bool SocketSend (SocketHandle socket, const void * data, size_t bytes);
+bool SocketRecv (SocketHandle socket, void * data, size_t bytes);
+bool SocketSendLine (SocketHandle socket, const std::string & line);
+//! Fails unless a whole line of at most maxLength arrives within seconds, 0 waits forever
+bool SocketRecvLine (SocketHandle socket, std::string * line, size_t maxLength, float32 seconds);
+
+} // namespace RT
+
+#endif //SOCKET_H
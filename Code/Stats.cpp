@@ -0,0 +1,256 @@
+//==================================================================================================
+//
+// File:	Stats.cpp
+//
+// Render statistics.
+//
+//=================================================================================================
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+static const char * const STAT_NAMES[STAT_COUNT] = {
+	"primary_rays",
+	"secondary_rays",
+	"primitive_tests",
+	"node_visits",
+	"roulette_kills",
+	"cached_primary_hits",
+};
+
+static const char * const SHADING_SLOT_NAMES[STAT_SHADING_SLOTS] = {
+	"diffuse",
+	"reflect",
+	"refract",
+	"miss",
+};
+
+//=============================================================================
+static uint64 GetNanoseconds ()
+{
+	return uint64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//=============================================================================
+// The time stamp counter where there is one, a fraction of the cost of reading the clock
+static inline uint64 GetTicks ()
+{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return GetNanoseconds();
+#endif
+}
+
+// Both clocks when the process started, to convert ticks with
+static const uint64 s_startTicks       = GetTicks();
+static const uint64 s_startNanoseconds = GetNanoseconds();
+
+#if RT_STATS
+
+thread_local RenderStats tl_renderStats;
+
+// Ticks the rays nested in the current ShadingTimer took
+static thread_local uint64 tl_childTicks;
+
+#endif
+
+//=============================================================================
+static float64 Divide (uint64 numerator, uint64 denominator)
+{
+	return denominator ? float64(numerator) / float64(denominator) : 0.0;
+}
+
+
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+const char * GetStatName (EStat stat)
+{
+	return STAT_NAMES[stat];
+}
+
+//=============================================================================
+const char * GetShadingSlotName (uint slot)
+{
+	return SHADING_SLOT_NAMES[slot];
+}
+
+//=============================================================================
+void RenderStats::Clear ()
+{
+	memset(this, 0, sizeof(*this));
+}
+
+//=============================================================================
+void RenderStats::Add (const RenderStats & stats)
+{
+	for (uint i = 0; i < STAT_COUNT; ++i)
+		counters[i] += stats.counters[i];
+
+	for (uint i = 0; i < STAT_SHADING_SLOTS; ++i)
+	{
+		shadingRays[i]  += stats.shadingRays[i];
+		shadingTicks[i] += stats.shadingTicks[i];
+	}
+}
+
+//=============================================================================
+AtomicRenderStats::AtomicRenderStats ()
+{
+	for (std::atomic<uint64> & counter : mCounters)
+		counter = 0;
+
+	for (uint i = 0; i < STAT_SHADING_SLOTS; ++i)
+	{
+		mShadingRays[i]  = 0;
+		mShadingTicks[i] = 0;
+	}
+}
+
+//=============================================================================
+void AtomicRenderStats::Add (const RenderStats & stats)
+{
+	for (uint i = 0; i < STAT_COUNT; ++i)
+		mCounters[i].fetch_add(stats.counters[i], std::memory_order_relaxed);
+
+	for (uint i = 0; i < STAT_SHADING_SLOTS; ++i)
+	{
+		mShadingRays[i].fetch_add(stats.shadingRays[i], std::memory_order_relaxed);
+		mShadingTicks[i].fetch_add(stats.shadingTicks[i], std::memory_order_relaxed);
+	}
+}
+
+//=============================================================================
+void AtomicRenderStats::Get (RenderStats * out) const
+{
+	for (uint i = 0; i < STAT_COUNT; ++i)
+		out->counters[i] = mCounters[i].load(std::memory_order_relaxed);
+
+	for (uint i = 0; i < STAT_SHADING_SLOTS; ++i)
+	{
+		out->shadingRays[i]  = mShadingRays[i].load(std::memory_order_relaxed);
+		out->shadingTicks[i] = mShadingTicks[i].load(std::memory_order_relaxed);
+	}
+}
+
+//=============================================================================
+float64 GetSecondsPerStatTick ()
+{
+	const uint64 ticks       = GetTicks() - s_startTicks;
+	const uint64 nanoseconds = GetNanoseconds() - s_startNanoseconds;
+	return ticks ? nanoseconds * 1e-9 / ticks : 1e-9;
+}
+
+//=============================================================================
+void PrintRenderStats (std::ostream & out, const RenderStats & stats, float32 seconds)
+{
+	const uint64 rays = stats.GetRays();
+
+	const float64 nanosecondsPerTick = GetSecondsPerStatTick() * 1e9;
+
+	uint64 shadingTotal = 0;
+	for (uint64 ticks : stats.shadingTicks)
+		shadingTotal += ticks;
+
+	out
+		<< std::fixed << std::setprecision(0)
+		<< "Rays:      " << rays << " (" << stats.counters[STAT_PRIMARY_RAYS] << " primary, "
+		<< stats.counters[STAT_SECONDARY_RAYS] << " secondary), "
+		<< (seconds > 0.0f ? rays / seconds : 0.0f) << " rays/s" << std::endl
+		<< std::setprecision(2)
+		<< "Per ray:   " << Divide(stats.counters[STAT_PRIMITIVE_TESTS], rays) << " primitive tests, "
+		<< Divide(stats.counters[STAT_NODE_VISITS], rays) << " node visits" << std::endl
+		<< "Roulette:  " << stats.counters[STAT_ROULETTE_KILLS] << " paths ended" << std::endl;
+
+	if (stats.counters[STAT_CACHED_PRIMARY_HITS])
+		out << "G-buffer:  " << stats.counters[STAT_CACHED_PRIMARY_HITS] << " camera rays not traced" << std::endl;
+
+	out << "Shading:  ";
+
+	for (uint i = 0; i < STAT_SHADING_SLOTS; ++i)
+	{
+		out
+			<< " " << SHADING_SLOT_NAMES[i] << " "
+			<< std::setprecision(1) << 100.0 * Divide(stats.shadingTicks[i], shadingTotal) << "% "
+			<< std::setprecision(0) << Divide(stats.shadingTicks[i], stats.shadingRays[i]) * nanosecondsPerTick << "ns/ray"
+			<< (i + 1 < STAT_SHADING_SLOTS ? "," : "");
+	}
+
+	out << std::endl;
+}
+
+//=============================================================================
+void WriteRenderStatsJson (std::ostream & out, const RenderStats & stats, float32 seconds)
+{
+	const uint64  rays           = stats.GetRays();
+	const float64 secondsPerTick = GetSecondsPerStatTick();
+
+	out << std::fixed << std::setprecision(3) << '{';
+	for (uint i = 0; i < STAT_COUNT; ++i)
+		out << (i ? "," : "") << '"' << STAT_NAMES[i] << "\":" << stats.counters[i];
+
+	out
+		<< ",\"rays_per_second\":"          << (seconds > 0.0f ? rays / seconds : 0.0f)
+		<< ",\"primitive_tests_per_ray\":"  << Divide(stats.counters[STAT_PRIMITIVE_TESTS], rays)
+		<< ",\"node_visits_per_ray\":"      << Divide(stats.counters[STAT_NODE_VISITS], rays)
+		<< ",\"shading\":{";
+
+	for (uint i = 0; i < STAT_SHADING_SLOTS; ++i)
+	{
+		out
+			<< (i ? "," : "") << '"' << SHADING_SLOT_NAMES[i] << "\":{"
+			<< "\"rays\":"     << stats.shadingRays[i]
+			<< ",\"seconds\":" << stats.shadingTicks[i] * secondsPerTick
+			<< "}";
+	}
+
+	out << "}}";
+}
+
+#if RT_STATS
+
+//=============================================================================
+ShadingTimer::ShadingTimer () :
+	mStart(GetTicks()),
+	mOuterChildren(tl_childTicks),
+	mSlot(MATERIAL_TYPE_COUNT)
+{
+	tl_childTicks = 0;
+}
+
+//=============================================================================
+ShadingTimer::~ShadingTimer ()
+{
+	const uint64 total = GetTicks() - mStart;
+
+	tl_renderStats.shadingRays[mSlot]        += 1;
+	tl_renderStats.shadingTicks[mSlot] += total - tl_childTicks;
+
+	// This ray and everything it spawned is nested time of the enclosing ray
+	tl_childTicks = mOuterChildren + total;
+}
+
+#endif
+
+} // namespace RT
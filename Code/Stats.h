@@ -0,0 +1,119 @@
+//==================================================================================================
+//
+// File:	Stats.h
+//
+// Counters of what the render threads spend their time on. Every thread counts into its own
+// thread local RenderStats without any synchronization, and hands them to its render manager at
+// the end of each block, where they are summed with atomic adds. Building with RT_STATS defined
+// to 0 compiles the counters and everything reporting them out.
+//=================================================================================================
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <iosfwd>
+
+#if !defined(RT_STATS)
+#define RT_STATS 1
+#endif
+
+namespace RT
+{
+
+enum EStat
+{
+	STAT_PRIMARY_RAYS,			//!< Rays from the camera
+	STAT_SECONDARY_RAYS,		//!< Bounce, reflection and refraction rays
+	STAT_PRIMITIVE_TESTS,		//!< Objects and triangles intersected, at every level of hierarchy
+	STAT_NODE_VISITS,			//!< Bvh nodes taken off the traversal stack, scene and meshes
+	STAT_ROULETTE_KILLS,		//!< Paths ended by russian roulette
+	STAT_CACHED_PRIMARY_HITS,	//!< Camera rays answered by the G-buffer instead of traced
+	STAT_COUNT
+};
+
+const char * GetStatName (EStat stat);
+
+//! Time is kept per material of what a ray hit, and in the last slot for rays that missed
+static const uint STAT_SHADING_SLOTS = MATERIAL_TYPE_COUNT + 1;
+
+const char * GetShadingSlotName (uint slot);
+
+//==================================================================================================
+//
+// The counters of one thread, or the sum of several
+//==================================================================================================
+struct RenderStats
+{
+	uint64 counters[STAT_COUNT];
+	uint64 shadingRays[STAT_SHADING_SLOTS];
+	uint64 shadingTicks[STAT_SHADING_SLOTS];	//!< Tracing and shading a ray, without the rays it spawned
+
+	void Clear ();
+	void Add (const RenderStats & stats);
+
+	inline uint64 GetRays () const { return counters[STAT_PRIMARY_RAYS] + counters[STAT_SECONDARY_RAYS]; }
+};
+
+//==================================================================================================
+//
+// Stats summed from many threads without a lock
+//==================================================================================================
+class AtomicRenderStats
+{
+public:
+	AtomicRenderStats ();
+
+	void Add (const RenderStats & stats);
+	void Get (RenderStats * out) const;
+
+private:
+	std::atomic<uint64> mCounters[STAT_COUNT];
+	std::atomic<uint64> mShadingRays[STAT_SHADING_SLOTS];
+	std::atomic<uint64> mShadingTicks[STAT_SHADING_SLOTS];
+};
+
+//! Seconds per tick of the shading times, measured over the life of the process so far
+float64 GetSecondsPerStatTick ();
+
+//! Rays per second and a breakdown per ray, for people
+void PrintRenderStats (std::ostream & out, const RenderStats & stats, float32 seconds);
+//! The same as a json object
+void WriteRenderStatsJson (std::ostream & out, const RenderStats & stats, float32 seconds);
+
+#if RT_STATS
+
+//! The counters of the calling thread
+extern thread_local RenderStats tl_renderStats;
+
+//==================================================================================================
+//
+// Times the ray traced and shaded in its scope, excluding the nested scopes of the rays it spawns,
+// and adds it to the slot of what the ray hit
+//==================================================================================================
+class ShadingTimer
+{
+public:
+	ShadingTimer ();
+	~ShadingTimer ();
+
+	inline void SetSlot (uint slot) { mSlot = slot; }
+
+private:
+	uint64 mStart;
+	uint64 mOuterChildren;	// Nested ticks of the enclosing scope, restored on exit
+	uint   mSlot;
+};
+
+#define RT_STAT_ADD(stat, n)	(::RT::tl_renderStats.counters[::RT::stat] += (n))
+#define RT_STATS_ONLY(...)		__VA_ARGS__
+
+#else
+
+#define RT_STAT_ADD(stat, n)	((void)0)
+#define RT_STATS_ONLY(...)
+
+#endif
+
+} // namespace RT
+
+#endif //STATS_H
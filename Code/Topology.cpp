@@ -0,0 +1,243 @@
+//==================================================================================================
+//
+// File:	Topology.cpp
+//
+// Processor topology, from sysfs on Linux.
+//
+//=================================================================================================
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <utility>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+static const char * const AFFINITY_NAMES[] = {
+	"none",
+	"compact",
+	"scatter",
+};
+
+#if defined(__linux__)
+
+//=============================================================================
+static bool ReadUint (const char * path, uint32 * out)
+{
+	FILE * file = fopen(path, "r");
+	if (!file)
+		return false;
+
+	unsigned value = 0;
+	const bool ok = fscanf(file, "%u", &value) == 1;
+	fclose(file);
+
+	if (ok)
+		*out = value;
+
+	return ok;
+}
+
+//=============================================================================
+// The node is only in the name of a nodeN link next to the processor's topology
+static uint32 ReadNode (uint32 cpu)
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", cpu);
+
+	DIR * dir = opendir(path);
+	if (!dir)
+		return 0;
+
+	uint32 node = 0;
+	while (const dirent * entry = readdir(dir))
+	{
+		unsigned value = 0;
+		if (sscanf(entry->d_name, "node%u", &value) == 1)
+		{
+			node = value;
+			break;
+		}
+	}
+
+	closedir(dir);
+	return node;
+}
+
+//=============================================================================
+// Hybrid parts report a capacity per core on recent kernels, the maximum
+// frequency tells big from little cores on older ones
+static uint32 ReadCapacity (uint32 cpu)
+{
+	char   path[96];
+	uint32 value = 0;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/cpu_capacity", cpu);
+	if (ReadUint(path, &value))
+		return value;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/cpufreq/cpuinfo_max_freq", cpu);
+	if (ReadUint(path, &value))
+		return value / 1000;
+
+	return 1;
+}
+
+#endif
+
+
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+bool ParseAffinity (const char * name, EAffinity * out)
+{
+	for (uint i = 0; i < sizeof(AFFINITY_NAMES) / sizeof(AFFINITY_NAMES[0]); ++i)
+	{
+		if (!strcmp(name, AFFINITY_NAMES[i]))
+		{
+			*out = EAffinity(i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//=============================================================================
+const char * GetAffinityName (EAffinity affinity)
+{
+	return AFFINITY_NAMES[affinity];
+}
+
+//=============================================================================
+std::vector<LogicalProcessor> GetProcessorTopology ()
+{
+	std::vector<LogicalProcessor> processors;
+
+#if defined(__linux__)
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+	{
+		std::map<std::pair<uint32, uint32>, uint32> cores;	// (package, core id) to core
+		std::map<uint32, uint32>                    siblings;	// Core to hardware threads seen
+
+		for (uint32 cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+		{
+			if (!CPU_ISSET(cpu, &allowed))
+				continue;
+
+			char   path[96];
+			uint32 coreId = cpu;
+
+			LogicalProcessor processor;
+			processor.index   = cpu;
+			processor.package = 0;
+
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/physical_package_id", cpu);
+			ReadUint(path, &processor.package);
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/core_id", cpu);
+			ReadUint(path, &coreId);
+
+			const auto core = cores.emplace(std::make_pair(processor.package, coreId), uint32(cores.size())).first;
+
+			processor.core     = core->second;
+			processor.node     = ReadNode(cpu);
+			processor.capacity = ReadCapacity(cpu);
+			processor.sibling  = siblings[processor.core]++;
+			processors.push_back(processor);
+		}
+	}
+#endif
+
+	if (processors.empty())
+	{
+		for (uint32 i = 0; i < ThreadLogicalProcessorCount(); ++i)
+			processors.push_back({ i, i, 0, 0, 1, 0 });
+	}
+
+	std::stable_sort(processors.begin(), processors.end(), [](const LogicalProcessor & a, const LogicalProcessor & b) {
+		return a.capacity > b.capacity;
+	});
+
+	return processors;
+}
+
+//=============================================================================
+std::vector<uint32> GetThreadPlacement (EAffinity affinity, uint32 threads)
+{
+	std::vector<uint32> placement;
+	if (affinity == AFFINITY_NONE || !threads)
+		return placement;
+
+	std::vector<LogicalProcessor> processors = GetProcessorTopology();
+
+	// How many cores of its package come before each core, to alternate packages with
+	std::map<uint32, uint32> coreRanks;
+	{
+		std::map<uint32, uint32> packageCores;
+		for (const LogicalProcessor & processor : processors)
+		{
+			if (!processor.sibling)
+				coreRanks[processor.core] = packageCores[processor.package]++;
+		}
+	}
+
+	std::stable_sort(processors.begin(), processors.end(), [&](const LogicalProcessor & a, const LogicalProcessor & b) {
+		if (affinity == AFFINITY_COMPACT)
+		{
+			if (a.capacity != b.capacity) return a.capacity > b.capacity;
+			if (a.package != b.package)   return a.package < b.package;
+			if (a.core != b.core)         return a.core < b.core;
+			return a.sibling < b.sibling;
+		}
+
+		// Scatter, every core gets one thread before any gets two
+		if (a.sibling != b.sibling)   return a.sibling < b.sibling;
+		if (a.capacity != b.capacity) return a.capacity > b.capacity;
+		if (coreRanks[a.core] != coreRanks[b.core]) return coreRanks[a.core] < coreRanks[b.core];
+		return a.package < b.package;
+	});
+
+	for (uint32 i = 0; i < threads; ++i)
+		placement.push_back(processors[i % processors.size()].index);
+
+	return placement;
+}
+
+//=============================================================================
+bool PinCurrentThread (uint32 processor)
+{
+#if defined(_WIN32)
+	return processor < 64 && SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << processor) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(processor, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	(void)processor;
+	return false;
+#endif
+}
+
+} // namespace RT
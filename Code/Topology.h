@@ -0,0 +1,51 @@
+//==================================================================================================
+//
+// File:	Topology.h
+//
+// Where the logical processors of the machine sit: which core, socket and numa node each belongs
+// to and how fast its core is on hybrid parts. Used to place render threads on processors.
+//=================================================================================================
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <vector>
+
+namespace RT
+{
+
+struct LogicalProcessor
+{
+	uint32 index;		//!< What the OS calls it, to pin threads with
+	uint32 core;		//!< Unique across packages
+	uint32 package;		//!< Socket
+	uint32 node;		//!< Numa node
+	uint32 capacity;	//!< Relative speed of its core, larger is faster, equal on uniform machines
+	uint32 sibling;		//!< 0 for the first hardware thread of its core, 1 for the second, ...
+};
+
+//! How render threads are placed on processors
+enum EAffinity
+{
+	AFFINITY_NONE,		//!< Left to the OS scheduler
+	AFFINITY_COMPACT,	//!< Fill every hardware thread of a core, then the next core of the same socket
+	AFFINITY_SCATTER,	//!< One thread per core, alternating sockets, before any core gets a second
+};
+
+//! Parses "none", "compact" or "scatter"
+bool ParseAffinity (const char * name, EAffinity * out);
+const char * GetAffinityName (EAffinity affinity);
+
+//! The processors this process may run on, fastest cores first. Machines whose topology can't be
+//! read come out as one core per processor on a single socket.
+std::vector<LogicalProcessor> GetProcessorTopology ();
+
+//! The processor for each of threads threads, empty for AFFINITY_NONE. Processors are reused from
+//! the start when there are more threads than processors.
+std::vector<uint32> GetThreadPlacement (EAffinity affinity, uint32 threads);
+
+//! Restricts the calling thread to processor, returns false if the OS refused
+bool PinCurrentThread (uint32 processor);
+
+} // namespace RT
+
+#endif //TOPOLOGY_H
@@ -0,0 +1,197 @@
+//==================================================================================================
+//
+// File:	Trace.cpp
+//
+// Chrome trace recording.
+//
+//=================================================================================================
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+
+#include "Pch.h"
+
+namespace RT
+{
+
+//=============================================================================
+// Helpers
+//=============================================================================
+
+static const char * const TRACE_EVENT_NAMES[TRACE_EVENT_COUNT] = {
+	"GetBlock",
+	"Render",
+	"CopyToBackbuffer",
+	"CompleteBlock",
+	"LoadScene",
+	"SaveImage",
+	"Paused",
+};
+
+// Threads past this many are still traced, just not named
+static const uint32 MAX_TRACE_THREADS = 256;
+static const uint32 NO_TRACE_THREAD   = ~0u;
+
+struct TraceSpan
+{
+	uint64 begin;	// Nanoseconds of GetTraceTime
+	uint64 end;
+	uint32 thread;
+	uint32 event;
+	uint32 x;
+	uint32 y;
+};
+
+std::atomic<bool> g_bTracing{false};
+
+static std::unique_ptr<TraceSpan[]> s_spans;
+static uint32                       s_capacity = 0;
+static uint64                       s_startTime = 0;
+static std::atomic<uint64>          s_nextSpan{0};		// Spans ever claimed, the ring wraps on it
+static std::atomic<uint32>          s_nextThread{0};
+static const char *                 s_threadNames[MAX_TRACE_THREADS];
+
+static thread_local uint32 tl_traceThread = NO_TRACE_THREAD;
+
+//=============================================================================
+// Threads are numbered as they first record something
+static uint32 GetTraceThread ()
+{
+	if (tl_traceThread == NO_TRACE_THREAD)
+		tl_traceThread = s_nextThread.fetch_add(1, std::memory_order_relaxed);
+
+	return tl_traceThread;
+}
+
+//=============================================================================
+// Chrome traces are in microseconds
+static float64 ToMicroseconds (uint64 time)
+{
+	return float64(time - s_startTime) * 1e-3;
+}
+
+
+
+//=============================================================================
+// Functions
+//=============================================================================
+
+//=============================================================================
+const char * GetTraceEventName (ETraceEvent event)
+{
+	ASSERT(event < TRACE_EVENT_COUNT);
+	return TRACE_EVENT_NAMES[event];
+}
+
+//=============================================================================
+uint64 GetTraceTime ()
+{
+	return uint64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//=============================================================================
+void StartTrace (uint32 capacity)
+{
+	ASSERT(capacity);
+
+	g_bTracing = false;
+
+	if (capacity != s_capacity)
+	{
+		s_spans.reset(new TraceSpan[capacity]);
+		s_capacity = capacity;
+	}
+
+	s_startTime = GetTraceTime();
+	s_nextSpan  = 0;
+	g_bTracing  = true;
+}
+
+//=============================================================================
+void StopTrace ()
+{
+	g_bTracing = false;
+}
+
+//=============================================================================
+void SetTraceThreadName (const char * name)
+{
+	const uint32 thread = GetTraceThread();
+	if (thread < MAX_TRACE_THREADS)
+		s_threadNames[thread] = name;
+}
+
+//=============================================================================
+void RecordTraceSpan (ETraceEvent event, uint64 begin, uint32 x, uint32 y)
+{
+	// Tracing may have stopped, or restarted with a smaller ring, since the scope began
+	if (!g_bTracing.load(std::memory_order_acquire))
+		return;
+
+	const uint64 index = s_nextSpan.fetch_add(1, std::memory_order_relaxed);
+
+	TraceSpan & span = s_spans[index % s_capacity];
+	span.begin  = begin;
+	span.end    = GetTraceTime();
+	span.thread = GetTraceThread();
+	span.event  = event;
+	span.x      = x;
+	span.y      = y;
+}
+
+//=============================================================================
+bool WriteTrace (const char * path)
+{
+	std::ofstream out(path);
+	if (!out)
+		return false;
+
+	const uint64 claimed = s_nextSpan.load();
+	const uint64 count   = Min<uint64>(claimed, s_capacity);
+	const uint32 threads = s_nextThread.load();
+
+	out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"RayTracer\"}}";
+
+	for (uint32 thread = 0; thread < threads; ++thread)
+	{
+		const char * name = thread < MAX_TRACE_THREADS ? s_threadNames[thread] : null;
+
+		out
+			<< ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+			<< ",\"args\":{\"name\":\"" << (name ? name : "Thread") << ' ' << thread << "\"}}";
+	}
+
+	// Oldest first, once the ring wrapped the oldest is where the next span goes
+	for (uint64 i = claimed - count; i < claimed; ++i)
+	{
+		const TraceSpan & span  = s_spans[i % s_capacity];
+		const ETraceEvent event = ETraceEvent(span.event);
+
+		// Spans recorded before this trace started, by scopes that began before it
+		if (span.begin < s_startTime)
+			continue;
+
+		out
+			<< ",\n{\"name\":\"" << GetTraceEventName(event)
+			<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << span.thread
+			<< ",\"ts\":"  << ToMicroseconds(span.begin)
+			<< ",\"dur\":" << float64(span.end - span.begin) * 1e-3;
+
+		if (event == TRACE_RENDER || event == TRACE_COPY_TO_BACKBUFFER || event == TRACE_COMPLETE_BLOCK)
+			out << ",\"args\":{\"x\":" << span.x << ",\"y\":" << span.y << '}';
+
+		out << '}';
+	}
+
+	out
+		<< "\n],\"displayTimeUnit\":\"ms\""
+		<< ",\"otherData\":{\"spans\":" << count << ",\"dropped_spans\":" << claimed - count << "}}"
+		<< std::endl;
+
+	return bool(out);
+}
+
+} // namespace RT
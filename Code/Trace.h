@@ -0,0 +1,96 @@
+//==================================================================================================
+//
+// File:	Trace.h
+//
+// An opt-in timeline of what every thread of the process spends its time on, written as Chrome
+// trace json for chrome://tracing or Perfetto. Spans are claimed from one ring buffer with an
+// atomic add, so recording never takes a lock, and the oldest spans are overwritten once it is
+// full. When tracing is off a span costs a single load and branch.
+//=================================================================================================
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+
+namespace RT
+{
+
+enum ETraceEvent
+{
+	TRACE_GET_BLOCK,			//!< Waiting for the render manager to hand out a block
+	TRACE_RENDER,				//!< Sampling every pixel of a block
+	TRACE_COPY_TO_BACKBUFFER,	//!< Resolving a block into the image
+	TRACE_COMPLETE_BLOCK,		//!< Handing a finished block back
+	TRACE_LOAD_SCENE,
+	TRACE_SAVE_IMAGE,
+	TRACE_PAUSED,				//!< A renderer waiting for its render manager to resume
+	TRACE_EVENT_COUNT
+};
+
+const char * GetTraceEventName (ETraceEvent event);
+
+//! Spans kept before the oldest are overwritten, 32 bytes each
+static const uint32 DEFAULT_TRACE_CAPACITY = 1 << 18;
+
+//! Starts recording into a ring of capacity spans, dropping anything recorded before
+void StartTrace (uint32 capacity = DEFAULT_TRACE_CAPACITY);
+//! Stops recording, the spans are kept until the next StartTrace
+void StopTrace ();
+
+//! Writes the recorded spans as Chrome trace json. Spans still being recorded by other threads
+//! may come out torn, so stop the threads being traced first.
+bool WriteTrace (const char * path);
+
+//! Names the calling thread in the timeline, name must outlive the trace
+void SetTraceThreadName (const char * name);
+
+//! Whether spans are being recorded
+extern std::atomic<bool> g_bTracing;
+
+void RecordTraceSpan (ETraceEvent event, uint64 begin, uint32 x, uint32 y);
+uint64 GetTraceTime ();
+
+//==================================================================================================
+//
+// Records a span from its construction to the end of its scope, x and y show up as the arguments
+// of the span, the block for block events
+//==================================================================================================
+class TraceScope
+{
+public:
+	inline TraceScope (ETraceEvent event, uint32 x = 0, uint32 y = 0) :
+		mBegin(g_bTracing.load(std::memory_order_relaxed) ? GetTraceTime() : 0),
+		mEvent(event),
+		mX(x),
+		mY(y)
+	{
+	}
+
+	inline ~TraceScope ()
+	{
+		if (mBegin)
+			RecordTraceSpan(mEvent, mBegin, mX, mY);
+	}
+
+	//! Records the span now instead of at the end of the scope
+	inline void End ()
+	{
+		if (mBegin)
+			RecordTraceSpan(mEvent, mBegin, mX, mY);
+
+		mBegin = 0;
+	}
+
+	TraceScope (const TraceScope &) = delete;
+	TraceScope & operator= (const TraceScope &) = delete;
+
+private:
+	uint64      mBegin;		// 0 when tracing was off as the scope started
+	ETraceEvent mEvent;
+	uint32      mX;
+	uint32      mY;
+};
+
+} // namespace RT
+
+#endif //TRACE_H
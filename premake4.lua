@@ -1,3 +1,8 @@
+newoption {
+    trigger     = "no-stats",
+    description = "Compile the render statistics counters out"
+}
+
 solution "RayTracer"
     language "C++"
     flags { "StaticRuntime", "Unicode" }
@@ -9,6 +14,9 @@ solution "RayTracer"
         "./Code/"
     }
     defines { "_UNICODE" }
+    if _OPTIONS["no-stats"] then
+        defines { "RT_STATS=0" }
+    end
     
     -- WindowsSDK
     configuration { "vs2017"}
@@ -56,6 +64,39 @@ solution "RayTracer"
     
     
     
+    -- BENCHMARKS ---------------------------
+    -- The renderer's code without its main, and the microbenchmarks of its hot kernels
+    project "RayTracerBench"
+        kind "ConsoleApp"
+        
+        location "./Build/Projects/"
+        targetdir "./Bin/"
+        
+        files {
+            "./Code/**.h",
+            "./Code/**.cpp",
+            "./Code/**.inl",
+            "./Bench/**.h",
+            "./Bench/**.cpp",
+        }
+        excludes {
+            "./Code/Main.cpp",
+        }
+        vpaths {
+            ["Bench/*"] = "./Bench/**",
+            ["*"] = "./Code/**"
+        }
+        
+        links {
+            "Ferrite"
+        }
+        
+        configuration "linux"
+            links { "pthread" }
+        configuration {}
+    
+    
+    
     -- ENGINE -------------------------------
 
     include "../Ferrite"
\ No newline at end of file